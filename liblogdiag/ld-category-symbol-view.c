@@ -8,6 +8,8 @@
  *
  */
 
+#include <math.h>
+
 #include "liblogdiag.h"
 #include "config.h"
 
@@ -19,6 +21,11 @@
  *
  * #LdCategorySymbolView allows the user to drag symbols from an #LdCategory
  * onto #LdDiagramView.
+ *
+ * Symbols are rendered into thumbnails once and the layout is only
+ * recomputed when the width of the widget changes.
+ *
+ * A filter can be set to only show some of the symbols.
  */
 
 /* Milimetres per inch. */
@@ -41,6 +48,14 @@ typedef struct
 }
 SymbolData;
 
+typedef struct
+{
+	cairo_surface_t *surface;  /* Alpha mask of the rendered symbol. */
+	gdouble scale;             /* Scale the symbol has been rendered in. */
+	gint x, y;                 /* Position of the surface from the origin. */
+}
+Thumbnail;
+
 /*
  * LdCategorySymbolViewPrivate:
  * @category: a category object assigned as a model.
@@ -48,6 +63,10 @@ SymbolData;
  * @layout: (element-type SymbolData *): current layout of symbols.
  * @preselected: currently preselected symbol.
  * @dragged: currently dragged symbol.
+ * @layout_width: the width that @layout has been made for, or -1.
+ * @layout_height: the height of @layout.
+ * @thumbnails: (element-type LdSymbol * Thumbnail *): rendered symbols.
+ * @filter: (allow-none): paths to the symbols that are to be shown.
  */
 struct _LdCategorySymbolViewPrivate
 {
@@ -56,6 +75,10 @@ struct _LdCategorySymbolViewPrivate
 	GSList *layout;
 	SymbolData *preselected;
 	SymbolData *dragged;
+	gint layout_width;
+	gint layout_height;
+	GHashTable *thumbnails;
+	GHashTable *filter;
 };
 
 enum
@@ -88,6 +111,8 @@ static void ld_category_symbol_view_set_category
 static LdCategory *ld_category_symbol_view_get_category
 	(LdCategoryView *iface);
 
+static void on_symbols_changed (LdCategorySymbolView *self);
+
 
 static void
 ld_category_view_init (LdCategoryViewInterface *iface)
@@ -181,6 +206,7 @@ layout_destroy (LdCategorySymbolView *self)
 	g_slist_foreach (self->priv->layout, (GFunc) symbol_data_free, NULL);
 	g_slist_free (self->priv->layout);
 	self->priv->layout = NULL;
+	self->priv->layout_width = -1;
 	self->priv->preselected = NULL;
 	self->priv->dragged = NULL;
 }
@@ -222,6 +248,10 @@ layout_for_width (LdCategorySymbolView *self, gint width)
 	GSList *symbols, *iter;
 	LayoutContext ctx = {SYMBOL_SPACING, 0, NULL, SYMBOL_SPACING, 0, 0};
 
+	/* Size requests and allocations keep asking for the same width. */
+	if (width == self->priv->layout_width)
+		return self->priv->layout_height;
+
 	layout_destroy (self);
 	ctx.max_width = width;
 
@@ -231,15 +261,24 @@ layout_for_width (LdCategorySymbolView *self, gint width)
 		SymbolData *data;
 		LdRectangle area;
 		LdSymbol *symbol;
+		gchar *path;
 		gint real_width, height_up, height_down;
 
 		symbol = LD_SYMBOL (iter->data);
+		path = g_build_path (LD_LIBRARY_IDENTIFIER_SEPARATOR,
+			self->priv->path, ld_symbol_get_name (symbol), NULL);
+		if (self->priv->filter
+		 && !g_hash_table_contains (self->priv->filter, path))
+		{
+			g_free (path);
+			continue;
+		}
+
 		ld_symbol_get_area (symbol, &area);
 
 		data = g_slice_new (SymbolData);
 		data->symbol = g_object_ref (symbol);
-		data->path = g_build_path (LD_LIBRARY_IDENTIFIER_SEPARATOR,
-			self->priv->path, ld_symbol_get_name (symbol), NULL);
+		data->path = path;
 
 		/* Compute the scale to fit the symbol to an area of
 		 * SYMBOL_WIDTH * SYMBOL_HEIGHT, vertically centred. */
@@ -282,9 +321,60 @@ layout_for_width (LdCategorySymbolView *self, gint width)
 		self->priv->layout = g_slist_concat (self->priv->layout,
 			layout_finish_row (&ctx));
 
+	self->priv->layout_width = width;
+	self->priv->layout_height = ctx.total_height;
 	return ctx.total_height;
 }
 
+static void
+thumbnail_free (Thumbnail *self)
+{
+	cairo_surface_destroy (self->surface);
+	g_slice_free (Thumbnail, self);
+}
+
+/*
+ * get_thumbnail:
+ *
+ * Retrieve a rendering of a symbol, creating it if necessary.
+ */
+static Thumbnail *
+get_thumbnail (LdCategorySymbolView *self, SymbolData *data)
+{
+	Thumbnail *thumbnail;
+	LdRectangle area;
+	cairo_t *cr;
+	gint width, height;
+
+	thumbnail = g_hash_table_lookup (self->priv->thumbnails, data->symbol);
+	if (thumbnail && thumbnail->scale == data->scale)
+		return thumbnail;
+
+	/* Leave a pixel of space around the area for strokes. */
+	ld_symbol_get_area (data->symbol, &area);
+	thumbnail = g_slice_new (Thumbnail);
+	thumbnail->scale = data->scale;
+	thumbnail->x = floor (area.x * data->scale) - 1;
+	thumbnail->y = floor (area.y * data->scale) - 1;
+	width  = ceil ((area.x + area.width)  * data->scale) + 1 - thumbnail->x;
+	height = ceil ((area.y + area.height) * data->scale) + 1 - thumbnail->y;
+
+	thumbnail->surface = gdk_window_create_similar_surface
+		(gtk_widget_get_window (GTK_WIDGET (self)),
+		CAIRO_CONTENT_ALPHA, width, height);
+
+	cr = cairo_create (thumbnail->surface);
+	cairo_translate (cr, -thumbnail->x, -thumbnail->y);
+	cairo_scale (cr, data->scale, data->scale);
+	cairo_set_line_width (cr, 1 / data->scale);
+	ld_symbol_draw (data->symbol, cr);
+	cairo_destroy (cr);
+
+	g_hash_table_replace (self->priv->thumbnails,
+		g_object_ref (data->symbol), thumbnail);
+	return thumbnail;
+}
+
 static GtkSizeRequestMode
 on_get_request_mode (GtkWidget *widget)
 {
@@ -367,6 +457,7 @@ on_draw (GtkWidget *widget, cairo_t *cr)
 	for (iter = self->priv->layout; iter; iter = iter->next)
 	{
 		SymbolData *data;
+		Thumbnail *thumbnail;
 
 		data = iter->data;
 		if (!gdk_rectangle_intersect (&data->rect, &draw_area, NULL))
@@ -387,11 +478,11 @@ on_draw (GtkWidget *widget, cairo_t *cr)
 		gtk_style_context_get_color (context, state, &color);
 		gdk_cairo_set_source_rgba (cr, &color);
 
-		cairo_translate (cr, data->rect.x + data->dx, data->rect.y + data->dy);
-		cairo_scale (cr, data->scale, data->scale);
-
-		cairo_set_line_width (cr, 1 / data->scale);
-		ld_symbol_draw (data->symbol, cr);
+		/* The thumbnail is aligned to whole pixels. */
+		thumbnail = get_thumbnail (self, data);
+		cairo_mask_surface (cr, thumbnail->surface,
+			floor (data->rect.x + data->dx + 0.5) + thumbnail->x,
+			floor (data->rect.y + data->dy + 0.5) + thumbnail->y);
 
 		cairo_restore (cr);
 	}
@@ -507,6 +598,10 @@ ld_category_symbol_view_init (LdCategorySymbolView *self)
 	self->priv = G_TYPE_INSTANCE_GET_PRIVATE
 		(self, LD_TYPE_CATEGORY_SYMBOL_VIEW, LdCategorySymbolViewPrivate);
 
+	self->priv->layout_width = -1;
+	self->priv->thumbnails = g_hash_table_new_full (g_direct_hash,
+		g_direct_equal, g_object_unref, (GDestroyNotify) thumbnail_free);
+
 	g_signal_connect (self, "size-allocate",
 		G_CALLBACK (on_size_allocate), NULL);
 
@@ -536,8 +631,15 @@ ld_category_symbol_view_finalize (GObject *gobject)
 	self = LD_CATEGORY_SYMBOL_VIEW (gobject);
 
 	layout_destroy (self);
+	g_hash_table_destroy (self->priv->thumbnails);
 	if (self->priv->category)
+	{
+		g_signal_handlers_disconnect_by_func (self->priv->category,
+			on_symbols_changed, self);
 		g_object_unref (self->priv->category);
+	}
+	if (self->priv->filter)
+		g_hash_table_unref (self->priv->filter);
 	g_free (self->priv->path);
 
 	/* Chain up to the parent class. */
@@ -605,6 +707,8 @@ ld_category_symbol_view_set_category (LdCategoryView *iface,
 	self = LD_CATEGORY_SYMBOL_VIEW (iface);
 	if (self->priv->category)
 	{
+		g_signal_handlers_disconnect_by_func (self->priv->category,
+			on_symbols_changed, self);
 		g_object_unref (self->priv->category);
 
 		g_free (self->priv->path);
@@ -618,6 +722,13 @@ ld_category_symbol_view_set_category (LdCategoryView *iface,
 	self->priv->category = category;
 	g_object_ref (category);
 
+	layout_destroy (self);
+	g_hash_table_remove_all (self->priv->thumbnails);
+
+	/* Symbols may get reloaded while the view is shown. */
+	g_signal_connect_swapped (category, "symbols-changed",
+		G_CALLBACK (on_symbols_changed), self);
+
 	g_object_notify (G_OBJECT (self), "category");
 	gtk_widget_queue_resize (GTK_WIDGET (self));
 }
@@ -628,3 +739,35 @@ ld_category_symbol_view_get_category (LdCategoryView *iface)
 	g_return_val_if_fail (LD_IS_CATEGORY_SYMBOL_VIEW (iface), NULL);
 	return LD_CATEGORY_SYMBOL_VIEW (iface)->priv->category;
 }
+
+/**
+ * ld_category_symbol_view_set_filter:
+ * @self: an #LdCategorySymbolView object.
+ * @filter: (allow-none): a set of paths to the symbols that are to be shown,
+ *          or %NULL to show all of them.
+ *
+ * Only show some of the symbols in the category.
+ */
+void
+ld_category_symbol_view_set_filter (LdCategorySymbolView *self,
+	GHashTable *filter)
+{
+	g_return_if_fail (LD_IS_CATEGORY_SYMBOL_VIEW (self));
+
+	if (filter)
+		g_hash_table_ref (filter);
+	if (self->priv->filter)
+		g_hash_table_unref (self->priv->filter);
+	self->priv->filter = filter;
+
+	layout_destroy (self);
+	gtk_widget_queue_resize (GTK_WIDGET (self));
+}
+
+static void
+on_symbols_changed (LdCategorySymbolView *self)
+{
+	layout_destroy (self);
+	g_hash_table_remove_all (self->priv->thumbnails);
+	gtk_widget_queue_resize (GTK_WIDGET (self));
+}
@@ -57,6 +57,8 @@ struct _LdCategorySymbolViewClass
 GType ld_category_symbol_view_get_type (void) G_GNUC_CONST;
 
 GtkWidget *ld_category_symbol_view_new (LdCategory *category);
+void ld_category_symbol_view_set_filter (LdCategorySymbolView *self,
+	GHashTable *filter);
 
 
 G_END_DECLS
@@ -19,17 +19,30 @@
  *
  * #LdCategoryTreeView enables the user to drag symbols from #LdLibrary
  * onto #LdDiagramView.
+ *
+ * Subcategories are shown collapsed and their contents are only created
+ * once they're expanded, so that large libraries stay cheap to browse.
+ * When a filter is set, only matching symbols and the categories leading
+ * to them are shown, expanded.
  */
 
+/* The category of an expander. */
+#define EXPANDER_CATEGORY_KEY "ld-category"
+
 /*
  * LdCategoryTreeViewPrivate:
  * @category: a category object assigned as a model.
  * @expander_prefix: a string to prepend to subcategory labels in expanders.
+ * @filter: (allow-none): paths to symbols and categories to be shown.
+ * @expanded: (allow-none): names of subcategories that had been expanded
+ *            before a filter was set.
  */
 struct _LdCategoryTreeViewPrivate
 {
 	LdCategory *category;
 	gchar *expander_prefix;
+	GHashTable *filter;
+	GHashTable *expanded;
 };
 
 enum
@@ -48,6 +61,9 @@ static void ld_category_tree_view_set_category (LdCategoryView *iface,
 	LdCategory *category);
 static LdCategory *ld_category_tree_view_get_category (LdCategoryView *iface);
 
+static void on_expander_expanded (GtkExpander *expander, GParamSpec *pspec,
+	LdCategoryTreeView *self);
+
 
 static void
 ld_category_view_init (LdCategoryViewInterface *iface)
@@ -94,6 +110,13 @@ ld_category_tree_view_dispose (GObject *gobject)
 	g_free (self->priv->expander_prefix);
 	self->priv->expander_prefix = NULL;
 
+	if (self->priv->filter)
+		g_hash_table_unref (self->priv->filter);
+	self->priv->filter = NULL;
+	if (self->priv->expanded)
+		g_hash_table_destroy (self->priv->expanded);
+	self->priv->expanded = NULL;
+
 	/* Chain up to the parent class. */
 	G_OBJECT_CLASS (ld_category_tree_view_parent_class)->dispose (gobject);
 }
@@ -209,13 +232,47 @@ on_symbol_deselected (GObject *source,
 		symbol_deselected_signal, 0, symbol, path);
 }
 
+/*
+ * is_shown:
+ *
+ * Check whether a symbol or a category passes the filter.
+ */
+static gboolean
+is_shown (LdCategoryTreeView *self, const gchar *path)
+{
+	return !self->priv->filter
+		|| g_hash_table_contains (self->priv->filter, path);
+}
+
+static gboolean
+has_shown_symbols (LdCategoryTreeView *self, const GSList *symbols)
+{
+	gchar *path, *symbol_path;
+	gboolean found = FALSE;
+
+	if (!self->priv->filter)
+		return symbols != NULL;
+
+	path = ld_category_get_path (self->priv->category);
+	for (; symbols && !found; symbols = symbols->next)
+	{
+		symbol_path = g_build_path (LD_LIBRARY_IDENTIFIER_SEPARATOR,
+			path, ld_symbol_get_name (LD_SYMBOL (symbols->data)), NULL);
+		found = is_shown (self, symbol_path);
+		g_free (symbol_path);
+	}
+	g_free (path);
+	return found;
+}
+
 static void
 load_category_cb (gpointer data, gpointer user_data)
 {
 	LdCategoryTreeView *self;
 	LdCategory *cat;
 	GtkWidget *expander, *child;
-	gchar *name, *label_markup;
+	gchar *name, *label_markup, *path;
+	gboolean shown;
 
 	g_return_if_fail (LD_IS_CATEGORY_TREE_VIEW (user_data));
 	g_return_if_fail (LD_IS_CATEGORY (data));
@@ -223,30 +280,119 @@ load_category_cb (gpointer data, gpointer user_data)
 	self = user_data;
 	cat = data;
 
+	path = ld_category_get_path (cat);
+	shown = is_shown (self, path);
+	g_free (path);
+	if (!shown)
+		return;
+
 	name = g_markup_escape_text (ld_category_get_human_name (cat), -1);
 	label_markup = g_strconcat (self->priv->expander_prefix, name, NULL);
 	g_free (name);
 
 	expander = gtk_expander_new (label_markup);
-	gtk_expander_set_expanded (GTK_EXPANDER (expander), TRUE);
 	gtk_expander_set_use_markup (GTK_EXPANDER (expander), TRUE);
 	g_free (label_markup);
 
-	child = ld_category_tree_view_new (cat);
-	gtk_container_add (GTK_CONTAINER (expander), child);
+	g_object_set_data_full (G_OBJECT (expander), EXPANDER_CATEGORY_KEY,
+		g_object_ref (cat), g_object_unref);
+	g_signal_connect (expander, "notify::expanded",
+		G_CALLBACK (on_expander_expanded), self);
+
 	gtk_box_pack_start (GTK_BOX (self), expander, FALSE, FALSE, 0);
 
+	/* Everything that passes the filter leads to a matching symbol. */
+	if (self->priv->filter)
+		gtk_expander_set_expanded (GTK_EXPANDER (expander), TRUE);
+}
+
+/*
+ * on_expander_expanded:
+ *
+ * Create the contents of a subcategory the first time it's expanded.
+ */
+static void
+on_expander_expanded (GtkExpander *expander, GParamSpec *pspec,
+	LdCategoryTreeView *self)
+{
+	LdCategory *cat;
+	GtkWidget *child;
+
+	if (!gtk_expander_get_expanded (expander)
+	 || gtk_bin_get_child (GTK_BIN (expander)))
+		return;
+
+	cat = g_object_get_data (G_OBJECT (expander), EXPANDER_CATEGORY_KEY);
+	child = g_object_new (LD_TYPE_CATEGORY_TREE_VIEW, NULL);
+	ld_category_tree_view_set_filter
+		(LD_CATEGORY_TREE_VIEW (child), self->priv->filter);
+	ld_category_view_set_category (LD_CATEGORY_VIEW (child), cat);
+	gtk_container_add (GTK_CONTAINER (expander), child);
+	gtk_widget_show_all (child);
+
 	g_signal_connect_after (child, "symbol-selected",
 		G_CALLBACK (on_symbol_selected), self);
 	g_signal_connect_after (child, "symbol-deselected",
 		G_CALLBACK (on_symbol_deselected), self);
 }
 
+/*
+ * save_expanded_cb:
+ *
+ * Remember which subcategories have been expanded.
+ */
+static void
+save_expanded_cb (GtkWidget *widget, gpointer user_data)
+{
+	LdCategory *cat;
+
+	if (!GTK_IS_EXPANDER (widget)
+	 || !gtk_expander_get_expanded (GTK_EXPANDER (widget)))
+		return;
+
+	cat = g_object_get_data (G_OBJECT (widget), EXPANDER_CATEGORY_KEY);
+	g_hash_table_add (user_data, g_strdup (ld_category_get_name (cat)));
+}
+
+/*
+ * restore_expanded_cb:
+ *
+ * Expand subcategories that have been expanded before a reload.
+ */
+static void
+restore_expanded_cb (GtkWidget *widget, gpointer user_data)
+{
+	LdCategory *cat;
+
+	if (!GTK_IS_EXPANDER (widget))
+		return;
+
+	cat = g_object_get_data (G_OBJECT (widget), EXPANDER_CATEGORY_KEY);
+	if (g_hash_table_contains (user_data, ld_category_get_name (cat)))
+		gtk_expander_set_expanded (GTK_EXPANDER (widget), TRUE);
+}
+
 static void
 reload_category (LdCategoryTreeView *self)
 {
+	GHashTable *expanded;
+
 	g_return_if_fail (LD_IS_CATEGORY_TREE_VIEW (self));
 
+	/* Return to the state from before filtering once it's over. */
+	if (self->priv->filter || !self->priv->expanded)
+	{
+		expanded = g_hash_table_new_full (g_str_hash, g_str_equal,
+			g_free, NULL);
+		gtk_container_foreach (GTK_CONTAINER (self),
+			save_expanded_cb, expanded);
+	}
+	else
+	{
+		expanded = self->priv->expanded;
+		self->priv->expanded = NULL;
+	}
+
 	/* Clear the container first, if there is already something in it. */
 	gtk_container_foreach (GTK_CONTAINER (self),
 		(GtkCallback) gtk_widget_destroy, NULL);
@@ -260,11 +406,13 @@ reload_category (LdCategoryTreeView *self)
 		symbols  = (GSList *) ld_category_get_symbols  (self->priv->category);
 		children = (GSList *) ld_category_get_children (self->priv->category);
 
-		if (symbols)
+		if (has_shown_symbols (self, symbols))
 		{
 			GtkWidget *symbol_view;
 
 			symbol_view = ld_category_symbol_view_new (self->priv->category);
+			ld_category_symbol_view_set_filter
+				(LD_CATEGORY_SYMBOL_VIEW (symbol_view), self->priv->filter);
 			gtk_box_pack_start (GTK_BOX (self), symbol_view, FALSE, FALSE, 0);
 
 			g_signal_connect_after (symbol_view, "symbol-selected",
@@ -277,11 +425,19 @@ reload_category (LdCategoryTreeView *self)
 		{
 			reconstruct_prefix (self);
 			g_slist_foreach (children, load_category_cb, self);
+			if (!self->priv->filter)
+				gtk_container_foreach (GTK_CONTAINER (self),
+					restore_expanded_cb, expanded);
 		}
 		else if (!symbols)
 			gtk_box_pack_start (GTK_BOX (self),
 				create_empty_label (), FALSE, FALSE, 0);
 	}
+
+	/* The view may have already been shown. */
+	gtk_container_foreach (GTK_CONTAINER (self),
+		(GtkCallback) gtk_widget_show_all, NULL);
+	g_hash_table_destroy (expanded);
 }
 
 /* ===== Interface ========================================================= */
@@ -340,3 +496,38 @@ ld_category_tree_view_get_category (LdCategoryView *iface)
 	g_return_val_if_fail (LD_IS_CATEGORY_TREE_VIEW (iface), NULL);
 	return LD_CATEGORY_TREE_VIEW (iface)->priv->category;
 }
+
+/**
+ * ld_category_tree_view_set_filter:
+ * @self: an #LdCategoryTreeView object.
+ * @filter: (allow-none): a set of paths to the symbols that are to be shown,
+ *          along with paths to all categories leading to them, or %NULL
+ *          to show everything.
+ *
+ * Only show some of the symbols in the category tree.
+ */
+void
+ld_category_tree_view_set_filter (LdCategoryTreeView *self,
+	GHashTable *filter)
+{
+	g_return_if_fail (LD_IS_CATEGORY_TREE_VIEW (self));
+
+	if (!filter && !self->priv->filter)
+		return;
+
+	if (filter && !self->priv->filter && !self->priv->expanded)
+	{
+		self->priv->expanded = g_hash_table_new_full (g_str_hash,
+			g_str_equal, g_free, NULL);
+		gtk_container_foreach (GTK_CONTAINER (self),
+			save_expanded_cb, self->priv->expanded);
+	}
+
+	if (filter)
+		g_hash_table_ref (filter);
+	if (self->priv->filter)
+		g_hash_table_unref (self->priv->filter);
+	self->priv->filter = filter;
+
+	reload_category (self);
+}
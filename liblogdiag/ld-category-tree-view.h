@@ -57,6 +57,8 @@ struct _LdCategoryTreeViewClass
 GType ld_category_tree_view_get_type (void) G_GNUC_CONST;
 
 GtkWidget *ld_category_tree_view_new (LdCategory *category);
+void ld_category_tree_view_set_filter (LdCategoryTreeView *self,
+	GHashTable *filter);
 
 
 G_END_DECLS
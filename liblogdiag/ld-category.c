@@ -27,6 +27,9 @@
  * @human_name: the localized human-readable name of this category.
  * @symbols: (element-type LdSymbol *): symbols in this category.
  * @subcategories: (element-type LdCategory *) children of this category.
+ * @loader: a function to insert symbols when they're first asked for.
+ * @loader_data: user data for @loader.
+ * @loader_destroy: destroy notification for @loader_data.
  */
 struct _LdCategoryPrivate
 {
@@ -35,6 +38,10 @@ struct _LdCategoryPrivate
 	gchar *human_name;
 	GSList *symbols;
 	GSList *subcategories;
+
+	LdCategoryLoadFunc loader;
+	gpointer loader_data;
+	GDestroyNotify loader_destroy;
 };
 
 enum
@@ -53,6 +60,7 @@ static void ld_category_finalize (GObject *gobject);
 
 static void on_category_notify_name (LdCategory *category,
 	GParamSpec *pspec, gpointer user_data);
+static void unset_loader (LdCategory *self);
 
 
 G_DEFINE_TYPE (LdCategory, ld_category, G_TYPE_OBJECT)
@@ -211,6 +219,8 @@ ld_category_finalize (GObject *gobject)
 		g_object_weak_unref
 			(G_OBJECT (self->priv->parent), parent_weak_notify, self);
 
+	unset_loader (self);
+
 	if (self->priv->name)
 		g_free (self->priv->name);
 	if (self->priv->human_name)
@@ -377,6 +387,44 @@ ld_category_remove_symbol (LdCategory *self, LdSymbol *symbol)
 	}
 }
 
+/**
+ * ld_category_replace_symbol:
+ * @self: an #LdCategory object.
+ * @old_symbol: the symbol to be replaced.
+ * @new_symbol: the symbol to take its place.
+ *
+ * Put a symbol in place of another one while keeping its position.
+ *
+ * Return value: %TRUE if successful.
+ */
+gboolean
+ld_category_replace_symbol (LdCategory *self,
+	LdSymbol *old_symbol, LdSymbol *new_symbol)
+{
+	GSList *link;
+
+	g_return_val_if_fail (LD_IS_CATEGORY (self), FALSE);
+	g_return_val_if_fail (LD_IS_SYMBOL (old_symbol), FALSE);
+	g_return_val_if_fail (LD_IS_SYMBOL (new_symbol), FALSE);
+
+	if (!(link = g_slist_find (self->priv->symbols, old_symbol)))
+		return FALSE;
+	if (strcmp (ld_symbol_get_name (old_symbol),
+		ld_symbol_get_name (new_symbol)))
+	{
+		g_warning ("attempted to replace symbol `%s' with `%s'",
+			ld_symbol_get_name (old_symbol), ld_symbol_get_name (new_symbol));
+		return FALSE;
+	}
+
+	link->data = g_object_ref (new_symbol);
+	g_object_unref (old_symbol);
+
+	g_signal_emit (self,
+		LD_CATEGORY_GET_CLASS (self)->symbols_changed_signal, 0);
+	return TRUE;
+}
+
 /**
  * ld_category_get_symbols:
  * @self: an #LdCategory object.
@@ -386,10 +434,66 @@ ld_category_remove_symbol (LdCategory *self, LdSymbol *symbol)
 const GSList *
 ld_category_get_symbols (LdCategory *self)
 {
+	LdCategoryLoadFunc loader;
+
 	g_return_val_if_fail (LD_IS_CATEGORY (self), NULL);
+
+	if ((loader = self->priv->loader))
+	{
+		/* Make sure the loader is only ever called once. */
+		self->priv->loader = NULL;
+		loader (self, self->priv->loader_data);
+		unset_loader (self);
+	}
 	return self->priv->symbols;
 }
 
+/**
+ * ld_category_set_loader:
+ * @self: an #LdCategory object.
+ * @loader: (allow-none): a function to insert symbols into the category.
+ * @user_data: user data to be passed to @loader.
+ * @destroy: (allow-none): destroy notification for @user_data.
+ *
+ * Defer loading of symbols until they're first asked for
+ * by ld_category_get_symbols().  Any previous loader is discarded.
+ */
+void
+ld_category_set_loader (LdCategory *self, LdCategoryLoadFunc loader,
+	gpointer user_data, GDestroyNotify destroy)
+{
+	g_return_if_fail (LD_IS_CATEGORY (self));
+
+	unset_loader (self);
+	self->priv->loader = loader;
+	self->priv->loader_data = user_data;
+	self->priv->loader_destroy = destroy;
+}
+
+/**
+ * ld_category_is_loaded:
+ * @self: an #LdCategory object.
+ *
+ * Return value: %FALSE if symbols still wait to be loaded.
+ */
+gboolean
+ld_category_is_loaded (LdCategory *self)
+{
+	g_return_val_if_fail (LD_IS_CATEGORY (self), TRUE);
+	return self->priv->loader == NULL;
+}
+
+static void
+unset_loader (LdCategory *self)
+{
+	if (self->priv->loader_destroy)
+		self->priv->loader_destroy (self->priv->loader_data);
+
+	self->priv->loader = NULL;
+	self->priv->loader_data = NULL;
+	self->priv->loader_destroy = NULL;
+}
+
 /**
  * ld_category_set_parent:
  * @self: an #LdCategory object.
@@ -51,6 +51,16 @@ struct _LdCategoryClass
 };
 
 
+/**
+ * LdCategoryLoadFunc:
+ * @category: the category to insert symbols into.
+ * @user_data: user data passed to ld_category_set_loader().
+ *
+ * A function that loads symbols into a category on demand.
+ */
+typedef void (*LdCategoryLoadFunc) (LdCategory *category, gpointer user_data);
+
+
 GType ld_category_get_type (void) G_GNUC_CONST;
 
 LdCategory *ld_category_new (const gchar *name, const gchar *human_name);
@@ -63,7 +73,12 @@ const gchar *ld_category_get_human_name (LdCategory *self);
 gboolean ld_category_insert_symbol (LdCategory *self,
 	LdSymbol *symbol, gint pos);
 void ld_category_remove_symbol (LdCategory *self, LdSymbol *symbol);
+gboolean ld_category_replace_symbol (LdCategory *self,
+	LdSymbol *old_symbol, LdSymbol *new_symbol);
 const GSList *ld_category_get_symbols (LdCategory *self);
+void ld_category_set_loader (LdCategory *self, LdCategoryLoadFunc loader,
+	gpointer user_data, GDestroyNotify destroy);
+gboolean ld_category_is_loaded (LdCategory *self);
 
 void ld_category_set_parent (LdCategory *self, LdCategory *parent);
 LdCategory *ld_category_get_parent (LdCategory *self);
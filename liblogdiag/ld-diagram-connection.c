@@ -287,6 +287,7 @@ ld_diagram_connection_set_points (LdDiagramConnection *self,
 	json_node_take_array (node, array);
 	action_data->new_node = json_node_copy (node);
 
+	ld_diagram_object_about_to_change (LD_DIAGRAM_OBJECT (self));
 	json_object_set_member (storage, "points", node);
 
 	action = ld_undo_action_new (on_set_points_undo, on_set_points_redo,
@@ -304,7 +305,9 @@ on_set_points_undo (gpointer user_data)
 	data = user_data;
 	storage = ld_diagram_object_get_storage (LD_DIAGRAM_OBJECT (data->self));
 
+	ld_diagram_object_about_to_change (LD_DIAGRAM_OBJECT (data->self));
 	json_object_set_member (storage, "points", json_node_copy (data->old_node));
+	g_object_notify (G_OBJECT (data->self), "points");
 }
 
 static void
@@ -316,7 +319,9 @@ on_set_points_redo (gpointer user_data)
 	data = user_data;
 	storage = ld_diagram_object_get_storage (LD_DIAGRAM_OBJECT (data->self));
 
+	ld_diagram_object_about_to_change (LD_DIAGRAM_OBJECT (data->self));
 	json_object_set_member (storage, "points", json_node_copy (data->new_node));
+	g_object_notify (G_OBJECT (data->self), "points");
 }
 
 static void
@@ -0,0 +1,478 @@
+/*
+ * ld-diagram-diff.c
+ *
+ * This file is a part of logdiag.
+ * Copyright 2026 Přemysl Eric Janouch
+ *
+ * See the file LICENSE for licensing information.
+ *
+ */
+
+#include <string.h>
+
+#include "liblogdiag.h"
+#include "config.h"
+
+
+/**
+ * SECTION:ld-diagram-diff
+ * @short_description: Comparing and merging diagrams
+ * @see_also: #LdDiagram
+ *
+ * Objects of two diagrams are paired by their identifiers first.
+ * The rest is paired by their contents and positions, and then by
+ * their contents alone, which makes it possible to compare files where
+ * objects have been given different identifiers.  Each step takes
+ * time linear in the number of objects.
+ */
+
+static GHashTable *match_objects (LdDiagram *old_diagram,
+	LdDiagram *new_diagram);
+static void index_add (GHashTable *index, guint64 key, gpointer object);
+static gpointer index_take (GHashTable *index, guint64 key,
+	GHashTable *taken);
+static guint64 get_position_key (LdDiagramObject *object);
+
+static LdDiagramChangeFlags compare_objects (LdDiagramObject *old_object,
+	LdDiagramObject *new_object);
+static LdDiagramChange *change_new (LdDiagramChangeFlags flags,
+	LdDiagramObject *old_object, LdDiagramObject *new_object);
+static void change_free (gpointer data);
+
+static LdDiagramObject *merge_objects (LdDiagramObject *base,
+	LdDiagramObject *ours, LdDiagramObject *theirs, guint *conflicts);
+static LdDiagramObject *copy_object (LdDiagramObject *object);
+
+
+/*
+ * match_objects:
+ *
+ * Return value: a table mapping objects of the old diagram
+ *               to their counterparts in the new one.
+ */
+static GHashTable *
+match_objects (LdDiagram *old_diagram, LdDiagram *new_diagram)
+{
+	GHashTable *map, *taken, *exact, *loose;
+	GPtrArray *unmatched, *rest;
+	LdDiagramObject *object, *match;
+	GList *iter;
+	guint i;
+
+	map = g_hash_table_new (g_direct_hash, g_direct_equal);
+	taken = g_hash_table_new (g_direct_hash, g_direct_equal);
+	unmatched = g_ptr_array_new ();
+
+	for (iter = ld_diagram_get_objects (old_diagram); iter;
+		iter = g_list_next (iter))
+	{
+		const gchar *id;
+
+		object = iter->data;
+		id = ld_diagram_object_get_id (object);
+		match = id ? ld_diagram_find_object (new_diagram, id) : NULL;
+		if (!match)
+		{
+			g_ptr_array_add (unmatched, object);
+			continue;
+		}
+		g_hash_table_insert (map, object, match);
+		g_hash_table_add (taken, match);
+	}
+
+	if (!unmatched->len)
+		goto match_objects_end;
+
+	exact = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+		g_free, (GDestroyNotify) g_queue_free);
+	loose = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+		g_free, (GDestroyNotify) g_queue_free);
+	for (iter = ld_diagram_get_objects (new_diagram); iter;
+		iter = g_list_next (iter))
+	{
+		guint64 hash;
+
+		if (g_hash_table_contains (taken, iter->data))
+			continue;
+
+		hash = ld_diagram_object_get_content_hash (iter->data);
+		index_add (exact, hash ^ get_position_key (iter->data), iter->data);
+		index_add (loose, hash, iter->data);
+	}
+
+	/* Objects that stayed where they were take precedence. */
+	rest = g_ptr_array_new ();
+	for (i = 0; i < unmatched->len; i++)
+	{
+		guint64 hash;
+
+		object = g_ptr_array_index (unmatched, i);
+		hash = ld_diagram_object_get_content_hash (object);
+		match = index_take (exact, hash ^ get_position_key (object), taken);
+		if (match)
+			g_hash_table_insert (map, object, match);
+		else
+			g_ptr_array_add (rest, object);
+	}
+	for (i = 0; i < rest->len; i++)
+	{
+		object = g_ptr_array_index (rest, i);
+		match = index_take (loose,
+			ld_diagram_object_get_content_hash (object), taken);
+		if (match)
+			g_hash_table_insert (map, object, match);
+	}
+
+	g_ptr_array_free (rest, TRUE);
+	g_hash_table_destroy (exact);
+	g_hash_table_destroy (loose);
+
+match_objects_end:
+	g_ptr_array_free (unmatched, TRUE);
+	g_hash_table_destroy (taken);
+	return map;
+}
+
+static void
+index_add (GHashTable *index, guint64 key, gpointer object)
+{
+	GQueue *queue;
+
+	queue = g_hash_table_lookup (index, &key);
+	if (!queue)
+	{
+		queue = g_queue_new ();
+		g_hash_table_insert (index, g_memdup (&key, sizeof key), queue);
+	}
+	g_queue_push_tail (queue, object);
+}
+
+static gpointer
+index_take (GHashTable *index, guint64 key, GHashTable *taken)
+{
+	GQueue *queue;
+	gpointer object;
+
+	queue = g_hash_table_lookup (index, &key);
+	if (!queue)
+		return NULL;
+
+	/* The object may have been paired through the other index already. */
+	while ((object = g_queue_pop_head (queue)))
+		if (!g_hash_table_contains (taken, object))
+		{
+			g_hash_table_add (taken, object);
+			return object;
+		}
+	return NULL;
+}
+
+static guint64
+get_position_key (LdDiagramObject *object)
+{
+	gdouble x, y;
+	guint64 x_bits, y_bits;
+
+	x = ld_diagram_object_get_x (object) + 0.0;
+	y = ld_diagram_object_get_y (object) + 0.0;
+	memcpy (&x_bits, &x, sizeof x);
+	memcpy (&y_bits, &y, sizeof y);
+	return (x_bits * G_GUINT64_CONSTANT (0x9e3779b97f4a7c15))
+		^ (y_bits * G_GUINT64_CONSTANT (0xc2b2ae3d27d4eb4f));
+}
+
+static LdDiagramChangeFlags
+compare_objects (LdDiagramObject *old_object, LdDiagramObject *new_object)
+{
+	LdDiagramChangeFlags flags = 0;
+
+	if (ld_diagram_object_get_x (old_object)
+		!= ld_diagram_object_get_x (new_object)
+		|| ld_diagram_object_get_y (old_object)
+		!= ld_diagram_object_get_y (new_object))
+		flags |= LD_DIAGRAM_CHANGE_MOVED;
+	if (ld_diagram_object_get_content_hash (old_object)
+		!= ld_diagram_object_get_content_hash (new_object))
+		flags |= LD_DIAGRAM_CHANGE_MODIFIED;
+	return flags;
+}
+
+static LdDiagramChange *
+change_new (LdDiagramChangeFlags flags,
+	LdDiagramObject *old_object, LdDiagramObject *new_object)
+{
+	LdDiagramChange *self;
+
+	self = g_slice_new (LdDiagramChange);
+	self->flags = flags;
+	self->old_object = old_object ? g_object_ref (old_object) : NULL;
+	self->new_object = new_object ? g_object_ref (new_object) : NULL;
+	return self;
+}
+
+static void
+change_free (gpointer data)
+{
+	LdDiagramChange *self;
+
+	self = data;
+	if (self->old_object)
+		g_object_unref (self->old_object);
+	if (self->new_object)
+		g_object_unref (self->new_object);
+	g_slice_free (LdDiagramChange, self);
+}
+
+/**
+ * ld_diagram_diff:
+ * @old_diagram: an #LdDiagram object.
+ * @new_diagram: another #LdDiagram object.
+ *
+ * Find out how objects differ between two diagrams.  Objects are
+ * reported in the order of the old diagram, added ones come last.
+ *
+ * Return value: (transfer full) (element-type LdDiagramChange):
+ *               changes to objects that aren't the same in both diagrams.
+ */
+GPtrArray *
+ld_diagram_diff (LdDiagram *old_diagram, LdDiagram *new_diagram)
+{
+	GPtrArray *changes;
+	GHashTable *map, *matched;
+	LdDiagramObject *match;
+	LdDiagramChangeFlags flags;
+	GList *iter;
+
+	g_return_val_if_fail (LD_IS_DIAGRAM (old_diagram), NULL);
+	g_return_val_if_fail (LD_IS_DIAGRAM (new_diagram), NULL);
+
+	changes = g_ptr_array_new_with_free_func (change_free);
+	map = match_objects (old_diagram, new_diagram);
+	matched = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	for (iter = ld_diagram_get_objects (old_diagram); iter;
+		iter = g_list_next (iter))
+	{
+		match = g_hash_table_lookup (map, iter->data);
+		if (!match)
+		{
+			g_ptr_array_add (changes,
+				change_new (LD_DIAGRAM_CHANGE_REMOVED, iter->data, NULL));
+			continue;
+		}
+
+		g_hash_table_add (matched, match);
+		flags = compare_objects (iter->data, match);
+		if (flags)
+			g_ptr_array_add (changes, change_new (flags, iter->data, match));
+	}
+
+	for (iter = ld_diagram_get_objects (new_diagram); iter;
+		iter = g_list_next (iter))
+		if (!g_hash_table_contains (matched, iter->data))
+			g_ptr_array_add (changes,
+				change_new (LD_DIAGRAM_CHANGE_ADDED, NULL, iter->data));
+
+	g_hash_table_destroy (matched);
+	g_hash_table_destroy (map);
+	return changes;
+}
+
+/**
+ * ld_diagram_merge:
+ * @self: an #LdDiagram object with our changes.
+ * @base: the common ancestor of both versions.
+ * @theirs: the diagram with their changes.
+ *
+ * Apply changes that have been made between @base and @theirs to
+ * the diagram, as a single user action.  Parameters of objects that
+ * have been changed in both versions are merged one by one.  Where
+ * the versions disagree, our changes are kept and a conflict is counted.
+ *
+ * Return value: the number of conflicts.
+ */
+guint
+ld_diagram_merge (LdDiagram *self, LdDiagram *base, LdDiagram *theirs)
+{
+	GHashTable *ours_map, *theirs_map, *matched, *positions;
+	GPtrArray *removed, *added;
+	LdDiagramObject *ours, *their, *merged;
+	GList *iter;
+	guint conflicts, i;
+
+	g_return_val_if_fail (LD_IS_DIAGRAM (self), 0);
+	g_return_val_if_fail (LD_IS_DIAGRAM (base), 0);
+	g_return_val_if_fail (LD_IS_DIAGRAM (theirs), 0);
+
+	ours_map = match_objects (base, self);
+	theirs_map = match_objects (base, theirs);
+
+	/* Replacing objects in place doesn't shift any positions. */
+	positions = g_hash_table_new (g_direct_hash, g_direct_equal);
+	i = 0;
+	for (iter = ld_diagram_get_objects (self); iter; iter = g_list_next (iter))
+		g_hash_table_insert (positions, iter->data, GUINT_TO_POINTER (i++));
+
+	ld_diagram_begin_user_action (self);
+
+	conflicts = 0;
+	matched = g_hash_table_new (g_direct_hash, g_direct_equal);
+	removed = g_ptr_array_new ();
+	for (iter = ld_diagram_get_objects (base); iter; iter = g_list_next (iter))
+	{
+		ours = g_hash_table_lookup (ours_map, iter->data);
+		their = g_hash_table_lookup (theirs_map, iter->data);
+		if (their)
+			g_hash_table_add (matched, their);
+
+		if (!their)
+		{
+			/* They have removed it, we may have changed it. */
+			if (ours && compare_objects (iter->data, ours))
+				conflicts++;
+			else if (ours)
+				g_ptr_array_add (removed, ours);
+		}
+		else if (!compare_objects (iter->data, their))
+			continue;
+		else if (!ours)
+			/* They have changed it, we have removed it. */
+			conflicts++;
+		else if ((merged = merge_objects
+			(iter->data, ours, their, &conflicts)))
+		{
+			ld_diagram_remove_object (self, ours);
+			ld_diagram_insert_object (self, merged,
+				GPOINTER_TO_UINT (g_hash_table_lookup (positions, ours)));
+			g_object_unref (merged);
+		}
+	}
+	ld_diagram_remove_objects (self,
+		(LdDiagramObject **) removed->pdata, removed->len);
+
+	added = g_ptr_array_new_with_free_func (g_object_unref);
+	for (iter = ld_diagram_get_objects (theirs); iter;
+		iter = g_list_next (iter))
+	{
+		if (g_hash_table_contains (matched, iter->data))
+			continue;
+
+		/* We might have picked up the very same object. */
+		ours = ld_diagram_find_object (self,
+			ld_diagram_object_get_id (iter->data));
+		if (!ours || compare_objects (ours, iter->data))
+			g_ptr_array_add (added, copy_object (iter->data));
+	}
+	ld_diagram_insert_objects (self,
+		(LdDiagramObject **) added->pdata, added->len, -1);
+
+	ld_diagram_end_user_action (self);
+
+	g_ptr_array_free (added, TRUE);
+	g_ptr_array_free (removed, TRUE);
+	g_hash_table_destroy (matched);
+	g_hash_table_destroy (positions);
+	g_hash_table_destroy (theirs_map);
+	g_hash_table_destroy (ours_map);
+	return conflicts;
+}
+
+/*
+ * merge_objects:
+ *
+ * Merge parameters of an object that has been changed in both versions.
+ *
+ * Return value: a new object to replace ours with,
+ *               or %NULL if it should be kept as it is.
+ */
+static LdDiagramObject *
+merge_objects (LdDiagramObject *base, LdDiagramObject *ours,
+	LdDiagramObject *theirs, guint *conflicts)
+{
+	JsonObject *storage, *ours_storage, *theirs_storage;
+	LdDiagramObject *objects[] = {base, ours, theirs};
+	LdDiagramObject *merged;
+	GHashTable *names;
+	GHashTableIter iter;
+	gpointer name;
+	gboolean changed;
+	guint i;
+
+	names = g_hash_table_new (g_str_hash, g_str_equal);
+	for (i = 0; i < G_N_ELEMENTS (objects); i++)
+	{
+		GList *members, *member;
+
+		members = json_object_get_members
+			(ld_diagram_object_get_storage (objects[i]));
+		for (member = members; member; member = g_list_next (member))
+			g_hash_table_add (names, member->data);
+		g_list_free (members);
+	}
+
+	ours_storage = ld_diagram_object_get_storage (ours);
+	theirs_storage = ld_diagram_object_get_storage (theirs);
+	storage = json_object_new ();
+	changed = FALSE;
+
+	g_hash_table_iter_init (&iter, names);
+	while (g_hash_table_iter_next (&iter, &name, NULL))
+	{
+		guint64 base_hash, ours_hash, theirs_hash;
+		JsonObject *source;
+
+		base_hash = ld_diagram_object_get_member_hash (base, name);
+		ours_hash = ld_diagram_object_get_member_hash (ours, name);
+		theirs_hash = ld_diagram_object_get_member_hash (theirs, name);
+
+		/* Our identifier stays, whatever theirs is. */
+		source = ours_storage;
+		if (!strcmp (name, "id"))
+			;
+		else if (ours_hash == base_hash && theirs_hash != ours_hash)
+		{
+			source = theirs_storage;
+			changed = TRUE;
+		}
+		else if (theirs_hash != base_hash && theirs_hash != ours_hash)
+			(*conflicts)++;
+
+		if (json_object_has_member (source, name))
+			json_object_set_member (storage, name,
+				json_node_copy (json_object_get_member (source, name)));
+	}
+	g_hash_table_destroy (names);
+
+	merged = NULL;
+	if (changed)
+		merged = g_object_new (G_OBJECT_TYPE (ours),
+			"storage", storage, NULL);
+	json_object_unref (storage);
+	return merged;
+}
+
+/*
+ * copy_object:
+ *
+ * Parameters are never modified in place, only replaced,
+ * so they don't need to be copied any deeper.
+ */
+static LdDiagramObject *
+copy_object (LdDiagramObject *object)
+{
+	JsonObject *storage, *copy;
+	LdDiagramObject *self;
+	GList *members, *iter;
+
+	storage = ld_diagram_object_get_storage (object);
+	copy = json_object_new ();
+	members = json_object_get_members (storage);
+	for (iter = members; iter; iter = g_list_next (iter))
+		json_object_set_member (copy, iter->data,
+			json_node_copy (json_object_get_member (storage, iter->data)));
+	g_list_free (members);
+
+	self = g_object_new (G_OBJECT_TYPE (object), "storage", copy, NULL);
+	json_object_unref (copy);
+	return self;
+}
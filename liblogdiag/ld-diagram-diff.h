@@ -0,0 +1,59 @@
+/*
+ * ld-diagram-diff.h
+ *
+ * This file is a part of logdiag.
+ * Copyright 2026 Přemysl Eric Janouch
+ *
+ * See the file LICENSE for licensing information.
+ *
+ */
+
+#ifndef __LD_DIAGRAM_DIFF_H__
+#define __LD_DIAGRAM_DIFF_H__
+
+G_BEGIN_DECLS
+
+
+/**
+ * LdDiagramChangeFlags:
+ * @LD_DIAGRAM_CHANGE_ADDED: the object has been added.
+ * @LD_DIAGRAM_CHANGE_REMOVED: the object has been removed.
+ * @LD_DIAGRAM_CHANGE_MOVED: the object has changed its position.
+ * @LD_DIAGRAM_CHANGE_MODIFIED: other parameters of the object have changed.
+ *
+ * What has happened to an object between two versions of a diagram.
+ */
+typedef enum
+{
+	LD_DIAGRAM_CHANGE_ADDED = 1 << 0,
+	LD_DIAGRAM_CHANGE_REMOVED = 1 << 1,
+	LD_DIAGRAM_CHANGE_MOVED = 1 << 2,
+	LD_DIAGRAM_CHANGE_MODIFIED = 1 << 3
+}
+LdDiagramChangeFlags;
+
+typedef struct _LdDiagramChange LdDiagramChange;
+
+/**
+ * LdDiagramChange:
+ * @flags: what has happened to the object.
+ * @old_object: (allow-none): the object in the old diagram.
+ * @new_object: (allow-none): the object in the new diagram.
+ *
+ * A change to a single object.
+ */
+struct _LdDiagramChange
+{
+	LdDiagramChangeFlags flags;
+	LdDiagramObject *old_object;
+	LdDiagramObject *new_object;
+};
+
+
+GPtrArray *ld_diagram_diff (LdDiagram *old_diagram, LdDiagram *new_diagram);
+guint ld_diagram_merge (LdDiagram *self, LdDiagram *base, LdDiagram *theirs);
+
+
+G_END_DECLS
+
+#endif /* ! __LD_DIAGRAM_DIFF_H__ */
@@ -13,6 +13,10 @@
 #include "liblogdiag.h"
 #include "config.h"
 
+/* Parameters of the 64-bit FNV-1a hash function. */
+#define HASH_OFFSET G_GUINT64_CONSTANT (14695981039346656037)
+#define HASH_PRIME G_GUINT64_CONSTANT (1099511628211)
+
 
 /**
  * SECTION:ld-diagram-object
@@ -26,11 +30,16 @@
  * LdDiagramObjectPrivate:
  * @storage: storage for object parameters.
  * @lock_history: lock emitting of changes.
+ * @content_hash: a cached result of ld_diagram_object_get_content_hash().
+ * @content_hash_valid: whether @content_hash is up to date.
  */
 struct _LdDiagramObjectPrivate
 {
 	JsonObject *storage;
 	gboolean lock_history;
+
+	guint64 content_hash;
+	gboolean content_hash_valid;
 };
 
 typedef struct _SetParamActionData SetParamActionData;
@@ -39,8 +48,8 @@ typedef struct _SetParamActionData SetParamActionData;
  * SetParamActionData:
  * @self: the object this action has happened on.
  * @param_name: the name of the parameter that has been changed.
- * @old_node: the old node.
- * @new_node: the new node.
+ * @old_node: (allow-none): the old node, or %NULL if it was missing.
+ * @new_node: (allow-none): the new node, or %NULL if it was removed.
  */
 struct _SetParamActionData
 {
@@ -63,7 +72,17 @@ static void ld_diagram_object_get_property (GObject *object, guint property_id,
 static void ld_diagram_object_set_property (GObject *object, guint property_id,
 	const GValue *value, GParamSpec *pspec);
 static void ld_diagram_object_dispose (GObject *gobject);
+static void ld_diagram_object_notify (GObject *gobject, GParamSpec *pspec);
+
+static guint64 hash_bytes (guint64 hash, gconstpointer data, gsize length);
+static guint64 hash_member (guint64 hash, JsonObject *object,
+	const gchar *name);
+static guint64 hash_node (guint64 hash, JsonNode *node);
 
+static void change_member (LdDiagramObject *self,
+	const gchar *name, JsonNode *new_node);
+static void replace_member (JsonObject *storage,
+	const gchar *name, JsonNode *node);
 static void on_set_param_undo (gpointer user_data);
 static void on_set_param_redo (gpointer user_data);
 static void on_set_param_destroy (gpointer user_data);
@@ -81,6 +100,7 @@ ld_diagram_object_class_init (LdDiagramObjectClass *klass)
 	object_class->get_property = ld_diagram_object_get_property;
 	object_class->set_property = ld_diagram_object_set_property;
 	object_class->dispose = ld_diagram_object_dispose;
+	object_class->notify = ld_diagram_object_notify;
 
 /**
  * LdDiagramObject:storage:
@@ -125,6 +145,18 @@ ld_diagram_object_class_init (LdDiagramObjectClass *klass)
 		g_cclosure_marshal_VOID__OBJECT,
 		G_TYPE_NONE, 1, LD_TYPE_UNDO_ACTION);
 
+/**
+ * LdDiagramObject::about-to-change:
+ * @self: an #LdDiagramObject object.
+ *
+ * The storage of the object is about to be changed, including changes
+ * made by undoing and redoing them.  Handlers still see the old state.
+ */
+	klass->about_to_change_signal = g_signal_new
+		("about-to-change", G_TYPE_FROM_CLASS (klass),
+		G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+		g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+
 	g_type_class_add_private (klass, sizeof (LdDiagramObjectPrivate));
 }
 
@@ -193,6 +225,19 @@ ld_diagram_object_dispose (GObject *gobject)
 	G_OBJECT_CLASS (ld_diagram_object_parent_class)->dispose (gobject);
 }
 
+static void
+ld_diagram_object_notify (GObject *gobject, GParamSpec *pspec)
+{
+	GObjectClass *parent_class;
+
+	/* All changes to the storage are followed by a notification. */
+	LD_DIAGRAM_OBJECT (gobject)->priv->content_hash_valid = FALSE;
+
+	parent_class = G_OBJECT_CLASS (ld_diagram_object_parent_class);
+	if (parent_class->notify)
+		parent_class->notify (gobject, pspec);
+}
+
 
 /**
  * ld_diagram_object_new:
@@ -242,6 +287,7 @@ ld_diagram_object_set_storage (LdDiagramObject *self, JsonObject *storage)
 {
 	g_return_if_fail (LD_IS_DIAGRAM_OBJECT (self));
 
+	ld_diagram_object_about_to_change (self);
 	if (self->priv->storage)
 		json_object_unref (self->priv->storage);
 
@@ -270,6 +316,199 @@ ld_diagram_object_changed (LdDiagramObject *self, LdUndoAction *action)
 		action);
 }
 
+/**
+ * ld_diagram_object_about_to_change:
+ * @self: an #LdDiagramObject object.
+ *
+ * Emit the #LdDiagramObject::about-to-change signal.  Subclasses must
+ * call this before they change the storage.
+ */
+void
+ld_diagram_object_about_to_change (LdDiagramObject *self)
+{
+	g_return_if_fail (LD_IS_DIAGRAM_OBJECT (self));
+
+	g_signal_emit (self,
+		LD_DIAGRAM_OBJECT_GET_CLASS (self)->about_to_change_signal, 0);
+}
+
+/**
+ * ld_diagram_object_get_id:
+ * @self: an #LdDiagramObject object.
+ *
+ * Get the identifier of the object, which is kept in the storage
+ * and stays the same across sessions.  An #LdDiagram assigns one
+ * to each object upon insertion unless it already has a unique one.
+ *
+ * Return value: (allow-none): the identifier, or %NULL.
+ */
+const gchar *
+ld_diagram_object_get_id (LdDiagramObject *self)
+{
+	JsonNode *node;
+
+	g_return_val_if_fail (LD_IS_DIAGRAM_OBJECT (self), NULL);
+
+	node = json_object_get_member (ld_diagram_object_get_storage (self), "id");
+	if (!node || !JSON_NODE_HOLDS_VALUE (node)
+		|| json_node_get_value_type (node) != G_TYPE_STRING)
+		return NULL;
+	return json_node_get_string (node);
+}
+
+/**
+ * ld_diagram_object_set_id:
+ * @self: an #LdDiagramObject object.
+ * @id: (allow-none): the new identifier, or %NULL.
+ *
+ * Set the identifier of the object.  This is not a change that could
+ * be undone and it mustn't be done while the object is in a diagram.
+ */
+void
+ld_diagram_object_set_id (LdDiagramObject *self, const gchar *id)
+{
+	JsonObject *storage;
+
+	g_return_if_fail (LD_IS_DIAGRAM_OBJECT (self));
+
+	storage = ld_diagram_object_get_storage (self);
+	ld_diagram_object_about_to_change (self);
+	if (id)
+		json_object_set_string_member (storage, "id", id);
+	else if (json_object_has_member (storage, "id"))
+		json_object_remove_member (storage, "id");
+}
+
+/**
+ * ld_diagram_object_get_content_hash:
+ * @self: an #LdDiagramObject object.
+ *
+ * Compute a hash of all parameters in the storage except for
+ * the identifier and the position of the object.  Objects that only
+ * differ in those have the same content.  The result is cached until
+ * the object changes.
+ *
+ * Return value: a 64-bit hash of the contents.
+ */
+guint64
+ld_diagram_object_get_content_hash (LdDiagramObject *self)
+{
+	JsonObject *storage;
+	GList *members, *iter;
+	guint64 hash;
+
+	g_return_val_if_fail (LD_IS_DIAGRAM_OBJECT (self), 0);
+	if (self->priv->content_hash_valid)
+		return self->priv->content_hash;
+
+	storage = ld_diagram_object_get_storage (self);
+	members = g_list_sort (json_object_get_members (storage),
+		(GCompareFunc) strcmp);
+
+	hash = HASH_OFFSET;
+	for (iter = members; iter; iter = g_list_next (iter))
+		if (strcmp (iter->data, "id")
+			&& strcmp (iter->data, "x") && strcmp (iter->data, "y"))
+			hash = hash_member (hash, storage, iter->data);
+	g_list_free (members);
+
+	self->priv->content_hash = hash;
+	self->priv->content_hash_valid = TRUE;
+	return hash;
+}
+
+/**
+ * ld_diagram_object_get_member_hash:
+ * @self: an #LdDiagramObject object.
+ * @name: the name of a parameter in the storage.
+ *
+ * Compute a hash of a single parameter in the storage.
+ *
+ * Return value: a 64-bit hash of the value, zero if it isn't present.
+ */
+guint64
+ld_diagram_object_get_member_hash (LdDiagramObject *self, const gchar *name)
+{
+	JsonObject *storage;
+
+	g_return_val_if_fail (LD_IS_DIAGRAM_OBJECT (self), 0);
+	g_return_val_if_fail (name != NULL, 0);
+
+	storage = ld_diagram_object_get_storage (self);
+	if (!json_object_has_member (storage, name))
+		return 0;
+	return hash_member (HASH_OFFSET, storage, name);
+}
+
+static guint64
+hash_bytes (guint64 hash, gconstpointer data, gsize length)
+{
+	const guchar *p;
+
+	for (p = data; length--; p++)
+		hash = (hash ^ *p) * HASH_PRIME;
+	return hash;
+}
+
+static guint64
+hash_member (guint64 hash, JsonObject *object, const gchar *name)
+{
+	hash = hash_bytes (hash, name, strlen (name) + 1);
+	return hash_node (hash, json_object_get_member (object, name));
+}
+
+static guint64
+hash_node (guint64 hash, JsonNode *node)
+{
+	GList *members, *iter;
+	JsonArray *array;
+	const gchar *string;
+	gdouble number;
+	guint i, length;
+
+	switch (JSON_NODE_TYPE (node))
+	{
+	case JSON_NODE_OBJECT:
+		members = g_list_sort (json_object_get_members
+			(json_node_get_object (node)), (GCompareFunc) strcmp);
+		hash = hash_bytes (hash, "{", 1);
+		for (iter = members; iter; iter = g_list_next (iter))
+			hash = hash_member (hash,
+				json_node_get_object (node), iter->data);
+		g_list_free (members);
+		return hash_bytes (hash, "}", 1);
+	case JSON_NODE_ARRAY:
+		array = json_node_get_array (node);
+		length = json_array_get_length (array);
+		hash = hash_bytes (hash, "[", 1);
+		for (i = 0; i < length; i++)
+			hash = hash_node (hash, json_array_get_element (array, i));
+		return hash_bytes (hash, "]", 1);
+	case JSON_NODE_NULL:
+		return hash_bytes (hash, "n", 1);
+	case JSON_NODE_VALUE:
+		break;
+	}
+
+	switch (json_node_get_value_type (node))
+	{
+	case G_TYPE_INT64:
+	case G_TYPE_DOUBLE:
+		/* 1 and 1.0 are the same, so are 0.0 and -0.0. */
+		number = json_node_get_double (node) + 0.0;
+		hash = hash_bytes (hash, "d", 1);
+		return hash_bytes (hash, &number, sizeof number);
+	case G_TYPE_BOOLEAN:
+		return hash_bytes (hash, json_node_get_boolean (node) ? "t" : "f", 1);
+	case G_TYPE_STRING:
+		string = json_node_get_string (node);
+		hash = hash_bytes (hash, "s", 1);
+		return hash_bytes (hash, string, strlen (string) + 1);
+	default:
+		return hash;
+	}
+}
+
 /**
  * ld_diagram_object_get_data_for_param:
  * @self: an #LdDiagramObject object.
@@ -335,36 +574,66 @@ void
 ld_diagram_object_set_data_for_param (LdDiagramObject *self,
 	const GValue *data, GParamSpec *pspec)
 {
-	LdUndoAction *action;
-	SetParamActionData *action_data;
-	JsonObject *storage;
-	const gchar *name;
-	JsonNode *new_node, *old_node;
+	JsonNode *node;
 
 	g_return_if_fail (LD_IS_DIAGRAM_OBJECT (self));
 	g_return_if_fail (G_IS_VALUE (data));
 	g_return_if_fail (G_IS_PARAM_SPEC (pspec));
 
-	storage = ld_diagram_object_get_storage (self);
-	name = g_param_spec_get_name (pspec);
+	node = json_node_new (JSON_NODE_VALUE);
+	json_node_set_value (node, data);
+	change_member (self, g_param_spec_get_name (pspec), node);
+}
+
+/**
+ * ld_diagram_object_unset_data_for_param:
+ * @self: an #LdDiagramObject object.
+ * @pspec: the parameter to remove data for.
+ *
+ * Remove data for a parameter from internal storage, so that it reads
+ * as the default value.
+ */
+void
+ld_diagram_object_unset_data_for_param (LdDiagramObject *self,
+	GParamSpec *pspec)
+{
+	g_return_if_fail (LD_IS_DIAGRAM_OBJECT (self));
+	g_return_if_fail (G_IS_PARAM_SPEC (pspec));
+
+	if (json_object_has_member (ld_diagram_object_get_storage (self),
+		g_param_spec_get_name (pspec)))
+		change_member (self, g_param_spec_get_name (pspec), NULL);
+}
+
+/*
+ * change_member:
+ * @new_node: (allow-none) (transfer full): the new node, or %NULL
+ *            to remove the member.
+ *
+ * Change a member of the storage, recording the change for undo.
+ */
+static void
+change_member (LdDiagramObject *self, const gchar *name, JsonNode *new_node)
+{
+	LdUndoAction *action;
+	SetParamActionData *action_data;
+	JsonObject *storage;
+	JsonNode *old_node;
 
+	storage = ld_diagram_object_get_storage (self);
 	if (!self->priv->lock_history)
 	{
 		action_data = g_slice_new (SetParamActionData);
 		action_data->self = g_object_ref (self);
-		action_data->param_name = g_strdup (g_param_spec_get_name (pspec));
+		action_data->param_name = g_strdup (name);
 
 		old_node = json_object_get_member (storage, name);
 		action_data->old_node = old_node ? json_node_copy (old_node) : NULL;
+		action_data->new_node = new_node ? json_node_copy (new_node) : NULL;
 	}
 
-	new_node = json_node_new (JSON_NODE_VALUE);
-	json_node_set_value (new_node, data);
-
-	if (!self->priv->lock_history)
-		action_data->new_node = json_node_copy (new_node);
-
-	json_object_set_member (storage, name, new_node);
+	ld_diagram_object_about_to_change (self);
+	replace_member (storage, name, new_node);
 
 	if (!self->priv->lock_history)
 	{
@@ -375,6 +644,15 @@ ld_diagram_object_set_data_for_param (LdDiagramObject *self,
 	}
 }
 
+static void
+replace_member (JsonObject *storage, const gchar *name, JsonNode *node)
+{
+	if (node)
+		json_object_set_member (storage, name, node);
+	else if (json_object_has_member (storage, name))
+		json_object_remove_member (storage, name);
+}
+
 static void
 on_set_param_undo (gpointer user_data)
 {
@@ -384,8 +662,10 @@ on_set_param_undo (gpointer user_data)
 	data = user_data;
 	storage = ld_diagram_object_get_storage (data->self);
 
-	json_object_set_member (storage, data->param_name,
-		json_node_copy (data->old_node));
+	ld_diagram_object_about_to_change (data->self);
+	replace_member (storage, data->param_name,
+		data->old_node ? json_node_copy (data->old_node) : NULL);
+	g_object_notify (G_OBJECT (data->self), data->param_name);
 }
 
 static void
@@ -397,8 +677,10 @@ on_set_param_redo (gpointer user_data)
 	data = user_data;
 	storage = ld_diagram_object_get_storage (data->self);
 
-	json_object_set_member (storage, data->param_name,
-		json_node_copy (data->new_node));
+	ld_diagram_object_about_to_change (data->self);
+	replace_member (storage, data->param_name,
+		data->new_node ? json_node_copy (data->new_node) : NULL);
+	g_object_notify (G_OBJECT (data->self), data->param_name);
 }
 
 static void
@@ -54,6 +54,7 @@ struct _LdDiagramObjectClass
 	GObjectClass parent_class;
 
 	guint changed_signal;
+	guint about_to_change_signal;
 };
 
 
@@ -63,11 +64,20 @@ LdDiagramObject *ld_diagram_object_new (JsonObject *storage);
 JsonObject *ld_diagram_object_get_storage (LdDiagramObject *self);
 void ld_diagram_object_set_storage (LdDiagramObject *self, JsonObject *storage);
 void ld_diagram_object_changed (LdDiagramObject *self, LdUndoAction *action);
+void ld_diagram_object_about_to_change (LdDiagramObject *self);
+
+const gchar *ld_diagram_object_get_id (LdDiagramObject *self);
+void ld_diagram_object_set_id (LdDiagramObject *self, const gchar *id);
+guint64 ld_diagram_object_get_content_hash (LdDiagramObject *self);
+guint64 ld_diagram_object_get_member_hash (LdDiagramObject *self,
+	const gchar *name);
 
 void ld_diagram_object_get_data_for_param (LdDiagramObject *self,
 	GValue *data, GParamSpec *pspec);
 void ld_diagram_object_set_data_for_param (LdDiagramObject *self,
 	const GValue *data, GParamSpec *pspec);
+void ld_diagram_object_unset_data_for_param (LdDiagramObject *self,
+	GParamSpec *pspec);
 
 gdouble ld_diagram_object_get_x (LdDiagramObject *self);
 gdouble ld_diagram_object_get_y (LdDiagramObject *self);
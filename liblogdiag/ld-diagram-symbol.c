@@ -24,7 +24,9 @@ enum
 {
 	PROP_0,
 	PROP_CLASS,
-	PROP_ROTATION
+	PROP_ROTATION,
+	PROP_SHEET,
+	PROP_LABEL
 };
 
 static void ld_diagram_symbol_get_property (GObject *object, guint property_id,
@@ -32,6 +34,9 @@ static void ld_diagram_symbol_get_property (GObject *object, guint property_id,
 static void ld_diagram_symbol_set_property (GObject *object, guint property_id,
 	const GValue *value, GParamSpec *pspec);
 
+static const gchar *get_string_member (LdDiagramSymbol *self,
+	const gchar *name);
+
 
 G_DEFINE_TYPE (LdDiagramSymbol, ld_diagram_symbol, LD_TYPE_DIAGRAM_OBJECT)
 
@@ -64,6 +69,30 @@ ld_diagram_symbol_class_init (LdDiagramSymbolClass *klass)
 		"Rotation of this symbol.",
 		0, 3, 0, G_PARAM_READWRITE);
 	g_object_class_install_property (object_class, PROP_ROTATION, pspec);
+
+/**
+ * LdDiagramSymbol:sheet:
+ *
+ * The diagram that this symbol stands for, relative to the diagram
+ * that contains the symbol, or an empty string.
+ */
+	pspec = g_param_spec_string ("sheet", "Sheet",
+		"The diagram that this symbol stands for.",
+		"", G_PARAM_READWRITE);
+	g_object_class_install_property (object_class, PROP_SHEET, pspec);
+
+/**
+ * LdDiagramSymbol:label:
+ *
+ * The name of the net that the terminal of this symbol is a part of,
+ * or an empty string.  Nets with the same label are connected,
+ * even across sheets.  Only symbols with a single terminal can be
+ * labelled, the label of any other symbol is ignored.
+ */
+	pspec = g_param_spec_string ("label", "Label",
+		"The name of the net that the terminal of this symbol is a part of.",
+		"", G_PARAM_READWRITE);
+	g_object_class_install_property (object_class, PROP_LABEL, pspec);
 }
 
 static void
@@ -84,6 +113,12 @@ ld_diagram_symbol_get_property (GObject *object, guint property_id,
 	case PROP_ROTATION:
 		ld_diagram_object_get_data_for_param (self, value, pspec);
 		break;
+	case PROP_SHEET:
+	case PROP_LABEL:
+		/* Most symbols have neither, let's not store the defaults. */
+		g_value_set_string (value, get_string_member
+			(LD_DIAGRAM_SYMBOL (self), g_param_spec_get_name (pspec)));
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
 	}
@@ -94,6 +129,7 @@ ld_diagram_symbol_set_property (GObject *object, guint property_id,
 	const GValue *value, GParamSpec *pspec)
 {
 	LdDiagramObject *self;
+	const gchar *string;
 
 	self = LD_DIAGRAM_OBJECT (object);
 	switch (property_id)
@@ -102,11 +138,32 @@ ld_diagram_symbol_set_property (GObject *object, guint property_id,
 	case PROP_ROTATION:
 		ld_diagram_object_set_data_for_param (self, value, pspec);
 		break;
+	case PROP_SHEET:
+	case PROP_LABEL:
+		string = g_value_get_string (value);
+		if (string && *string)
+			ld_diagram_object_set_data_for_param (self, value, pspec);
+		else
+			ld_diagram_object_unset_data_for_param (self, pspec);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
 	}
 }
 
+static const gchar *
+get_string_member (LdDiagramSymbol *self, const gchar *name)
+{
+	JsonNode *node;
+
+	node = json_object_get_member
+		(ld_diagram_object_get_storage (LD_DIAGRAM_OBJECT (self)), name);
+	if (!node || !JSON_NODE_HOLDS_VALUE (node)
+		|| json_node_get_value_type (node) != G_TYPE_STRING)
+		return "";
+	return json_node_get_string (node);
+}
+
 
 /**
  * ld_diagram_symbol_new:
@@ -182,3 +239,104 @@ ld_diagram_symbol_set_rotation (LdDiagramSymbol *self, gint rotation)
 	g_return_if_fail (LD_IS_DIAGRAM_SYMBOL (self));
 	g_object_set (self, "rotation", rotation, NULL);
 }
+
+/**
+ * ld_diagram_symbol_get_sheet:
+ * @self: an #LdDiagramSymbol object.
+ *
+ * Return value: the diagram the symbol stands for, or %NULL.
+ */
+const gchar *
+ld_diagram_symbol_get_sheet (LdDiagramSymbol *self)
+{
+	const gchar *sheet;
+
+	g_return_val_if_fail (LD_IS_DIAGRAM_SYMBOL (self), NULL);
+	sheet = get_string_member (self, "sheet");
+	return *sheet ? sheet : NULL;
+}
+
+/**
+ * ld_diagram_symbol_set_sheet:
+ * @self: an #LdDiagramSymbol object.
+ * @sheet: (allow-none): the path to a diagram, or %NULL.
+ *
+ * Make the symbol stand for another diagram.
+ */
+void
+ld_diagram_symbol_set_sheet (LdDiagramSymbol *self, const gchar *sheet)
+{
+	g_return_if_fail (LD_IS_DIAGRAM_SYMBOL (self));
+	g_object_set (self, "sheet", sheet, NULL);
+}
+
+/**
+ * ld_diagram_symbol_get_label:
+ * @self: an #LdDiagramSymbol object.
+ *
+ * Return value: the net label of the symbol, or %NULL.
+ */
+const gchar *
+ld_diagram_symbol_get_label (LdDiagramSymbol *self)
+{
+	const gchar *label;
+
+	g_return_val_if_fail (LD_IS_DIAGRAM_SYMBOL (self), NULL);
+	label = get_string_member (self, "label");
+	return *label ? label : NULL;
+}
+
+/**
+ * ld_diagram_symbol_set_label:
+ * @self: an #LdDiagramSymbol object.
+ * @label: (allow-none): the net label, or %NULL.
+ *
+ * Set the name of the net that terminals of the symbol are a part of.
+ */
+void
+ld_diagram_symbol_set_label (LdDiagramSymbol *self, const gchar *label)
+{
+	g_return_if_fail (LD_IS_DIAGRAM_SYMBOL (self));
+	g_object_set (self, "label", label, NULL);
+}
+
+/**
+ * ld_diagram_symbol_transform_terminal:
+ * @self: an #LdDiagramSymbol object.
+ * @terminal: a terminal of the symbol's #LdSymbol.
+ *
+ * Rotate a terminal along with the symbol and move it to where the symbol
+ * is placed in the diagram.
+ */
+void
+ld_diagram_symbol_transform_terminal (LdDiagramSymbol *self,
+	LdPoint *terminal)
+{
+	gdouble x, y, temp;
+	gint rotation;
+
+	g_return_if_fail (LD_IS_DIAGRAM_SYMBOL (self));
+	g_return_if_fail (terminal != NULL);
+
+	g_object_get (self, "x", &x, "y", &y, "rotation", &rotation, NULL);
+	switch (rotation)
+	{
+	case LD_DIAGRAM_SYMBOL_ROTATION_90:
+		temp = terminal->y;
+		terminal->y = terminal->x;
+		terminal->x = -temp;
+		break;
+	case LD_DIAGRAM_SYMBOL_ROTATION_180:
+		terminal->y = -terminal->y;
+		terminal->x = -terminal->x;
+		break;
+	case LD_DIAGRAM_SYMBOL_ROTATION_270:
+		temp = terminal->x;
+		terminal->x = terminal->y;
+		terminal->y = -temp;
+		break;
+	}
+
+	terminal->x += x;
+	terminal->y += y;
+}
@@ -69,6 +69,12 @@ gchar *ld_diagram_symbol_get_class (LdDiagramSymbol *self);
 void ld_diagram_symbol_set_class (LdDiagramSymbol *self, const gchar *klass);
 gint ld_diagram_symbol_get_rotation (LdDiagramSymbol *self);
 void ld_diagram_symbol_set_rotation (LdDiagramSymbol *self, gint rotation);
+const gchar *ld_diagram_symbol_get_sheet (LdDiagramSymbol *self);
+void ld_diagram_symbol_set_sheet (LdDiagramSymbol *self, const gchar *sheet);
+const gchar *ld_diagram_symbol_get_label (LdDiagramSymbol *self);
+void ld_diagram_symbol_set_label (LdDiagramSymbol *self, const gchar *label);
+void ld_diagram_symbol_transform_terminal (LdDiagramSymbol *self,
+	LdPoint *terminal);
 
 
 G_END_DECLS
@@ -51,6 +51,19 @@
 /* Tolerance around terminal points. */
 #define TERMINAL_HOVER_TOLERANCE 8
 
+/* Search steps for routing a connection, lest it lag behind the cursor. */
+#define ROUTER_MAX_ITERATIONS 10000
+/* The same for each connection that follows moved symbols. */
+#define RUBBER_BAND_MAX_ITERATIONS 2000
+
+/* Size of cells that objects are sorted into for rubber-band selection. */
+#define SELECT_CELL_SIZE 64
+/* Objects spanning more cells than this are checked on every change. */
+#define SELECT_MAX_CELLS 256
+
+/* Terminals closer to each other than this are considered the same. */
+#define TERMINAL_QUANTUM 1e-3
+
 /*
  * OperationEnd:
  *
@@ -85,21 +98,89 @@ typedef struct
 {
 	LdDiagramConnection *connection;
 	LdPoint origin;
+	LdRouter *router;
 }
 ConnectData;
 
+/*
+ * SelectData:
+ * @drag_last_pos: the current corner of the selection rectangle.
+ * @rect: the selection rectangle that @entries reflect.
+ * @entries: (element-type SelectEntry): objects that can be selected,
+ *           or %NULL if they need to be collected again.
+ * @cells: indexes into @entries of objects overlapping each cell of a grid.
+ * @large: indexes into @entries of objects too large for @cells.
+ * @x: horizontal position of the view that @entries were made for.
+ * @y: vertical position of the view that @entries were made for.
+ * @zoom: zoom of the view that @entries were made for.
+ * @stamp: sequence number of the current change of the rectangle.
+ */
 typedef struct
 {
 	LdPoint drag_last_pos;
+	LdRectangle rect;
+	GArray *entries;
+	GHashTable *cells;
+	GArray *large;
+	gdouble x, y, zoom;
+	guint stamp;
 }
 SelectData;
 
+/*
+ * SelectEntry:
+ * @object: an object, owned by the diagram.
+ * @area: the area of the object in widget coordinates.
+ * @selected: whether the object is within the selection rectangle.
+ * @stamp: the change of the rectangle that the object was last checked in.
+ */
+typedef struct
+{
+	LdDiagramObject *object;
+	LdRectangle area;
+	gboolean selected;
+	guint stamp;
+}
+SelectEntry;
+
 typedef struct
 {
 	LdPoint move_origin;
+	LdPoint offset;
+	GArray *bands;
+	LdRouter *router;
 }
 MoveSelectionData;
 
+/*
+ * RubberBand:
+ * @connection: a connection attached to symbols being moved.
+ * @origin: the original position of the connection.
+ * @points: the original points of the connection.
+ * @start_moves: whether the first point is attached to a moved symbol.
+ * @end_moves: whether the last point is attached to a moved symbol.
+ */
+typedef struct
+{
+	LdDiagramConnection *connection;
+	LdPoint origin;
+	LdPointArray *points;
+	gboolean start_moves;
+	gboolean end_moves;
+}
+RubberBand;
+
+/*
+ * TerminalKey:
+ *
+ * A terminal position rounded to %TERMINAL_QUANTUM.
+ */
+typedef struct
+{
+	gint64 x, y;
+}
+TerminalKey;
+
 enum
 {
 	COLOR_BASE,
@@ -107,6 +188,8 @@ enum
 	COLOR_OBJECT,
 	COLOR_SELECTION,
 	COLOR_TERMINAL,
+	COLOR_PROFILE_BASE,
+	COLOR_PROFILE_TEXT,
 	COLOR_COUNT
 };
 
@@ -119,6 +202,45 @@ typedef struct
 }
 Color;
 
+/* Distance of the profiling overlay from the corner of the widget. */
+#define PROFILE_MARGIN 5
+
+/*
+ * Profile:
+ * @frames: the number of frames recorded.
+ * @frame_time: microseconds spent drawing the whole frame.
+ * @grid_time: microseconds spent drawing the grid.
+ * @diagram_time: microseconds spent drawing diagram objects.
+ * @terminal_time: microseconds spent drawing the hovered terminal.
+ * @selection_time: microseconds spent drawing the selection rectangle.
+ * @drawn: objects drawn.
+ * @culled: objects skipped for being out of the exposed area.
+ * @draw_calls: symbols drawn, either by Lua or from a recording.
+ * @draw_time: microseconds spent drawing symbols.
+ * @hit_tests: objects hit-tested since the last frame.
+ * @hit_test_time: microseconds spent hit-testing since the last frame.
+ * @terminal_checks: searches for terminals since the last frame.
+ * @terminal_check_time: microseconds spent searching for terminals.
+ */
+typedef struct
+{
+	guint frames;
+	gint64 frame_time;
+	gint64 grid_time;
+	gint64 diagram_time;
+	gint64 terminal_time;
+	gint64 selection_time;
+	guint drawn;
+	guint culled;
+	guint draw_calls;
+	gint64 draw_time;
+	guint hit_tests;
+	gint64 hit_test_time;
+	guint terminal_checks;
+	gint64 terminal_check_time;
+}
+Profile;
+
 /*
  * LdDiagramViewPrivate:
  * @diagram: a diagram object assigned as a model.
@@ -129,6 +251,10 @@ Color;
  * @y: the Y coordinate of the center of view.
  * @zoom: the current zoom.
  * @show_grid: whether to show the grid.
+ * @show_profile: whether to profile drawing and show the results.
+ * @profile: measurements of the frame being drawn.
+ * @profile_last: measurements of the last complete frame.
+ * @profile_rect: where the results were last shown.
  * @dnd_symbol: currently dragged symbol.
  * @dnd_last_position: last cursor movement position.
  * @dnd_left: whether the user has stopped dragging.
@@ -137,6 +263,11 @@ Color;
  * @drag_start_pos: position of the mouse pointer when dragging started.
  * @drag_operation: the operation to start when dragging starts.
  * @simulation_lock: prevents endless looping of simulate_motion()
+ * @frame_clock: the frame clock that motion is processed on, if realized.
+ * @frame_clock_handler: our "update" handler on the frame clock.
+ * @motion_pending: whether there is motion waiting to be processed.
+ * @motion_point: the last pointer position, in widget coordinates.
+ * @motion_state: the modifier state at the last pointer position.
  * @operation: the current operation.
  * @operation_data: data related to the current operation.
  * @operation_end: a callback to end the operation.
@@ -158,6 +289,11 @@ struct _LdDiagramViewPrivate
 
 	gboolean show_grid;
 
+	gboolean show_profile;
+	Profile profile;
+	Profile profile_last;
+	LdRectangle profile_rect;
+
 	LdDiagramObject *dnd_symbol;
 	LdPoint dnd_last_position;
 	guint dnd_left : 1;
@@ -170,6 +306,12 @@ struct _LdDiagramViewPrivate
 
 	gboolean simulation_lock;
 
+	GdkFrameClock *frame_clock;
+	gulong frame_clock_handler;
+	gboolean motion_pending;
+	LdPoint motion_point;
+	GdkModifierType motion_state;
+
 	gint operation;
 	union
 	{
@@ -252,6 +394,9 @@ static void ld_diagram_view_real_move (LdDiagramView *self,
 
 static void diagram_connect_signals (LdDiagramView *self);
 static void diagram_disconnect_signals (LdDiagramView *self);
+static void on_diagram_changed (LdDiagram *diagram, LdDiagramView *self);
+static void on_library_symbol_changed (LdLibrary *library,
+	const gchar *identifier, LdDiagramView *self);
 
 static gdouble ld_diagram_view_get_base_unit_in_px (GtkWidget *self);
 static gdouble ld_diagram_view_get_scale_in_px (LdDiagramView *self);
@@ -277,6 +422,11 @@ static LdDiagramObject *get_object_at_point (LdDiagramView *self,
 	const LdPoint *point);
 
 static void move_selection (LdDiagramView *self, gdouble dx, gdouble dy);
+static GArray *rubber_band_collect (LdDiagramView *self);
+static void rubber_band_update (LdDiagramView *self, GArray *bands,
+	LdRouter *router, const LdPoint *offset);
+static void rubber_band_free (GArray *bands);
+static void simplify_path (LdPointArray *points);
 static gboolean is_object_selected (LdDiagramView *self,
 	LdDiagramObject *object);
 
@@ -291,7 +441,6 @@ void check_connection_terminals (LdDiagramView *self,
 	LdDiagramConnection *connection, CheckTerminalsData *data);
 void check_symbol_terminals (LdDiagramView *self,
 	LdDiagramSymbol *diagram_symbol, CheckTerminalsData *data);
-static void rotate_symbol_terminal (LdPoint *terminal, gint symbol_rotation);
 static void hide_terminals (LdDiagramView *self);
 static void queue_terminal_draw (LdDiagramView *self, LdPoint *terminal);
 
@@ -329,6 +478,8 @@ static void oper_add_object_end (LdDiagramView *self);
 static void oper_connect_begin (LdDiagramView *self, const LdPoint *point);
 static void oper_connect_end (LdDiagramView *self);
 static void oper_connect_motion (LdDiagramView *self, const LdPoint *point);
+static LdRouter *create_connection_router (LdDiagramView *self,
+	gboolean include_selected);
 static LdPointArray *create_connection_path (const LdPoint *end_point);
 
 static void oper_select_begin (LdDiagramView *self, const LdPoint *point);
@@ -337,6 +488,16 @@ static void oper_select_get_rectangle (LdDiagramView *self, LdRectangle *rect);
 static void oper_select_queue_draw (LdDiagramView *self);
 static void oper_select_draw (DrawData *data);
 static void oper_select_motion (LdDiagramView *self, const LdPoint *point);
+static gint64 select_cell_key (gint x, gint y);
+static gint select_cell_coord (gdouble coord);
+static void oper_select_build_index (LdDiagramView *self);
+static void oper_select_free_index (LdDiagramView *self);
+static void oper_select_check (LdDiagramView *self, SelectEntry *entry,
+	const LdRectangle *rect, GList **select, GList **unselect);
+static void oper_select_query (LdDiagramView *self, const LdRectangle *region,
+	const LdRectangle *rect, GList **select, GList **unselect);
+static guint rectangle_subtract (const LdRectangle *a, const LdRectangle *b,
+	LdRectangle *parts);
 
 static void oper_move_selection_begin (LdDiagramView *self,
 	const LdPoint *point);
@@ -345,11 +506,19 @@ static void oper_move_selection_motion (LdDiagramView *self,
 	const LdPoint *point);
 
 /* Events, rendering. */
+static void on_realize (GtkWidget *widget, gpointer user_data);
+static void on_unrealize (GtkWidget *widget, gpointer user_data);
+static void on_frame_clock_update (GdkFrameClock *clock, LdDiagramView *self);
 static void simulate_motion (LdDiagramView *self);
+static void flush_motion (LdDiagramView *self);
+static void process_motion (LdDiagramView *self, const LdPoint *point,
+	GdkModifierType state);
 static gboolean on_motion_notify (GtkWidget *widget, GdkEventMotion *event,
 	gpointer user_data);
 static gboolean on_leave_notify (GtkWidget *widget, GdkEventCrossing *event,
 	gpointer user_data);
+static gboolean on_key_press (GtkWidget *widget, GdkEventKey *event,
+	gpointer user_data);
 static gboolean on_button_press (GtkWidget *widget, GdkEventButton *event,
 	gpointer user_data);
 static void on_left_button_press (LdDiagramView *self, GdkEventButton *event,
@@ -374,6 +543,10 @@ static void on_drag_leave (GtkWidget *widget, GdkDragContext *drag_ctx,
 	guint time, gpointer user_data);
 
 static gboolean on_draw (GtkWidget *widget, cairo_t *cr, gpointer user_data);
+static gint64 profile_clock (LdDiagramView *self);
+static gint64 profile_lap (LdDiagramView *self, gint64 *counter, gint64 since);
+static void profile_record (DrawData *data);
+static void draw_profile (DrawData *data);
 static void draw_grid (DrawData *data);
 static void draw_diagram (DrawData *data);
 static void draw_terminal (DrawData *data);
@@ -538,9 +711,15 @@ ld_diagram_view_init (LdDiagramView *self)
 	color_set (COLOR_GET (self, COLOR_OBJECT), 0, 0, 0, 1);
 	color_set (COLOR_GET (self, COLOR_SELECTION), 1, 0, 0, 1);
 	color_set (COLOR_GET (self, COLOR_TERMINAL), 1, 0.5, 0.5, 1);
+	color_set (COLOR_GET (self, COLOR_PROFILE_BASE), 0, 0, 0, 0.7);
+	color_set (COLOR_GET (self, COLOR_PROFILE_TEXT), 1, 1, 1, 1);
 
 	g_signal_connect (self, "size-allocate",
 		G_CALLBACK (on_size_allocate), NULL);
+	g_signal_connect (self, "realize",
+		G_CALLBACK (on_realize), NULL);
+	g_signal_connect (self, "unrealize",
+		G_CALLBACK (on_unrealize), NULL);
 	g_signal_connect (self, "draw",
 		G_CALLBACK (on_draw), NULL);
 
@@ -548,6 +727,8 @@ ld_diagram_view_init (LdDiagramView *self)
 		G_CALLBACK (on_motion_notify), NULL);
 	g_signal_connect (self, "leave-notify-event",
 		G_CALLBACK (on_leave_notify), NULL);
+	g_signal_connect (self, "key-press-event",
+		G_CALLBACK (on_key_press), NULL);
 	g_signal_connect (self, "button-press-event",
 		G_CALLBACK (on_button_press), NULL);
 	g_signal_connect (self, "button-release-event",
@@ -601,7 +782,11 @@ ld_diagram_view_finalize (GObject *gobject)
 		g_object_unref (self->priv->diagram);
 	}
 	if (self->priv->library)
+	{
+		g_signal_handlers_disconnect_by_func (self->priv->library,
+			on_library_symbol_changed, self);
 		g_object_unref (self->priv->library);
+	}
 	if (self->priv->dnd_symbol)
 		g_object_unref (self->priv->dnd_symbol);
 
@@ -835,7 +1020,22 @@ ld_diagram_view_real_move (LdDiagramView *self, gdouble dx, gdouble dy)
 		return;
 
 	if (ld_diagram_get_selection (diagram))
+	{
+		GArray *bands;
+		LdRouter *router;
+		LdPoint offset = {dx, dy};
+
+		ld_diagram_begin_user_action (diagram);
+		bands = rubber_band_collect (self);
+		router = create_connection_router (self, FALSE);
+
 		move_selection (self, dx, dy);
+		rubber_band_update (self, bands, router, &offset);
+
+		ld_router_free (router);
+		rubber_band_free (bands);
+		ld_diagram_end_user_action (diagram);
+	}
 	else
 	{
 		ld_diagram_view_set_x (self, self->priv->x + dx);
@@ -906,6 +1106,8 @@ diagram_connect_signals (LdDiagramView *self)
 		G_CALLBACK (gtk_widget_queue_draw), self);
 	g_signal_connect_swapped (self->priv->diagram, "selection-changed",
 		G_CALLBACK (gtk_widget_queue_draw), self);
+	g_signal_connect (self->priv->diagram, "changed",
+		G_CALLBACK (on_diagram_changed), self);
 }
 
 static void
@@ -916,6 +1118,19 @@ diagram_disconnect_signals (LdDiagramView *self)
 	g_signal_handlers_disconnect_matched (self->priv->diagram,
 		G_SIGNAL_MATCH_FUNC | G_SIGNAL_MATCH_DATA, 0, 0, NULL,
 		gtk_widget_queue_draw, self);
+	g_signal_handlers_disconnect_by_func (self->priv->diagram,
+		on_diagram_changed, self);
+
+	/* Objects of the selection index may be gone. */
+	if (self->priv->operation == OPER_SELECT)
+		oper_select_free_index (self);
+}
+
+static void
+on_diagram_changed (LdDiagram *diagram, LdDiagramView *self)
+{
+	if (self->priv->operation == OPER_SELECT)
+		oper_select_free_index (self);
 }
 
 /**
@@ -932,14 +1147,51 @@ ld_diagram_view_set_library (LdDiagramView *self, LdLibrary *library)
 	g_return_if_fail (LD_IS_LIBRARY (library));
 
 	if (self->priv->library)
+	{
+		g_signal_handlers_disconnect_by_func (self->priv->library,
+			on_library_symbol_changed, self);
 		g_object_unref (self->priv->library);
+	}
 
 	self->priv->library = library;
 	g_object_ref (library);
 
+	g_signal_connect (library, "symbol-changed",
+		G_CALLBACK (on_library_symbol_changed), self);
+
 	g_object_notify (G_OBJECT (self), "library");
 }
 
+/*
+ * on_library_symbol_changed:
+ *
+ * Redraw the view if it shows a symbol that has been reloaded.
+ */
+static void
+on_library_symbol_changed (LdLibrary *library,
+	const gchar *identifier, LdDiagramView *self)
+{
+	GList *objects, *iter;
+
+	if (!self->priv->diagram)
+		return;
+
+	objects = (GList *) ld_diagram_get_objects (self->priv->diagram);
+	for (iter = objects; iter; iter = g_list_next (iter))
+	{
+		if (!LD_IS_DIAGRAM_SYMBOL (iter->data))
+			continue;
+
+		/* The area of the symbol may have changed as well. */
+		if (!g_strcmp0 (identifier,
+			ld_diagram_symbol_get_class (iter->data)))
+		{
+			gtk_widget_queue_draw (GTK_WIDGET (self));
+			return;
+		}
+	}
+}
+
 /**
  * ld_diagram_view_get_library:
  * @self: an #LdDiagramView object.
@@ -1269,6 +1521,39 @@ ld_diagram_view_set_show_grid (LdDiagramView *self, gboolean show_grid)
 	gtk_widget_queue_draw (GTK_WIDGET (self));
 }
 
+/**
+ * ld_diagram_view_get_show_profile:
+ * @self: an #LdDiagramView object.
+ *
+ * Return value: whether drawing is profiled.
+ */
+gboolean
+ld_diagram_view_get_show_profile (LdDiagramView *self)
+{
+	g_return_val_if_fail (LD_IS_DIAGRAM_VIEW (self), FALSE);
+	return self->priv->show_profile;
+}
+
+/**
+ * ld_diagram_view_set_show_profile:
+ * @self: an #LdDiagramView object.
+ * @show_profile: whether to profile drawing.
+ *
+ * Set whether drawing, hit-testing and terminal searches should be timed.
+ * The results of each frame are shown in an overlay in the top left corner
+ * and logged as debug messages for offline analysis.
+ */
+void
+ld_diagram_view_set_show_profile (LdDiagramView *self, gboolean show_profile)
+{
+	g_return_if_fail (LD_IS_DIAGRAM_VIEW (self));
+
+	self->priv->show_profile = show_profile;
+	memset (&self->priv->profile, 0, sizeof self->priv->profile);
+	memset (&self->priv->profile_last, 0, sizeof self->priv->profile_last);
+	gtk_widget_queue_draw (GTK_WIDGET (self));
+}
+
 
 /* ===== Helper functions ================================================== */
 
@@ -1369,18 +1654,25 @@ static LdDiagramObject *
 get_object_at_point (LdDiagramView *self, const LdPoint *point)
 {
 	GList *objects, *iter;
+	LdDiagramObject *object = NULL;
+	gint64 start;
+
+	start = profile_clock (self);
 
 	/* Iterate from the top object downwards. */
 	objects = (GList *) ld_diagram_get_objects (self->priv->diagram);
 	for (iter = g_list_last (objects); iter; iter = g_list_previous (iter))
 	{
-		LdDiagramObject *object;
-
-		object = LD_DIAGRAM_OBJECT (iter->data);
-		if (object_hit_test (self, object, point))
-			return object;
+		self->priv->profile.hit_tests++;
+		if (object_hit_test (self, iter->data, point))
+		{
+			object = LD_DIAGRAM_OBJECT (iter->data);
+			break;
+		}
 	}
-	return NULL;
+
+	self->priv->profile.hit_test_time += profile_clock (self) - start;
+	return object;
 }
 
 static void
@@ -1414,6 +1706,303 @@ move_selection (LdDiagramView *self, gdouble dx, gdouble dy)
 	ld_diagram_end_user_action (diagram);
 }
 
+static void
+terminal_key_init (TerminalKey *key, const LdPoint *point)
+{
+	key->x = (gint64) floor (point->x / TERMINAL_QUANTUM + 0.5);
+	key->y = (gint64) floor (point->y / TERMINAL_QUANTUM + 0.5);
+}
+
+static guint
+terminal_key_hash (gconstpointer key)
+{
+	const TerminalKey *k = key;
+	return (guint) (k->x * 73856093) ^ (guint) (k->y * 19349663);
+}
+
+static gboolean
+terminal_key_equal (gconstpointer a, gconstpointer b)
+{
+	const TerminalKey *ka = a, *kb = b;
+	return ka->x == kb->x && ka->y == kb->y;
+}
+
+static gboolean
+is_terminal_moved (GHashTable *moved, const LdPoint *point)
+{
+	TerminalKey key;
+
+	terminal_key_init (&key, point);
+	return g_hash_table_contains (moved, &key);
+}
+
+/*
+ * rubber_band_collect:
+ *
+ * Find connections that aren't selected but are attached to terminals
+ * of selected symbols, so that they can follow them.
+ *
+ * Return value: (element-type RubberBand): the connections.
+ */
+static GArray *
+rubber_band_collect (LdDiagramView *self)
+{
+	GHashTable *moved;
+	GArray *bands;
+	GList *iter;
+
+	bands = g_array_new (FALSE, FALSE, sizeof (RubberBand));
+
+	/* Index terminals of the selection so that each connection
+	 * can be checked in constant time. */
+	moved = g_hash_table_new_full (terminal_key_hash, terminal_key_equal,
+		g_free, NULL);
+	for (iter = ld_diagram_get_selection (self->priv->diagram);
+		iter; iter = g_list_next (iter))
+	{
+		const LdPointArray *terminals;
+		LdSymbol *symbol;
+		guint i;
+
+		if (!LD_IS_DIAGRAM_SYMBOL (iter->data)
+		 || !(symbol = resolve_symbol (self, iter->data)))
+			continue;
+
+		terminals = ld_symbol_get_terminals (symbol);
+		for (i = 0; i < terminals->length; i++)
+		{
+			TerminalKey *key;
+			LdPoint terminal;
+
+			terminal = terminals->points[i];
+			ld_diagram_symbol_transform_terminal (iter->data, &terminal);
+
+			key = g_new (TerminalKey, 1);
+			terminal_key_init (key, &terminal);
+			g_hash_table_add (moved, key);
+		}
+	}
+
+	if (!g_hash_table_size (moved))
+		goto out;
+
+	for (iter = (GList *) ld_diagram_get_objects (self->priv->diagram);
+		iter; iter = g_list_next (iter))
+	{
+		RubberBand band;
+		LdPoint start, end;
+		guint last;
+
+		if (!LD_IS_DIAGRAM_CONNECTION (iter->data)
+		 || is_object_selected (self, iter->data))
+			continue;
+
+		band.points = ld_diagram_connection_get_points (iter->data);
+		if (band.points->length < 2)
+		{
+			ld_point_array_free (band.points);
+			continue;
+		}
+
+		g_object_get (iter->data,
+			"x", &band.origin.x, "y", &band.origin.y, NULL);
+
+		last = band.points->length - 1;
+		start.x = band.origin.x + band.points->points[0].x;
+		start.y = band.origin.y + band.points->points[0].y;
+		end.x = band.origin.x + band.points->points[last].x;
+		end.y = band.origin.y + band.points->points[last].y;
+
+		band.start_moves = is_terminal_moved (moved, &start);
+		band.end_moves = is_terminal_moved (moved, &end);
+		if (!band.start_moves && !band.end_moves)
+		{
+			ld_point_array_free (band.points);
+			continue;
+		}
+
+		band.connection = g_object_ref (iter->data);
+		g_array_append_val (bands, band);
+	}
+
+out:
+	g_hash_table_destroy (moved);
+	return bands;
+}
+
+/*
+ * rubber_band_update:
+ * @bands: (element-type RubberBand): connections to update.
+ * @router: a router to find new paths with.
+ * @offset: how far the selection has moved in total.
+ *
+ * Make connections follow moved symbols.  Connections attached to them
+ * on both ends are simply moved.  For the others, only the segment at
+ * the moved end is routed anew, so that the rest of the path stays
+ * the way the user has laid it out.
+ */
+static void
+rubber_band_update (LdDiagramView *self, GArray *bands,
+	LdRouter *router, const LdPoint *offset)
+{
+	guint i, k;
+
+	for (i = 0; i < bands->len; i++)
+	{
+		RubberBand *band;
+		LdPointArray *points, *route;
+		LdPoint start, end, from, to, end_point, origin;
+		guint last;
+
+		band = &g_array_index (bands, RubberBand, i);
+		last = band->points->length - 1;
+
+		start.x = band->origin.x + band->points->points[0].x;
+		start.y = band->origin.y + band->points->points[0].y;
+		end.x = band->origin.x + band->points->points[last].x;
+		end.y = band->origin.y + band->points->points[last].y;
+
+		queue_object_draw (self, LD_DIAGRAM_OBJECT (band->connection));
+		if (band->start_moves && band->end_moves)
+		{
+			g_object_set (band->connection,
+				"x", band->origin.x + offset->x,
+				"y", band->origin.y + offset->y, NULL);
+			queue_object_draw (self, LD_DIAGRAM_OBJECT (band->connection));
+			continue;
+		}
+
+		/* Route between the moved end and the nearest vertex. */
+		if (band->start_moves)
+		{
+			from.x = start.x + offset->x;
+			from.y = start.y + offset->y;
+			to.x = band->origin.x + band->points->points[1].x;
+			to.y = band->origin.y + band->points->points[1].y;
+		}
+		else
+		{
+			from.x = band->origin.x + band->points->points[last - 1].x;
+			from.y = band->origin.y + band->points->points[last - 1].y;
+			to.x = end.x + offset->x;
+			to.y = end.y + offset->y;
+		}
+
+		route = ld_router_route (router,
+			&from, &to, RUBBER_BAND_MAX_ITERATIONS);
+		if (!route)
+		{
+			end_point.x = to.x - from.x;
+			end_point.y = to.y - from.y;
+			route = create_connection_path (&end_point);
+		}
+
+		/* And splice the new route with the part that stays. */
+		points = ld_point_array_sized_new
+			(band->points->length + route->length);
+		if (band->start_moves)
+		{
+			origin = from;
+			for (k = 0; k < route->length; k++)
+				points->points[points->length++] = route->points[k];
+			for (k = 2; k <= last; k++)
+			{
+				points->points[points->length].x = band->origin.x
+					+ band->points->points[k].x - origin.x;
+				points->points[points->length++].y = band->origin.y
+					+ band->points->points[k].y - origin.y;
+			}
+		}
+		else
+		{
+			origin = band->origin;
+			for (k = 0; k + 1 < last; k++)
+				points->points[points->length++] = band->points->points[k];
+			for (k = 0; k < route->length; k++)
+			{
+				points->points[points->length].x =
+					from.x - origin.x + route->points[k].x;
+				points->points[points->length++].y =
+					from.y - origin.y + route->points[k].y;
+			}
+		}
+		ld_point_array_free (route);
+		simplify_path (points);
+
+		g_object_set (band->connection,
+			"x", origin.x, "y", origin.y, NULL);
+		ld_diagram_connection_set_points (band->connection, points);
+		ld_point_array_free (points);
+		queue_object_draw (self, LD_DIAGRAM_OBJECT (band->connection));
+	}
+}
+
+static void
+rubber_band_free (GArray *bands)
+{
+	guint i;
+
+	for (i = 0; i < bands->len; i++)
+	{
+		RubberBand *band;
+
+		band = &g_array_index (bands, RubberBand, i);
+		g_object_unref (band->connection);
+		ld_point_array_free (band->points);
+	}
+	g_array_unref (bands);
+}
+
+/*
+ * simplify_path:
+ *
+ * Remove vertices of an orthogonal path that lie on a straight line
+ * between their neighbours, as well as repeated ones.
+ */
+static void
+simplify_path (LdPointArray *points)
+{
+	LdPoint *a, *b, *c, last;
+	guint i, n;
+
+	if (points->length < 2)
+		return;
+
+	last = points->points[points->length - 1];
+	for (i = n = 0; i < points->length; i++)
+	{
+		c = &points->points[i];
+		if (n && ABS (c->x - points->points[n - 1].x) < TERMINAL_QUANTUM
+			&& ABS (c->y - points->points[n - 1].y) < TERMINAL_QUANTUM)
+			continue;
+
+		points->points[n++] = *c;
+		if (n < 3)
+			continue;
+
+		a = &points->points[n - 3];
+		b = &points->points[n - 2];
+		c = &points->points[n - 1];
+		if ((ABS (a->x - b->x) < TERMINAL_QUANTUM
+			&& ABS (b->x - c->x) < TERMINAL_QUANTUM)
+		 || (ABS (a->y - b->y) < TERMINAL_QUANTUM
+			&& ABS (b->y - c->y) < TERMINAL_QUANTUM))
+		{
+			points->points[--n - 1] = *c;
+
+			/* Going back along the same line may end where it began. */
+			if (ABS (c->x - a->x) < TERMINAL_QUANTUM
+			 && ABS (c->y - a->y) < TERMINAL_QUANTUM)
+				n--;
+		}
+	}
+
+	/* A path needs both of its ends, even if they coincide. */
+	if (n < 2)
+		points->points[n++] = last;
+	points->length = n;
+}
+
 static gboolean
 is_object_selected (LdDiagramView *self, LdDiagramObject *object)
 {
@@ -1451,6 +2040,7 @@ check_terminals (LdDiagramView *self, const LdPoint *point)
 	GList *objects, *iter;
 	CheckTerminalsData data;
 	LdDiagramObject *object_at_cursor;
+	gint64 start;
 
 	hide_terminals (self);
 
@@ -1458,6 +2048,9 @@ check_terminals (LdDiagramView *self, const LdPoint *point)
 	if (object_at_cursor && is_object_selected (self, object_at_cursor))
 		return;
 
+	start = profile_clock (self);
+	self->priv->profile.terminal_checks++;
+
 	data.found = FALSE;
 	data.point = *point;
 	data.distance = TERMINAL_HOVER_TOLERANCE;
@@ -1470,6 +2063,7 @@ check_terminals (LdDiagramView *self, const LdPoint *point)
 		else if (LD_IS_DIAGRAM_SYMBOL (iter->data))
 			check_symbol_terminals (self, iter->data, &data);
 	}
+	self->priv->profile.terminal_check_time += profile_clock (self) - start;
 
 	if (data.found)
 	{
@@ -1531,57 +2125,26 @@ void
 check_symbol_terminals (LdDiagramView *self,
 	LdDiagramSymbol *diagram_symbol, CheckTerminalsData *data)
 {
-	gdouble object_x, object_y;
 	LdSymbol *symbol;
 	const LdPointArray *terminals;
 	guint i;
-	gint rotation;
 
 	symbol = resolve_symbol (self, diagram_symbol);
 	if (!symbol)
 		return;
 
-	g_object_get (diagram_symbol, "x", &object_x, "y", &object_y,
-		"rotation", &rotation, NULL);
-
 	terminals = ld_symbol_get_terminals (symbol);
 	for (i = 0; i < terminals->length; i++)
 	{
 		LdPoint cur_term;
 
 		cur_term = terminals->points[i];
-		rotate_symbol_terminal (&cur_term, rotation);
-		cur_term.x += object_x;
-		cur_term.y += object_y;
+		ld_diagram_symbol_transform_terminal (diagram_symbol, &cur_term);
 
 		check_terminals_point (self, &cur_term, data);
 	}
 }
 
-static void
-rotate_symbol_terminal (LdPoint *terminal, gint symbol_rotation)
-{
-	gdouble temp;
-
-	switch (symbol_rotation)
-	{
-	case LD_DIAGRAM_SYMBOL_ROTATION_90:
-		temp = terminal->y;
-		terminal->y = terminal->x;
-		terminal->x = -temp;
-		break;
-	case LD_DIAGRAM_SYMBOL_ROTATION_180:
-		terminal->y = -terminal->y;
-		terminal->x = -terminal->x;
-		break;
-	case LD_DIAGRAM_SYMBOL_ROTATION_270:
-		temp = terminal->x;
-		terminal->x = terminal->y;
-		terminal->y = -temp;
-		break;
-	}
-}
-
 static void
 hide_terminals (LdDiagramView *self)
 {
@@ -1984,6 +2547,7 @@ oper_connect_begin (LdDiagramView *self, const LdPoint *point)
 		"y", data->origin.y,
 		NULL);
 
+	data->router = create_connection_router (self, TRUE);
 	self->priv->terminal_hovered = FALSE;
 
 	oper_connect_motion (self, point);
@@ -2001,6 +2565,7 @@ oper_connect_end (LdDiagramView *self)
 		LD_DIAGRAM_OBJECT (data->connection), -1);
 
 	g_object_unref (data->connection);
+	ld_router_free (data->router);
 }
 
 static void
@@ -2008,7 +2573,7 @@ oper_connect_motion (LdDiagramView *self, const LdPoint *point)
 {
 	ConnectData *data;
 	LdPointArray *points;
-	LdPoint end_point;
+	LdPoint end_point, target;
 	gdouble diagram_x, diagram_y;
 
 	data = &OPER_DATA (self, connect);
@@ -2032,7 +2597,12 @@ oper_connect_motion (LdDiagramView *self, const LdPoint *point)
 		end_point.y = floor (diagram_y - data->origin.y + 0.5);
 	}
 
-	points = create_connection_path (&end_point);
+	target.x = data->origin.x + end_point.x;
+	target.y = data->origin.y + end_point.y;
+	points = ld_router_route (data->router,
+		&data->origin, &target, ROUTER_MAX_ITERATIONS);
+	if (!points)
+		points = create_connection_path (&end_point);
 
 	queue_object_draw (self, LD_DIAGRAM_OBJECT (data->connection));
 	ld_diagram_connection_set_points (data->connection, points);
@@ -2040,6 +2610,32 @@ oper_connect_motion (LdDiagramView *self, const LdPoint *point)
 	queue_object_draw (self, LD_DIAGRAM_OBJECT (data->connection));
 }
 
+/* create_connection_router:
+ * @include_selected: whether selected symbols should be obstacles as well.
+ *
+ * Create a router with areas of symbols in the diagram as obstacles.
+ */
+static LdRouter *
+create_connection_router (LdDiagramView *self, gboolean include_selected)
+{
+	LdRouter *router;
+	GList *objects, *iter;
+	LdRectangle area;
+
+	router = ld_router_new ();
+	objects = (GList *) ld_diagram_get_objects (self->priv->diagram);
+	for (iter = objects; iter; iter = g_list_next (iter))
+	{
+		if (!include_selected && is_object_selected (self, iter->data))
+			continue;
+		if (LD_IS_DIAGRAM_SYMBOL (iter->data)
+		 && get_symbol_area_in_diagram_units (self,
+			LD_DIAGRAM_SYMBOL (iter->data), &area))
+			ld_router_add_obstacle (router, &area);
+	}
+	return router;
+}
+
 /* create_connection_path:
  * @end_point: the end point of the path. The start point is always at {0, 0}.
  *
@@ -2099,6 +2695,10 @@ oper_select_begin (LdDiagramView *self, const LdPoint *point)
 	data = &OPER_DATA (self, select);
 	data->drag_last_pos.x = self->priv->drag_start_pos.x;
 	data->drag_last_pos.y = self->priv->drag_start_pos.y;
+	data->entries = NULL;
+	data->cells = NULL;
+	data->large = NULL;
+	data->stamp = 0;
 
 	oper_select_motion (self, point);
 }
@@ -2107,6 +2707,7 @@ static void
 oper_select_end (LdDiagramView *self)
 {
 	oper_select_queue_draw (self);
+	oper_select_free_index (self);
 }
 
 static void
@@ -2157,8 +2758,9 @@ static void
 oper_select_motion (LdDiagramView *self, const LdPoint *point)
 {
 	SelectData *data;
-	GList *objects, *iter;
-	LdRectangle selection_rect, rect;
+	LdRectangle selection_rect, parts[8];
+	GList *select = NULL, *unselect = NULL;
+	guint n_parts, i;
 
 	data = &OPER_DATA (self, select);
 
@@ -2167,32 +2769,287 @@ oper_select_motion (LdDiagramView *self, const LdPoint *point)
 	oper_select_queue_draw (self);
 
 	oper_select_get_rectangle (self, &selection_rect);
-	objects = (GList *) ld_diagram_get_objects (self->priv->diagram);
 
-	for (iter = objects; iter; iter = g_list_next (iter))
+	/* Areas of objects change along with the view. */
+	if (data->entries && (data->x != self->priv->x
+		|| data->y != self->priv->y || data->zoom != self->priv->zoom))
+		oper_select_free_index (self);
+
+	data->stamp++;
+	if (!data->entries)
 	{
-		LdDiagramObject *object;
+		/* This also removes anything else from the selection. */
+		oper_select_build_index (self);
+		for (i = 0; i < data->entries->len; i++)
+		{
+			SelectEntry *entry;
+
+			entry = &g_array_index (data->entries, SelectEntry, i);
+			entry->selected
+				= ld_rectangle_contains (&selection_rect, &entry->area);
+			if (entry->selected)
+				select = g_list_prepend (select, entry->object);
+			else
+				unselect = g_list_prepend (unselect, entry->object);
+		}
+	}
+	else
+	{
+		/* Only objects overlapping what the rectangle has gained
+		 * or lost can change their state. */
+		n_parts = rectangle_subtract (&data->rect, &selection_rect, parts);
+		n_parts += rectangle_subtract (&selection_rect, &data->rect,
+			parts + n_parts);
+		for (i = 0; i < n_parts; i++)
+			oper_select_query (self, &parts[i], &selection_rect,
+				&select, &unselect);
+	}
+	data->rect = selection_rect;
+
+	ld_diagram_change_selection (self->priv->diagram, select, unselect);
+	g_list_free (select);
+	g_list_free (unselect);
+}
+
+static gint64
+select_cell_key (gint x, gint y)
+{
+	return (gint64) ((guint64) (guint32) x << 32 | (guint32) y);
+}
+
+static gint
+select_cell_coord (gdouble coord)
+{
+	/* Make sure it fits, whatever the zoom. */
+	return floor (CLAMP (coord / SELECT_CELL_SIZE, -1e6, 1e6));
+}
+
+/*
+ * oper_select_build_index:
+ *
+ * Collect areas of all objects in the diagram and sort them into cells.
+ */
+static void
+oper_select_build_index (LdDiagramView *self)
+{
+	SelectData *data;
+	GList *iter;
+	gint x, y, x0, y0, x1, y1;
+
+	data = &OPER_DATA (self, select);
+	data->entries = g_array_new (FALSE, FALSE, sizeof (SelectEntry));
+	data->cells = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+		g_free, (GDestroyNotify) g_array_unref);
+	data->large = g_array_new (FALSE, FALSE, sizeof (guint));
+	data->x = self->priv->x;
+	data->y = self->priv->y;
+	data->zoom = self->priv->zoom;
+
+	iter = ld_diagram_get_objects (self->priv->diagram);
+	for (; iter; iter = g_list_next (iter))
+	{
+		SelectEntry entry;
+		guint index;
 
-		object = LD_DIAGRAM_OBJECT (iter->data);
-		if (LD_IS_DIAGRAM_SYMBOL (object))
+		entry.object = LD_DIAGRAM_OBJECT (iter->data);
+		if (LD_IS_DIAGRAM_SYMBOL (entry.object))
 		{
 			if (!get_symbol_area (self,
-				LD_DIAGRAM_SYMBOL (object), &rect))
+				LD_DIAGRAM_SYMBOL (entry.object), &entry.area))
 				continue;
 		}
-		else if (LD_IS_DIAGRAM_CONNECTION (object))
+		else if (LD_IS_DIAGRAM_CONNECTION (entry.object))
 		{
 			if (!get_connection_area (self,
-				LD_DIAGRAM_CONNECTION (object), &rect))
+				LD_DIAGRAM_CONNECTION (entry.object), &entry.area))
 				continue;
 		}
-
-		ld_rectangle_extend (&rect, OBJECT_BORDER_TOLERANCE);
-		if (ld_rectangle_contains (&selection_rect, &rect))
-			ld_diagram_select (self->priv->diagram, object);
 		else
-			ld_diagram_unselect (self->priv->diagram, object);
+			continue;
+
+		ld_rectangle_extend (&entry.area, OBJECT_BORDER_TOLERANCE);
+		entry.selected = FALSE;
+		entry.stamp = 0;
+
+		index = data->entries->len;
+		g_array_append_val (data->entries, entry);
+
+		x0 = select_cell_coord (entry.area.x);
+		y0 = select_cell_coord (entry.area.y);
+		x1 = select_cell_coord (entry.area.x + entry.area.width);
+		y1 = select_cell_coord (entry.area.y + entry.area.height);
+		if ((gdouble) (x1 - x0 + 1) * (y1 - y0 + 1) > SELECT_MAX_CELLS)
+		{
+			g_array_append_val (data->large, index);
+			continue;
+		}
+
+		for (y = y0; y <= y1; y++)
+		for (x = x0; x <= x1; x++)
+		{
+			gint64 key;
+			GArray *cell;
+
+			key = select_cell_key (x, y);
+			cell = g_hash_table_lookup (data->cells, &key);
+			if (!cell)
+			{
+				cell = g_array_new (FALSE, FALSE, sizeof (guint));
+				g_hash_table_insert (data->cells,
+					g_memdup (&key, sizeof key), cell);
+			}
+			g_array_append_val (cell, index);
+		}
+	}
+}
+
+static void
+oper_select_free_index (LdDiagramView *self)
+{
+	SelectData *data;
+
+	data = &OPER_DATA (self, select);
+	if (!data->entries)
+		return;
+
+	g_array_free (data->entries, TRUE);
+	g_hash_table_destroy (data->cells);
+	g_array_free (data->large, TRUE);
+	data->entries = NULL;
+	data->cells = NULL;
+	data->large = NULL;
+}
+
+/*
+ * oper_select_check:
+ *
+ * Find out whether an object is within the selection rectangle
+ * and note it down if that has changed.
+ */
+static void
+oper_select_check (LdDiagramView *self, SelectEntry *entry,
+	const LdRectangle *rect, GList **select, GList **unselect)
+{
+	gboolean selected;
+
+	entry->stamp = OPER_DATA (self, select).stamp;
+	selected = ld_rectangle_contains (rect, &entry->area);
+	if (selected == entry->selected)
+		return;
+
+	entry->selected = selected;
+	if (selected)
+		*select = g_list_prepend (*select, entry->object);
+	else
+		*unselect = g_list_prepend (*unselect, entry->object);
+}
+
+/*
+ * oper_select_query:
+ * @region: the area where objects are to be checked.
+ * @rect: the current selection rectangle.
+ *
+ * Check objects overlapping a region, each at most once per change.
+ */
+static void
+oper_select_query (LdDiagramView *self, const LdRectangle *region,
+	const LdRectangle *rect, GList **select, GList **unselect)
+{
+	SelectData *data;
+	gint x, y, x0, y0, x1, y1;
+	guint i;
+
+	data = &OPER_DATA (self, select);
+	for (i = 0; i < data->large->len; i++)
+	{
+		SelectEntry *entry;
+
+		entry = &g_array_index (data->entries, SelectEntry,
+			g_array_index (data->large, guint, i));
+		if (entry->stamp != data->stamp)
+			oper_select_check (self, entry, rect, select, unselect);
+	}
+
+	x0 = select_cell_coord (region->x);
+	y0 = select_cell_coord (region->y);
+	x1 = select_cell_coord (region->x + region->width);
+	y1 = select_cell_coord (region->y + region->height);
+
+	for (y = y0; y <= y1; y++)
+	for (x = x0; x <= x1; x++)
+	{
+		gint64 key;
+		GArray *cell;
+
+		key = select_cell_key (x, y);
+		if (!(cell = g_hash_table_lookup (data->cells, &key)))
+			continue;
+
+		for (i = 0; i < cell->len; i++)
+		{
+			SelectEntry *entry;
+
+			entry = &g_array_index (data->entries, SelectEntry,
+				g_array_index (cell, guint, i));
+			if (entry->stamp != data->stamp)
+				oper_select_check (self, entry, rect, select, unselect);
+		}
+	}
+}
+
+/*
+ * rectangle_subtract:
+ * @parts: (out caller-allocates): space for at least four rectangles.
+ *
+ * Cover the part of @a that is outside of @b with rectangles.
+ *
+ * Return value: the number of rectangles.
+ */
+static guint
+rectangle_subtract (const LdRectangle *a, const LdRectangle *b,
+	LdRectangle *parts)
+{
+	gdouble top, bottom;
+	guint n = 0;
+
+	if (!ld_rectangle_intersects (a, b))
+	{
+		parts[n++] = *a;
+		return n;
 	}
+
+	top = MAX (a->y, b->y);
+	bottom = MIN (a->y + a->height, b->y + b->height);
+
+	if (b->y > a->y)
+	{
+		parts[n].x = a->x;
+		parts[n].y = a->y;
+		parts[n].width = a->width;
+		parts[n++].height = b->y - a->y;
+	}
+	if (b->y + b->height < a->y + a->height)
+	{
+		parts[n].x = a->x;
+		parts[n].y = bottom;
+		parts[n].width = a->width;
+		parts[n++].height = a->y + a->height - bottom;
+	}
+	if (b->x > a->x)
+	{
+		parts[n].x = a->x;
+		parts[n].y = top;
+		parts[n].width = b->x - a->x;
+		parts[n++].height = bottom - top;
+	}
+	if (b->x + b->width < a->x + a->width)
+	{
+		parts[n].x = b->x + b->width;
+		parts[n].y = top;
+		parts[n].width = a->x + a->width - parts[n].x;
+		parts[n++].height = bottom - top;
+	}
+	return n;
 }
 
 static void
@@ -2210,6 +3067,9 @@ oper_move_selection_begin (LdDiagramView *self, const LdPoint *point)
 
 	data = &OPER_DATA (self, move_selection);
 	data->move_origin = self->priv->drag_start_pos;
+	data->offset.x = data->offset.y = 0;
+	data->bands = rubber_band_collect (self);
+	data->router = create_connection_router (self, FALSE);
 
 	oper_move_selection_motion (self, point);
 }
@@ -2217,6 +3077,12 @@ oper_move_selection_begin (LdDiagramView *self, const LdPoint *point)
 static void
 oper_move_selection_end (LdDiagramView *self)
 {
+	MoveSelectionData *data;
+
+	data = &OPER_DATA (self, move_selection);
+	ld_router_free (data->router);
+	rubber_band_free (data->bands);
+
 	ld_diagram_end_user_action (self->priv->diagram);
 }
 
@@ -2248,12 +3114,57 @@ oper_move_selection_motion (LdDiagramView *self, const LdPoint *point)
 	}
 
 	if (move)
+	{
 		move_selection (self, move_x, move_y);
+
+		data->offset.x += move_x;
+		data->offset.y += move_y;
+		rubber_band_update (self, data->bands, data->router, &data->offset);
+	}
 }
 
 
 /* ===== Events, rendering ================================================= */
 
+static void
+on_realize (GtkWidget *widget, gpointer user_data)
+{
+	LdDiagramView *self;
+
+	self = LD_DIAGRAM_VIEW (widget);
+	self->priv->frame_clock = gtk_widget_get_frame_clock (widget);
+	if (self->priv->frame_clock)
+	{
+		g_object_ref (self->priv->frame_clock);
+		self->priv->frame_clock_handler = g_signal_connect
+			(self->priv->frame_clock, "update",
+			G_CALLBACK (on_frame_clock_update), self);
+	}
+}
+
+static void
+on_unrealize (GtkWidget *widget, gpointer user_data)
+{
+	LdDiagramView *self;
+
+	self = LD_DIAGRAM_VIEW (widget);
+	self->priv->motion_pending = FALSE;
+	if (self->priv->frame_clock)
+	{
+		g_signal_handler_disconnect (self->priv->frame_clock,
+			self->priv->frame_clock_handler);
+		g_object_unref (self->priv->frame_clock);
+		self->priv->frame_clock = NULL;
+		self->priv->frame_clock_handler = 0;
+	}
+}
+
+static void
+on_frame_clock_update (GdkFrameClock *clock, LdDiagramView *self)
+{
+	flush_motion (self);
+}
+
 static void
 simulate_motion (LdDiagramView *self)
 {
@@ -2286,17 +3197,56 @@ simulate_motion (LdDiagramView *self)
 	on_motion_notify (widget, &event, NULL);
 }
 
+/*
+ * flush_motion:
+ *
+ * Process pointer motion that has been postponed until the next frame.
+ * Needs to be done before handling any event that follows it.
+ */
+static void
+flush_motion (LdDiagramView *self)
+{
+	if (!self->priv->motion_pending)
+		return;
+
+	self->priv->motion_pending = FALSE;
+	process_motion (self, &self->priv->motion_point,
+		self->priv->motion_state);
+}
+
 static gboolean
 on_motion_notify (GtkWidget *widget, GdkEventMotion *event, gpointer user_data)
 {
-	LdPoint point;
 	LdDiagramView *self;
-	AddObjectData *add_data;
-
-	point.x = event->x;
-	point.y = event->y;
 
 	self = LD_DIAGRAM_VIEW (widget);
+	self->priv->motion_point.x = event->x;
+	self->priv->motion_point.y = event->y;
+	self->priv->motion_state = event->state;
+	self->priv->motion_pending = TRUE;
+
+	/* Pointers can report motion many times per frame but all of them
+	 * except for the last one would only be drawn over, and the work
+	 * we do for each may be expensive with large diagrams.
+	 */
+	if (self->priv->frame_clock)
+		gdk_frame_clock_request_phase (self->priv->frame_clock,
+			GDK_FRAME_CLOCK_PHASE_UPDATE);
+	else
+		flush_motion (self);
+	return FALSE;
+}
+
+/*
+ * process_motion:
+ *
+ * Do the actual work of the current operation for a pointer position.
+ */
+static void
+process_motion (LdDiagramView *self, const LdPoint *point,
+	GdkModifierType state)
+{
+	AddObjectData *add_data;
 
 	/* Prevent endless looping when any of the following code changes our
 	 * properties, for example during OPER_MOVE_VIEW.
@@ -2306,49 +3256,48 @@ on_motion_notify (GtkWidget *widget, GdkEventMotion *event, gpointer user_data)
 	switch (self->priv->operation)
 	{
 	case OPER_MOVE_VIEW:
-		oper_move_view_motion (self, &point);
+		oper_move_view_motion (self, point);
 		break;
 	case OPER_ADD_OBJECT:
 		add_data = &OPER_DATA (self, add_object);
 		add_data->visible = TRUE;
 
 		queue_object_draw (self, add_data->object);
-		move_object_to_point (self, add_data->object, &point);
+		move_object_to_point (self, add_data->object, point);
 		queue_object_draw (self, add_data->object);
 		break;
 	case OPER_CONNECT:
-		oper_connect_motion (self, &point);
+		oper_connect_motion (self, point);
 		break;
 	case OPER_SELECT:
-		oper_select_motion (self, &point);
+		oper_select_motion (self, point);
 		break;
 	case OPER_MOVE_SELECTION:
-		oper_move_selection_motion (self, &point);
+		oper_move_selection_motion (self, point);
 		break;
 	case OPER_0:
-		if (event->state & GDK_BUTTON1_MASK
-			&& (event->x != self->priv->drag_start_pos.x
-				|| event->y != self->priv->drag_start_pos.y))
+		if (state & GDK_BUTTON1_MASK
+			&& (point->x != self->priv->drag_start_pos.x
+				|| point->y != self->priv->drag_start_pos.y))
 		{
 			switch (self->priv->drag_operation)
 			{
 			case OPER_CONNECT:
-				oper_connect_begin (self, &point);
+				oper_connect_begin (self, point);
 				break;
 			case OPER_SELECT:
-				oper_select_begin (self, &point);
+				oper_select_begin (self, point);
 				break;
 			case OPER_MOVE_SELECTION:
-				oper_move_selection_begin (self, &point);
+				oper_move_selection_begin (self, point);
 				break;
 			}
 		}
-		check_terminals (self, &point);
+		check_terminals (self, point);
 		break;
 	}
 
 	self->priv->simulation_lock = FALSE;
-	return FALSE;
 }
 
 static gboolean
@@ -2357,6 +3306,8 @@ on_leave_notify (GtkWidget *widget, GdkEventCrossing *event, gpointer user_data)
 	LdDiagramView *self;
 
 	self = LD_DIAGRAM_VIEW (widget);
+	flush_motion (self);
+
 	switch (self->priv->operation)
 	{
 		AddObjectData *data;
@@ -2371,6 +3322,16 @@ on_leave_notify (GtkWidget *widget, GdkEventCrossing *event, gpointer user_data)
 	return FALSE;
 }
 
+static gboolean
+on_key_press (GtkWidget *widget, GdkEventKey *event, gpointer user_data)
+{
+	/* Key bindings are only activated by the default handler,
+	 * which runs after us, so they already see the current position.
+	 */
+	flush_motion (LD_DIAGRAM_VIEW (widget));
+	return FALSE;
+}
+
 static gboolean
 on_button_press (GtkWidget *widget, GdkEventButton *event, gpointer user_data)
 {
@@ -2378,6 +3339,7 @@ on_button_press (GtkWidget *widget, GdkEventButton *event, gpointer user_data)
 	LdDiagramView *self;
 
 	self = LD_DIAGRAM_VIEW (widget);
+	flush_motion (self);
 	if (!self->priv->diagram
 	 || event->type != GDK_BUTTON_PRESS)
 		return FALSE;
@@ -2494,6 +3456,7 @@ on_button_release (GtkWidget *widget, GdkEventButton *event, gpointer user_data)
 	LdDiagramObject *object_at_cursor;
 
 	self = LD_DIAGRAM_VIEW (widget);
+	flush_motion (self);
 	if (!self->priv->diagram)
 		return FALSE;
 
@@ -2540,6 +3503,7 @@ on_scroll (GtkWidget *widget, GdkEventScroll *event, gpointer user_data)
 	LdDiagramView *self;
 
 	self = LD_DIAGRAM_VIEW (widget);
+	flush_motion (self);
 
 	if (self->priv->operation != OPER_0
 		&& self->priv->operation != OPER_ADD_OBJECT)
@@ -2679,6 +3643,8 @@ static gboolean
 on_draw (GtkWidget *widget, cairo_t *cr, gpointer user_data)
 {
 	DrawData data;
+	Profile *profile;
+	gint64 start, lap;
 
 	GdkRectangle draw_area;
 	if (!gdk_cairo_get_clip_rectangle (cr, &draw_area))
@@ -2692,21 +3658,148 @@ on_draw (GtkWidget *widget, cairo_t *cr, gpointer user_data)
 	data.exposed_rect.width = draw_area.width;
 	data.exposed_rect.height = draw_area.height;
 
+	profile = &data.self->priv->profile;
+	profile->drawn = profile->culled = 0;
+	profile->draw_calls = profile->draw_time = 0;
+	profile->selection_time = 0;
+	start = lap = profile_clock (data.self);
+
 	color_apply (COLOR_GET (data.self, COLOR_BASE), data.cr);
 	cairo_paint (data.cr);
 
 	if (data.self->priv->show_grid)
 		draw_grid (&data);
+	lap = profile_lap (data.self, &profile->grid_time, lap);
 
 	draw_diagram (&data);
+	lap = profile_lap (data.self, &profile->diagram_time, lap);
 	draw_terminal (&data);
+	lap = profile_lap (data.self, &profile->terminal_time, lap);
 
 	if (data.self->priv->operation == OPER_SELECT)
+	{
 		oper_select_draw (&data);
+		profile_lap (data.self, &profile->selection_time, lap);
+	}
 
+	if (data.self->priv->show_profile)
+	{
+		profile_lap (data.self, &profile->frame_time, start);
+		profile_record (&data);
+		draw_profile (&data);
+	}
 	return FALSE;
 }
 
+static gint64
+profile_clock (LdDiagramView *self)
+{
+	return self->priv->show_profile ? g_get_monotonic_time () : 0;
+}
+
+static gint64
+profile_lap (LdDiagramView *self, gint64 *counter, gint64 since)
+{
+	gint64 now;
+
+	now = profile_clock (self);
+	*counter = now - since;
+	return now;
+}
+
+/*
+ * profile_record:
+ *
+ * Keep the measurements of the frame just drawn, unless it only refreshed
+ * the overlay, and make sure the overlay shows them.
+ */
+static void
+profile_record (DrawData *data)
+{
+	LdDiagramViewPrivate *priv;
+	LdRectangle *rect, *exposed;
+	Profile *profile;
+
+	priv = data->self->priv;
+	profile = &priv->profile;
+	rect = &priv->profile_rect;
+	exposed = &data->exposed_rect;
+
+	if (ld_rectangle_contains (rect, exposed))
+		return;
+
+	profile->frames++;
+	g_debug ("profile: frame=%u frame_us=%" G_GINT64_FORMAT
+		" grid_us=%" G_GINT64_FORMAT " diagram_us=%" G_GINT64_FORMAT
+		" terminal_us=%" G_GINT64_FORMAT " selection_us=%" G_GINT64_FORMAT
+		" drawn=%u culled=%u draw_calls=%u draw_us=%" G_GINT64_FORMAT
+		" hit_tests=%u hit_test_us=%" G_GINT64_FORMAT
+		" terminal_checks=%u terminal_check_us=%" G_GINT64_FORMAT,
+		profile->frames, profile->frame_time,
+		profile->grid_time, profile->diagram_time,
+		profile->terminal_time, profile->selection_time,
+		profile->drawn, profile->culled,
+		profile->draw_calls, profile->draw_time,
+		profile->hit_tests, profile->hit_test_time,
+		profile->terminal_checks, profile->terminal_check_time);
+
+	priv->profile_last = *profile;
+	profile->hit_tests = profile->hit_test_time = 0;
+	profile->terminal_checks = profile->terminal_check_time = 0;
+
+	/* Only a part of the overlay may have been exposed.  Not extending
+	 * the area lets us recognize the refresh in the next frame. */
+	if (rect->width && !ld_rectangle_contains (exposed, rect))
+		gtk_widget_queue_draw_area (GTK_WIDGET (data->self),
+			rect->x, rect->y, rect->width, rect->height);
+}
+
+static void
+draw_profile (DrawData *data)
+{
+	PangoLayout *layout;
+	Profile *profile;
+	LdRectangle *rect;
+	gchar *text;
+	gint width, height;
+
+	profile = &data->self->priv->profile_last;
+	text = g_strdup_printf ("frame %u: %.1f ms\n"
+		"grid %.1f ms, diagram %.1f ms\n"
+		"terminal %.1f ms, selection %.1f ms\n"
+		"objects drawn %u, culled %u\n"
+		"symbol draws %u: %.1f ms\n"
+		"hit tests %u: %.1f ms\n"
+		"terminal searches %u: %.1f ms",
+		profile->frames, profile->frame_time / 1000.,
+		profile->grid_time / 1000., profile->diagram_time / 1000.,
+		profile->terminal_time / 1000., profile->selection_time / 1000.,
+		profile->drawn, profile->culled,
+		profile->draw_calls, profile->draw_time / 1000.,
+		profile->hit_tests, profile->hit_test_time / 1000.,
+		profile->terminal_checks, profile->terminal_check_time / 1000.);
+
+	layout = gtk_widget_create_pango_layout (GTK_WIDGET (data->self), text);
+	pango_layout_get_pixel_size (layout, &width, &height);
+	g_free (text);
+
+	rect = &data->self->priv->profile_rect;
+	rect->x = PROFILE_MARGIN;
+	rect->y = PROFILE_MARGIN;
+	rect->width = width + 2 * PROFILE_MARGIN;
+	rect->height = height + 2 * PROFILE_MARGIN;
+
+	color_apply (COLOR_GET (data->self, COLOR_PROFILE_BASE), data->cr);
+	cairo_rectangle (data->cr, rect->x, rect->y, rect->width, rect->height);
+	cairo_fill (data->cr);
+
+	color_apply (COLOR_GET (data->self, COLOR_PROFILE_TEXT), data->cr);
+	cairo_move_to (data->cr,
+		rect->x + PROFILE_MARGIN, rect->y + PROFILE_MARGIN);
+	pango_cairo_show_layout (data->cr, layout);
+	g_object_unref (layout);
+}
+
 static void
 draw_grid (DrawData *data)
 {
@@ -2853,6 +3946,7 @@ draw_symbol (LdDiagramSymbol *diagram_symbol, DrawData *data)
 	LdRectangle clip_rect;
 	gdouble x, y;
 	gint rotation;
+	gint64 start;
 
 	symbol = resolve_symbol (data->self, diagram_symbol);
 
@@ -2869,8 +3963,12 @@ draw_symbol (LdDiagramSymbol *diagram_symbol, DrawData *data)
 
 	if (!get_symbol_clip_area (data->self, diagram_symbol, &clip_rect)
 		|| !ld_rectangle_intersects (&clip_rect, &data->exposed_rect))
+	{
+		data->self->priv->profile.culled++;
 		return;
+	}
 
+	data->self->priv->profile.drawn++;
 	cairo_save (data->cr);
 
 	cairo_rectangle (data->cr, clip_rect.x, clip_rect.y,
@@ -2896,7 +3994,11 @@ draw_symbol (LdDiagramSymbol *diagram_symbol, DrawData *data)
 		break;
 	}
 
+	start = profile_clock (data->self);
 	ld_symbol_draw (symbol, data->cr);
+	data->self->priv->profile.draw_time += profile_clock (data->self) - start;
+	data->self->priv->profile.draw_calls++;
+
 	cairo_restore (data->cr);
 }
 
@@ -2910,7 +4012,12 @@ draw_connection (LdDiagramConnection *connection, DrawData *data)
 
 	if (!get_connection_clip_area (data->self, connection, &clip_rect)
 		|| !ld_rectangle_intersects (&clip_rect, &data->exposed_rect))
+	{
+		data->self->priv->profile.culled++;
 		return;
+	}
+
+	data->self->priv->profile.drawn++;
 
 	points = ld_diagram_connection_get_points (connection);
 	if (points->length < 2)
@@ -92,6 +92,9 @@ void ld_diagram_view_zoom_out (LdDiagramView *self);
 
 gboolean ld_diagram_view_get_show_grid (LdDiagramView *self);
 void ld_diagram_view_set_show_grid (LdDiagramView *self, gboolean show_grid);
+gboolean ld_diagram_view_get_show_profile (LdDiagramView *self);
+void ld_diagram_view_set_show_profile (LdDiagramView *self,
+	gboolean show_profile);
 
 void ld_diagram_view_add_object_begin (LdDiagramView *self,
 	LdDiagramObject *object);
@@ -8,9 +8,23 @@
  *
  */
 
+#include <string.h>
+#include <math.h>
+
 #include "liblogdiag.h"
 #include "config.h"
 
+/* The gzip level used when a compressed file is loaded. */
+#define DEFAULT_COMPRESSION_LEVEL 6
+
+/* How much of an existing file is compared with new contents at once. */
+#define COMPARE_CHUNK_SIZE 65536
+
+/* How many objects a deferred copy goes through in one iteration. */
+#define COPY_CHUNK_SIZE 500
+
+static const gchar signature[] = "/* logdiag diagram */\n";
+
 
 /**
  * SECTION:ld-diagram
@@ -23,6 +37,8 @@
 /*
  * LdDiagramPrivate:
  * @modified: whether the diagram has been modified.
+ * @compression_level: the gzip level to save with, or zero.
+ * @canonical: whether to save in the canonical form.
  * @lock_history: whether the history stacks are currently locked.
  * @in_user_action: how many times a user action has been initiated.
  * @undo_stack: a stack of actions that can be undone,
@@ -31,10 +47,22 @@
  *              each containing a #GList of #LdUndoAction subactions.
  * @objects: all objects in the diagram.
  * @selection: all currently selected objects.
+ * @index: maps identifiers of all objects in the diagram to the objects.
+ * @journal: (allow-none): where completed changes are recorded.
+ * @journal_ops: (element-type JournalOp): structural changes that
+ *               haven't been written to the journal yet.
+ * @journal_dirty: a set of objects whose storage may have changed
+ *                 since the journal has last been written to.
+ * @copy: (allow-none): a copy of the selection that is in progress.
+ * @copy_source: the idle source that advances @copy, or zero.
  */
+typedef struct _CopyData CopyData;
+
 struct _LdDiagramPrivate
 {
 	gboolean modified;
+	gint compression_level;
+	gboolean canonical;
 	gboolean lock_history;
 	guint in_user_action;
 	GList *undo_stack;
@@ -42,6 +70,14 @@ struct _LdDiagramPrivate
 
 	GList *objects;
 	GList *selection;
+	GHashTable *index;
+
+	LdJournal *journal;
+	GArray *journal_ops;
+	GHashTable *journal_dirty;
+
+	CopyData *copy;
+	guint copy_source;
 };
 
 typedef struct _ObjectActionData ObjectActionData;
@@ -59,10 +95,83 @@ struct _ObjectActionData
 	gint pos;
 };
 
+typedef struct _ObjectsActionData ObjectsActionData;
+
+/*
+ * ObjectsActionData:
+ * @self: an #LdDiagram object.
+ * @entries: (element-type ObjectActionEntry): objects that have been
+ *           inserted or removed, sorted by their position.
+ */
+struct _ObjectsActionData
+{
+	gpointer self;
+	GArray *entries;
+};
+
+/*
+ * ObjectActionEntry:
+ * @object: an #LdDiagramObject object.
+ * @pos: the position of the object while it is in the diagram.
+ */
+typedef struct
+{
+	LdDiagramObject *object;
+	gint pos;
+}
+ObjectActionEntry;
+
+typedef enum
+{
+	JOURNAL_OP_INSERT,
+	JOURNAL_OP_REMOVE,
+	JOURNAL_OP_CLEAR
+}
+JournalOpType;
+
+/*
+ * JournalOp:
+ * @type: what has happened.
+ * @pos: the position of the object at the time.
+ * @object: (allow-none): the inserted object, with a reference.
+ */
+typedef struct
+{
+	JournalOpType type;
+	gint pos;
+	LdDiagramObject *object;
+}
+JournalOp;
+
+/*
+ * CopyData:
+ * @objects: (element-type LdDiagramObject): selected objects with
+ *           references, in their stacking order.
+ * @next: how many of @objects have been processed in the current pass.
+ * @have_origin: whether the origin has been found and objects are
+ *               being copied in this pass.
+ * @origin_x: the horizontal coordinate of the origin.
+ * @origin_y: the vertical coordinate of the origin.
+ * @root: the root object of the fragment, with a reference.
+ * @array: the array of copies in the fragment, with a reference.
+ */
+struct _CopyData
+{
+	GPtrArray *objects;
+	guint next;
+	gboolean have_origin;
+	gdouble origin_x;
+	gdouble origin_y;
+	JsonObject *root;
+	JsonArray *array;
+};
+
 enum
 {
 	PROP_0,
 	PROP_MODIFIED,
+	PROP_COMPRESSION_LEVEL,
+	PROP_CANONICAL,
 	PROP_CAN_UNDO,
 	PROP_CAN_REDO
 };
@@ -76,7 +185,20 @@ static void ld_diagram_finalize (GObject *gobject);
 static void ld_diagram_real_changed (LdDiagram *self);
 static void ld_diagram_clear_internal (LdDiagram *self, gboolean emit_signals);
 
+static GInputStream *open_input (const gchar *filename,
+	gboolean *compressed, GError **error);
+static GOutputStream *open_output (const gchar *filename,
+	gint compression_level, GError **error);
 static gboolean write_signature (GOutputStream *stream, GError **error);
+static gboolean stream_matches (GInputStream *stream,
+	const gchar *data, gsize length);
+static gboolean file_matches (const gchar *filename,
+	gint compression_level, const gchar *data, gsize length);
+
+static gchar *generate_canonical (JsonNode *root, gsize *length);
+static void append_canonical_node (GString *string, JsonNode *node);
+static void append_canonical_string (GString *string, const gchar *value);
+static void append_canonical_double (GString *string, gdouble value);
 
 static gboolean check_node (JsonNode *node, JsonNodeType type,
 	const gchar *id, GError **error);
@@ -86,6 +208,9 @@ static LdDiagramObject *deserialize_object (JsonObject *object_storage);
 
 static JsonNode *serialize_diagram (LdDiagram *self);
 static JsonNode *serialize_object (LdDiagramObject *object);
+static JsonNode *copy_node (JsonNode *node);
+static JsonObject *copy_object (JsonObject *object);
+static gdouble get_double_member (JsonObject *object, const gchar *name);
 static const gchar *get_object_class_string (GType type);
 
 static void push_undo_action (LdDiagram *self, LdUndoAction *action);
@@ -93,6 +218,8 @@ static void destroy_action_stack (GList **stack);
 
 static void on_object_changed (LdDiagramObject *object,
 	LdUndoAction *action, gpointer user_data);
+static void on_object_notify (LdDiagramObject *object,
+	GParamSpec *pspec, gpointer user_data);
 static void on_object_notify_storage (LdDiagramObject *object,
 	GParamSpec *pspec, gpointer user_data);
 
@@ -100,9 +227,32 @@ static void on_object_action_insert (gpointer user_data);
 static void on_object_action_remove (gpointer user_data);
 static void on_object_action_destroy (gpointer user_data);
 
+static void insert_entries (LdDiagram *self, GArray *entries);
+static void remove_entries (LdDiagram *self, GHashTable *set);
+static void push_objects_action (LdDiagram *self, GArray *entries,
+	gboolean inserted);
+static void on_objects_action_insert (gpointer user_data);
+static void on_objects_action_remove (gpointer user_data);
+static void on_objects_action_destroy (gpointer user_data);
+
+static void journal_record (LdDiagram *self, JournalOpType type,
+	gint pos, LdDiagramObject *object);
+static void journal_discard (LdDiagram *self);
+static void journal_maybe_flush (LdDiagram *self);
+static void journal_write_line (JsonGenerator *generator,
+	GString *buffer, JsonObject *line);
+static void journal_mark_dirty (LdDiagram *self, LdDiagramObject *object);
+static gboolean journal_apply (GPtrArray *objects,
+	JsonObject *line, GError **error);
+
+static gchar *generate_id (LdDiagram *self);
 static void install_object (LdDiagramObject *object, LdDiagram *self);
 static void uninstall_object (LdDiagramObject *object, LdDiagram *self);
 static void ld_diagram_unselect_all_internal (LdDiagram *self);
+static gboolean copy_advance (LdDiagram *self, guint limit);
+static gboolean on_copy_idle (gpointer user_data);
+static void on_copy_object_about_to_change (LdDiagramObject *object,
+	gpointer user_data);
 
 
 G_DEFINE_TYPE (LdDiagram, ld_diagram, G_TYPE_OBJECT)
@@ -131,6 +281,30 @@ ld_diagram_class_init (LdDiagramClass *klass)
 		FALSE, G_PARAM_READWRITE);
 	g_object_class_install_property (object_class, PROP_MODIFIED, pspec);
 
+/**
+ * LdDiagram:compression-level:
+ *
+ * The level of gzip compression to use when saving the diagram,
+ * zero for plain text.  Loading a file sets it according to the file.
+ */
+	pspec = g_param_spec_int ("compression-level", "Compression level",
+		"The level of gzip compression to use when saving the diagram.",
+		0, 9, 0, G_PARAM_READWRITE);
+	g_object_class_install_property (object_class,
+		PROP_COMPRESSION_LEVEL, pspec);
+
+/**
+ * LdDiagram:canonical:
+ *
+ * Whether the diagram is saved in a canonical form, which only depends
+ * on the contents of the diagram.  Files are not rewritten when they
+ * already contain the same data.
+ */
+	pspec = g_param_spec_boolean ("canonical", "Canonical",
+		"Whether the diagram is saved in a canonical form.",
+		FALSE, G_PARAM_READWRITE);
+	g_object_class_install_property (object_class, PROP_CANONICAL, pspec);
+
 /**
  * LdDiagram:can-undo:
  *
@@ -175,6 +349,32 @@ ld_diagram_class_init (LdDiagramClass *klass)
 		G_STRUCT_OFFSET (LdDiagramClass, selection_changed), NULL, NULL,
 		g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
 
+/**
+ * LdDiagram::object-inserted:
+ * @self: an #LdDiagram object.
+ * @object: the object that has been inserted.
+ *
+ * An object has been inserted into the diagram.
+ */
+	klass->object_inserted_signal = g_signal_new
+		("object-inserted", G_TYPE_FROM_CLASS (klass),
+		G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+		g_cclosure_marshal_VOID__OBJECT, G_TYPE_NONE, 1,
+		LD_TYPE_DIAGRAM_OBJECT);
+
+/**
+ * LdDiagram::object-removed:
+ * @self: an #LdDiagram object.
+ * @object: the object that has been removed.
+ *
+ * An object has been removed from the diagram.
+ */
+	klass->object_removed_signal = g_signal_new
+		("object-removed", G_TYPE_FROM_CLASS (klass),
+		G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+		g_cclosure_marshal_VOID__OBJECT, G_TYPE_NONE, 1,
+		LD_TYPE_DIAGRAM_OBJECT);
+
 	g_type_class_add_private (klass, sizeof (LdDiagramPrivate));
 }
 
@@ -183,6 +383,12 @@ ld_diagram_init (LdDiagram *self)
 {
 	self->priv = G_TYPE_INSTANCE_GET_PRIVATE
 		(self, LD_TYPE_DIAGRAM, LdDiagramPrivate);
+
+	self->priv->index = g_hash_table_new_full
+		(g_str_hash, g_str_equal, g_free, NULL);
+	self->priv->journal_ops = g_array_new (FALSE, FALSE, sizeof (JournalOp));
+	self->priv->journal_dirty = g_hash_table_new_full
+		(g_direct_hash, g_direct_equal, g_object_unref, NULL);
 }
 
 static void
@@ -197,6 +403,12 @@ ld_diagram_get_property (GObject *object, guint property_id,
 	case PROP_MODIFIED:
 		g_value_set_boolean (value, ld_diagram_get_modified (self));
 		break;
+	case PROP_COMPRESSION_LEVEL:
+		g_value_set_int (value, ld_diagram_get_compression_level (self));
+		break;
+	case PROP_CANONICAL:
+		g_value_set_boolean (value, ld_diagram_get_canonical (self));
+		break;
 	case PROP_CAN_UNDO:
 		g_value_set_boolean (value, ld_diagram_can_undo (self));
 		break;
@@ -220,6 +432,12 @@ ld_diagram_set_property (GObject *object, guint property_id,
 	case PROP_MODIFIED:
 		ld_diagram_set_modified (self, g_value_get_boolean (value));
 		break;
+	case PROP_COMPRESSION_LEVEL:
+		ld_diagram_set_compression_level (self, g_value_get_int (value));
+		break;
+	case PROP_CANONICAL:
+		ld_diagram_set_canonical (self, g_value_get_boolean (value));
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
 	}
@@ -231,8 +449,12 @@ ld_diagram_dispose (GObject *gobject)
 	LdDiagram *self;
 
 	self = LD_DIAGRAM (gobject);
+	ld_diagram_finish_copy (self);
 	ld_diagram_clear_internal (self, FALSE);
 
+	self->priv->journal = NULL;
+	journal_discard (self);
+
 	/* Chain up to the parent class. */
 	G_OBJECT_CLASS (ld_diagram_parent_class)->dispose (gobject);
 }
@@ -240,6 +462,13 @@ ld_diagram_dispose (GObject *gobject)
 static void
 ld_diagram_finalize (GObject *gobject)
 {
+	LdDiagram *self;
+
+	self = LD_DIAGRAM (gobject);
+	g_hash_table_destroy (self->priv->index);
+	g_array_free (self->priv->journal_ops, TRUE);
+	g_hash_table_destroy (self->priv->journal_dirty);
+
 	/* Chain up to the parent class. */
 	G_OBJECT_CLASS (ld_diagram_parent_class)->finalize (gobject);
 }
@@ -250,6 +479,7 @@ ld_diagram_real_changed (LdDiagram *self)
 	g_return_if_fail (LD_IS_DIAGRAM (self));
 
 	ld_diagram_set_modified (self, TRUE);
+	journal_maybe_flush (self);
 }
 
 
@@ -304,10 +534,22 @@ ld_diagram_clear_internal (LdDiagram *self, gboolean emit_signals)
 
 	if (self->priv->objects)
 	{
-		g_list_foreach (self->priv->objects, (GFunc) uninstall_object, self);
-		g_list_free (self->priv->objects);
+		GList *objects, *iter;
+
+		objects = self->priv->objects;
 		self->priv->objects = NULL;
+		for (iter = objects; iter; iter = g_list_next (iter))
+		{
+			if (emit_signals)
+				g_signal_emit (self, LD_DIAGRAM_GET_CLASS (self)->
+					object_removed_signal, 0, iter->data);
+			uninstall_object (iter->data, self);
+		}
+		g_list_free (objects);
 		changed = TRUE;
+
+		if (emit_signals)
+			journal_record (self, JOURNAL_OP_CLEAR, 0, NULL);
 	}
 
 	destroy_action_stack (&self->priv->undo_stack);
@@ -333,7 +575,8 @@ ld_diagram_clear_internal (LdDiagram *self, gboolean emit_signals)
  * @filename: a filename.
  * @error: (allow-none): return location for a #GError, or %NULL.
  *
- * Clear the diagram and load a file into it.
+ * Clear the diagram and load a file into it.  Files compressed
+ * with gzip are recognized and decompressed on the fly.
  *
  * Return value: %TRUE if the file could be loaded, %FALSE otherwise.
  */
@@ -342,23 +585,58 @@ ld_diagram_load_from_file (LdDiagram *self,
 	const gchar *filename, GError **error)
 {
 	JsonParser *parser;
+	GInputStream *stream;
+	GOutputStream *buffer;
 	GError *local_error;
+	gboolean compressed;
+	gint64 trace, trace_phase;
 
 	g_return_val_if_fail (LD_IS_DIAGRAM (self), FALSE);
 	g_return_val_if_fail (filename != NULL, FALSE);
 
+	trace = trace_phase = ld_trace_begin ();
+	stream = open_input (filename, &compressed, error);
+	if (!stream)
+	{
+		ld_trace_end (trace, "diagram", "ld_diagram_load_from_file", filename);
+		return FALSE;
+	}
+
+	/* JSON-GLib reads the whole stream into memory before parsing anyway,
+	 * and json_parser_load_from_stream() would need a newer version. */
 	parser = json_parser_new ();
+	buffer = g_memory_output_stream_new (NULL, 0, g_realloc, g_free);
 
 	local_error = NULL;
-	json_parser_load_from_file (parser, filename, &local_error);
+	if (g_output_stream_splice (buffer, stream,
+		G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET, NULL, &local_error) != -1)
+	{
+		GMemoryOutputStream *memory;
+
+		memory = G_MEMORY_OUTPUT_STREAM (buffer);
+		json_parser_load_from_data (parser,
+			g_memory_output_stream_get_data (memory),
+			g_memory_output_stream_get_data_size (memory), &local_error);
+	}
+	g_object_unref (buffer);
+	g_object_unref (stream);
+	ld_trace_end (trace_phase, "diagram", "parse", filename);
 	if (local_error)
 	{
 		g_propagate_error (error, local_error);
 		g_object_unref (parser);
+		ld_trace_end (trace, "diagram", "ld_diagram_load_from_file", filename);
 		return FALSE;
 	}
 
+	if (!compressed)
+		ld_diagram_set_compression_level (self, 0);
+	else if (!self->priv->compression_level)
+		ld_diagram_set_compression_level (self, DEFAULT_COMPRESSION_LEVEL);
+
+	trace_phase = ld_trace_begin ();
 	ld_diagram_clear (self);
+	ld_trace_end (trace_phase, "diagram", "clear", NULL);
 
 	self->priv->lock_history = TRUE;
 
@@ -366,8 +644,10 @@ ld_diagram_load_from_file (LdDiagram *self,
 	deserialize_diagram (self, json_parser_get_root (parser), &local_error);
 
 	self->priv->lock_history = FALSE;
+	journal_maybe_flush (self);
 
 	g_object_unref (parser);
+	ld_trace_end (trace, "diagram", "ld_diagram_load_from_file", filename);
 	if (local_error)
 	{
 		g_propagate_error (error, local_error);
@@ -382,7 +662,8 @@ ld_diagram_load_from_file (LdDiagram *self,
  * @filename: a filename.
  * @error: (allow-none): return location for a #GError, or %NULL.
  *
- * Save the diagram into a file.
+ * Save the diagram into a file, compressed according to
+ * #LdDiagram:compression-level.  See also #LdDiagram:canonical.
  *
  * Return value: %TRUE if the diagram could be saved, %FALSE otherwise.
  */
@@ -390,76 +671,228 @@ gboolean
 ld_diagram_save_to_file (LdDiagram *self,
 	const gchar *filename, GError **error)
 {
-	GFile *file;
-	GFileOutputStream *file_stream;
+	GOutputStream *stream;
 	JsonGenerator *generator;
 	JsonNode *root;
 	gchar *buffer;
 	gsize length;
 	GError *local_error;
+	gint64 trace, trace_phase;
 
 	g_return_val_if_fail (LD_IS_DIAGRAM (self), FALSE);
 	g_return_val_if_fail (filename != NULL, FALSE);
 
-	file = g_file_new_for_path (filename);
+	trace = trace_phase = ld_trace_begin ();
+	root = serialize_diagram (self);
+	ld_trace_end (trace_phase, "diagram", "serialize", NULL);
 
-	local_error = NULL;
-	file_stream = g_file_replace (file, NULL, FALSE,
-		G_FILE_CREATE_NONE, NULL, &local_error);
-	g_object_unref (file);
+	trace_phase = ld_trace_begin ();
+	if (self->priv->canonical)
+		buffer = generate_canonical (root, &length);
+	else
+	{
+		generator = json_generator_new ();
+		g_object_set (generator, "pretty", TRUE, NULL);
+		json_generator_set_root (generator, root);
+		buffer = json_generator_to_data (generator, &length);
+		g_object_unref (generator);
+	}
+	json_node_free (root);
+	ld_trace_end (trace_phase, "diagram", "generate", NULL);
 
-	if (local_error)
+	/* Leaving the file alone keeps its timestamp, and anything that
+	 * synchronizes files by their contents doesn't need to look at it. */
+	if (self->priv->canonical)
 	{
-		g_propagate_error (error, local_error);
-		return FALSE;
+		gboolean unchanged;
+
+		trace_phase = ld_trace_begin ();
+		unchanged = file_matches (filename,
+			self->priv->compression_level, buffer, length);
+		ld_trace_end (trace_phase, "diagram", "compare", filename);
+		if (unchanged)
+		{
+			g_free (buffer);
+			goto save_to_file_done;
+		}
 	}
 
-	local_error = NULL;
-	write_signature (G_OUTPUT_STREAM (file_stream), &local_error);
-	if (local_error)
+	stream = open_output (filename, self->priv->compression_level, error);
+	if (!stream)
 	{
-		g_object_unref (file_stream);
-		g_propagate_error (error, local_error);
+		g_free (buffer);
+		ld_trace_end (trace, "diagram", "ld_diagram_save_to_file", filename);
 		return FALSE;
 	}
 
-	generator = json_generator_new ();
-	g_object_set (generator, "pretty", TRUE, NULL);
-
-	root = serialize_diagram (self);
-	json_generator_set_root (generator, root);
-	json_node_free (root);
-
+	/* The compressor only buffers a block at a time.  Closing the stream
+	 * flushes it, and we'd rather know if that fails. */
+	trace_phase = ld_trace_begin ();
 	local_error = NULL;
-	buffer = json_generator_to_data (generator, &length);
-	g_output_stream_write (G_OUTPUT_STREAM (file_stream),
-		buffer, length, NULL, &local_error);
-	g_object_unref (file_stream);
-	g_object_unref (generator);
+	if (write_signature (stream, &local_error)
+		&& g_output_stream_write_all (stream,
+		buffer, length, NULL, NULL, &local_error))
+		g_output_stream_close (stream, NULL, &local_error);
+	g_object_unref (stream);
 	g_free (buffer);
+	ld_trace_end (trace_phase, "diagram", "write", filename);
 
 	if (local_error)
 	{
+		ld_trace_end (trace, "diagram", "ld_diagram_save_to_file", filename);
 		g_propagate_error (error, local_error);
 		return FALSE;
 	}
+
+save_to_file_done:
+	ld_trace_end (trace, "diagram", "ld_diagram_save_to_file", filename);
+
+	/* Everything in the journal is in the file now. */
+	local_error = NULL;
+	if (self->priv->journal
+		&& !ld_journal_truncate (self->priv->journal, &local_error))
+	{
+		g_warning ("%s", local_error->message);
+		g_error_free (local_error);
+	}
 	return TRUE;
 }
 
+/*
+ * open_input:
+ * @compressed: where to store whether the file is compressed.
+ *
+ * Open a file for reading, decompressing it if it starts with
+ * the gzip magic number.
+ */
+static GInputStream *
+open_input (const gchar *filename, gboolean *compressed, GError **error)
+{
+	GFile *file;
+	GFileInputStream *file_stream;
+	GInputStream *stream, *buffered;
+	GConverter *decompressor;
+	const guchar *magic;
+	gsize available;
+
+	file = g_file_new_for_path (filename);
+	file_stream = g_file_read (file, NULL, error);
+	g_object_unref (file);
+	if (!file_stream)
+		return NULL;
+
+	buffered = g_buffered_input_stream_new (G_INPUT_STREAM (file_stream));
+	g_object_unref (file_stream);
+	if (g_buffered_input_stream_fill (G_BUFFERED_INPUT_STREAM (buffered),
+		2, NULL, error) < 0)
+	{
+		g_object_unref (buffered);
+		return NULL;
+	}
+
+	magic = g_buffered_input_stream_peek_buffer
+		(G_BUFFERED_INPUT_STREAM (buffered), &available);
+	*compressed = available >= 2 && magic[0] == 0x1f && magic[1] == 0x8b;
+	if (!*compressed)
+		return buffered;
+
+	decompressor = G_CONVERTER (g_zlib_decompressor_new
+		(G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+	stream = g_converter_input_stream_new (buffered, decompressor);
+	g_object_unref (decompressor);
+	g_object_unref (buffered);
+	return stream;
+}
+
+/*
+ * open_output:
+ * @compression_level: the gzip level, zero for none.
+ *
+ * Replace a file, compressing whatever is written to it.
+ */
+static GOutputStream *
+open_output (const gchar *filename, gint compression_level, GError **error)
+{
+	GFile *file;
+	GFileOutputStream *file_stream;
+	GOutputStream *stream;
+	GConverter *compressor;
+
+	file = g_file_new_for_path (filename);
+	file_stream = g_file_replace (file, NULL, FALSE,
+		G_FILE_CREATE_NONE, NULL, error);
+	g_object_unref (file);
+	if (!file_stream || !compression_level)
+		return G_OUTPUT_STREAM (file_stream);
+
+	compressor = G_CONVERTER (g_zlib_compressor_new
+		(G_ZLIB_COMPRESSOR_FORMAT_GZIP, compression_level));
+	stream = g_converter_output_stream_new
+		(G_OUTPUT_STREAM (file_stream), compressor);
+	g_object_unref (compressor);
+	g_object_unref (file_stream);
+	return stream;
+}
+
 static gboolean
 write_signature (GOutputStream *stream, GError **error)
 {
-	static const gchar signature[] = "/* logdiag diagram */\n";
-	GError *local_error = NULL;
+	return g_output_stream_write_all (stream, signature,
+		sizeof signature - 1, NULL, NULL, error);
+}
 
-	g_output_stream_write (stream, signature, sizeof (signature) - 1,
-		NULL, &local_error);
-	if (local_error)
+/*
+ * stream_matches:
+ *
+ * Check whether the stream continues with the given data.
+ */
+static gboolean
+stream_matches (GInputStream *stream, const gchar *data, gsize length)
+{
+	gchar *chunk;
+	gsize chunk_length, read;
+	gboolean matches;
+
+	chunk = g_malloc (MIN (length, COMPARE_CHUNK_SIZE) + 1);
+	matches = TRUE;
+	while (matches && length)
 	{
-		g_propagate_error (error, local_error);
-		return FALSE;
+		chunk_length = MIN (length, COMPARE_CHUNK_SIZE);
+		matches = g_input_stream_read_all (stream, chunk, chunk_length,
+			&read, NULL, NULL) && read == chunk_length
+			&& !memcmp (chunk, data, chunk_length);
+
+		data += chunk_length;
+		length -= chunk_length;
 	}
-	return TRUE;
+	g_free (chunk);
+	return matches;
+}
+
+/*
+ * file_matches:
+ *
+ * Check whether a file, including its signature, would be saved
+ * just the same as it already is.
+ */
+static gboolean
+file_matches (const gchar *filename, gint compression_level,
+	const gchar *data, gsize length)
+{
+	GInputStream *stream;
+	gboolean compressed, matches;
+	gchar trailing;
+
+	stream = open_input (filename, &compressed, NULL);
+	if (!stream)
+		return FALSE;
+
+	matches = compressed == (compression_level != 0)
+		&& stream_matches (stream, signature, sizeof signature - 1)
+		&& stream_matches (stream, data, length)
+		&& g_input_stream_read (stream, &trailing, 1, NULL, NULL) == 0;
+	g_object_unref (stream);
+	return matches;
 }
 
 static gboolean
@@ -486,6 +919,8 @@ deserialize_diagram (LdDiagram *self, JsonNode *root, GError **error)
 	JsonObject *root_object;
 	JsonNode *objects_node;
 	GList *iter;
+	GPtrArray *objects;
+	gint64 trace, construct_time = 0, insert_time = 0;
 
 	if (!check_node (root, JSON_NODE_OBJECT, "the root node", error))
 		return FALSE;
@@ -496,22 +931,48 @@ deserialize_diagram (LdDiagram *self, JsonNode *root, GError **error)
 		"the `objects' array", error))
 		return FALSE;
 
+	trace = ld_trace_begin ();
+	objects = g_ptr_array_new_with_free_func (g_object_unref);
 	iter = json_array_get_elements (json_node_get_array (objects_node));
 	for (; iter; iter = g_list_next (iter))
 	{
 		GError *node_error = NULL;
+		gint64 phase;
 
 		check_node (iter->data, JSON_NODE_OBJECT, "object node", &node_error);
 		if (node_error)
 		{
 			g_warning ("%s", node_error->message);
 			g_error_free (node_error);
+			continue;
 		}
-		else
-			/* FIXME: Appending is slow. */
-			ld_diagram_insert_object (self,
-				deserialize_object (json_node_get_object (iter->data)), -1);
+
+		/* Construction and insertion, including signal emission,
+		 * are measured apart, though only reported as totals. */
+		phase = ld_trace_begin ();
+		g_ptr_array_add (objects,
+			deserialize_object (json_node_get_object (iter->data)));
+		if (phase)
+			construct_time += g_get_monotonic_time () - phase;
+	}
+
+	insert_time = ld_trace_begin ();
+	ld_diagram_insert_objects (self,
+		(LdDiagramObject **) objects->pdata, objects->len, -1);
+	if (insert_time)
+		insert_time = g_get_monotonic_time () - insert_time;
+
+	if (trace)
+	{
+		gchar *detail;
+
+		detail = g_strdup_printf ("objects=%u construct_us=%"
+			G_GINT64_FORMAT " insert_us=%" G_GINT64_FORMAT,
+			objects->len, construct_time, insert_time);
+		ld_trace_end (trace, "diagram", "deserialize", detail);
+		g_free (detail);
 	}
+	g_ptr_array_free (objects, TRUE);
 	return TRUE;
 }
 
@@ -521,7 +982,6 @@ deserialize_object (JsonObject *object_storage)
 	JsonNode *object_type_node;
 	const gchar *type;
 
-	json_object_ref (object_storage);
 	object_type_node = json_object_get_member (object_storage, "type");
 
 	if (!object_type_node || !JSON_NODE_HOLDS_VALUE (object_type_node))
@@ -578,6 +1038,245 @@ serialize_object (LdDiagramObject *object)
 	return object_node;
 }
 
+/*
+ * generate_canonical:
+ *
+ * Generate text for a serialized diagram that only depends on its
+ * contents: members are sorted by name, numbers are always written
+ * the same way and each object in the diagram lies on its own line.
+ */
+static gchar *
+generate_canonical (JsonNode *root, gsize *length)
+{
+	GString *string;
+	JsonObject *root_object;
+	GList *members, *iter;
+
+	string = g_string_new ("{\n");
+	root_object = json_node_get_object (root);
+	members = g_list_sort (json_object_get_members (root_object),
+		(GCompareFunc) strcmp);
+	for (iter = members; iter; iter = g_list_next (iter))
+	{
+		JsonNode *node;
+
+		node = json_object_get_member (root_object, iter->data);
+		g_string_append (string, "\t");
+		append_canonical_string (string, iter->data);
+		g_string_append (string, ": ");
+
+		if (!strcmp (iter->data, "objects") && JSON_NODE_HOLDS_ARRAY (node))
+		{
+			GList *objects, *object_iter;
+
+			objects = json_array_get_elements (json_node_get_array (node));
+			g_string_append (string, "[");
+			for (object_iter = objects; object_iter;
+				object_iter = g_list_next (object_iter))
+			{
+				g_string_append (string, object_iter == objects ? "\n" : ",\n");
+				g_string_append (string, "\t\t");
+				append_canonical_node (string, object_iter->data);
+			}
+			g_string_append (string, objects ? "\n\t]" : "]");
+			g_list_free (objects);
+		}
+		else
+			append_canonical_node (string, node);
+
+		g_string_append (string, g_list_next (iter) ? ",\n" : "\n");
+	}
+	g_list_free (members);
+	g_string_append (string, "}\n");
+
+	*length = string->len;
+	return g_string_free (string, FALSE);
+}
+
+static void
+append_canonical_node (GString *string, JsonNode *node)
+{
+	GList *list, *iter;
+
+	switch (json_node_get_node_type (node))
+	{
+	case JSON_NODE_OBJECT:
+	{
+		JsonObject *object;
+
+		object = json_node_get_object (node);
+		list = g_list_sort (json_object_get_members (object),
+			(GCompareFunc) strcmp);
+		g_string_append_c (string, '{');
+		for (iter = list; iter; iter = g_list_next (iter))
+		{
+			if (iter != list)
+				g_string_append (string, ", ");
+			append_canonical_string (string, iter->data);
+			g_string_append (string, ": ");
+			append_canonical_node (string,
+				json_object_get_member (object, iter->data));
+		}
+		g_string_append_c (string, '}');
+		g_list_free (list);
+		break;
+	}
+	case JSON_NODE_ARRAY:
+		list = json_array_get_elements (json_node_get_array (node));
+		g_string_append_c (string, '[');
+		for (iter = list; iter; iter = g_list_next (iter))
+		{
+			if (iter != list)
+				g_string_append (string, ", ");
+			append_canonical_node (string, iter->data);
+		}
+		g_string_append_c (string, ']');
+		g_list_free (list);
+		break;
+	case JSON_NODE_VALUE:
+		switch (json_node_get_value_type (node))
+		{
+		case G_TYPE_INT64:
+			g_string_append_printf (string, "%" G_GINT64_FORMAT,
+				json_node_get_int (node));
+			break;
+		case G_TYPE_DOUBLE:
+			append_canonical_double (string, json_node_get_double (node));
+			break;
+		case G_TYPE_BOOLEAN:
+			g_string_append (string,
+				json_node_get_boolean (node) ? "true" : "false");
+			break;
+		case G_TYPE_STRING:
+			append_canonical_string (string, json_node_get_string (node));
+			break;
+		default:
+			g_string_append (string, "null");
+		}
+		break;
+	case JSON_NODE_NULL:
+		g_string_append (string, "null");
+		break;
+	}
+}
+
+static void
+append_canonical_string (GString *string, const gchar *value)
+{
+	g_string_append_c (string, '"');
+	for (; *value; value++)
+	{
+		switch (*value)
+		{
+		case '"':
+			g_string_append (string, "\\\"");
+			break;
+		case '\\':
+			g_string_append (string, "\\\\");
+			break;
+		case '\n':
+			g_string_append (string, "\\n");
+			break;
+		case '\t':
+			g_string_append (string, "\\t");
+			break;
+		default:
+			if ((guchar) *value < 0x20)
+				g_string_append_printf (string, "\\u%04x", (guchar) *value);
+			else
+				g_string_append_c (string, *value);
+		}
+	}
+	g_string_append_c (string, '"');
+}
+
+/*
+ * append_canonical_double:
+ *
+ * Write the number with the lowest precision that reads back exactly,
+ * taking care that it can't be mistaken for an integer.
+ */
+static void
+append_canonical_double (GString *string, gdouble value)
+{
+	gchar buffer[G_ASCII_DTOSTR_BUF_SIZE];
+
+	/* JSON can't express these, they're read back as the default. */
+	if (!isfinite (value))
+	{
+		g_string_append (string, "null");
+		return;
+	}
+
+	g_ascii_formatd (buffer, sizeof buffer, "%.15g", value);
+	if (g_ascii_strtod (buffer, NULL) != value)
+		g_ascii_formatd (buffer, sizeof buffer, "%.17g", value);
+
+	g_string_append (string, buffer);
+	if (!strpbrk (buffer, ".eE"))
+		g_string_append (string, ".0");
+}
+
+/*
+ * copy_node:
+ *
+ * Make a deep copy of a node, unlike json_node_copy().
+ */
+static JsonNode *
+copy_node (JsonNode *node)
+{
+	JsonNode *copy;
+	JsonArray *array, *array_copy;
+	guint i, length;
+
+	switch (JSON_NODE_TYPE (node))
+	{
+	case JSON_NODE_OBJECT:
+		copy = json_node_new (JSON_NODE_OBJECT);
+		json_node_take_object (copy, copy_object (json_node_get_object (node)));
+		return copy;
+	case JSON_NODE_ARRAY:
+		array = json_node_get_array (node);
+		length = json_array_get_length (array);
+		array_copy = json_array_sized_new (length);
+		for (i = 0; i < length; i++)
+			json_array_add_element (array_copy,
+				copy_node (json_array_get_element (array, i)));
+
+		copy = json_node_new (JSON_NODE_ARRAY);
+		json_node_take_array (copy, array_copy);
+		return copy;
+	default:
+		return json_node_copy (node);
+	}
+}
+
+static JsonObject *
+copy_object (JsonObject *object)
+{
+	JsonObject *copy;
+	GList *members, *iter;
+
+	copy = json_object_new ();
+	members = json_object_get_members (object);
+	for (iter = members; iter; iter = g_list_next (iter))
+		json_object_set_member (copy, iter->data,
+			copy_node (json_object_get_member (object, iter->data)));
+	g_list_free (members);
+	return copy;
+}
+
+static gdouble
+get_double_member (JsonObject *object, const gchar *name)
+{
+	JsonNode *node;
+
+	node = json_object_get_member (object, name);
+	if (!node || !JSON_NODE_HOLDS_VALUE (node))
+		return 0;
+	return json_node_get_double (node);
+}
+
 static const gchar *
 get_object_class_string (GType type)
 {
@@ -620,19 +1319,435 @@ ld_diagram_set_modified (LdDiagram *self, gboolean value)
 	g_object_notify (G_OBJECT (self), "modified");
 }
 
-static void
+/**
+ * ld_diagram_get_compression_level:
+ * @self: an #LdDiagram object.
+ *
+ * Return value: the level of gzip compression used for saving,
+ *               zero if files are saved uncompressed.
+ */
+gint
+ld_diagram_get_compression_level (LdDiagram *self)
+{
+	g_return_val_if_fail (LD_IS_DIAGRAM (self), 0);
+	return self->priv->compression_level;
+}
+
+/**
+ * ld_diagram_set_compression_level:
+ * @self: an #LdDiagram object.
+ * @level: a gzip level from 1 to 9, or zero to disable compression.
+ *
+ * Set how the diagram is going to be compressed when saved.
+ */
+void
+ld_diagram_set_compression_level (LdDiagram *self, gint level)
+{
+	g_return_if_fail (LD_IS_DIAGRAM (self));
+	g_return_if_fail (level >= 0 && level <= 9);
+
+	if (self->priv->compression_level == level)
+		return;
+
+	self->priv->compression_level = level;
+	g_object_notify (G_OBJECT (self), "compression-level");
+}
+
+/**
+ * ld_diagram_get_canonical:
+ * @self: an #LdDiagram object.
+ *
+ * Return value: whether the diagram is saved in the canonical form.
+ */
+gboolean
+ld_diagram_get_canonical (LdDiagram *self)
+{
+	g_return_val_if_fail (LD_IS_DIAGRAM (self), FALSE);
+	return self->priv->canonical;
+}
+
+/**
+ * ld_diagram_set_canonical:
+ * @self: an #LdDiagram object.
+ * @value: whether to save the diagram in the canonical form.
+ *
+ * Set whether the diagram is saved in the canonical form.
+ */
+void
+ld_diagram_set_canonical (LdDiagram *self, gboolean value)
+{
+	g_return_if_fail (LD_IS_DIAGRAM (self));
+
+	if (self->priv->canonical == !!value)
+		return;
+
+	self->priv->canonical = !!value;
+	g_object_notify (G_OBJECT (self), "canonical");
+}
+
+/**
+ * ld_diagram_set_journal:
+ * @self: an #LdDiagram object.
+ * @journal: (allow-none): a journal to record changes into, or %NULL.
+ *
+ * Record each completed change to the diagram into a journal, so that
+ * it can be recovered with ld_diagram_replay_journal() if the program
+ * ends before the diagram is saved.  Saving the diagram into a file
+ * truncates the journal.  The journal is not owned by the diagram and
+ * it has to be detached before it is freed.
+ */
+void
+ld_diagram_set_journal (LdDiagram *self, LdJournal *journal)
+{
+	g_return_if_fail (LD_IS_DIAGRAM (self));
+
+	journal_discard (self);
+	self->priv->journal = journal;
+}
+
+/**
+ * ld_diagram_get_journal:
+ * @self: an #LdDiagram object.
+ *
+ * Return value: (allow-none): the journal of the diagram, if any.
+ */
+LdJournal *
+ld_diagram_get_journal (LdDiagram *self)
+{
+	g_return_val_if_fail (LD_IS_DIAGRAM (self), NULL);
+	return self->priv->journal;
+}
+
+/**
+ * ld_diagram_replay_journal:
+ * @self: an #LdDiagram object.
+ * @filename: a journal that has been recorded for the diagram.
+ * @error: (allow-none): return location for a #GError, or %NULL.
+ *
+ * Apply changes from a journal to the diagram, which should be in
+ * the state that the journal has started from.  Incomplete changes
+ * at the end of the journal are ignored.  If any complete change can't
+ * be applied, the diagram is left as it was.  The changes cannot be undone.
+ *
+ * Return value: %TRUE if the journal could be replayed, %FALSE otherwise.
+ */
+gboolean
+ld_diagram_replay_journal (LdDiagram *self,
+	const gchar *filename, GError **error)
+{
+	gchar *contents, **lines, **iter;
+	GPtrArray *group, *objects;
+	LdJournal *journal;
+	gboolean success, changed;
+	GList *link;
+	guint i;
+
+	g_return_val_if_fail (LD_IS_DIAGRAM (self), FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	if (!g_file_get_contents (filename, &contents, NULL, error))
+		return FALSE;
+
+	lines = g_strsplit (contents, "\n", -1);
+	g_free (contents);
+
+	/* Positions are looked up in an array rather than in the list. */
+	objects = g_ptr_array_new_with_free_func (g_object_unref);
+	for (link = self->priv->objects; link; link = g_list_next (link))
+		g_ptr_array_add (objects, g_object_ref (link->data));
+
+	/* Each change is a group of lines terminated with a commit. */
+	success = TRUE;
+	changed = FALSE;
+	group = g_ptr_array_new_with_free_func (g_object_unref);
+	for (iter = lines; success && *iter; iter++)
+	{
+		JsonParser *parser;
+		JsonNode *root, *op_node;
+
+		if (!**iter)
+			continue;
+
+		parser = json_parser_new ();
+		if (!json_parser_load_from_data (parser, *iter, -1, NULL)
+			|| !JSON_NODE_HOLDS_OBJECT (root = json_parser_get_root (parser)))
+		{
+			/* This is most likely the tail of an interrupted write. */
+			g_object_unref (parser);
+			break;
+		}
+
+		op_node = json_object_get_member (json_node_get_object (root), "op");
+		if (!op_node || !JSON_NODE_HOLDS_VALUE (op_node)
+			|| g_strcmp0 (json_node_get_string (op_node), "commit"))
+		{
+			g_ptr_array_add (group, parser);
+			continue;
+		}
+		g_object_unref (parser);
+
+		for (i = 0; success && i < group->len; i++)
+			success = journal_apply (objects, json_node_get_object
+				(json_parser_get_root (g_ptr_array_index (group, i))), error);
+		changed |= group->len != 0;
+		g_ptr_array_set_size (group, 0);
+	}
+	g_ptr_array_free (group, TRUE);
+	g_strfreev (lines);
+
+	if (success && changed)
+	{
+		journal = self->priv->journal;
+		self->priv->journal = NULL;
+		self->priv->lock_history = TRUE;
+
+		ld_diagram_clear (self);
+		ld_diagram_insert_objects (self,
+			(LdDiagramObject **) objects->pdata, objects->len, -1);
+
+		self->priv->lock_history = FALSE;
+		self->priv->journal = journal;
+	}
+	g_ptr_array_free (objects, TRUE);
+	return success;
+}
+
+static void
+journal_record (LdDiagram *self, JournalOpType type,
+	gint pos, LdDiagramObject *object)
+{
+	JournalOp op;
+
+	if (!self->priv->journal)
+		return;
+
+	op.type = type;
+	op.pos = pos;
+	op.object = object ? g_object_ref (object) : NULL;
+	g_array_append_val (self->priv->journal_ops, op);
+}
+
+/*
+ * journal_mark_dirty:
+ *
+ * Have the current state of an object written with the next change.
+ */
+static void
+journal_mark_dirty (LdDiagram *self, LdDiagramObject *object)
+{
+	if (self->priv->journal
+		&& !g_hash_table_contains (self->priv->journal_dirty, object))
+		g_hash_table_add (self->priv->journal_dirty, g_object_ref (object));
+}
+
+static void
+journal_discard (LdDiagram *self)
+{
+	guint i;
+
+	for (i = 0; i < self->priv->journal_ops->len; i++)
+	{
+		JournalOp *op;
+
+		op = &g_array_index (self->priv->journal_ops, JournalOp, i);
+		if (op->object)
+			g_object_unref (op->object);
+	}
+	g_array_set_size (self->priv->journal_ops, 0);
+	g_hash_table_remove_all (self->priv->journal_dirty);
+}
+
+/*
+ * journal_maybe_flush:
+ *
+ * Write pending changes to the journal as a single group,
+ * unless they are only a part of a larger change.
+ */
+static void
+journal_maybe_flush (LdDiagram *self)
+{
+	JsonGenerator *generator;
+	JsonObject *line;
+	GString *buffer;
+	GList *iter;
+	GError *error;
+	gint pos;
+	guint i;
+
+	if (!self->priv->journal
+		|| self->priv->in_user_action || self->priv->lock_history)
+		return;
+	if (!self->priv->journal_ops->len
+		&& !g_hash_table_size (self->priv->journal_dirty))
+		return;
+
+	generator = json_generator_new ();
+	buffer = g_string_new (NULL);
+
+	/* Objects are only serialized now so that they're up to date. */
+	for (i = 0; i < self->priv->journal_ops->len; i++)
+	{
+		JournalOp *op;
+
+		op = &g_array_index (self->priv->journal_ops, JournalOp, i);
+		line = json_object_new ();
+		switch (op->type)
+		{
+		case JOURNAL_OP_INSERT:
+			json_object_set_string_member (line, "op", "insert");
+			json_object_set_int_member (line, "pos", op->pos);
+			json_object_set_member (line, "object",
+				serialize_object (op->object));
+			break;
+		case JOURNAL_OP_REMOVE:
+			json_object_set_string_member (line, "op", "remove");
+			json_object_set_int_member (line, "pos", op->pos);
+			break;
+		case JOURNAL_OP_CLEAR:
+			json_object_set_string_member (line, "op", "clear");
+		}
+		journal_write_line (generator, buffer, line);
+	}
+
+	/* Objects that have been removed in the meantime are skipped. */
+	pos = 0;
+	if (g_hash_table_size (self->priv->journal_dirty))
+		for (iter = self->priv->objects; iter; iter = g_list_next (iter))
+		{
+			if (g_hash_table_contains (self->priv->journal_dirty, iter->data))
+			{
+				line = json_object_new ();
+				json_object_set_string_member (line, "op", "set");
+				json_object_set_int_member (line, "pos", pos);
+				json_object_set_member (line, "object",
+					serialize_object (LD_DIAGRAM_OBJECT (iter->data)));
+				journal_write_line (generator, buffer, line);
+			}
+			pos++;
+		}
+
+	line = json_object_new ();
+	json_object_set_string_member (line, "op", "commit");
+	journal_write_line (generator, buffer, line);
+
+	error = NULL;
+	if (!ld_journal_append (self->priv->journal,
+		buffer->str, buffer->len, &error))
+	{
+		g_warning ("%s", error->message);
+		g_error_free (error);
+	}
+
+	g_string_free (buffer, TRUE);
+	g_object_unref (generator);
+	journal_discard (self);
+}
+
+/*
+ * journal_write_line:
+ * @line: a journal record.  It is taken over.
+ *
+ * Append a compact line of JSON to the buffer.
+ */
+static void
+journal_write_line (JsonGenerator *generator, GString *buffer,
+	JsonObject *line)
+{
+	JsonNode *node;
+	gchar *data;
+	gsize length;
+
+	node = json_node_new (JSON_NODE_OBJECT);
+	json_node_take_object (node, line);
+	json_generator_set_root (generator, node);
+	json_node_free (node);
+
+	data = json_generator_to_data (generator, &length);
+	g_string_append_len (buffer, data, length);
+	g_string_append_c (buffer, '\n');
+	g_free (data);
+}
+
+/*
+ * journal_apply:
+ * @objects: (element-type LdDiagramObject): objects of the diagram.
+ *
+ * Apply a journal record to an array of objects.
+ */
+static gboolean
+journal_apply (GPtrArray *objects, JsonObject *line, GError **error)
+{
+	JsonNode *op_node, *pos_node, *object_node;
+	LdDiagramObject *object;
+	const gchar *op;
+	gint64 pos, length;
+
+	op_node = json_object_get_member (line, "op");
+	op = (op_node && JSON_NODE_HOLDS_VALUE (op_node))
+		? json_node_get_string (op_node) : NULL;
+	pos_node = json_object_get_member (line, "pos");
+	pos = (pos_node && JSON_NODE_HOLDS_VALUE (pos_node))
+		? json_node_get_int (pos_node) : -1;
+	object_node = json_object_get_member (line, "object");
+	if (object_node && !JSON_NODE_HOLDS_OBJECT (object_node))
+		object_node = NULL;
+
+	length = objects->len;
+	if (!g_strcmp0 (op, "clear"))
+	{
+		g_ptr_array_set_size (objects, 0);
+		return TRUE;
+	}
+	if (!g_strcmp0 (op, "remove") && pos >= 0 && pos < length)
+	{
+		g_ptr_array_remove_index (objects, pos);
+		return TRUE;
+	}
+	if (!g_strcmp0 (op, "set") && object_node && pos >= 0 && pos < length)
+	{
+		g_object_unref (g_ptr_array_index (objects, pos));
+		g_ptr_array_index (objects, pos) =
+			deserialize_object (json_node_get_object (object_node));
+		return TRUE;
+	}
+	if (!g_strcmp0 (op, "insert") && object_node && pos >= 0 && pos <= length)
+	{
+		object = deserialize_object (json_node_get_object (object_node));
+		g_ptr_array_add (objects, object);
+		memmove (objects->pdata + pos + 1, objects->pdata + pos,
+			(length - pos) * sizeof (gpointer));
+		g_ptr_array_index (objects, pos) = object;
+		return TRUE;
+	}
+
+	g_set_error (error, LD_DIAGRAM_ERROR, LD_DIAGRAM_ERROR_DIAGRAM_CORRUPT,
+		"invalid journal record");
+	return FALSE;
+}
+
+static void
 on_object_changed (LdDiagramObject *object,
 	LdUndoAction *action, gpointer user_data)
 {
 	LdDiagram *self;
 
 	self = LD_DIAGRAM (user_data);
+
 	push_undo_action (self, action);
+	journal_mark_dirty (self, object);
 
 	g_signal_emit (self,
 		LD_DIAGRAM_GET_CLASS (self)->changed_signal, 0);
 }
 
+static void
+on_object_notify (LdDiagramObject *object,
+	GParamSpec *pspec, gpointer user_data)
+{
+	/* Undo and redo only change objects without emitting "changed". */
+	journal_mark_dirty (LD_DIAGRAM (user_data), object);
+}
+
 static void
 on_object_notify_storage (LdDiagramObject *object,
 	GParamSpec *pspec, gpointer user_data)
@@ -802,6 +1917,8 @@ ld_diagram_end_user_action (LdDiagram *self)
 	if (!--self->priv->in_user_action && !self->priv->undo_stack->data)
 		self->priv->undo_stack = g_list_delete_link
 			(self->priv->undo_stack, self->priv->undo_stack);
+
+	journal_maybe_flush (self);
 }
 
 static void
@@ -838,11 +1955,49 @@ on_object_action_destroy (gpointer user_data)
 	g_slice_free (ObjectActionData, data);
 }
 
+/*
+ * generate_id:
+ *
+ * Return value: a new identifier that isn't used within the diagram.
+ * Random ones don't clash even when merging independent changes.
+ */
+static gchar *
+generate_id (LdDiagram *self)
+{
+	gchar *id;
+
+	id = NULL;
+	do
+	{
+		g_free (id);
+		id = g_strdup_printf ("%08x%08x", g_random_int (), g_random_int ());
+	}
+	while (g_hash_table_contains (self->priv->index, id));
+	return id;
+}
+
 static void
 install_object (LdDiagramObject *object, LdDiagram *self)
 {
+	const gchar *id;
+
+	/* Copies of objects come with identifiers that are already taken. */
+	id = ld_diagram_object_get_id (object);
+	if (!id || g_hash_table_contains (self->priv->index, id))
+	{
+		gchar *new_id;
+
+		new_id = generate_id (self);
+		ld_diagram_object_set_id (object, new_id);
+		g_free (new_id);
+		id = ld_diagram_object_get_id (object);
+	}
+	g_hash_table_insert (self->priv->index, g_strdup (id), object);
+
 	g_signal_connect (object, "changed",
 		G_CALLBACK (on_object_changed), self);
+	g_signal_connect (object, "notify",
+		G_CALLBACK (on_object_notify), self);
 	g_signal_connect (object, "notify::storage",
 		G_CALLBACK (on_object_notify_storage), self);
 	g_object_ref (object);
@@ -851,8 +2006,16 @@ install_object (LdDiagramObject *object, LdDiagram *self)
 static void
 uninstall_object (LdDiagramObject *object, LdDiagram *self)
 {
+	const gchar *id;
+
+	id = ld_diagram_object_get_id (object);
+	if (id && g_hash_table_lookup (self->priv->index, id) == object)
+		g_hash_table_remove (self->priv->index, id);
+
 	g_signal_handlers_disconnect_by_func (object,
 		on_object_changed, self);
+	g_signal_handlers_disconnect_by_func (object,
+		on_object_notify, self);
 	g_signal_handlers_disconnect_by_func (object,
 		on_object_notify_storage, self);
 	g_object_unref (object);
@@ -872,6 +2035,40 @@ ld_diagram_get_objects (LdDiagram *self)
 	return self->priv->objects;
 }
 
+/**
+ * ld_diagram_find_object:
+ * @self: an #LdDiagram object.
+ * @id: the identifier of an object.
+ *
+ * Find an object in the diagram by its identifier in constant time.
+ *
+ * Return value: (transfer none) (allow-none): the object, or %NULL
+ *               if there is no such object in the diagram.
+ */
+LdDiagramObject *
+ld_diagram_find_object (LdDiagram *self, const gchar *id)
+{
+	g_return_val_if_fail (LD_IS_DIAGRAM (self), NULL);
+	g_return_val_if_fail (id != NULL, NULL);
+
+	return g_hash_table_lookup (self->priv->index, id);
+}
+
+/**
+ * ld_diagram_get_object_ids:
+ * @self: an #LdDiagram object.
+ *
+ * Return value: (element-type utf8) (transfer container): identifiers
+ *               of all objects in the diagram, in no particular order.
+ *               Free the list with g_list_free().
+ */
+GList *
+ld_diagram_get_object_ids (LdDiagram *self)
+{
+	g_return_val_if_fail (LD_IS_DIAGRAM (self), NULL);
+	return g_hash_table_get_keys (self->priv->index);
+}
+
 /**
  * ld_diagram_insert_object:
  * @self: an #LdDiagram object.
@@ -896,6 +2093,10 @@ ld_diagram_insert_object (LdDiagram *self, LdDiagramObject *object, gint pos)
 	self->priv->objects = g_list_insert (self->priv->objects, object, pos);
 	install_object (object, self);
 
+	if (self->priv->journal)
+		journal_record (self, JOURNAL_OP_INSERT,
+			g_list_index (self->priv->objects, object), object);
+
 	action_data = g_slice_new (ObjectActionData);
 	action_data->self = self;
 	g_object_add_weak_pointer (G_OBJECT (self), &action_data->self);
@@ -907,6 +2108,8 @@ ld_diagram_insert_object (LdDiagram *self, LdDiagramObject *object, gint pos)
 	push_undo_action (self, action);
 	g_object_unref (action);
 
+	g_signal_emit (self,
+		LD_DIAGRAM_GET_CLASS (self)->object_inserted_signal, 0, object);
 	g_signal_emit (self,
 		LD_DIAGRAM_GET_CLASS (self)->changed_signal, 0);
 }
@@ -942,6 +2145,9 @@ ld_diagram_remove_object (LdDiagram *self, LdDiagramObject *object)
 	ld_diagram_unselect (self, object);
 
 	self->priv->objects = g_list_delete_link (self->priv->objects, link);
+	journal_record (self, JOURNAL_OP_REMOVE, pos, NULL);
+	g_signal_emit (self,
+		LD_DIAGRAM_GET_CLASS (self)->object_removed_signal, 0, object);
 	uninstall_object (object, self);
 
 	action_data = g_slice_new (ObjectActionData);
@@ -959,6 +2165,298 @@ ld_diagram_remove_object (LdDiagram *self, LdDiagramObject *object)
 		LD_DIAGRAM_GET_CLASS (self)->changed_signal, 0);
 }
 
+/**
+ * ld_diagram_insert_objects:
+ * @self: an #LdDiagram object.
+ * @objects: (array length=n_objects): objects to be inserted.
+ * @n_objects: the number of objects.
+ * @pos: the position at which the objects are to be inserted.
+ *       Negative values will append to the end.
+ *
+ * Insert objects into the diagram, next to each other and in order,
+ * as a single change that can be undone.  Objects that are already
+ * in the diagram are skipped.
+ */
+void
+ld_diagram_insert_objects (LdDiagram *self,
+	LdDiagramObject **objects, guint n_objects, gint pos)
+{
+	GHashTable *present;
+	GArray *entries;
+	GList *iter;
+	guint length, i;
+
+	g_return_if_fail (LD_IS_DIAGRAM (self));
+	g_return_if_fail (objects != NULL || n_objects == 0);
+	for (i = 0; i < n_objects; i++)
+		g_return_if_fail (LD_IS_DIAGRAM_OBJECT (objects[i]));
+
+	present = g_hash_table_new (g_direct_hash, g_direct_equal);
+	length = 0;
+	for (iter = self->priv->objects; iter; iter = g_list_next (iter))
+	{
+		g_hash_table_add (present, iter->data);
+		length++;
+	}
+	if (pos < 0 || (guint) pos > length)
+		pos = length;
+
+	entries = g_array_sized_new (FALSE, FALSE,
+		sizeof (ObjectActionEntry), n_objects);
+	for (i = 0; i < n_objects; i++)
+	{
+		ObjectActionEntry entry;
+
+		if (g_hash_table_contains (present, objects[i]))
+			continue;
+		g_hash_table_add (present, objects[i]);
+
+		entry.object = g_object_ref (objects[i]);
+		entry.pos = pos++;
+		g_array_append_val (entries, entry);
+	}
+	g_hash_table_destroy (present);
+
+	if (entries->len)
+	{
+		insert_entries (self, entries);
+		push_objects_action (self, entries, TRUE);
+		g_signal_emit (self,
+			LD_DIAGRAM_GET_CLASS (self)->changed_signal, 0);
+	}
+	else
+		g_array_free (entries, TRUE);
+}
+
+/**
+ * ld_diagram_remove_objects:
+ * @self: an #LdDiagram object.
+ * @objects: (array length=n_objects): objects to be removed.
+ * @n_objects: the number of objects.
+ *
+ * Remove objects from the diagram as a single change that can be undone.
+ * Objects that aren't in the diagram are skipped.
+ */
+void
+ld_diagram_remove_objects (LdDiagram *self,
+	LdDiagramObject **objects, guint n_objects)
+{
+	GHashTable *set;
+	guint i;
+
+	g_return_if_fail (LD_IS_DIAGRAM (self));
+	g_return_if_fail (objects != NULL || n_objects == 0);
+
+	set = g_hash_table_new (g_direct_hash, g_direct_equal);
+	for (i = 0; i < n_objects; i++)
+		g_hash_table_add (set, objects[i]);
+
+	remove_entries (self, set);
+	g_hash_table_destroy (set);
+}
+
+/*
+ * insert_entries:
+ *
+ * Splice objects into the list at their positions in a single pass.
+ */
+static void
+insert_entries (LdDiagram *self, GArray *entries)
+{
+	GList *link, *prev, *new_link;
+	gint index;
+	guint i;
+
+	link = self->priv->objects;
+	prev = NULL;
+	index = 0;
+	for (i = 0; i < entries->len; i++)
+	{
+		ObjectActionEntry *entry;
+
+		entry = &g_array_index (entries, ObjectActionEntry, i);
+		while (link && index < entry->pos)
+		{
+			prev = link;
+			link = link->next;
+			index++;
+		}
+
+		new_link = g_list_alloc ();
+		new_link->data = entry->object;
+		new_link->prev = prev;
+		new_link->next = link;
+		if (prev)
+			prev->next = new_link;
+		else
+			self->priv->objects = new_link;
+		if (link)
+			link->prev = new_link;
+
+		prev = new_link;
+		index++;
+
+		install_object (entry->object, self);
+		journal_record (self, JOURNAL_OP_INSERT, entry->pos, entry->object);
+	}
+
+	for (i = 0; i < entries->len; i++)
+		g_signal_emit (self,
+			LD_DIAGRAM_GET_CLASS (self)->object_inserted_signal, 0,
+			g_array_index (entries, ObjectActionEntry, i).object);
+}
+
+/*
+ * remove_entries:
+ *
+ * Remove objects in a set from the list in a single pass.
+ */
+static void
+remove_entries (LdDiagram *self, GHashTable *set)
+{
+	GArray *entries;
+	GList *link, *next, *unselect;
+	gint index;
+	guint i;
+
+	/* Unselecting objects one by one is much too slow. */
+	unselect = NULL;
+	for (link = self->priv->selection; link; link = g_list_next (link))
+		if (g_hash_table_contains (set, link->data))
+			unselect = g_list_prepend (unselect, link->data);
+	ld_diagram_change_selection (self, NULL, unselect);
+	g_list_free (unselect);
+
+	entries = g_array_new (FALSE, FALSE, sizeof (ObjectActionEntry));
+	index = 0;
+	for (link = self->priv->objects; link; link = next, index++)
+	{
+		ObjectActionEntry entry;
+
+		next = g_list_next (link);
+		if (!g_hash_table_contains (set, link->data))
+			continue;
+
+		entry.object = g_object_ref (link->data);
+		entry.pos = index;
+		g_array_append_val (entries, entry);
+		self->priv->objects = g_list_delete_link (self->priv->objects, link);
+	}
+
+	if (!entries->len)
+	{
+		g_array_free (entries, TRUE);
+		return;
+	}
+
+	/* Positions only stay valid when removing from the end. */
+	for (i = entries->len; i--; )
+		journal_record (self, JOURNAL_OP_REMOVE,
+			g_array_index (entries, ObjectActionEntry, i).pos, NULL);
+
+	for (i = 0; i < entries->len; i++)
+	{
+		ObjectActionEntry *entry;
+
+		entry = &g_array_index (entries, ObjectActionEntry, i);
+		g_signal_emit (self,
+			LD_DIAGRAM_GET_CLASS (self)->object_removed_signal, 0,
+			entry->object);
+		uninstall_object (entry->object, self);
+	}
+
+	push_objects_action (self, entries, FALSE);
+	g_signal_emit (self,
+		LD_DIAGRAM_GET_CLASS (self)->changed_signal, 0);
+}
+
+/*
+ * push_objects_action:
+ * @entries: inserted or removed objects, each with a reference.
+ *           The array is taken over.
+ * @inserted: whether the objects have been inserted.
+ *
+ * Record a compact undo action for a batch of objects.
+ */
+static void
+push_objects_action (LdDiagram *self, GArray *entries, gboolean inserted)
+{
+	ObjectsActionData *action_data;
+	LdUndoAction *action;
+
+	action_data = g_slice_new (ObjectsActionData);
+	action_data->self = self;
+	g_object_add_weak_pointer (G_OBJECT (self), &action_data->self);
+	action_data->entries = entries;
+
+	if (inserted)
+		action = ld_undo_action_new (on_objects_action_remove,
+			on_objects_action_insert, on_objects_action_destroy, action_data);
+	else
+		action = ld_undo_action_new (on_objects_action_insert,
+			on_objects_action_remove, on_objects_action_destroy, action_data);
+	push_undo_action (self, action);
+	g_object_unref (action);
+}
+
+static void
+on_objects_action_insert (gpointer user_data)
+{
+	ObjectsActionData *data;
+	GArray *entries;
+	guint i;
+
+	data = user_data;
+	g_return_if_fail (data->self != NULL);
+
+	/* The undo stack keeps its own copy. */
+	entries = g_array_sized_new (FALSE, FALSE,
+		sizeof (ObjectActionEntry), data->entries->len);
+	g_array_append_vals (entries, data->entries->data, data->entries->len);
+	for (i = 0; i < entries->len; i++)
+		g_object_ref (g_array_index (entries, ObjectActionEntry, i).object);
+
+	insert_entries ((LdDiagram *) data->self, entries);
+	push_objects_action ((LdDiagram *) data->self, entries, TRUE);
+	g_signal_emit (data->self,
+		LD_DIAGRAM_GET_CLASS (data->self)->changed_signal, 0);
+}
+
+static void
+on_objects_action_remove (gpointer user_data)
+{
+	ObjectsActionData *data;
+	GHashTable *set;
+	guint i;
+
+	data = user_data;
+	g_return_if_fail (data->self != NULL);
+
+	set = g_hash_table_new (g_direct_hash, g_direct_equal);
+	for (i = 0; i < data->entries->len; i++)
+		g_hash_table_add (set,
+			g_array_index (data->entries, ObjectActionEntry, i).object);
+
+	remove_entries ((LdDiagram *) data->self, set);
+	g_hash_table_destroy (set);
+}
+
+static void
+on_objects_action_destroy (gpointer user_data)
+{
+	ObjectsActionData *data;
+	guint i;
+
+	data = user_data;
+	if (data->self)
+		g_object_remove_weak_pointer (G_OBJECT (data->self), &data->self);
+	for (i = 0; i < data->entries->len; i++)
+		g_object_unref (g_array_index (data->entries,
+			ObjectActionEntry, i).object);
+	g_array_free (data->entries, TRUE);
+	g_slice_free (ObjectsActionData, data);
+}
+
 /**
  * ld_diagram_get_selection:
  * @self: an #LdDiagram object.
@@ -982,20 +2480,298 @@ ld_diagram_get_selection (LdDiagram *self)
 void
 ld_diagram_remove_selection (LdDiagram *self)
 {
-	GList *selection_copy, *iter;
+	GPtrArray *objects;
+	GList *iter;
 
 	g_return_if_fail (LD_IS_DIAGRAM (self));
 
 	/* We still retain references in the object list. */
-	selection_copy = g_list_copy (self->priv->selection);
-	ld_diagram_unselect_all (self);
+	objects = g_ptr_array_new ();
+	for (iter = self->priv->selection; iter; iter = g_list_next (iter))
+		g_ptr_array_add (objects, iter->data);
+
+	ld_diagram_remove_objects (self,
+		(LdDiagramObject **) objects->pdata, objects->len);
+	g_ptr_array_free (objects, TRUE);
+}
+
+/**
+ * ld_diagram_copy_selection:
+ * @self: an #LdDiagram object.
+ *
+ * Make a copy of selected objects that is independent of the diagram.
+ * Positions of the objects are relative to the "x" and "y" members
+ * of the resulting fragment, which is otherwise in the file format.
+ *
+ * Return value: (transfer full): a fragment of a diagram,
+ *               or %NULL if nothing is selected.
+ */
+JsonNode *
+ld_diagram_copy_selection (LdDiagram *self)
+{
+	JsonNode *fragment;
+
+	fragment = ld_diagram_copy_selection_deferred (self);
+	ld_diagram_finish_copy (self);
+	return fragment;
+}
+
+/**
+ * ld_diagram_copy_selection_deferred:
+ * @self: an #LdDiagram object.
+ *
+ * Like ld_diagram_copy_selection() but the fragment is only filled in
+ * from idle callbacks, a few objects at a time.  The copy is finished
+ * before any of the objects changes, even after it has been removed
+ * from the diagram, so it still reflects the selection at the time
+ * of the call.  Only one copy can be in progress, starting another one
+ * finishes the previous one.
+ *
+ * Call ld_diagram_finish_copy() before using the fragment.
+ *
+ * Return value: (transfer full): a fragment of a diagram,
+ *               or %NULL if nothing is selected.
+ */
+JsonNode *
+ld_diagram_copy_selection_deferred (LdDiagram *self)
+{
+	GHashTable *selected;
+	JsonNode *root_node;
+	CopyData *data;
+	GList *iter;
+
+	g_return_val_if_fail (LD_IS_DIAGRAM (self), NULL);
+
+	if (!self->priv->selection)
+		return NULL;
+
+	ld_diagram_finish_copy (self);
+	data = g_slice_new (CopyData);
+	data->objects = g_ptr_array_new_with_free_func (g_object_unref);
+	data->next = 0;
+	data->have_origin = FALSE;
+	data->origin_x = G_MAXDOUBLE;
+	data->origin_y = G_MAXDOUBLE;
+
+	selected = g_hash_table_new (g_direct_hash, g_direct_equal);
+	for (iter = self->priv->selection; iter; iter = g_list_next (iter))
+		g_hash_table_add (selected, iter->data);
+
+	/* Keep the objects in their stacking order. */
+	for (iter = self->priv->objects; iter; iter = g_list_next (iter))
+		if (g_hash_table_contains (selected, iter->data))
+		{
+			g_ptr_array_add (data->objects, g_object_ref (iter->data));
+			g_signal_connect (iter->data, "about-to-change",
+				G_CALLBACK (on_copy_object_about_to_change), self);
+		}
+	g_hash_table_destroy (selected);
+
+	root_node = json_node_new (JSON_NODE_OBJECT);
+	data->root = json_object_new ();
+	json_node_set_object (root_node, data->root);
+	json_object_set_int_member (data->root, "version", 1);
+	json_object_set_double_member (data->root, "x", 0);
+	json_object_set_double_member (data->root, "y", 0);
+	data->array = json_array_new ();
+	json_object_set_array_member (data->root,
+		"objects", json_array_ref (data->array));
+
+	self->priv->copy = data;
+	self->priv->copy_source = g_idle_add (on_copy_idle, self);
+	return root_node;
+}
+
+/**
+ * ld_diagram_finish_copy:
+ * @self: an #LdDiagram object.
+ *
+ * Finish any copy that ld_diagram_copy_selection_deferred() has left
+ * in progress.
+ */
+void
+ld_diagram_finish_copy (LdDiagram *self)
+{
+	g_return_if_fail (LD_IS_DIAGRAM (self));
+
+	if (self->priv->copy)
+		copy_advance (self, G_MAXUINT);
+}
+
+static gboolean
+on_copy_idle (gpointer user_data)
+{
+	LdDiagram *self;
+
+	self = LD_DIAGRAM (user_data);
+	if (copy_advance (self, COPY_CHUNK_SIZE))
+		return G_SOURCE_CONTINUE;
+
+	/* The source has already been destroyed by this point. */
+	return G_SOURCE_REMOVE;
+}
+
+static void
+on_copy_object_about_to_change (LdDiagramObject *object, gpointer user_data)
+{
+	/* The copy must reflect the state before the change. */
+	ld_diagram_finish_copy (LD_DIAGRAM (user_data));
+}
+
+/*
+ * copy_advance:
+ * @limit: the maximum number of objects to process.
+ *
+ * Find the origin of the copy in the first pass over selected objects,
+ * then copy them in the second one.
+ *
+ * Return value: whether the copy is still in progress.
+ */
+static gboolean
+copy_advance (LdDiagram *self, guint limit)
+{
+	CopyData *data;
+	gdouble x, y;
+
+	data = self->priv->copy;
+	for (; limit && data->next < data->objects->len; limit--, data->next++)
+	{
+		LdDiagramObject *object;
+		JsonNode *node, *copy;
 
-	ld_diagram_begin_user_action (self);
-	for (iter = selection_copy; iter; iter = g_list_next (iter))
-		ld_diagram_remove_object (self, LD_DIAGRAM_OBJECT (iter->data));
-	ld_diagram_end_user_action (self);
+		object = g_ptr_array_index (data->objects, data->next);
+		g_object_get (object, "x", &x, "y", &y, NULL);
+		if (!data->have_origin)
+		{
+			data->origin_x = MIN (data->origin_x, x);
+			data->origin_y = MIN (data->origin_y, y);
+			continue;
+		}
 
-	g_list_free (selection_copy);
+		node = serialize_object (object);
+		copy = copy_node (node);
+		json_node_free (node);
+
+		/* The position may not be stored when it's the default. */
+		json_object_set_double_member (json_node_get_object (copy),
+			"x", x - data->origin_x);
+		json_object_set_double_member (json_node_get_object (copy),
+			"y", y - data->origin_y);
+		json_array_add_element (data->array, copy);
+	}
+
+	if (data->next < data->objects->len)
+		return TRUE;
+
+	if (!data->have_origin)
+	{
+		/* Stay aligned to the grid. */
+		data->origin_x = floor (data->origin_x);
+		data->origin_y = floor (data->origin_y);
+		json_object_set_double_member (data->root, "x", data->origin_x);
+		json_object_set_double_member (data->root, "y", data->origin_y);
+
+		data->have_origin = TRUE;
+		data->next = 0;
+		return copy_advance (self, limit);
+	}
+
+	g_source_remove (self->priv->copy_source);
+	self->priv->copy_source = 0;
+	self->priv->copy = NULL;
+
+	for (data->next = 0; data->next < data->objects->len; data->next++)
+		g_signal_handlers_disconnect_by_func
+			(g_ptr_array_index (data->objects, data->next),
+			on_copy_object_about_to_change, self);
+	g_ptr_array_free (data->objects, TRUE);
+	json_object_unref (data->root);
+	json_array_unref (data->array);
+	g_slice_free (CopyData, data);
+	return FALSE;
+}
+
+/**
+ * ld_diagram_paste:
+ * @self: an #LdDiagram object.
+ * @fragment: a fragment of a diagram from ld_diagram_copy_selection().
+ * @origin: (allow-none): where to put the fragment, or %NULL to put it
+ *          where it has been copied from.
+ * @error: (allow-none): return location for a #GError, or %NULL.
+ *
+ * Insert new copies of objects from a fragment as a single change
+ * that can be undone and make them the selection.
+ *
+ * Return value: %TRUE if no error has occured, %FALSE otherwise.
+ */
+gboolean
+ld_diagram_paste (LdDiagram *self, JsonNode *fragment,
+	const LdPoint *origin, GError **error)
+{
+	JsonObject *root_object;
+	JsonNode *objects_node;
+	GPtrArray *objects;
+	GList *elements, *iter, *unselect;
+	gdouble origin_x, origin_y;
+	guint i;
+
+	g_return_val_if_fail (LD_IS_DIAGRAM (self), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	if (!check_node (fragment, JSON_NODE_OBJECT, "the root node", error))
+		return FALSE;
+
+	root_object = json_node_get_object (fragment);
+	objects_node = json_object_get_member (root_object, "objects");
+	if (!check_node (objects_node, JSON_NODE_ARRAY,
+		"the `objects' array", error))
+		return FALSE;
+
+	if (origin)
+	{
+		origin_x = origin->x;
+		origin_y = origin->y;
+	}
+	else
+	{
+		origin_x = get_double_member (root_object, "x");
+		origin_y = get_double_member (root_object, "y");
+	}
+
+	objects = g_ptr_array_new_with_free_func (g_object_unref);
+	elements = json_array_get_elements (json_node_get_array (objects_node));
+	for (iter = elements; iter; iter = g_list_next (iter))
+	{
+		JsonObject *copy;
+
+		if (!JSON_NODE_HOLDS_OBJECT (iter->data))
+			continue;
+
+		copy = copy_object (json_node_get_object (iter->data));
+		json_object_set_double_member (copy, "x",
+			get_double_member (copy, "x") + origin_x);
+		json_object_set_double_member (copy, "y",
+			get_double_member (copy, "y") + origin_y);
+
+		g_ptr_array_add (objects, deserialize_object (copy));
+		json_object_unref (copy);
+	}
+	g_list_free (elements);
+
+	ld_diagram_insert_objects (self,
+		(LdDiagramObject **) objects->pdata, objects->len, -1);
+
+	elements = NULL;
+	for (i = objects->len; i--; )
+		elements = g_list_prepend (elements, g_ptr_array_index (objects, i));
+
+	unselect = g_list_copy (self->priv->selection);
+	ld_diagram_change_selection (self, elements, unselect);
+	g_list_free (unselect);
+	g_list_free (elements);
+
+	g_ptr_array_free (objects, TRUE);
+	return TRUE;
 }
 
 /**
@@ -1086,6 +2862,76 @@ ld_diagram_unselect_all (LdDiagram *self)
 		LD_DIAGRAM_GET_CLASS (self)->selection_changed_signal, 0);
 }
 
+/**
+ * ld_diagram_change_selection:
+ * @self: an #LdDiagram object.
+ * @select: (element-type LdDiagramObject): objects to be added
+ *          to the selection.
+ * @unselect: (element-type LdDiagramObject): objects to be removed
+ *            from the selection.
+ *
+ * Change the selection in one step, emitting at most a single
+ * #LdDiagram::selection-changed signal.  All objects to be selected
+ * must be a part of the diagram.  Objects that are in both lists
+ * end up selected.
+ */
+void
+ld_diagram_change_selection (LdDiagram *self, GList *select, GList *unselect)
+{
+	GHashTable *set;
+	GList *iter, *next;
+	gboolean changed = FALSE;
+
+	g_return_if_fail (LD_IS_DIAGRAM (self));
+	for (iter = select; iter; iter = g_list_next (iter))
+		g_return_if_fail (LD_IS_DIAGRAM_OBJECT (iter->data));
+
+	/* Go through the current selection just once for each list. */
+	if (unselect && self->priv->selection)
+	{
+		set = g_hash_table_new (g_direct_hash, g_direct_equal);
+		for (iter = unselect; iter; iter = g_list_next (iter))
+			g_hash_table_add (set, iter->data);
+
+		for (iter = self->priv->selection; iter; iter = next)
+		{
+			next = g_list_next (iter);
+			if (!g_hash_table_contains (set, iter->data))
+				continue;
+
+			g_object_unref (iter->data);
+			self->priv->selection
+				= g_list_delete_link (self->priv->selection, iter);
+			changed = TRUE;
+		}
+		g_hash_table_destroy (set);
+	}
+
+	if (select)
+	{
+		set = g_hash_table_new (g_direct_hash, g_direct_equal);
+		for (iter = self->priv->selection; iter; iter = g_list_next (iter))
+			g_hash_table_add (set, iter->data);
+
+		for (iter = select; iter; iter = g_list_next (iter))
+		{
+			if (g_hash_table_contains (set, iter->data))
+				continue;
+
+			g_hash_table_add (set, iter->data);
+			self->priv->selection
+				= g_list_prepend (self->priv->selection, iter->data);
+			g_object_ref (iter->data);
+			changed = TRUE;
+		}
+		g_hash_table_destroy (set);
+	}
+
+	if (changed)
+		g_signal_emit (self,
+			LD_DIAGRAM_GET_CLASS (self)->selection_changed_signal, 0);
+}
+
 static void
 ld_diagram_unselect_all_internal (LdDiagram *self)
 {
@@ -49,6 +49,8 @@ struct _LdDiagramClass
 
 	guint changed_signal;
 	guint selection_changed_signal;
+	guint object_inserted_signal;
+	guint object_removed_signal;
 
 	void (*changed) (LdDiagram *self);
 	void (*selection_changed) (LdDiagram *self);
@@ -85,6 +87,15 @@ gboolean ld_diagram_load_from_file (LdDiagram *self,
 	const gchar *filename, GError **error);
 gboolean ld_diagram_save_to_file (LdDiagram *self,
 	const gchar *filename, GError **error);
+gint ld_diagram_get_compression_level (LdDiagram *self);
+void ld_diagram_set_compression_level (LdDiagram *self, gint level);
+gboolean ld_diagram_get_canonical (LdDiagram *self);
+void ld_diagram_set_canonical (LdDiagram *self, gboolean value);
+
+void ld_diagram_set_journal (LdDiagram *self, LdJournal *journal);
+LdJournal *ld_diagram_get_journal (LdDiagram *self);
+gboolean ld_diagram_replay_journal (LdDiagram *self,
+	const gchar *filename, GError **error);
 
 gboolean ld_diagram_get_modified (LdDiagram *self);
 void ld_diagram_set_modified (LdDiagram *self, gboolean value);
@@ -97,17 +108,30 @@ void ld_diagram_begin_user_action (LdDiagram *self);
 void ld_diagram_end_user_action (LdDiagram *self);
 
 GList *ld_diagram_get_objects (LdDiagram *self);
+LdDiagramObject *ld_diagram_find_object (LdDiagram *self, const gchar *id);
+GList *ld_diagram_get_object_ids (LdDiagram *self);
 void ld_diagram_insert_object (LdDiagram *self,
 	LdDiagramObject *object, gint pos);
 void ld_diagram_remove_object (LdDiagram *self,
 	LdDiagramObject *object);
+void ld_diagram_insert_objects (LdDiagram *self,
+	LdDiagramObject **objects, guint n_objects, gint pos);
+void ld_diagram_remove_objects (LdDiagram *self,
+	LdDiagramObject **objects, guint n_objects);
 
 GList *ld_diagram_get_selection (LdDiagram *self);
 void ld_diagram_remove_selection (LdDiagram *self);
+JsonNode *ld_diagram_copy_selection (LdDiagram *self);
+JsonNode *ld_diagram_copy_selection_deferred (LdDiagram *self);
+void ld_diagram_finish_copy (LdDiagram *self);
+gboolean ld_diagram_paste (LdDiagram *self, JsonNode *fragment,
+	const LdPoint *origin, GError **error);
 void ld_diagram_select (LdDiagram *self, LdDiagramObject *object);
 void ld_diagram_select_all (LdDiagram *self);
 void ld_diagram_unselect (LdDiagram *self, LdDiagramObject *object);
 void ld_diagram_unselect_all (LdDiagram *self);
+void ld_diagram_change_selection (LdDiagram *self,
+	GList *select, GList *unselect);
 
 
 G_END_DECLS
@@ -0,0 +1,829 @@
+/*
+ * ld-document.c
+ *
+ * This file is a part of logdiag.
+ * Copyright 2026 Přemysl Eric Janouch
+ *
+ * See the file LICENSE for licensing information.
+ *
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <glib/gstdio.h>
+
+#include "liblogdiag.h"
+#include "config.h"
+
+
+/**
+ * SECTION:ld-document
+ * @short_description: A hierarchy of diagrams
+ * @see_also: #LdDiagram, #LdDiagramSymbol
+ *
+ * #LdDocument is a hierarchical design made of sheets, each of which is
+ * an #LdDiagram stored in a file of its own.  Symbols with
+ * #LdDiagramSymbol:sheet set stand for child sheets, and symbols with
+ * #LdDiagramSymbol:label set connect nets of different sheets.
+ *
+ * Sheets are only loaded once they're asked for.  When the sizes of files
+ * of loaded sheets exceed the budget, the least recently used ones are
+ * unloaded again, except for the active sheet, sheets with unsaved
+ * changes and sheets held with ld_document_hold_sheet().  Compressed
+ * files count with their uncompressed size.
+ */
+
+/* The default limit on the total size of files of loaded sheets. */
+#define DEFAULT_BUDGET (64 << 20)
+
+/*
+ * Sheet:
+ *
+ * A diagram within the document.
+ */
+typedef struct
+{
+	gchar *filename;         /* The canonical path to the diagram. */
+	LdDiagram *diagram;      /* The diagram, or NULL if it's not loaded. */
+	guint64 cost;            /* Size of the file when it was loaded. */
+	guint holds;             /* How many times the sheet has been held. */
+	gboolean stale;          /* Whether it has changed since indexing. */
+}
+Sheet;
+
+/*
+ * LdDocumentPrivate:
+ * @filename: the path to the root sheet.
+ * @budget: the limit on the total cost of loaded sheets.
+ * @used: the total cost of loaded sheets.
+ * @sheets: (element-type gchar * Sheet *): all known sheets, by path.
+ * @loaded: (element-type Sheet *): loaded sheets, most recently used first.
+ * @active: the sheet that is being worked on, or %NULL.
+ * @labels: (element-type gchar * GHashTable *): sets of sheets that
+ *          contain a label, as far as they have been seen.
+ */
+struct _LdDocumentPrivate
+{
+	gchar *filename;
+	guint64 budget;
+	guint64 used;
+	GHashTable *sheets;
+	GQueue *loaded;
+	Sheet *active;
+	GHashTable *labels;
+};
+
+enum
+{
+	PROP_0,
+	PROP_FILENAME,
+	PROP_BUDGET,
+	PROP_ACTIVE_SHEET
+};
+
+static void ld_document_get_property (GObject *object, guint property_id,
+	GValue *value, GParamSpec *pspec);
+static void ld_document_set_property (GObject *object, guint property_id,
+	const GValue *value, GParamSpec *pspec);
+static void ld_document_finalize (GObject *gobject);
+
+static gchar *canonicalize (const gchar *filename);
+static void sheet_free (Sheet *sheet);
+static Sheet *get_sheet (LdDocument *self,
+	const gchar *filename, GError **error);
+static gboolean load_sheet (LdDocument *self, Sheet *sheet, GError **error);
+static guint64 get_uncompressed_size (const gchar *filename, guint64 size);
+static void unload_sheet (LdDocument *self, Sheet *sheet);
+static void enforce_budget (LdDocument *self, Sheet *keep);
+static void index_sheet (LdDocument *self, Sheet *sheet);
+static void on_sheet_changed (LdDiagram *diagram, Sheet *sheet);
+
+
+G_DEFINE_TYPE (LdDocument, ld_document, G_TYPE_OBJECT)
+
+static void
+ld_document_class_init (LdDocumentClass *klass)
+{
+	GObjectClass *object_class;
+	GParamSpec *pspec;
+
+	object_class = G_OBJECT_CLASS (klass);
+	object_class->get_property = ld_document_get_property;
+	object_class->set_property = ld_document_set_property;
+	object_class->finalize = ld_document_finalize;
+
+/**
+ * LdDocument:filename:
+ *
+ * The path to the root sheet of the document.
+ */
+	pspec = g_param_spec_string ("filename", "Filename",
+		"The path to the root sheet of the document.",
+		NULL, G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+	g_object_class_install_property (object_class, PROP_FILENAME, pspec);
+
+/**
+ * LdDocument:budget:
+ *
+ * The total size of files of sheets that may stay loaded when unused.
+ */
+	pspec = g_param_spec_uint64 ("budget", "Budget",
+		"The total size of files of sheets that may stay loaded.",
+		0, G_MAXUINT64, DEFAULT_BUDGET, G_PARAM_READWRITE);
+	g_object_class_install_property (object_class, PROP_BUDGET, pspec);
+
+/**
+ * LdDocument:active-sheet:
+ *
+ * The path to the sheet that is being worked on.
+ */
+	pspec = g_param_spec_string ("active-sheet", "Active sheet",
+		"The path to the sheet that is being worked on.",
+		NULL, G_PARAM_READABLE);
+	g_object_class_install_property (object_class, PROP_ACTIVE_SHEET, pspec);
+
+/**
+ * LdDocument::sheet-loaded:
+ * @self: an #LdDocument object.
+ * @filename: the path to the sheet.
+ *
+ * A sheet has been loaded.
+ */
+	klass->sheet_loaded_signal = g_signal_new
+		("sheet-loaded", G_TYPE_FROM_CLASS (klass),
+		G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+		g_cclosure_marshal_VOID__STRING, G_TYPE_NONE, 1, G_TYPE_STRING);
+
+/**
+ * LdDocument::sheet-unloaded:
+ * @self: an #LdDocument object.
+ * @filename: the path to the sheet.
+ *
+ * A sheet has been unloaded to save memory.
+ */
+	klass->sheet_unloaded_signal = g_signal_new
+		("sheet-unloaded", G_TYPE_FROM_CLASS (klass),
+		G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+		g_cclosure_marshal_VOID__STRING, G_TYPE_NONE, 1, G_TYPE_STRING);
+
+	g_type_class_add_private (klass, sizeof (LdDocumentPrivate));
+}
+
+static void
+ld_document_init (LdDocument *self)
+{
+	self->priv = G_TYPE_INSTANCE_GET_PRIVATE
+		(self, LD_TYPE_DOCUMENT, LdDocumentPrivate);
+
+	self->priv->budget = DEFAULT_BUDGET;
+	self->priv->sheets = g_hash_table_new_full (g_str_hash, g_str_equal,
+		NULL, (GDestroyNotify) sheet_free);
+	self->priv->loaded = g_queue_new ();
+	self->priv->labels = g_hash_table_new_full (g_str_hash, g_str_equal,
+		g_free, (GDestroyNotify) g_hash_table_destroy);
+}
+
+static void
+ld_document_get_property (GObject *object, guint property_id,
+	GValue *value, GParamSpec *pspec)
+{
+	LdDocument *self;
+
+	self = LD_DOCUMENT (object);
+	switch (property_id)
+	{
+	case PROP_FILENAME:
+		g_value_set_string (value, ld_document_get_filename (self));
+		break;
+	case PROP_BUDGET:
+		g_value_set_uint64 (value, ld_document_get_budget (self));
+		break;
+	case PROP_ACTIVE_SHEET:
+		g_value_set_string (value, ld_document_get_active_sheet (self));
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+	}
+}
+
+static void
+ld_document_set_property (GObject *object, guint property_id,
+	const GValue *value, GParamSpec *pspec)
+{
+	LdDocument *self;
+
+	self = LD_DOCUMENT (object);
+	switch (property_id)
+	{
+	case PROP_FILENAME:
+		self->priv->filename = canonicalize (g_value_get_string (value));
+		break;
+	case PROP_BUDGET:
+		ld_document_set_budget (self, g_value_get_uint64 (value));
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+	}
+}
+
+static void
+ld_document_finalize (GObject *gobject)
+{
+	LdDocument *self;
+
+	self = LD_DOCUMENT (gobject);
+
+	g_hash_table_destroy (self->priv->labels);
+	g_queue_free (self->priv->loaded);
+	g_hash_table_destroy (self->priv->sheets);
+	g_free (self->priv->filename);
+
+	/* Chain up to the parent class. */
+	G_OBJECT_CLASS (ld_document_parent_class)->finalize (gobject);
+}
+
+/**
+ * ld_document_new:
+ * @filename: the path to the root sheet.
+ *
+ * Create an instance.  No sheet is loaded until it's asked for.
+ */
+LdDocument *
+ld_document_new (const gchar *filename)
+{
+	g_return_val_if_fail (filename != NULL, NULL);
+	return g_object_new (LD_TYPE_DOCUMENT, "filename", filename, NULL);
+}
+
+/* ===== Sheets ============================================================ */
+
+/*
+ * canonicalize:
+ *
+ * Make an absolute path without any `.' or `..' components, so that
+ * each sheet is only known under one name.
+ */
+static gchar *
+canonicalize (const gchar *filename)
+{
+	GFile *file;
+	gchar *path;
+
+	if (!filename)
+		return NULL;
+
+	file = g_file_new_for_path (filename);
+	path = g_file_get_path (file);
+	g_object_unref (file);
+	return path;
+}
+
+static void
+sheet_free (Sheet *sheet)
+{
+	if (sheet->diagram)
+	{
+		g_signal_handlers_disconnect_by_func (sheet->diagram,
+			on_sheet_changed, sheet);
+		g_object_unref (sheet->diagram);
+	}
+	g_free (sheet->filename);
+	g_slice_free (Sheet, sheet);
+}
+
+/*
+ * load_sheet:
+ *
+ * Parse a sheet.  Sheets that don't exist yet start out empty.
+ */
+static gboolean
+load_sheet (LdDocument *self, Sheet *sheet, GError **error)
+{
+	LdDiagram *diagram;
+	GStatBuf stat_buf;
+	gchar *display_name;
+	gint errsv;
+
+	diagram = ld_diagram_new ();
+	if (g_stat (sheet->filename, &stat_buf))
+	{
+		/* Saving over a file that merely couldn't be read would be bad. */
+		errsv = errno;
+		if (errsv != ENOENT)
+		{
+			display_name = g_filename_display_name (sheet->filename);
+			g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+				"%s: %s", display_name, g_strerror (errsv));
+			g_free (display_name);
+			g_object_unref (diagram);
+			return FALSE;
+		}
+		sheet->cost = 0;
+	}
+	else if (!ld_diagram_load_from_file (diagram, sheet->filename, error))
+	{
+		g_object_unref (diagram);
+		return FALSE;
+	}
+	else if (ld_diagram_get_compression_level (diagram))
+		sheet->cost = get_uncompressed_size (sheet->filename,
+			stat_buf.st_size);
+	else
+		sheet->cost = stat_buf.st_size;
+
+	/* Inserting the loaded objects has marked it as modified. */
+	ld_diagram_set_modified (diagram, FALSE);
+	sheet->diagram = diagram;
+	self->priv->used += sheet->cost;
+	g_queue_push_head (self->priv->loaded, sheet);
+
+	index_sheet (self, sheet);
+	g_signal_connect (diagram, "changed",
+		G_CALLBACK (on_sheet_changed), sheet);
+	g_signal_emit (self, LD_DOCUMENT_GET_CLASS (self)->sheet_loaded_signal,
+		0, sheet->filename);
+	return TRUE;
+}
+
+/*
+ * get_uncompressed_size:
+ * @size: the size of the gzip file.
+ *
+ * Read the size of the original data from the end of a gzip file,
+ * which is only correct modulo 4 GiB, and for files of one member.
+ *
+ * Return value: the size, or @size if it can't be found out.
+ */
+static guint64
+get_uncompressed_size (const gchar *filename, guint64 size)
+{
+	guchar trailer[4];
+	FILE *fp;
+
+	if (!(fp = g_fopen (filename, "rb")))
+		return size;
+
+	if (!fseek (fp, -4, SEEK_END) && fread (trailer, 4, 1, fp) == 1)
+		size = (guint32) trailer[0] | (guint32) trailer[1] << 8
+			| (guint32) trailer[2] << 16 | (guint32) trailer[3] << 24;
+	fclose (fp);
+	return size;
+}
+
+static void
+unload_sheet (LdDocument *self, Sheet *sheet)
+{
+	/* Keep labels of the sheet around, they may have been changed. */
+	if (sheet->stale)
+		index_sheet (self, sheet);
+
+	g_queue_remove (self->priv->loaded, sheet);
+	self->priv->used -= sheet->cost;
+	g_signal_handlers_disconnect_by_func (sheet->diagram,
+		on_sheet_changed, sheet);
+	g_object_unref (sheet->diagram);
+	sheet->diagram = NULL;
+
+	g_signal_emit (self, LD_DOCUMENT_GET_CLASS (self)->sheet_unloaded_signal,
+		0, sheet->filename);
+}
+
+/*
+ * enforce_budget:
+ * @keep: (allow-none): a sheet that must stay loaded.
+ *
+ * Unload the least recently used sheets until the budget is met,
+ * as far as that is possible.
+ */
+static void
+enforce_budget (LdDocument *self, Sheet *keep)
+{
+	GList *iter, *prev;
+
+	for (iter = g_queue_peek_tail_link (self->priv->loaded);
+		iter && self->priv->used > self->priv->budget; iter = prev)
+	{
+		Sheet *sheet;
+
+		prev = iter->prev;
+		sheet = iter->data;
+		if (sheet == keep || sheet == self->priv->active
+			|| ld_diagram_get_modified (sheet->diagram) || sheet->holds)
+			continue;
+
+		unload_sheet (self, sheet);
+	}
+}
+
+/*
+ * index_sheet:
+ *
+ * Update the label index with the current contents of a loaded sheet.
+ */
+static void
+index_sheet (LdDocument *self, Sheet *sheet)
+{
+	GHashTableIter iter;
+	GHashTable *set;
+	GList *objects;
+
+	g_hash_table_iter_init (&iter, self->priv->labels);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &set))
+	{
+		g_hash_table_remove (set, sheet);
+		if (!g_hash_table_size (set))
+			g_hash_table_iter_remove (&iter);
+	}
+
+	for (objects = ld_diagram_get_objects (sheet->diagram); objects;
+		objects = g_list_next (objects))
+	{
+		const gchar *label;
+
+		if (!LD_IS_DIAGRAM_SYMBOL (objects->data))
+			continue;
+
+		label = ld_diagram_symbol_get_label (objects->data);
+		if (!label)
+			continue;
+
+		set = g_hash_table_lookup (self->priv->labels, label);
+		if (!set)
+		{
+			set = g_hash_table_new (g_direct_hash, g_direct_equal);
+			g_hash_table_insert (self->priv->labels, g_strdup (label), set);
+		}
+		g_hash_table_add (set, sheet);
+	}
+	sheet->stale = FALSE;
+}
+
+static void
+on_sheet_changed (LdDiagram *diagram, Sheet *sheet)
+{
+	sheet->stale = TRUE;
+}
+
+/* ===== Interface ========================================================= */
+
+/**
+ * ld_document_get_filename:
+ * @self: an #LdDocument object.
+ *
+ * Return value: the path to the root sheet.
+ */
+const gchar *
+ld_document_get_filename (LdDocument *self)
+{
+	g_return_val_if_fail (LD_IS_DOCUMENT (self), NULL);
+	return self->priv->filename;
+}
+
+/**
+ * ld_document_get_budget:
+ * @self: an #LdDocument object.
+ *
+ * Return value: the total size of files of sheets that may stay loaded.
+ */
+guint64
+ld_document_get_budget (LdDocument *self)
+{
+	g_return_val_if_fail (LD_IS_DOCUMENT (self), 0);
+	return self->priv->budget;
+}
+
+/**
+ * ld_document_set_budget:
+ * @self: an #LdDocument object.
+ * @budget: the total size of files in bytes.
+ *
+ * Limit the total size of files of sheets that stay loaded when unused.
+ * Sheets over the limit are unloaded immediately.
+ */
+void
+ld_document_set_budget (LdDocument *self, guint64 budget)
+{
+	g_return_if_fail (LD_IS_DOCUMENT (self));
+
+	self->priv->budget = budget;
+	enforce_budget (self, NULL);
+	g_object_notify (G_OBJECT (self), "budget");
+}
+
+/**
+ * ld_document_get_sheet:
+ * @self: an #LdDocument object.
+ * @filename: the path to the sheet.
+ * @error: (allow-none): return location for a #GError, or %NULL.
+ *
+ * Retrieve a sheet of the document, loading it if necessary.  Other
+ * sheets may get unloaded in turn.  Use ld_document_hold_sheet()
+ * to keep it loaded for longer than until the next call.
+ *
+ * Return value: (transfer none): the sheet, or %NULL on error.
+ */
+LdDiagram *
+ld_document_get_sheet (LdDocument *self,
+	const gchar *filename, GError **error)
+{
+	Sheet *sheet;
+
+	g_return_val_if_fail (LD_IS_DOCUMENT (self), NULL);
+	g_return_val_if_fail (filename != NULL, NULL);
+
+	sheet = get_sheet (self, filename, error);
+	return sheet ? sheet->diagram : NULL;
+}
+
+/**
+ * ld_document_hold_sheet:
+ * @self: an #LdDocument object.
+ * @filename: the path to the sheet.
+ * @error: (allow-none): return location for a #GError, or %NULL.
+ *
+ * Retrieve a sheet like ld_document_get_sheet() and keep it loaded
+ * until a matching call to ld_document_release_sheet().
+ *
+ * Return value: (transfer none): the sheet, or %NULL on error.
+ */
+LdDiagram *
+ld_document_hold_sheet (LdDocument *self,
+	const gchar *filename, GError **error)
+{
+	Sheet *sheet;
+
+	g_return_val_if_fail (LD_IS_DOCUMENT (self), NULL);
+	g_return_val_if_fail (filename != NULL, NULL);
+
+	sheet = get_sheet (self, filename, error);
+	if (!sheet)
+		return NULL;
+
+	sheet->holds++;
+	return sheet->diagram;
+}
+
+/**
+ * ld_document_release_sheet:
+ * @self: an #LdDocument object.
+ * @filename: the path to a sheet held with ld_document_hold_sheet().
+ *
+ * Let a sheet be unloaded again once it's no longer held.
+ */
+void
+ld_document_release_sheet (LdDocument *self, const gchar *filename)
+{
+	Sheet *sheet;
+	gchar *path;
+
+	g_return_if_fail (LD_IS_DOCUMENT (self));
+	g_return_if_fail (filename != NULL);
+
+	path = canonicalize (filename);
+	sheet = g_hash_table_lookup (self->priv->sheets, path);
+	g_free (path);
+
+	g_return_if_fail (sheet != NULL && sheet->holds != 0);
+	if (!--sheet->holds)
+		enforce_budget (self, NULL);
+}
+
+/*
+ * get_sheet:
+ *
+ * Find a sheet, load it if necessary and mark it as the most recently
+ * used one.
+ */
+static Sheet *
+get_sheet (LdDocument *self, const gchar *filename, GError **error)
+{
+	Sheet *sheet;
+	gchar *path;
+
+	path = canonicalize (filename);
+	sheet = g_hash_table_lookup (self->priv->sheets, path);
+	if (!sheet)
+	{
+		sheet = g_slice_new0 (Sheet);
+		sheet->filename = path;
+		g_hash_table_insert (self->priv->sheets, sheet->filename, sheet);
+	}
+	else
+		g_free (path);
+
+	if (sheet->diagram)
+	{
+		g_queue_remove (self->priv->loaded, sheet);
+		g_queue_push_head (self->priv->loaded, sheet);
+	}
+	else if (!load_sheet (self, sheet, error))
+		return NULL;
+
+	enforce_budget (self, sheet);
+	return sheet;
+}
+
+/**
+ * ld_document_is_loaded:
+ * @self: an #LdDocument object.
+ * @filename: the path to the sheet.
+ *
+ * Return value: whether the sheet is currently loaded.
+ */
+gboolean
+ld_document_is_loaded (LdDocument *self, const gchar *filename)
+{
+	Sheet *sheet;
+	gchar *path;
+
+	g_return_val_if_fail (LD_IS_DOCUMENT (self), FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	path = canonicalize (filename);
+	sheet = g_hash_table_lookup (self->priv->sheets, path);
+	g_free (path);
+	return sheet && sheet->diagram;
+}
+
+/**
+ * ld_document_resolve_sheet:
+ * @self: an #LdDocument object.
+ * @parent: (allow-none): the sheet containing @symbol, or %NULL
+ *          for the root sheet.
+ * @symbol: a symbol that stands for a sheet.
+ *
+ * Return value: (transfer full): the path to the sheet that @symbol
+ *               stands for, or %NULL if it doesn't stand for any.
+ */
+gchar *
+ld_document_resolve_sheet (LdDocument *self,
+	const gchar *parent, LdDiagramSymbol *symbol)
+{
+	GFile *parent_file, *directory, *file;
+	const gchar *sheet;
+	gchar *path;
+
+	g_return_val_if_fail (LD_IS_DOCUMENT (self), NULL);
+	g_return_val_if_fail (LD_IS_DIAGRAM_SYMBOL (symbol), NULL);
+
+	sheet = ld_diagram_symbol_get_sheet (symbol);
+	if (!sheet)
+		return NULL;
+
+	parent_file = g_file_new_for_path (parent ? parent : self->priv->filename);
+	directory = g_file_get_parent (parent_file);
+	file = g_file_resolve_relative_path (directory, sheet);
+	path = g_file_get_path (file);
+
+	g_object_unref (file);
+	g_object_unref (directory);
+	g_object_unref (parent_file);
+	return path;
+}
+
+/**
+ * ld_document_open_sheet:
+ * @self: an #LdDocument object.
+ * @filename: (allow-none): the path to the sheet, or %NULL
+ *            for the root sheet.
+ * @error: (allow-none): return location for a #GError, or %NULL.
+ *
+ * Make a sheet active, loading it if necessary.  The active sheet
+ * is never unloaded.
+ *
+ * Return value: (transfer none): the sheet, or %NULL on error.
+ */
+LdDiagram *
+ld_document_open_sheet (LdDocument *self,
+	const gchar *filename, GError **error)
+{
+	LdDiagram *diagram;
+	gchar *path;
+
+	g_return_val_if_fail (LD_IS_DOCUMENT (self), NULL);
+
+	diagram = ld_document_get_sheet (self,
+		filename ? filename : self->priv->filename, error);
+	if (!diagram)
+		return NULL;
+
+	path = canonicalize (filename ? filename : self->priv->filename);
+	self->priv->active = g_hash_table_lookup (self->priv->sheets, path);
+	g_free (path);
+
+	/* The previously active sheet may go now. */
+	enforce_budget (self, NULL);
+	g_object_notify (G_OBJECT (self), "active-sheet");
+	return diagram;
+}
+
+/**
+ * ld_document_enter_sheet:
+ * @self: an #LdDocument object.
+ * @symbol: a symbol within the active sheet that stands for a sheet.
+ * @error: (allow-none): return location for a #GError, or %NULL.
+ *
+ * Make the sheet that @symbol stands for active.  Only that sheet
+ * is parsed, if it isn't loaded already.
+ *
+ * Return value: (transfer none): the sheet, or %NULL on error.
+ */
+LdDiagram *
+ld_document_enter_sheet (LdDocument *self,
+	LdDiagramSymbol *symbol, GError **error)
+{
+	LdDiagram *diagram;
+	gchar *path;
+
+	g_return_val_if_fail (LD_IS_DOCUMENT (self), NULL);
+	g_return_val_if_fail (LD_IS_DIAGRAM_SYMBOL (symbol), NULL);
+
+	path = ld_document_resolve_sheet (self,
+		ld_document_get_active_sheet (self), symbol);
+	g_return_val_if_fail (path != NULL, NULL);
+
+	diagram = ld_document_open_sheet (self, path, error);
+	g_free (path);
+	return diagram;
+}
+
+/**
+ * ld_document_get_active_sheet:
+ * @self: an #LdDocument object.
+ *
+ * Return value: the path to the active sheet, or %NULL if there's none.
+ */
+const gchar *
+ld_document_get_active_sheet (LdDocument *self)
+{
+	g_return_val_if_fail (LD_IS_DOCUMENT (self), NULL);
+	return self->priv->active ? self->priv->active->filename : NULL;
+}
+
+/**
+ * ld_document_find_label:
+ * @self: an #LdDocument object.
+ * @label: a net label.
+ *
+ * Find sheets that contain symbols with the label.  Sheets that have
+ * never been loaded are not searched.
+ *
+ * Return value: (element-type utf8) (transfer container): paths to
+ *               the sheets, owned by the document.
+ */
+GList *
+ld_document_find_label (LdDocument *self, const gchar *label)
+{
+	GHashTable *set;
+	GList *iter, *sheets;
+
+	g_return_val_if_fail (LD_IS_DOCUMENT (self), NULL);
+	g_return_val_if_fail (label != NULL, NULL);
+
+	/* Loaded sheets could have been edited since. */
+	for (iter = self->priv->loaded->head; iter; iter = g_list_next (iter))
+		if (((Sheet *) iter->data)->stale)
+			index_sheet (self, iter->data);
+
+	set = g_hash_table_lookup (self->priv->labels, label);
+	if (!set)
+		return NULL;
+
+	sheets = g_hash_table_get_keys (set);
+	for (iter = sheets; iter; iter = g_list_next (iter))
+		iter->data = ((Sheet *) iter->data)->filename;
+	return sheets;
+}
+
+/**
+ * ld_document_save:
+ * @self: an #LdDocument object.
+ * @error: (allow-none): return location for a #GError, or %NULL.
+ *
+ * Save all sheets that have been modified.
+ *
+ * Return value: %TRUE if all of them could be saved, %FALSE otherwise.
+ */
+gboolean
+ld_document_save (LdDocument *self, GError **error)
+{
+	GList *iter;
+
+	g_return_val_if_fail (LD_IS_DOCUMENT (self), FALSE);
+
+	for (iter = self->priv->loaded->head; iter; iter = g_list_next (iter))
+	{
+		Sheet *sheet;
+
+		sheet = iter->data;
+		if (!ld_diagram_get_modified (sheet->diagram))
+			continue;
+		if (!ld_diagram_save_to_file (sheet->diagram, sheet->filename, error))
+			return FALSE;
+		ld_diagram_set_modified (sheet->diagram, FALSE);
+	}
+
+	/* Sheets that had to stay loaded because of changes may go now. */
+	enforce_budget (self, NULL);
+	return TRUE;
+}
@@ -0,0 +1,83 @@
+/*
+ * ld-document.h
+ *
+ * This file is a part of logdiag.
+ * Copyright 2026 Přemysl Eric Janouch
+ *
+ * See the file LICENSE for licensing information.
+ *
+ */
+
+#ifndef __LD_DOCUMENT_H__
+#define __LD_DOCUMENT_H__
+
+G_BEGIN_DECLS
+
+
+#define LD_TYPE_DOCUMENT (ld_document_get_type ())
+#define LD_DOCUMENT(obj) \
+	(G_TYPE_CHECK_INSTANCE_CAST ((obj), LD_TYPE_DOCUMENT, LdDocument))
+#define LD_DOCUMENT_CLASS(klass) \
+	(G_TYPE_CHECK_CLASS_CAST ((klass), LD_TYPE_DOCUMENT, LdDocumentClass))
+#define LD_IS_DOCUMENT(obj) \
+	(G_TYPE_CHECK_INSTANCE_TYPE ((obj), LD_TYPE_DOCUMENT))
+#define LD_IS_DOCUMENT_CLASS(klass) \
+	(G_TYPE_CHECK_INSTANCE_TYPE ((klass), LD_TYPE_DOCUMENT))
+#define LD_DOCUMENT_GET_CLASS(obj) \
+	(G_TYPE_INSTANCE_GET_CLASS ((obj), LD_DOCUMENT, LdDocumentClass))
+
+typedef struct _LdDocument LdDocument;
+typedef struct _LdDocumentPrivate LdDocumentPrivate;
+typedef struct _LdDocumentClass LdDocumentClass;
+
+
+/**
+ * LdDocument:
+ */
+struct _LdDocument
+{
+/*< private >*/
+	GObject parent_instance;
+	LdDocumentPrivate *priv;
+};
+
+struct _LdDocumentClass
+{
+/*< private >*/
+	GObjectClass parent_class;
+
+	guint sheet_loaded_signal;
+	guint sheet_unloaded_signal;
+};
+
+
+GType ld_document_get_type (void) G_GNUC_CONST;
+
+LdDocument *ld_document_new (const gchar *filename);
+const gchar *ld_document_get_filename (LdDocument *self);
+
+guint64 ld_document_get_budget (LdDocument *self);
+void ld_document_set_budget (LdDocument *self, guint64 budget);
+
+LdDiagram *ld_document_get_sheet (LdDocument *self,
+	const gchar *filename, GError **error);
+LdDiagram *ld_document_hold_sheet (LdDocument *self,
+	const gchar *filename, GError **error);
+void ld_document_release_sheet (LdDocument *self, const gchar *filename);
+gboolean ld_document_is_loaded (LdDocument *self, const gchar *filename);
+gchar *ld_document_resolve_sheet (LdDocument *self,
+	const gchar *parent, LdDiagramSymbol *symbol);
+
+LdDiagram *ld_document_open_sheet (LdDocument *self,
+	const gchar *filename, GError **error);
+LdDiagram *ld_document_enter_sheet (LdDocument *self,
+	LdDiagramSymbol *symbol, GError **error);
+const gchar *ld_document_get_active_sheet (LdDocument *self);
+
+GList *ld_document_find_label (LdDocument *self, const gchar *label);
+gboolean ld_document_save (LdDocument *self, GError **error);
+
+
+G_END_DECLS
+
+#endif /* ! __LD_DOCUMENT_H__ */
@@ -0,0 +1,248 @@
+/*
+ * ld-journal.c
+ *
+ * This file is a part of logdiag.
+ * Copyright 2026 Přemysl Eric Janouch
+ *
+ * See the file LICENSE for licensing information.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glib/gstdio.h>
+
+#ifdef G_OS_WIN32
+#include <io.h>
+#define fsync _commit
+#define ftruncate _chsize
+#else
+#include <unistd.h>
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+#include "liblogdiag.h"
+#include "config.h"
+
+
+/**
+ * SECTION:ld-journal
+ * @short_description: An append-only file
+ * @see_also: #LdDiagram
+ *
+ * #LdJournal writes records to the end of a file as they come and
+ * flushes them to the disk in a separate thread, so that doing so
+ * never stalls the caller.  Writes that happen while the disk is busy
+ * are flushed together.
+ */
+
+/*
+ * LdJournal:
+ * @filename: the path to the file.
+ * @fd: a descriptor of the file open for appending.
+ * @thread: the thread that flushes the file.
+ * @mutex: protects @dirty and @quit.
+ * @cond: signalled when either of them changes.
+ * @dirty: whether there is data to be flushed.
+ * @quit: whether the thread is to finish.
+ */
+struct _LdJournal
+{
+	gchar *filename;
+	gint fd;
+
+	GThread *thread;
+	GMutex mutex;
+	GCond cond;
+	gboolean dirty;
+	gboolean quit;
+};
+
+static gpointer sync_thread (gpointer data);
+static void set_error (GError **error, const gchar *filename, gint errsv);
+static void mark_dirty (LdJournal *self);
+
+
+static gpointer
+sync_thread (gpointer data)
+{
+	LdJournal *self;
+
+	self = data;
+	g_mutex_lock (&self->mutex);
+	while (TRUE)
+	{
+		while (!self->dirty && !self->quit)
+			g_cond_wait (&self->cond, &self->mutex);
+		if (!self->dirty)
+			break;
+
+		self->dirty = FALSE;
+		g_mutex_unlock (&self->mutex);
+
+		if (fsync (self->fd))
+			g_warning ("failed to synchronize `%s': %s",
+				self->filename, g_strerror (errno));
+
+		g_mutex_lock (&self->mutex);
+	}
+	g_mutex_unlock (&self->mutex);
+	return NULL;
+}
+
+static void
+set_error (GError **error, const gchar *filename, gint errsv)
+{
+	gchar *display_name;
+
+	display_name = g_filename_display_name (filename);
+	g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv),
+		"%s: %s", display_name, g_strerror (errsv));
+	g_free (display_name);
+}
+
+static void
+mark_dirty (LdJournal *self)
+{
+	g_mutex_lock (&self->mutex);
+	self->dirty = TRUE;
+	g_cond_signal (&self->cond);
+	g_mutex_unlock (&self->mutex);
+}
+
+/**
+ * ld_journal_new:
+ * @filename: the file to append to, it is created if it doesn't exist.
+ * @error: (allow-none): return location for a #GError, or %NULL.
+ *
+ * Open a journal.
+ *
+ * Return value: a new #LdJournal, or %NULL on error.
+ */
+LdJournal *
+ld_journal_new (const gchar *filename, GError **error)
+{
+	LdJournal *self;
+	gint fd;
+
+	g_return_val_if_fail (filename != NULL, NULL);
+
+	fd = g_open (filename, O_WRONLY | O_CREAT | O_APPEND | O_BINARY, 0666);
+	if (fd == -1)
+	{
+		set_error (error, filename, errno);
+		return NULL;
+	}
+
+	self = g_slice_new0 (LdJournal);
+	self->filename = g_strdup (filename);
+	self->fd = fd;
+
+	g_mutex_init (&self->mutex);
+	g_cond_init (&self->cond);
+	self->thread = g_thread_new ("journal", sync_thread, self);
+	return self;
+}
+
+/**
+ * ld_journal_free:
+ * @self: an #LdJournal.
+ *
+ * Flush and close the journal.  The file is kept.
+ */
+void
+ld_journal_free (LdJournal *self)
+{
+	g_return_if_fail (self != NULL);
+
+	g_mutex_lock (&self->mutex);
+	self->quit = TRUE;
+	g_cond_signal (&self->cond);
+	g_mutex_unlock (&self->mutex);
+	g_thread_join (self->thread);
+
+	g_mutex_clear (&self->mutex);
+	g_cond_clear (&self->cond);
+	g_close (self->fd, NULL);
+	g_free (self->filename);
+	g_slice_free (LdJournal, self);
+}
+
+/**
+ * ld_journal_get_filename:
+ * @self: an #LdJournal.
+ *
+ * Return value: the path to the file of the journal.
+ */
+const gchar *
+ld_journal_get_filename (LdJournal *self)
+{
+	g_return_val_if_fail (self != NULL, NULL);
+	return self->filename;
+}
+
+/**
+ * ld_journal_append:
+ * @self: an #LdJournal.
+ * @data: (array length=length): data to be written.
+ * @length: the length of @data.
+ * @error: (allow-none): return location for a #GError, or %NULL.
+ *
+ * Write data to the end of the journal.  They are handed over to
+ * the operating system immediately and flushed to the disk later.
+ *
+ * Return value: %TRUE if no error has occured, %FALSE otherwise.
+ */
+gboolean
+ld_journal_append (LdJournal *self,
+	const gchar *data, gsize length, GError **error)
+{
+	gssize written;
+
+	g_return_val_if_fail (self != NULL, FALSE);
+	g_return_val_if_fail (data != NULL || length == 0, FALSE);
+
+	while (length)
+	{
+		written = write (self->fd, data, length);
+		if (written == -1 && errno == EINTR)
+			continue;
+		if (written == -1)
+		{
+			set_error (error, self->filename, errno);
+			return FALSE;
+		}
+		data += written;
+		length -= written;
+	}
+
+	mark_dirty (self);
+	return TRUE;
+}
+
+/**
+ * ld_journal_truncate:
+ * @self: an #LdJournal.
+ * @error: (allow-none): return location for a #GError, or %NULL.
+ *
+ * Throw away the contents of the journal.
+ *
+ * Return value: %TRUE if no error has occured, %FALSE otherwise.
+ */
+gboolean
+ld_journal_truncate (LdJournal *self, GError **error)
+{
+	g_return_val_if_fail (self != NULL, FALSE);
+
+	if (ftruncate (self->fd, 0))
+	{
+		set_error (error, self->filename, errno);
+		return FALSE;
+	}
+
+	mark_dirty (self);
+	return TRUE;
+}
@@ -0,0 +1,36 @@
+/*
+ * ld-journal.h
+ *
+ * This file is a part of logdiag.
+ * Copyright 2026 Přemysl Eric Janouch
+ *
+ * See the file LICENSE for licensing information.
+ *
+ */
+
+#ifndef __LD_JOURNAL_H__
+#define __LD_JOURNAL_H__
+
+G_BEGIN_DECLS
+
+
+/**
+ * LdJournal:
+ *
+ * An opaque append-only file that is synchronized in the background.
+ */
+typedef struct _LdJournal LdJournal;
+
+
+LdJournal *ld_journal_new (const gchar *filename, GError **error);
+void ld_journal_free (LdJournal *self);
+
+const gchar *ld_journal_get_filename (LdJournal *self);
+gboolean ld_journal_append (LdJournal *self,
+	const gchar *data, gsize length, GError **error);
+gboolean ld_journal_truncate (LdJournal *self, GError **error);
+
+
+G_END_DECLS
+
+#endif /* ! __LD_JOURNAL_H__ */
@@ -22,29 +22,139 @@
  * #LdLibrary is used for loading symbols from their files.  The library object
  * itself is a container for categories, which in turn contain other
  * subcategories and the actual symbols.
+ *
+ * In the lazy mode, only the category tree is built when loading a directory
+ * and symbol files are loaded the first time that symbols of their category
+ * are asked for.
+ *
+ * When watching is enabled, directories of the library are monitored for
+ * changes and only the affected symbol files get reloaded.  Symbols are then
+ * replaced in their categories and #LdLibrary::symbol-changed is emitted
+ * for each of them.
+ *
+ * Symbols can be searched for by their names and names of their categories
+ * with ld_library_search().  The search index is only updated for categories
+ * whose symbols have changed since the last search.
  */
 
 /*
  * LdLibraryPrivate:
  * @lua: state of the scripting language.
  * @children: categories in the library.
+ * @cache_filename: where compiled symbols are cached between sessions.
+ * @cache_loaded: whether the cache has already been read.
+ * @lazy: whether loading of symbols should be deferred.
+ * @watch: whether loaded directories should be monitored for changes.
+ * @monitors: (element-type MonitorData *): active directory monitors.
+ * @files: symbols that have been loaded from each file.
+ * @symbols: lookup cache mapping paths of categories to tables that map
+ *           names to symbols, so that a category can be dropped at once.
+ * @index: search index of symbols.
+ * @indexed: (element-type LdCategory * IndexedCategory *): categories
+ *           that have been inserted into @index.
  */
 struct _LdLibraryPrivate
 {
 	LdLua *lua;
 	LdCategory *root;
+	gchar *cache_filename;
+	gboolean cache_loaded;
+	gboolean lazy;
+	gboolean watch;
+	GSList *monitors;
+	GHashTable *files;
+	GHashTable *symbols;
+	LdSymbolIndex *index;
+	GHashTable *indexed;
 };
 
+/*
+ * MonitorData:
+ * @self: the library that owns the monitor.
+ * @cat: the category that corresponds to the monitored directory.
+ * @path: the monitored directory.
+ * @monitor: the monitor itself.
+ */
+typedef struct
+{
+	LdLibrary *self;
+	LdCategory *cat;
+	gchar *path;
+	GFileMonitor *monitor;
+}
+MonitorData;
+
+/*
+ * IndexedCategory:
+ * @self: the library that owns the search index.
+ * @cat: the category.
+ * @path: the path the category has been indexed under.
+ * @identifiers: (element-type gchar *): symbols inserted into the index.
+ * @dirty: whether symbols of the category have changed since.
+ * @seen: whether the category has been found during the current update.
+ */
+typedef struct
+{
+	LdLibrary *self;
+	LdCategory *cat;
+	gchar *path;
+	GSList *identifiers;
+	gboolean dirty;
+	gboolean seen;
+}
+IndexedCategory;
+
+enum
+{
+	PROP_0,
+	PROP_LAZY,
+	PROP_WATCH
+};
+
+static void ld_library_get_property (GObject *object, guint property_id,
+	GValue *value, GParamSpec *pspec);
+static void ld_library_set_property (GObject *object, guint property_id,
+	const GValue *value, GParamSpec *pspec);
 static void ld_library_finalize (GObject *gobject);
 
 static LdCategory *load_category (LdLibrary *self,
 	const gchar *path, const gchar *name);
 static gboolean load_category_cb (const gchar *base,
 	const gchar *path, gpointer userdata);
-static void load_category_symbol_cb (LdSymbol *symbol, gpointer user_data);
+static void load_deferred_cb (LdCategory *category, gpointer user_data);
+
+static void load_file (LdLibrary *self, LdCategory *cat,
+	const gchar *filename);
+static void load_file_cb (LdSymbol *symbol, gpointer user_data);
+static LdSymbol *take_symbol (GSList **symbols, const gchar *name);
+static void reload_file (LdLibrary *self, LdCategory *cat,
+	const gchar *filename);
+static void symbol_changed (LdLibrary *self, LdCategory *cat,
+	const gchar *name);
+static void free_symbol_list (GSList *symbols);
+static void on_category_symbols_changed (LdCategory *cat, LdLibrary *self);
+
+static void watch_directory (LdLibrary *self,
+	LdCategory *cat, const gchar *path);
+static void monitor_data_free (MonitorData *data);
+static void on_monitor_changed (GFileMonitor *monitor, GFile *file,
+	GFile *other_file, GFileMonitorEvent event_type, MonitorData *data);
+static void remove_directory (LdLibrary *self,
+	LdCategory *parent, const gchar *path);
+
+static void update_index (LdLibrary *self, LdCategory *cat,
+	const gchar *path, const gchar *human_path);
+static void index_category (LdLibrary *self, IndexedCategory *data,
+	const gchar *human_path);
+static void indexed_category_free (IndexedCategory *data);
+static void on_indexed_symbols_changed (LdCategory *cat,
+	IndexedCategory *data);
 
 static gchar *read_human_name_from_file (const gchar *filename);
 
+static void load_cache (LdLibrary *self);
+static void save_cache (LdLibrary *self);
+
 static gboolean foreach_dir (const gchar *path,
 	gboolean (*callback) (const gchar *, const gchar *, gpointer),
 	gpointer userdata, GError **error);
@@ -58,10 +168,33 @@ static void
 ld_library_class_init (LdLibraryClass *klass)
 {
 	GObjectClass *object_class;
+	GParamSpec *pspec;
 
 	object_class = G_OBJECT_CLASS (klass);
+	object_class->get_property = ld_library_get_property;
+	object_class->set_property = ld_library_set_property;
 	object_class->finalize = ld_library_finalize;
 
+/**
+ * LdLibrary:lazy:
+ *
+ * Whether symbols are only loaded once they're needed.
+ */
+	pspec = g_param_spec_boolean ("lazy", "Lazy",
+		"Whether symbols are only loaded once they're needed.",
+		FALSE, G_PARAM_READWRITE);
+	g_object_class_install_property (object_class, PROP_LAZY, pspec);
+
+/**
+ * LdLibrary:watch:
+ *
+ * Whether loaded directories are monitored for changes.
+ */
+	pspec = g_param_spec_boolean ("watch", "Watch",
+		"Whether loaded directories are monitored for changes.",
+		FALSE, G_PARAM_READWRITE);
+	g_object_class_install_property (object_class, PROP_WATCH, pspec);
+
 /**
  * LdLibrary::changed:
  * @self: an #LdLibrary object.
@@ -73,6 +206,19 @@ ld_library_class_init (LdLibraryClass *klass)
 		G_SIGNAL_RUN_LAST, 0, NULL, NULL,
 		g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
 
+/**
+ * LdLibrary::symbol-changed:
+ * @self: an #LdLibrary object.
+ * @identifier: identifier of the symbol.
+ *
+ * A symbol has been reloaded, added or removed.  The library has to be
+ * searched again for the current symbol object.
+ */
+	klass->symbol_changed_signal = g_signal_new
+		("symbol-changed", G_TYPE_FROM_CLASS (klass),
+		G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+		g_cclosure_marshal_VOID__STRING, G_TYPE_NONE, 1, G_TYPE_STRING);
+
 	g_type_class_add_private (klass, sizeof (LdLibraryPrivate));
 }
 
@@ -84,6 +230,59 @@ ld_library_init (LdLibrary *self)
 
 	self->priv->lua = ld_lua_new ();
 	self->priv->root = ld_category_new (LD_LIBRARY_IDENTIFIER_SEPARATOR, "/");
+	g_signal_connect_object (self->priv->root, "symbols-changed",
+		G_CALLBACK (on_category_symbols_changed), self, 0);
+	self->priv->cache_filename = g_build_filename (g_get_user_cache_dir (),
+		PROJECT_NAME, "library-cache.json", NULL);
+
+	self->priv->files = g_hash_table_new_full (g_str_hash, g_str_equal,
+		g_free, (GDestroyNotify) free_symbol_list);
+	self->priv->symbols = g_hash_table_new_full (g_str_hash, g_str_equal,
+		g_free, (GDestroyNotify) g_hash_table_destroy);
+
+	self->priv->index = ld_symbol_index_new ();
+	self->priv->indexed = g_hash_table_new_full (g_direct_hash,
+		g_direct_equal, NULL, (GDestroyNotify) indexed_category_free);
+}
+
+static void
+ld_library_get_property (GObject *object, guint property_id,
+	GValue *value, GParamSpec *pspec)
+{
+	LdLibrary *self;
+
+	self = LD_LIBRARY (object);
+	switch (property_id)
+	{
+	case PROP_LAZY:
+		g_value_set_boolean (value, ld_library_get_lazy (self));
+		break;
+	case PROP_WATCH:
+		g_value_set_boolean (value, ld_library_get_watch (self));
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+	}
+}
+
+static void
+ld_library_set_property (GObject *object, guint property_id,
+	const GValue *value, GParamSpec *pspec)
+{
+	LdLibrary *self;
+
+	self = LD_LIBRARY (object);
+	switch (property_id)
+	{
+	case PROP_LAZY:
+		ld_library_set_lazy (self, g_value_get_boolean (value));
+		break;
+	case PROP_WATCH:
+		ld_library_set_watch (self, g_value_get_boolean (value));
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+	}
 }
 
 static void
@@ -93,8 +292,20 @@ ld_library_finalize (GObject *gobject)
 
 	self = LD_LIBRARY (gobject);
 
+	/* Symbols that have been loaded lazily may have updated the cache. */
+	if (self->priv->cache_loaded)
+		save_cache (self);
+
+	g_slist_foreach (self->priv->monitors, (GFunc) monitor_data_free, NULL);
+	g_slist_free (self->priv->monitors);
+	g_hash_table_destroy (self->priv->files);
+	g_hash_table_destroy (self->priv->symbols);
+	g_hash_table_destroy (self->priv->indexed);
+	ld_symbol_index_free (self->priv->index);
+
 	g_object_unref (self->priv->lua);
 	g_object_unref (self->priv->root);
+	g_free (self->priv->cache_filename);
 
 	/* Chain up to the parent class. */
 	G_OBJECT_CLASS (ld_library_parent_class)->finalize (gobject);
@@ -153,11 +364,28 @@ typedef struct
 {
 	LdLibrary *self;
 	LdCategory *cat;
+	GSList *deferred;
 	guint changed : 1;
 	guint load_symbols : 1;
 }
 LoadCategoryData;
 
+/*
+ * DeferredData:
+ * @self: a weak pointer to the library.
+ * @filenames: symbol files to be loaded into the category.
+ *
+ * Data for load_deferred_cb().
+ */
+typedef struct
+{
+	LdLibrary *self;
+	GSList *filenames;
+}
+DeferredData;
+
+static void deferred_data_free (DeferredData *data);
+
 /*
  * load_category:
  * @self: an #LdLibrary object.
@@ -171,6 +399,7 @@ load_category (LdLibrary *self, const gchar *path, const gchar *name)
 {
 	gchar *category_file, *human_name;
 	LoadCategoryData data;
+	gint64 trace;
 
 	g_return_val_if_fail (LD_IS_LIBRARY (self), NULL);
 	g_return_val_if_fail (path != NULL, NULL);
@@ -179,6 +408,8 @@ load_category (LdLibrary *self, const gchar *path, const gchar *name)
 	if (!g_file_test (path, G_FILE_TEST_IS_DIR))
 		return NULL;
 
+	trace = ld_trace_begin ();
+
 	category_file = g_build_filename (path, "category.json", NULL);
 	human_name = read_human_name_from_file (category_file);
 	if (!human_name)
@@ -186,12 +417,33 @@ load_category (LdLibrary *self, const gchar *path, const gchar *name)
 
 	data.self = self;
 	data.cat = ld_category_new (name, human_name);
+	g_signal_connect_object (data.cat, "symbols-changed",
+		G_CALLBACK (on_category_symbols_changed), self, 0);
+	data.deferred = NULL;
 	data.load_symbols = TRUE;
 	data.changed = FALSE;
 	foreach_dir (path, load_category_cb, &data, NULL);
 
+	if (self->priv->watch)
+		watch_directory (self, data.cat, path);
+
+	if (data.deferred)
+	{
+		DeferredData *deferred;
+
+		deferred = g_slice_new (DeferredData);
+		deferred->self = self;
+		deferred->filenames = g_slist_reverse (data.deferred);
+		g_object_add_weak_pointer (G_OBJECT (self),
+			(gpointer *) &deferred->self);
+
+		ld_category_set_loader (data.cat, load_deferred_cb,
+			deferred, (GDestroyNotify) deferred_data_free);
+	}
+
 	g_free (human_name);
 	g_free (category_file);
+	ld_trace_end (trace, "library", "load_category", path);
 	return data.cat;
 }
 
@@ -225,8 +477,10 @@ load_category_cb (const gchar *base, const gchar *path, gpointer userdata)
 	else if (data->load_symbols
 		&& ld_lua_check_file (data->self->priv->lua, path))
 	{
-		ld_lua_load_file (data->self->priv->lua, path,
-			load_category_symbol_cb, data->cat);
+		if (data->self->priv->lazy)
+			data->deferred = g_slist_prepend (data->deferred, g_strdup (path));
+		else
+			load_file (data->self, data->cat, path);
 	}
 
 	data->changed = TRUE;
@@ -234,20 +488,414 @@ load_category_cb (const gchar *base, const gchar *path, gpointer userdata)
 }
 
 /*
- * load_category_symbol_cb:
+ * load_deferred_cb:
  *
- * Insert newly registered symbols into the category.
+ * Load symbol files of a category in the lazy mode.
  */
 static void
-load_category_symbol_cb (LdSymbol *symbol, gpointer user_data)
+load_deferred_cb (LdCategory *category, gpointer user_data)
 {
-	LdCategory *cat;
+	DeferredData *data;
+	GSList *iter;
+
+	data = user_data;
+	if (!data->self)
+		return;
+
+	for (iter = data->filenames; iter; iter = g_slist_next (iter))
+		load_file (data->self, category, iter->data);
+}
+
+static void
+deferred_data_free (DeferredData *data)
+{
+	if (data->self)
+		g_object_remove_weak_pointer (G_OBJECT (data->self),
+			(gpointer *) &data->self);
+
+	g_slist_foreach (data->filenames, (GFunc) g_free, NULL);
+	g_slist_free (data->filenames);
+	g_slice_free (DeferredData, data);
+}
+
+/*
+ * load_file:
+ * @self: an #LdLibrary object.
+ * @cat: the category to insert symbols into.
+ * @filename: the symbol file.
+ *
+ * Load symbols from a file and remember where they have come from.
+ */
+static void
+load_file (LdLibrary *self, LdCategory *cat, const gchar *filename)
+{
+	GSList *symbols = NULL, *inserted = NULL, *iter;
+	gint64 trace;
+
+	/* The file may have disappeared since the directory has been read. */
+	if (!g_file_test (filename, G_FILE_TEST_IS_REGULAR))
+		return;
+
+	trace = ld_trace_begin ();
+	ld_lua_load_file (self->priv->lua, filename, load_file_cb, &symbols);
+	for (iter = g_slist_reverse (symbols); iter; iter = g_slist_next (iter))
+	{
+		if (ld_category_insert_symbol (cat, iter->data, -1))
+			inserted = g_slist_prepend (inserted, iter->data);
+		else
+			g_object_unref (iter->data);
+	}
+	g_slist_free (symbols);
+
+	if (inserted)
+		g_hash_table_replace (self->priv->files,
+			g_strdup (filename), g_slist_reverse (inserted));
+	ld_trace_end (trace, "library", "load_file", filename);
+}
+
+/*
+ * load_file_cb:
+ *
+ * Collect newly registered symbols.
+ */
+static void
+load_file_cb (LdSymbol *symbol, gpointer user_data)
+{
+	GSList **symbols;
 
 	g_return_if_fail (LD_IS_SYMBOL (symbol));
-	g_return_if_fail (LD_IS_CATEGORY (user_data));
 
-	cat = LD_CATEGORY (user_data);
-	ld_category_insert_symbol (cat, symbol, -1);
+	symbols = user_data;
+	*symbols = g_slist_prepend (*symbols, g_object_ref (symbol));
+}
+
+/*
+ * take_symbol:
+ *
+ * Remove a symbol of the given name from a list and return it.
+ */
+static LdSymbol *
+take_symbol (GSList **symbols, const gchar *name)
+{
+	GSList *iter;
+	LdSymbol *symbol;
+
+	for (iter = *symbols; iter; iter = g_slist_next (iter))
+	{
+		symbol = LD_SYMBOL (iter->data);
+		if (!strcmp (name, ld_symbol_get_name (symbol)))
+		{
+			*symbols = g_slist_delete_link (*symbols, iter);
+			return symbol;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * reload_file:
+ * @self: an #LdLibrary object.
+ * @cat: the category the file belongs to.
+ * @filename: the symbol file.
+ *
+ * Run a symbol file again and update the category with its current contents.
+ * Symbols keep their position, symbols that are gone are removed and new ones
+ * are appended to the end.
+ */
+static void
+reload_file (LdLibrary *self, LdCategory *cat, const gchar *filename)
+{
+	GSList *old = NULL, *new = NULL, *kept = NULL, *iter;
+	gpointer key, value;
+
+	/* Nothing has seen symbols of a category that hasn't been loaded yet,
+	 * so it's enough to load it now, unless the file has just been added. */
+	if (!ld_category_is_loaded (cat))
+	{
+		ld_category_get_symbols (cat);
+		if (g_hash_table_contains (self->priv->files, filename))
+			return;
+	}
+
+	if (g_hash_table_lookup_extended (self->priv->files,
+		filename, &key, &value))
+	{
+		g_hash_table_steal (self->priv->files, filename);
+		g_free (key);
+		old = value;
+	}
+
+	if (g_file_test (filename, G_FILE_TEST_IS_REGULAR)
+		&& ld_lua_check_file (self->priv->lua, filename))
+	{
+		ld_lua_load_file (self->priv->lua, filename, load_file_cb, &new);
+		new = g_slist_reverse (new);
+	}
+
+	for (iter = old; iter; iter = g_slist_next (iter))
+	{
+		LdSymbol *old_symbol, *new_symbol;
+		const gchar *name;
+
+		old_symbol = LD_SYMBOL (iter->data);
+		name = ld_symbol_get_name (old_symbol);
+
+		new_symbol = take_symbol (&new, name);
+		if (new_symbol && ld_category_replace_symbol (cat,
+			old_symbol, new_symbol))
+			kept = g_slist_prepend (kept, new_symbol);
+		else
+		{
+			ld_category_remove_symbol (cat, old_symbol);
+			if (new_symbol)
+				g_object_unref (new_symbol);
+		}
+
+		symbol_changed (self, cat, name);
+		g_object_unref (old_symbol);
+	}
+	g_slist_free (old);
+
+	for (iter = new; iter; iter = g_slist_next (iter))
+	{
+		if (ld_category_insert_symbol (cat, iter->data, -1))
+		{
+			kept = g_slist_prepend (kept, iter->data);
+			symbol_changed (self, cat, ld_symbol_get_name (iter->data));
+		}
+		else
+			g_object_unref (iter->data);
+	}
+	g_slist_free (new);
+
+	if (kept)
+		g_hash_table_replace (self->priv->files,
+			g_strdup (filename), g_slist_reverse (kept));
+
+	save_cache (self);
+}
+
+/*
+ * symbol_changed:
+ *
+ * Drop a symbol from the lookup cache and announce the change.
+ */
+static void
+symbol_changed (LdLibrary *self, LdCategory *cat, const gchar *name)
+{
+	GHashTable *symbols;
+	gchar *path, *identifier;
+
+	path = ld_category_get_path (cat);
+	if (path)
+		identifier = g_build_path
+			(LD_LIBRARY_IDENTIFIER_SEPARATOR, path, name, NULL);
+	else
+		identifier = g_strdup (name);
+
+	symbols = g_hash_table_lookup (self->priv->symbols, path ? path : "");
+	if (symbols)
+		g_hash_table_remove (symbols, name);
+	g_signal_emit (self, LD_LIBRARY_GET_CLASS (self)->symbol_changed_signal,
+		0, identifier);
+
+	g_free (identifier);
+	g_free (path);
+}
+
+/*
+ * on_category_symbols_changed:
+ *
+ * Drop symbols of a category from the lookup cache, whoever has changed it.
+ */
+static void
+on_category_symbols_changed (LdCategory *cat, LdLibrary *self)
+{
+	gchar *path;
+
+	path = ld_category_get_path (cat);
+	g_hash_table_remove (self->priv->symbols, path ? path : "");
+	g_free (path);
+}
+
+static void
+free_symbol_list (GSList *symbols)
+{
+	g_slist_foreach (symbols, (GFunc) g_object_unref, NULL);
+	g_slist_free (symbols);
+}
+
+/*
+ * watch_directory:
+ * @self: an #LdLibrary object.
+ * @cat: the category that corresponds to the directory.
+ * @path: the directory to be monitored.
+ *
+ * Start monitoring a directory for changes.
+ */
+static void
+watch_directory (LdLibrary *self, LdCategory *cat, const gchar *path)
+{
+	MonitorData *data;
+	GFileMonitor *monitor;
+	GFile *file;
+	GError *error = NULL;
+
+	file = g_file_new_for_path (path);
+	monitor = g_file_monitor_directory (file,
+		G_FILE_MONITOR_NONE, NULL, &error);
+	g_object_unref (file);
+
+	if (!monitor)
+	{
+		g_warning ("cannot monitor `%s': %s", path, error->message);
+		g_error_free (error);
+		return;
+	}
+
+	data = g_slice_new (MonitorData);
+	data->self = self;
+	data->cat = g_object_ref (cat);
+	data->path = g_strdup (path);
+	data->monitor = monitor;
+
+	g_signal_connect (monitor, "changed",
+		G_CALLBACK (on_monitor_changed), data);
+	self->priv->monitors = g_slist_prepend (self->priv->monitors, data);
+}
+
+static void
+monitor_data_free (MonitorData *data)
+{
+	g_signal_handlers_disconnect_by_func (data->monitor,
+		on_monitor_changed, data);
+	g_file_monitor_cancel (data->monitor);
+	g_object_unref (data->monitor);
+
+	g_object_unref (data->cat);
+	g_free (data->path);
+	g_slice_free (MonitorData, data);
+}
+
+/*
+ * on_monitor_changed:
+ *
+ * React to a change within a monitored directory.
+ */
+static void
+on_monitor_changed (GFileMonitor *monitor, GFile *file, GFile *other_file,
+	GFileMonitorEvent event_type, MonitorData *data)
+{
+	LdLibrary *self;
+	gchar *path, *base;
+	gboolean is_root;
+
+	self = data->self;
+	is_root = data->cat == self->priv->root;
+
+	path = g_file_get_path (file);
+	if (!path)
+		return;
+	base = g_path_get_basename (path);
+
+	switch (event_type)
+	{
+	case G_FILE_MONITOR_EVENT_CREATED:
+		if (g_file_test (path, G_FILE_TEST_IS_DIR))
+		{
+			LdCategory *cat;
+
+			cat = load_category (self, path, base);
+			if (cat)
+			{
+				ld_category_add_child (data->cat, cat);
+				g_object_unref (cat);
+				g_signal_emit (self,
+					LD_LIBRARY_GET_CLASS (self)->changed_signal, 0);
+			}
+		}
+		break;
+	case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+		if (is_root)
+			break;
+		if (!strcmp (base, "category.json"))
+		{
+			gchar *human_name;
+
+			human_name = read_human_name_from_file (path);
+			if (human_name)
+				ld_category_set_human_name (data->cat, human_name);
+			g_free (human_name);
+		}
+		else if (ld_lua_check_file (self->priv->lua, path))
+			reload_file (self, data->cat, path);
+		break;
+	case G_FILE_MONITOR_EVENT_DELETED:
+		if (!is_root && g_hash_table_contains (self->priv->files, path))
+			reload_file (self, data->cat, path);
+		else
+			remove_directory (self, data->cat, path);
+		break;
+	default:
+		break;
+	}
+
+	g_free (base);
+	g_free (path);
+}
+
+/*
+ * remove_directory:
+ * @self: an #LdLibrary object.
+ * @parent: the category that contained the directory.
+ * @path: the directory that has been removed.
+ *
+ * Remove the category for a directory that no longer exists.
+ */
+static void
+remove_directory (LdLibrary *self, LdCategory *parent, const gchar *path)
+{
+	const GSList *iter;
+	GSList *monitor_iter, *next;
+	GHashTableIter file_iter;
+	gpointer key;
+	gchar *base, *prefix;
+
+	base = g_path_get_basename (path);
+	for (iter = ld_category_get_children (parent); iter;
+		iter = g_slist_next (iter))
+		if (!strcmp (base, ld_category_get_name (iter->data)))
+			break;
+	g_free (base);
+	if (!iter)
+		return;
+
+	/* Forget everything that has been loaded from within the directory. */
+	prefix = g_strconcat (path, G_DIR_SEPARATOR_S, NULL);
+	for (monitor_iter = self->priv->monitors; monitor_iter;
+		monitor_iter = next)
+	{
+		MonitorData *data;
+
+		next = g_slist_next (monitor_iter);
+		data = monitor_iter->data;
+		if (strcmp (data->path, path) && !g_str_has_prefix (data->path, prefix))
+			continue;
+
+		self->priv->monitors
+			= g_slist_delete_link (self->priv->monitors, monitor_iter);
+		monitor_data_free (data);
+	}
+
+	g_hash_table_iter_init (&file_iter, self->priv->files);
+	while (g_hash_table_iter_next (&file_iter, &key, NULL))
+		if (g_str_has_prefix (key, prefix))
+			g_hash_table_iter_remove (&file_iter);
+	g_free (prefix);
+
+	g_hash_table_remove_all (self->priv->symbols);
+	ld_category_remove_child (parent, iter->data);
+	g_signal_emit (self, LD_LIBRARY_GET_CLASS (self)->changed_signal, 0);
 }
 
 /*
@@ -319,10 +967,18 @@ gboolean
 ld_library_load (LdLibrary *self, const gchar *directory)
 {
 	LoadCategoryData data;
+	gint64 trace, trace_signal;
 
 	g_return_val_if_fail (LD_IS_LIBRARY (self), FALSE);
 	g_return_val_if_fail (directory != NULL, FALSE);
 
+	trace = ld_trace_begin ();
+	if (!self->priv->cache_loaded)
+	{
+		load_cache (self);
+		self->priv->cache_loaded = TRUE;
+	}
+
 	/* Almost like load_category(). */
 	data.self = self;
 	data.cat = self->priv->root;
@@ -330,6 +986,10 @@ ld_library_load (LdLibrary *self, const gchar *directory)
 	data.changed = FALSE;
 	foreach_dir (directory, load_category_cb, &data, NULL);
 
+	/* New categories may appear in the directory. */
+	if (self->priv->watch)
+		watch_directory (self, data.cat, directory);
+
 	/* XXX: It might also make sense to just forward the "children-changed"
 	 *      signal of the root category but we'd have to block it here anyway,
 	 *      so that we don't unnecessarily fire events for every single change.
@@ -341,35 +1001,182 @@ ld_library_load (LdLibrary *self, const gchar *directory)
 	 *      LdCategory and so delay the signal emission until an `unblock'.
 	 */
 	if (data.changed)
+	{
+		trace_signal = ld_trace_begin ();
 		g_signal_emit (self, LD_LIBRARY_GET_CLASS (self)->changed_signal, 0);
+		ld_trace_end (trace_signal, "library", "changed", NULL);
+	}
 
+	save_cache (self);
+	ld_trace_end (trace, "library", "ld_library_load", directory);
 	return TRUE;
 }
 
+/*
+ * load_cache:
+ *
+ * Read the symbol cache, a missing file is not an error.
+ */
+static void
+load_cache (LdLibrary *self)
+{
+	GError *error = NULL;
+	gint64 trace;
+
+	trace = ld_trace_begin ();
+	if (!ld_lua_load_cache (self->priv->lua,
+		self->priv->cache_filename, &error))
+	{
+		if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+			g_warning ("failed to load the symbol cache: %s",
+				error->message);
+		g_error_free (error);
+	}
+	ld_trace_end (trace, "library", "load_cache", self->priv->cache_filename);
+}
+
+/*
+ * save_cache:
+ *
+ * Write the symbol cache if anything has changed.
+ */
+static void
+save_cache (LdLibrary *self)
+{
+	GError *error = NULL;
+	gint64 trace;
+
+	trace = ld_trace_begin ();
+	if (!ld_lua_save_cache (self->priv->lua,
+		self->priv->cache_filename, &error))
+	{
+		g_warning ("failed to save the symbol cache: %s", error->message);
+		g_error_free (error);
+	}
+	ld_trace_end (trace, "library", "save_cache", self->priv->cache_filename);
+}
+
+/**
+ * ld_library_set_lazy:
+ * @self: an #LdLibrary object.
+ * @lazy: whether symbols should only be loaded once they're needed.
+ *
+ * Set the lazy mode.  This only affects subsequent calls to ld_library_load().
+ */
+void
+ld_library_set_lazy (LdLibrary *self, gboolean lazy)
+{
+	g_return_if_fail (LD_IS_LIBRARY (self));
+
+	self->priv->lazy = lazy;
+	g_object_notify (G_OBJECT (self), "lazy");
+}
+
+/**
+ * ld_library_get_lazy:
+ * @self: an #LdLibrary object.
+ *
+ * Return value: whether symbols are only loaded once they're needed.
+ */
+gboolean
+ld_library_get_lazy (LdLibrary *self)
+{
+	g_return_val_if_fail (LD_IS_LIBRARY (self), FALSE);
+	return self->priv->lazy;
+}
+
+/**
+ * ld_library_set_watch:
+ * @self: an #LdLibrary object.
+ * @watch: whether loaded directories should be monitored for changes.
+ *
+ * Set the watching mode.  This only affects subsequent calls
+ * to ld_library_load().
+ */
+void
+ld_library_set_watch (LdLibrary *self, gboolean watch)
+{
+	g_return_if_fail (LD_IS_LIBRARY (self));
+
+	self->priv->watch = watch;
+	g_object_notify (G_OBJECT (self), "watch");
+}
+
+/**
+ * ld_library_get_watch:
+ * @self: an #LdLibrary object.
+ *
+ * Return value: whether loaded directories are monitored for changes.
+ */
+gboolean
+ld_library_get_watch (LdLibrary *self)
+{
+	g_return_val_if_fail (LD_IS_LIBRARY (self), FALSE);
+	return self->priv->watch;
+}
+
 /**
  * ld_library_find_symbol:
  * @self: an #LdLibrary object.
  * @identifier: an identifier of the symbol to be searched for.
  *
- * Search for a symbol in the library.
+ * Search for a symbol in the library.  In the lazy mode, this loads
+ * symbols of the category the symbol is supposed to be in.
  *
  * Return value: a symbol object if found, %NULL otherwise.
  */
 LdSymbol *
 ld_library_find_symbol (LdLibrary *self, const gchar *identifier)
 {
-	gchar **path;
+	gchar **path, *category;
+	const gchar *name;
+	GHashTable *symbols;
 	LdSymbol *symbol = NULL;
 
 	g_return_val_if_fail (LD_IS_LIBRARY (self), NULL);
 	g_return_val_if_fail (identifier != NULL, NULL);
 
+	name = g_strrstr (identifier, LD_LIBRARY_IDENTIFIER_SEPARATOR);
+	if (name)
+	{
+		category = g_strndup (identifier, name - identifier);
+		name += strlen (LD_LIBRARY_IDENTIFIER_SEPARATOR);
+	}
+	else
+	{
+		category = g_strdup ("");
+		name = identifier;
+	}
+
+	symbols = g_hash_table_lookup (self->priv->symbols, category);
+	if (symbols && (symbol = g_hash_table_lookup (symbols, name)))
+	{
+		g_free (category);
+		return symbol;
+	}
+
 	path = g_strsplit (identifier, LD_LIBRARY_IDENTIFIER_SEPARATOR, 0);
 	if (path)
 	{
 		symbol = traverse_path (self->priv->root, path);
 		g_strfreev (path);
 	}
+	if (!symbol)
+	{
+		g_free (category);
+		return NULL;
+	}
+
+	if (!symbols)
+	{
+		symbols = g_hash_table_new_full (g_str_hash, g_str_equal,
+			g_free, g_object_unref);
+		g_hash_table_insert (self->priv->symbols, category, symbols);
+	}
+	else
+		g_free (category);
+
+	g_hash_table_insert (symbols, g_strdup (name), g_object_ref (symbol));
 	return symbol;
 }
 
@@ -406,6 +1213,167 @@ traverse_path (LdCategory *category, gchar **path)
 	return NULL;
 }
 
+/**
+ * ld_library_search:
+ * @self: an #LdLibrary object.
+ * @query: words to look for in names of symbols and their categories.
+ * @max_results: the maximum number of results, or zero for no limit.
+ *
+ * Search for symbols in the library.  In the lazy mode, this loads all
+ * symbols the first time it's called.
+ *
+ * Return value: (transfer full): a %NULL-terminated array of identifiers,
+ *               best matches first.  Free it with g_strfreev().
+ */
+gchar **
+ld_library_search (LdLibrary *self, const gchar *query, guint max_results)
+{
+	GHashTableIter iter;
+	IndexedCategory *data;
+
+	g_return_val_if_fail (LD_IS_LIBRARY (self), NULL);
+	g_return_val_if_fail (query != NULL, NULL);
+
+	update_index (self, self->priv->root, NULL, NULL);
+
+	/* Forget categories that are no longer a part of the library. */
+	g_hash_table_iter_init (&iter, self->priv->indexed);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &data))
+	{
+		if (!data->seen)
+			g_hash_table_iter_remove (&iter);
+		else
+			data->seen = FALSE;
+	}
+	return ld_symbol_index_query (self->priv->index, query, max_results);
+}
+
+/*
+ * update_index:
+ *
+ * Walk the category tree and reindex categories that have changed.
+ */
+static void
+update_index (LdLibrary *self, LdCategory *cat,
+	const gchar *path, const gchar *human_path)
+{
+	IndexedCategory *data;
+	const GSList *iter;
+
+	data = g_hash_table_lookup (self->priv->indexed, cat);
+	if (!data)
+	{
+		data = g_slice_new0 (IndexedCategory);
+		data->self = self;
+		data->cat = g_object_ref (cat);
+		data->dirty = TRUE;
+		g_signal_connect (cat, "symbols-changed",
+			G_CALLBACK (on_indexed_symbols_changed), data);
+		g_hash_table_insert (self->priv->indexed, cat, data);
+	}
+	if (g_strcmp0 (data->path, path))
+	{
+		g_free (data->path);
+		data->path = g_strdup (path);
+		data->dirty = TRUE;
+	}
+
+	data->seen = TRUE;
+	if (data->dirty)
+		index_category (self, data, human_path);
+
+	for (iter = ld_category_get_children (cat); iter; iter = iter->next)
+	{
+		LdCategory *child;
+		gchar *child_path, *child_human_path;
+
+		child = LD_CATEGORY (iter->data);
+		child_path = path
+			? g_build_path (LD_LIBRARY_IDENTIFIER_SEPARATOR,
+				path, ld_category_get_name (child), NULL)
+			: g_strdup (ld_category_get_name (child));
+		child_human_path = human_path
+			? g_strconcat (human_path, " ",
+				ld_category_get_human_name (child), NULL)
+			: g_strdup (ld_category_get_human_name (child));
+
+		update_index (self, child, child_path, child_human_path);
+		g_free (child_path);
+		g_free (child_human_path);
+	}
+}
+
+/*
+ * index_category:
+ *
+ * Replace symbols of a category in the search index.  Symbols can be found
+ * by their identifiers and by their human names in any language along with
+ * human names of their categories.
+ */
+static void
+index_category (LdLibrary *self, IndexedCategory *data,
+	const gchar *human_path)
+{
+	const GSList *iter;
+
+	for (iter = data->identifiers; iter; iter = iter->next)
+		ld_symbol_index_remove (self->priv->index, iter->data);
+	g_slist_free_full (data->identifiers, g_free);
+	data->identifiers = NULL;
+
+	for (iter = ld_category_get_symbols (data->cat); iter; iter = iter->next)
+	{
+		LdSymbol *symbol;
+		gchar *identifier, **human_names, **keys;
+		guint i, n_names;
+
+		symbol = LD_SYMBOL (iter->data);
+		identifier = data->path
+			? g_build_path (LD_LIBRARY_IDENTIFIER_SEPARATOR,
+				data->path, ld_symbol_get_name (symbol), NULL)
+			: g_strdup (ld_symbol_get_name (symbol));
+
+		human_names = ld_symbol_get_human_names (symbol);
+		n_names = g_strv_length (human_names);
+
+		keys = g_new0 (gchar *, n_names + 2);
+		keys[0] = g_strdup (identifier);
+		for (i = 0; i < n_names; i++)
+			keys[i + 1] = human_path
+				? g_strconcat (human_path, " ", human_names[i], NULL)
+				: g_strdup (human_names[i]);
+		ld_symbol_index_insert (self->priv->index,
+			identifier, (const gchar *const *) keys);
+
+		data->identifiers = g_slist_prepend (data->identifiers, identifier);
+		g_strfreev (human_names);
+		g_strfreev (keys);
+	}
+	data->dirty = FALSE;
+}
+
+static void
+indexed_category_free (IndexedCategory *data)
+{
+	const GSList *iter;
+
+	for (iter = data->identifiers; iter; iter = iter->next)
+		ld_symbol_index_remove (data->self->priv->index, iter->data);
+	g_slist_free_full (data->identifiers, g_free);
+
+	g_signal_handlers_disconnect_by_func (data->cat,
+		on_indexed_symbols_changed, data);
+	g_object_unref (data->cat);
+	g_free (data->path);
+	g_slice_free (IndexedCategory, data);
+}
+
+static void
+on_indexed_symbols_changed (LdCategory *cat, IndexedCategory *data)
+{
+	data->dirty = TRUE;
+}
+
 /**
  * ld_library_get_root:
  * @self: an #LdLibrary object.
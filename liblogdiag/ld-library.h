@@ -43,6 +43,7 @@ struct _LdLibraryClass
 	GObjectClass parent_class;
 
 	guint changed_signal;
+	guint symbol_changed_signal;
 };
 
 
@@ -58,7 +59,13 @@ GType ld_library_get_type (void) G_GNUC_CONST;
 
 LdLibrary *ld_library_new (void);
 gboolean ld_library_load (LdLibrary *self, const gchar *directory);
+void ld_library_set_lazy (LdLibrary *self, gboolean lazy);
+gboolean ld_library_get_lazy (LdLibrary *self);
+void ld_library_set_watch (LdLibrary *self, gboolean watch);
+gboolean ld_library_get_watch (LdLibrary *self);
 LdSymbol *ld_library_find_symbol (LdLibrary *self, const gchar *identifier);
+gchar **ld_library_search (LdLibrary *self, const gchar *query,
+	guint max_results);
 LdCategory *ld_library_get_root (LdLibrary *self);
 
 
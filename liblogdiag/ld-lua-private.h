@@ -16,6 +16,9 @@ G_BEGIN_DECLS
 
 /*< private_header >*/
 
+typedef struct _LdLuaPending LdLuaPending;
+typedef struct _LdLuaProgram LdLuaProgram;
+
 void ld_lua_private_unregister (LdLua *self, LdLuaSymbol *symbol);
 void ld_lua_private_draw (LdLua *self, LdLuaSymbol *symbol, cairo_t *cr);
 
@@ -21,16 +21,24 @@ G_BEGIN_DECLS
  * @lua: parent #LdLua object.
  * @name: name of this symbol.
  * @human_name: localized human name of this symbol.
+ * @human_names: human names of this symbol in all languages.
  * @area: area of this symbol.
  * @terminals: terminals of this symbol.
+ * @pending: the cached chunk to run before the symbol can be drawn.
+ * @program: recorded drawing operations of the render function.
+ * @dynamic: whether the render function has to be run for every draw.
  */
 struct _LdLuaSymbolPrivate
 {
 	LdLua *lua;
 	gchar *name;
 	gchar *human_name;
+	gchar **human_names;
 	LdRectangle area;
 	LdPointArray *terminals;
+	LdLuaPending *pending;
+	LdLuaProgram *program;
+	gboolean dynamic;
 };
 
 
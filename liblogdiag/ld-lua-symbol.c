@@ -27,6 +27,7 @@ static void ld_lua_symbol_finalize (GObject *gobject);
 
 static const gchar *ld_lua_symbol_real_get_name (LdSymbol *symbol);
 static const gchar *ld_lua_symbol_real_get_human_name (LdSymbol *symbol);
+static gchar **ld_lua_symbol_real_get_human_names (LdSymbol *symbol);
 static void ld_lua_symbol_real_get_area (LdSymbol *symbol, LdRectangle *area);
 static const LdPointArray *ld_lua_symbol_real_get_terminals (LdSymbol *symbol);
 static void ld_lua_symbol_real_draw (LdSymbol *symbol, cairo_t *cr);
@@ -44,6 +45,7 @@ ld_lua_symbol_class_init (LdLuaSymbolClass *klass)
 
 	klass->parent_class.get_name = ld_lua_symbol_real_get_name;
 	klass->parent_class.get_human_name = ld_lua_symbol_real_get_human_name;
+	klass->parent_class.get_human_names = ld_lua_symbol_real_get_human_names;
 	klass->parent_class.get_area = ld_lua_symbol_real_get_area;
 	klass->parent_class.get_terminals = ld_lua_symbol_real_get_terminals;
 	klass->parent_class.draw = ld_lua_symbol_real_draw;
@@ -75,6 +77,7 @@ ld_lua_symbol_finalize (GObject *gobject)
 		g_free (self->priv->name);
 	if (self->priv->human_name)
 		g_free (self->priv->human_name);
+	g_strfreev (self->priv->human_names);
 
 	if (self->priv->terminals)
 		ld_point_array_free (self->priv->terminals);
@@ -98,6 +101,23 @@ ld_lua_symbol_real_get_human_name (LdSymbol *symbol)
 	return LD_LUA_SYMBOL (symbol)->priv->human_name;
 }
 
+static gchar **
+ld_lua_symbol_real_get_human_names (LdSymbol *symbol)
+{
+	LdLuaSymbol *self;
+	gchar **names;
+
+	g_return_val_if_fail (LD_IS_LUA_SYMBOL (symbol), NULL);
+
+	self = LD_LUA_SYMBOL (symbol);
+	if (self->priv->human_names && *self->priv->human_names)
+		return g_strdupv (self->priv->human_names);
+
+	names = g_new0 (gchar *, 2);
+	names[0] = g_strdup (self->priv->human_name);
+	return names;
+}
+
 static void
 ld_lua_symbol_real_get_area (LdSymbol *symbol, LdRectangle *area)
 {
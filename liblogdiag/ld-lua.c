@@ -8,6 +8,8 @@
  *
  */
 
+#include <string.h>
+
 #include <lua.h>
 #include <lualib.h>
 #include <lauxlib.h>
@@ -25,19 +27,75 @@
  * @see_also: #LdLuaSymbol
  *
  * #LdLua is a symbol engine that uses Lua scripts to manage symbols.
+ *
+ * Scripts register symbols by calling `logdiag.register (name, names,
+ * area, terminals, render, options)'.  The render function's output is
+ * recorded the first time the symbol is drawn and replayed afterwards,
+ * so it must depend on nothing but the context it's given; random numbers
+ * from math.random(), for example, would only be drawn once.  Symbols that need
+ * to be rendered anew for each draw say so with `{dynamic = true}'
+ * as the optional last argument.
  */
 
 /*
  * LdLuaPrivate:
  * @L: Lua state.
+ * @cache: cached results of loading files, indexed by filename.
+ * @cache_changed: whether @cache differs from what has been last saved.
+ * @format: identifies the bytecode format of this build of Lua.
  *
  * The library contains the real function for rendering.
  */
 struct _LdLuaPrivate
 {
 	lua_State *L;
+	GHashTable *cache;
+	gboolean cache_changed;
+	gchar *format;
+};
+
+/*
+ * LdLuaCacheEntry:
+ * @mtime: modification time of the file at the time it was compiled,
+ *         in microseconds.
+ * @size: size of the file at the time it was compiled.
+ * @bytecode: the compiled chunk.
+ * @symbols: descriptions of symbols that the chunk has registered.
+ * @seen: whether the file has been loaded since the cache was read.
+ *
+ * Everything needed to recreate symbols from a file without running it.
+ */
+typedef struct _LdLuaCacheEntry LdLuaCacheEntry;
+
+struct _LdLuaCacheEntry
+{
+	gint64 mtime;
+	gint64 size;
+	GBytes *bytecode;
+	JsonArray *symbols;
+	gboolean seen;
+};
+
+/*
+ * LdLuaPending:
+ * @ref_count: reference count, one for each symbol in @symbols.
+ * @filename: the file the chunk has been compiled from.
+ * @bytecode: the compiled chunk.
+ * @symbols: symbols restored from the cache that still lack
+ *           a rendering function.
+ *
+ * The chunk only gets executed once one of its symbols is to be drawn.
+ */
+struct _LdLuaPending
+{
+	gint ref_count;
+	gchar *filename;
+	GBytes *bytecode;
+	GSList *symbols;
 };
 
+#define LD_LUA_CACHE_VERSION  4
+
 /* registry.logdiag_symbols
  *   -> A table indexed by pointers to LdLuaSymbol objects
  * registry.logdiag_symbols.object.render(cr)
@@ -54,6 +112,9 @@ struct _LdLuaPrivate
  * @self: a reference to self.
  * @load_callback: a callback for newly registered symbols.
  * @load_user_data: user data to be passed to the callback.
+ * @record: where to describe newly registered symbols for the cache.
+ * @rebind: symbols to receive rendering functions instead of creating
+ *          new ones.
  *
  * Full user data to be stored in Lua registry.
  */
@@ -64,8 +125,18 @@ struct _LdLuaData
 	LdLua *self;
 	LdLuaLoadCallback load_callback;
 	gpointer load_user_data;
+	JsonArray *record;
+	LdLuaPending *rebind;
 };
 
+/*
+ * LdLuaDrawData:
+ * @symbol: the symbol being drawn.
+ * @cr: the Cairo context to draw onto.
+ * @save_count: how many times the context has been saved by the script.
+ * @program: where to record drawing operations, if anywhere.
+ * @dynamic: whether the drawing can't be replayed from the recording.
+ */
 typedef struct _LdLuaDrawData LdLuaDrawData;
 
 struct _LdLuaDrawData
@@ -73,23 +144,128 @@ struct _LdLuaDrawData
 	LdLuaSymbol *symbol;
 	cairo_t *cr;
 	unsigned save_count;
+	LdLuaProgram *program;
+	gboolean dynamic;
+};
+
+/*
+ * LdLuaOp:
+ *
+ * Operations of a recorded render function.  The comments say how many
+ * numeric arguments each of them takes.  LD_LUA_OP_SHOW_TEXT takes
+ * a text argument instead.
+ */
+typedef enum _LdLuaOp LdLuaOp;
+
+enum _LdLuaOp
+{
+	LD_LUA_OP_SAVE,              /* 0 */
+	LD_LUA_OP_RESTORE,           /* 0 */
+	LD_LUA_OP_SET_LINE_WIDTH,    /* 1 */
+	LD_LUA_OP_TRANSLATE,         /* 2 */
+	LD_LUA_OP_SCALE,             /* 2 */
+	LD_LUA_OP_ROTATE,            /* 1 */
+	LD_LUA_OP_MOVE_TO,           /* 2 */
+	LD_LUA_OP_LINE_TO,           /* 2 */
+	LD_LUA_OP_CURVE_TO,          /* 6 */
+	LD_LUA_OP_ARC,               /* 5 */
+	LD_LUA_OP_ARC_NEGATIVE,      /* 5 */
+	LD_LUA_OP_NEW_PATH,          /* 0 */
+	LD_LUA_OP_NEW_SUB_PATH,      /* 0 */
+	LD_LUA_OP_CLOSE_PATH,        /* 0 */
+	LD_LUA_OP_STROKE,            /* 0 */
+	LD_LUA_OP_STROKE_PRESERVE,   /* 0 */
+	LD_LUA_OP_FILL,              /* 0 */
+	LD_LUA_OP_FILL_PRESERVE,     /* 0 */
+	LD_LUA_OP_CLIP,              /* 0 */
+	LD_LUA_OP_CLIP_PRESERVE,     /* 0 */
+	LD_LUA_OP_SHOW_TEXT
+};
+
+/*
+ * LdLuaProgram:
+ * @ops: a stream of #LdLuaOp codes.
+ * @args: numeric arguments of the operations, in order.
+ * @texts: text arguments of the operations, in order.
+ *
+ * A recording of what a render function has drawn, so that the symbol
+ * can be drawn again without calling into Lua.  Programs are replayed
+ * from many threads at once, so text is only laid out when replaying,
+ * using the cache of the current thread.
+ */
+struct _LdLuaProgram
+{
+	GByteArray *ops;
+	GArray *args;
+	GPtrArray *texts;
+};
+
+/*
+ * LdLuaTextCache:
+ * @context: the Pango context shared by all layouts.
+ * @font_desc: the font used for text in symbols.
+ * @layouts: layouts indexed by their text.
+ *
+ * State for showing text that is kept for each thread.
+ */
+typedef struct _LdLuaTextCache LdLuaTextCache;
+
+struct _LdLuaTextCache
+{
+	PangoContext *context;
+	PangoFontDescription *font_desc;
+	GHashTable *layouts;
 };
 
+/* Labels of symbols are few, this is just a safety limit. */
+#define LD_LUA_TEXT_CACHE_MAX  1024
+
 static void ld_lua_finalize (GObject *gobject);
 
 static void *ld_lua_alloc (void *ud, void *ptr, size_t osize, size_t nsize);
+static LdLuaData *get_data (LdLua *self);
+
+static gboolean stat_file (const gchar *filename,
+	gint64 *mtime, gint64 *size);
+static gchar *get_bytecode_format (lua_State *L);
+static void cache_entry_free (LdLuaCacheEntry *entry);
+static LdLuaCacheEntry *cache_entry_deserialize (JsonObject *object);
+static JsonObject *cache_entry_serialize (LdLuaCacheEntry *entry);
+static int dump_writer (lua_State *L, const void *p, size_t sz, void *ud);
+static void restore_symbols (LdLua *self, const gchar *filename,
+	LdLuaCacheEntry *entry, LdLuaLoadCallback callback, gpointer user_data);
+static LdLuaSymbol *restore_symbol (JsonObject *object);
+
+static LdLuaPending *pending_ref (LdLuaPending *self);
+static void pending_unref (LdLuaPending *self);
+static void pending_bind (LdLua *self, LdLuaPending *pending);
+
+static LdLuaProgram *program_new (void);
+static void program_free (LdLuaProgram *self);
+static void program_add (LdLuaDrawData *data, LdLuaOp op, gint n_args, ...);
+static void program_add_text (LdLuaDrawData *data, const gchar *text);
+static void program_run (LdLuaProgram *self, cairo_t *cr);
 
 static int ld_lua_private_draw_cb (lua_State *L);
 static int ld_lua_private_unregister_cb (lua_State *L);
 
 static int ld_lua_logdiag_register (lua_State *L);
 static int process_registration (lua_State *L);
-static gchar *get_translation (lua_State *L, int index);
+static int process_rebinding (lua_State *L, LdLuaPending *pending);
+static void register_render (lua_State *L, LdLuaSymbol *symbol, int index);
+static JsonObject *describe_registration (LdLuaSymbol *symbol,
+	JsonObject *names);
+static JsonObject *read_translations (lua_State *L, int index);
+static gchar *select_translation (JsonObject *names, const gchar *fallback);
+static gchar **list_translations (JsonObject *names);
 static gboolean read_symbol_area (lua_State *L, int index, LdRectangle *area);
 static gboolean read_terminals (lua_State *L, int index,
 	LdPointArray **terminals);
 
 static gdouble get_cairo_scale (cairo_t *cr);
+static void text_cache_free (LdLuaTextCache *cache);
+static PangoLayout *get_text_layout (const gchar *text);
+static void show_text (cairo_t *cr, PangoLayout *layout);
 static int ld_lua_cairo_save (lua_State *L);
 static int ld_lua_cairo_restore (lua_State *L);
 static int ld_lua_cairo_get_line_width (lua_State *L);
@@ -209,6 +385,8 @@ ld_lua_init (LdLua *self)
 	ud->self = self;
 	ud->load_callback = NULL;
 	ud->load_user_data = NULL;
+	ud->record = NULL;
+	ud->rebind = NULL;
 
 	lua_setfield (L, LUA_REGISTRYINDEX, LD_LUA_DATA_INDEX);
 
@@ -217,6 +395,11 @@ ld_lua_init (LdLua *self)
 	lua_setfield (L, LUA_REGISTRYINDEX, LD_LUA_SYMBOLS_INDEX);
 
 	push_cairo_metatable (L);
+
+	/* Bytecode can only be loaded by a build of Lua with the same format. */
+	self->priv->format = get_bytecode_format (L);
+	self->priv->cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+		g_free, (GDestroyNotify) cache_entry_free);
 }
 
 static void
@@ -226,6 +409,8 @@ ld_lua_finalize (GObject *gobject)
 
 	self = LD_LUA (gobject);
 	lua_close (self->priv->L);
+	g_hash_table_destroy (self->priv->cache);
+	g_free (self->priv->format);
 
 	/* Chain up to the parent class. */
 	G_OBJECT_CLASS (ld_lua_parent_class)->finalize (gobject);
@@ -270,6 +455,18 @@ ld_lua_check_file (LdLua *self, const gchar *filename)
 		&& g_file_test (filename, G_FILE_TEST_IS_REGULAR);
 }
 
+static LdLuaData *
+get_data (LdLua *self)
+{
+	LdLuaData *ud;
+
+	/* XXX: If something from the following fails, Lua will panic. */
+	lua_getfield (self->priv->L, LUA_REGISTRYINDEX, LD_LUA_DATA_INDEX);
+	ud = lua_touserdata (self->priv->L, -1);
+	lua_pop (self->priv->L, 1);
+	return ud;
+}
+
 /**
  * ld_lua_load_file:
  * @self: an #LdLua object.
@@ -279,6 +476,8 @@ ld_lua_check_file (LdLua *self, const gchar *filename)
  * @user_data: user data to be passed to the callback.
  *
  * Loads a file and creates #LdLuaSymbol objects for contained symbols.
+ * If the file hasn't changed since it was last cached, symbols are created
+ * from the cache and the file is only executed once they need to be drawn.
  *
  * Returns: %TRUE if no error has occured, %FALSE otherwise.
  */
@@ -286,43 +485,578 @@ gboolean
 ld_lua_load_file (LdLua *self, const gchar *filename,
 	LdLuaLoadCallback callback, gpointer user_data)
 {
+	gint64 mtime, size;
+	LdLuaCacheEntry *entry;
+	GByteArray *bytecode;
+	JsonArray *record;
 	gint retval;
 	LdLuaData *ud;
+	gint64 trace;
 
 	g_return_val_if_fail (LD_IS_LUA (self), FALSE);
 	g_return_val_if_fail (filename != NULL, FALSE);
 	g_return_val_if_fail (callback != NULL, FALSE);
 
-	/* XXX: If something from the following fails, Lua will panic. */
-	lua_getfield (self->priv->L, LUA_REGISTRYINDEX, LD_LUA_DATA_INDEX);
-	ud = lua_touserdata (self->priv->L, -1);
-	lua_pop (self->priv->L, 1);
-	g_return_val_if_fail (ud != NULL, FALSE);
+	if (!stat_file (filename, &mtime, &size))
+		return FALSE;
 
-	ud->load_callback = callback;
-	ud->load_user_data = user_data;
+	entry = g_hash_table_lookup (self->priv->cache, filename);
+	if (entry && entry->mtime == mtime && entry->size == size)
+	{
+		trace = ld_trace_begin ();
+		entry->seen = TRUE;
+		restore_symbols (self, filename, entry, callback, user_data);
+		ld_trace_end (trace, "lua", "restore", filename);
+		return TRUE;
+	}
 
+	ud = get_data (self);
+	g_return_val_if_fail (ud != NULL, FALSE);
+
+	trace = ld_trace_begin ();
 	retval = luaL_loadfile (self->priv->L, filename);
 	if (retval)
 		goto ld_lua_lftc_fail;
 
+	/* Keep the compiled chunk for the next time the file is loaded. */
+	bytecode = g_byte_array_new ();
+#if LUA_VERSION_NUM >= 503
+	lua_dump (self->priv->L, dump_writer, bytecode, FALSE);
+#else
+	lua_dump (self->priv->L, dump_writer, bytecode);
+#endif
+	ld_trace_end (trace, "lua", "compile", filename);
+
+	record = json_array_new ();
+	ud->load_callback = callback;
+	ud->load_user_data = user_data;
+	ud->record = record;
+
+	trace = ld_trace_begin ();
 	retval = lua_pcall (self->priv->L, 0, 0, 0);
-	if (retval)
-		goto ld_lua_lftc_fail;
+	ld_trace_end (trace, "lua", "run", filename);
 
 	ud->load_callback = NULL;
 	ud->load_user_data = NULL;
+	ud->record = NULL;
+
+	if (retval)
+	{
+		g_byte_array_unref (bytecode);
+		json_array_unref (record);
+		goto ld_lua_lftc_fail;
+	}
+
+	entry = g_slice_new (LdLuaCacheEntry);
+	entry->mtime = mtime;
+	entry->size = size;
+	entry->bytecode = g_byte_array_free_to_bytes (bytecode);
+	entry->symbols = record;
+	entry->seen = TRUE;
+
+	g_hash_table_replace (self->priv->cache, g_strdup (filename), entry);
+	self->priv->cache_changed = TRUE;
 	return TRUE;
 
 ld_lua_lftc_fail:
 	g_warning ("Lua error: %s", lua_tostring (self->priv->L, -1));
 	lua_remove (self->priv->L, -1);
 
-	ud->load_callback = NULL;
-	ud->load_user_data = NULL;
+	if (g_hash_table_remove (self->priv->cache, filename))
+		self->priv->cache_changed = TRUE;
 	return FALSE;
 }
 
+/*
+ * stat_file:
+ *
+ * Retrieve the modification time and the size of a file.  Seconds aren't
+ * precise enough for files that are being edited while the program runs.
+ */
+static gboolean
+stat_file (const gchar *filename, gint64 *mtime, gint64 *size)
+{
+	GFile *file;
+	GFileInfo *info;
+	GError *error = NULL;
+
+	file = g_file_new_for_path (filename);
+	info = g_file_query_info (file, G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+		G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC ","
+		G_FILE_ATTRIBUTE_STANDARD_SIZE, G_FILE_QUERY_INFO_NONE, NULL, &error);
+	g_object_unref (file);
+
+	if (!info)
+	{
+		g_warning ("cannot stat `%s': %s", filename, error->message);
+		g_error_free (error);
+		return FALSE;
+	}
+
+	*mtime = g_file_info_get_attribute_uint64 (info,
+		G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC
+		+ g_file_info_get_attribute_uint32 (info,
+		G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+	*size = g_file_info_get_size (info);
+
+	g_object_unref (info);
+	return TRUE;
+}
+
+static int
+dump_writer (lua_State *L, const void *p, size_t sz, void *ud)
+{
+	g_byte_array_append (ud, p, sz);
+	return 0;
+}
+
+/*
+ * get_bytecode_format:
+ *
+ * Lua doesn't verify bytecode, so it must never be given a chunk compiled
+ * by a build with a different version, number types or byte order.  All of
+ * that is part of the header of a dumped chunk, hence the checksum of
+ * an empty one identifies the format.
+ */
+static gchar *
+get_bytecode_format (lua_State *L)
+{
+	GByteArray *bytecode;
+	gchar *format;
+
+	if (luaL_loadstring (L, ""))
+	{
+		lua_pop (L, 1);
+		return g_strdup (LUA_RELEASE);
+	}
+
+	bytecode = g_byte_array_new ();
+#if LUA_VERSION_NUM >= 503
+	lua_dump (L, dump_writer, bytecode, FALSE);
+#else
+	lua_dump (L, dump_writer, bytecode);
+#endif
+	lua_pop (L, 1);
+
+	format = g_compute_checksum_for_data (G_CHECKSUM_SHA256,
+		bytecode->data, bytecode->len);
+	g_byte_array_unref (bytecode);
+	return format;
+}
+
+/* ===== Cache ============================================================= */
+
+/* The cache is a JSON file in the following format:
+ *
+ *   { "version": LD_LUA_CACHE_VERSION, "lua": LUA_RELEASE,
+ *     "format": get_bytecode_format (), "files": {
+ *       filename: { "mtime": int, "size": int, "bytecode": base64,
+ *         "checksum": sha256 (bytecode),
+ *         "symbols": [ { "name": string, "names": { lang: string },
+ *           "area": [x, y, width, height], "terminals": [[x, y]],
+ *           "dynamic": bool } ] } } }
+ *
+ * All translations of human names are stored, so that changing the locale
+ * doesn't invalidate anything.  The cache lives in a user-writable
+ * directory and Lua would crash on malformed bytecode, so entries whose
+ * checksum doesn't match are dropped and their files compiled again.
+ */
+
+/**
+ * ld_lua_load_cache:
+ * @self: an #LdLua object.
+ * @filename: location of the cache.
+ * @error: (allow-none): return location for a #GError, or %NULL.
+ *
+ * Read results of previous ld_lua_load_file() calls, so that files which
+ * haven't changed since then don't need to be executed again.
+ * A cache written by a different version or build of Lua is silently
+ * ignored, as are entries that have been damaged.
+ *
+ * Return value: %TRUE if no error has occured, %FALSE otherwise.
+ */
+gboolean
+ld_lua_load_cache (LdLua *self, const gchar *filename, GError **error)
+{
+	JsonParser *parser;
+	JsonNode *root;
+	JsonObject *root_object, *files;
+	GList *members, *iter;
+	GError *json_error = NULL;
+
+	g_return_val_if_fail (LD_IS_LUA (self), FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	parser = json_parser_new ();
+	if (!json_parser_load_from_file (parser, filename, &json_error))
+	{
+		g_propagate_error (error, json_error);
+		g_object_unref (parser);
+		return FALSE;
+	}
+
+	root = json_parser_get_root (parser);
+	if (!JSON_NODE_HOLDS_OBJECT (root))
+		goto ld_lua_load_cache_end;
+
+	root_object = json_node_get_object (root);
+	if (!json_object_has_member (root_object, "version")
+	 || json_object_get_int_member (root_object, "version")
+		!= LD_LUA_CACHE_VERSION
+	 || !json_object_has_member (root_object, "lua")
+	 || g_strcmp0 (json_object_get_string_member (root_object, "lua"),
+		LUA_RELEASE)
+	 || !json_object_has_member (root_object, "format")
+	 || g_strcmp0 (json_object_get_string_member (root_object, "format"),
+		self->priv->format)
+	 || !json_object_has_member (root_object, "files"))
+		goto ld_lua_load_cache_end;
+
+	files = json_object_get_object_member (root_object, "files");
+	if (!files)
+		goto ld_lua_load_cache_end;
+
+	members = json_object_get_members (files);
+	for (iter = members; iter; iter = g_list_next (iter))
+	{
+		LdLuaCacheEntry *entry;
+		JsonNode *node;
+
+		node = json_object_get_member (files, iter->data);
+		if (!JSON_NODE_HOLDS_OBJECT (node)
+		 || !(entry = cache_entry_deserialize (json_node_get_object (node))))
+			continue;
+
+		/* Entries from actual loads are at least as fresh as ours. */
+		if (!g_hash_table_lookup (self->priv->cache, iter->data))
+			g_hash_table_insert (self->priv->cache,
+				g_strdup (iter->data), entry);
+		else
+			cache_entry_free (entry);
+	}
+	g_list_free (members);
+
+ld_lua_load_cache_end:
+	g_object_unref (parser);
+	return TRUE;
+}
+
+/**
+ * ld_lua_save_cache:
+ * @self: an #LdLua object.
+ * @filename: location of the cache.
+ * @error: (allow-none): return location for a #GError, or %NULL.
+ *
+ * Write the cache if it has changed since it was last loaded or saved.
+ * Entries for files that no longer exist are dropped.
+ *
+ * Return value: %TRUE if no error has occured, %FALSE otherwise.
+ */
+gboolean
+ld_lua_save_cache (LdLua *self, const gchar *filename, GError **error)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+	JsonObject *root_object, *files;
+	JsonNode *root;
+	JsonGenerator *generator;
+	gchar *dirname, *data;
+	gsize length;
+	gboolean success;
+
+	g_return_val_if_fail (LD_IS_LUA (self), FALSE);
+	g_return_val_if_fail (filename != NULL, FALSE);
+
+	if (!self->priv->cache_changed)
+		return TRUE;
+
+	files = json_object_new ();
+	g_hash_table_iter_init (&iter, self->priv->cache);
+	while (g_hash_table_iter_next (&iter, &key, &value))
+	{
+		LdLuaCacheEntry *entry;
+
+		entry = value;
+		if (!entry->seen && !g_file_test (key, G_FILE_TEST_IS_REGULAR))
+		{
+			g_hash_table_iter_remove (&iter);
+			continue;
+		}
+		json_object_set_object_member (files, key,
+			cache_entry_serialize (entry));
+	}
+
+	root_object = json_object_new ();
+	json_object_set_int_member (root_object, "version", LD_LUA_CACHE_VERSION);
+	json_object_set_string_member (root_object, "lua", LUA_RELEASE);
+	json_object_set_string_member (root_object, "format", self->priv->format);
+	json_object_set_object_member (root_object, "files", files);
+
+	root = json_node_new (JSON_NODE_OBJECT);
+	json_node_take_object (root, root_object);
+
+	generator = json_generator_new ();
+	json_generator_set_root (generator, root);
+	data = json_generator_to_data (generator, &length);
+	g_object_unref (generator);
+	json_node_free (root);
+
+	dirname = g_path_get_dirname (filename);
+	g_mkdir_with_parents (dirname, 0755);
+	g_free (dirname);
+
+	success = g_file_set_contents (filename, data, length, error);
+	g_free (data);
+
+	if (success)
+		self->priv->cache_changed = FALSE;
+	return success;
+}
+
+static void
+cache_entry_free (LdLuaCacheEntry *entry)
+{
+	g_bytes_unref (entry->bytecode);
+	json_array_unref (entry->symbols);
+	g_slice_free (LdLuaCacheEntry, entry);
+}
+
+static LdLuaCacheEntry *
+cache_entry_deserialize (JsonObject *object)
+{
+	LdLuaCacheEntry *entry;
+	const gchar *encoded, *checksum;
+	JsonArray *symbols;
+	guchar *bytecode;
+	gchar *actual;
+	gsize length;
+
+	if (!json_object_has_member (object, "mtime")
+	 || !json_object_has_member (object, "size")
+	 || !json_object_has_member (object, "bytecode")
+	 || !json_object_has_member (object, "checksum")
+	 || !json_object_has_member (object, "symbols")
+	 || !(encoded = json_object_get_string_member (object, "bytecode"))
+	 || !(checksum = json_object_get_string_member (object, "checksum"))
+	 || !(symbols = json_object_get_array_member (object, "symbols")))
+		return NULL;
+
+	bytecode = g_base64_decode (encoded, &length);
+	actual = g_compute_checksum_for_data (G_CHECKSUM_SHA256,
+		bytecode, length);
+	if (strcmp (actual, checksum))
+	{
+		g_free (actual);
+		g_free (bytecode);
+		return NULL;
+	}
+	g_free (actual);
+
+	entry = g_slice_new (LdLuaCacheEntry);
+	entry->mtime = json_object_get_int_member (object, "mtime");
+	entry->size = json_object_get_int_member (object, "size");
+	entry->bytecode = g_bytes_new_take (bytecode, length);
+	entry->symbols = json_array_ref (symbols);
+	entry->seen = FALSE;
+	return entry;
+}
+
+static JsonObject *
+cache_entry_serialize (LdLuaCacheEntry *entry)
+{
+	JsonObject *object;
+	gconstpointer bytecode;
+	gsize length;
+	gchar *encoded, *checksum;
+
+	bytecode = g_bytes_get_data (entry->bytecode, &length);
+	encoded = g_base64_encode (bytecode, length);
+	checksum = g_compute_checksum_for_data (G_CHECKSUM_SHA256,
+		bytecode, length);
+
+	object = json_object_new ();
+	json_object_set_int_member (object, "mtime", entry->mtime);
+	json_object_set_int_member (object, "size", entry->size);
+	json_object_set_string_member (object, "bytecode", encoded);
+	json_object_set_string_member (object, "checksum", checksum);
+	g_free (encoded);
+	g_free (checksum);
+	json_object_set_array_member (object, "symbols",
+		json_array_ref (entry->symbols));
+	return object;
+}
+
+/*
+ * restore_symbols:
+ *
+ * Create symbols described by a cache entry without running any code.
+ */
+static void
+restore_symbols (LdLua *self, const gchar *filename, LdLuaCacheEntry *entry,
+	LdLuaLoadCallback callback, gpointer user_data)
+{
+	LdLuaPending *pending;
+	guint i, length;
+
+	pending = g_slice_new (LdLuaPending);
+	pending->ref_count = 1;
+	pending->filename = g_strdup (filename);
+	pending->bytecode = g_bytes_ref (entry->bytecode);
+	pending->symbols = NULL;
+
+	length = json_array_get_length (entry->symbols);
+	for (i = 0; i < length; i++)
+	{
+		LdLuaSymbol *symbol;
+		JsonNode *node;
+
+		node = json_array_get_element (entry->symbols, i);
+		if (!JSON_NODE_HOLDS_OBJECT (node)
+		 || !(symbol = restore_symbol (json_node_get_object (node))))
+			continue;
+
+		symbol->priv->lua = g_object_ref (self);
+		symbol->priv->pending = pending_ref (pending);
+		pending->symbols = g_slist_prepend (pending->symbols, symbol);
+
+		callback (LD_SYMBOL (symbol), user_data);
+		g_object_unref (symbol);
+	}
+	pending_unref (pending);
+}
+
+static LdLuaSymbol *
+restore_symbol (JsonObject *object)
+{
+	LdLuaSymbol *symbol;
+	JsonObject *names;
+	JsonArray *area, *terminals;
+	const gchar *name;
+	guint i, length;
+
+	if (!json_object_has_member (object, "name")
+	 || !json_object_has_member (object, "names")
+	 || !json_object_has_member (object, "area")
+	 || !json_object_has_member (object, "terminals")
+	 || !(name = json_object_get_string_member (object, "name"))
+	 || !(names = json_object_get_object_member (object, "names"))
+	 || !(area = json_object_get_array_member (object, "area"))
+	 || !(terminals = json_object_get_array_member (object, "terminals"))
+	 || json_array_get_length (area) != 4)
+		return NULL;
+
+	symbol = g_object_new (LD_TYPE_LUA_SYMBOL, NULL);
+	symbol->priv->name = g_strdup (name);
+	symbol->priv->human_name = select_translation (names, name);
+	symbol->priv->human_names = list_translations (names);
+
+	if (json_object_has_member (object, "dynamic"))
+		symbol->priv->dynamic =
+			json_object_get_boolean_member (object, "dynamic");
+
+	symbol->priv->area.x      = json_array_get_double_element (area, 0);
+	symbol->priv->area.y      = json_array_get_double_element (area, 1);
+	symbol->priv->area.width  = json_array_get_double_element (area, 2);
+	symbol->priv->area.height = json_array_get_double_element (area, 3);
+
+	length = json_array_get_length (terminals);
+	symbol->priv->terminals = ld_point_array_sized_new (length);
+	for (i = 0; i < length; i++)
+	{
+		JsonArray *point;
+
+		point = json_array_get_array_element (terminals, i);
+		if (!point || json_array_get_length (point) != 2)
+			continue;
+
+		symbol->priv->terminals->points[symbol->priv->terminals->length].x
+			= json_array_get_double_element (point, 0);
+		symbol->priv->terminals->points[symbol->priv->terminals->length].y
+			= json_array_get_double_element (point, 1);
+		symbol->priv->terminals->length++;
+	}
+	return symbol;
+}
+
+static LdLuaPending *
+pending_ref (LdLuaPending *self)
+{
+	self->ref_count++;
+	return self;
+}
+
+static void
+pending_unref (LdLuaPending *self)
+{
+	if (--self->ref_count)
+		return;
+
+	g_free (self->filename);
+	g_bytes_unref (self->bytecode);
+	g_slist_free (self->symbols);
+	g_slice_free (LdLuaPending, self);
+}
+
+/*
+ * pending_bind:
+ *
+ * Run a cached chunk and give its rendering functions to restored symbols.
+ * Should the chunk fail to load, the file is compiled again from source
+ * and its entry dropped from the cache.
+ */
+static void
+pending_bind (LdLua *self, LdLuaPending *pending)
+{
+	LdLuaData *ud;
+	LdLuaSymbol *symbol;
+	gconstpointer bytecode;
+	gsize length;
+	gchar *chunkname;
+	gint retval;
+
+	ud = get_data (self);
+	g_return_if_fail (ud != NULL);
+
+	pending_ref (pending);
+
+	bytecode = g_bytes_get_data (pending->bytecode, &length);
+	chunkname = g_strconcat ("@", pending->filename, NULL);
+	retval = luaL_loadbufferx (self->priv->L,
+		bytecode, length, chunkname, "b");
+	g_free (chunkname);
+
+	if (retval)
+	{
+		lua_pop (self->priv->L, 1);
+		if (g_hash_table_remove (self->priv->cache, pending->filename))
+			self->priv->cache_changed = TRUE;
+		retval = luaL_loadfile (self->priv->L, pending->filename);
+	}
+	if (!retval)
+	{
+		ud->rebind = pending;
+		retval = lua_pcall (self->priv->L, 0, 0, 0);
+		ud->rebind = NULL;
+	}
+	if (retval)
+	{
+		g_warning ("Lua error: %s", lua_tostring (self->priv->L, -1));
+		lua_pop (self->priv->L, 1);
+	}
+
+	/* Symbols that the file no longer registers will fail to draw. */
+	while (pending->symbols)
+	{
+		symbol = pending->symbols->data;
+		pending->symbols = g_slist_delete_link (pending->symbols,
+			pending->symbols);
+
+		symbol->priv->pending = NULL;
+		pending_unref (pending);
+	}
+	pending_unref (pending);
+}
+
 /* ===== LdLuaSymbol callbacks ============================================= */
 
 /**
@@ -332,6 +1066,11 @@ ld_lua_lftc_fail:
  * @cr: a Cairo context to be drawn onto.
  *
  * Draw a symbol onto a Cairo context.
+ *
+ * The first time a symbol is drawn, operations of its render function
+ * are recorded and later draws just replay them.  Symbols registered
+ * as dynamic, as well as those that ask the context for information,
+ * run the function each time instead.
  */
 void
 ld_lua_private_draw (LdLua *self, LdLuaSymbol *symbol, cairo_t *cr)
@@ -342,9 +1081,20 @@ ld_lua_private_draw (LdLua *self, LdLuaSymbol *symbol, cairo_t *cr)
 	g_return_if_fail (LD_IS_LUA_SYMBOL (symbol));
 	g_return_if_fail (cr != NULL);
 
+	if (symbol->priv->program)
+	{
+		program_run (symbol->priv->program, cr);
+		return;
+	}
+
+	if (symbol->priv->pending)
+		pending_bind (self, symbol->priv->pending);
+
 	data.symbol = symbol;
 	data.cr = cr;
 	data.save_count = 0;
+	data.program = symbol->priv->dynamic ? NULL : program_new ();
+	data.dynamic = FALSE;
 
 	lua_pushcfunction (self->priv->L, ld_lua_private_draw_cb);
 	lua_pushlightuserdata (self->priv->L, &data);
@@ -352,10 +1102,22 @@ ld_lua_private_draw (LdLua *self, LdLuaSymbol *symbol, cairo_t *cr)
 	{
 		g_warning ("Lua error: %s", lua_tostring (self->priv->L, -1));
 		lua_pop (self->priv->L, 1);
+		data.dynamic = TRUE;
 	}
 
 	while (data.save_count--)
 		cairo_restore (cr);
+
+	if (!data.program)
+		return;
+
+	if (data.dynamic)
+	{
+		program_free (data.program);
+		symbol->priv->dynamic = TRUE;
+	}
+	else
+		symbol->priv->program = data.program;
 }
 
 static int
@@ -389,6 +1151,9 @@ ld_lua_private_draw_cb (lua_State *L)
 	{
 		g_warning ("Lua error: %s", lua_tostring (L, -1));
 		lua_pop (L, 1);
+
+		/* Don't keep a recording of a failed render. */
+		luadata->dynamic = TRUE;
 	}
 
 	/* Copy the userdata back and invalidate it, so that malicious Lua
@@ -412,6 +1177,23 @@ ld_lua_private_unregister (LdLua *self, LdLuaSymbol *symbol)
 	g_return_if_fail (LD_IS_LUA (self));
 	g_return_if_fail (LD_IS_LUA_SYMBOL (symbol));
 
+	if (symbol->priv->program)
+	{
+		program_free (symbol->priv->program);
+		symbol->priv->program = NULL;
+	}
+
+	if (symbol->priv->pending)
+	{
+		LdLuaPending *pending;
+
+		pending = symbol->priv->pending;
+		pending->symbols = g_slist_remove (pending->symbols, symbol);
+		symbol->priv->pending = NULL;
+		pending_unref (pending);
+		return;
+	}
+
 	lua_pushcfunction (self->priv->L, ld_lua_private_unregister_cb);
 	lua_pushlightuserdata (self->priv->L, symbol);
 	if (lua_pcall (self->priv->L, 1, 0, 0))
@@ -445,6 +1227,9 @@ ld_lua_logdiag_register (lua_State *L)
 	lua_pop (L, 1);
 	g_return_val_if_fail (ud != NULL, 0);
 
+	if (ud->rebind)
+		return process_rebinding (L, ud->rebind);
+
 	/* Use a protected environment, so script errors won't cause leaking
 	 * of the symbol object. Only a failure of the last three function calls
 	 * before lua_pcall() may cause the symbol to leak.
@@ -490,8 +1275,9 @@ static int
 process_registration (lua_State *L)
 {
 	LdLuaSymbol *symbol;
+	LdLuaData *ud;
+	JsonObject *names;
 	const gchar *name;
-	gchar *human_name;
 
 	int i, type, types[] =
 		{LUA_TSTRING, LUA_TTABLE, LUA_TTABLE, LUA_TTABLE, LUA_TFUNCTION};
@@ -506,61 +1292,241 @@ process_registration (lua_State *L)
 				" Expected %s, got %s.", i + 1,
 				lua_typename (L, types[i]), lua_typename (L, type));
 
+	/* The table of options is optional. */
+	type = lua_type (L, n_args_needed + 1);
+	if (type != LUA_TNONE && type != LUA_TNIL && type != LUA_TTABLE)
+		return luaL_error (L, "Bad type of argument #%d."
+			" Expected %s, got %s.", n_args_needed + 1,
+			lua_typename (L, LUA_TTABLE), lua_typename (L, type));
+
 	symbol = LD_LUA_SYMBOL (lua_touserdata (L, lua_upvalueindex (1)));
 	name = lua_tostring (L, 1);
 	if (g_strstr_len (name, -1, LD_LIBRARY_IDENTIFIER_SEPARATOR))
 		return luaL_error (L, "Invalid symbol name.");
 	symbol->priv->name = g_strdup (name);
 
-	human_name = get_translation (L, 2);
-	if (!human_name)
-		human_name = g_strdup (symbol->priv->name);
-	symbol->priv->human_name = human_name;
-
 	if (!read_symbol_area (L, 3, &symbol->priv->area))
 		return luaL_error (L, "Malformed symbol area array.");
 	if (!read_terminals (L, 4, &symbol->priv->terminals))
 		return luaL_error (L, "Malformed terminals array.");
 
+	if (type == LUA_TTABLE)
+	{
+		lua_getfield (L, n_args_needed + 1, "dynamic");
+		symbol->priv->dynamic = lua_toboolean (L, -1);
+		lua_pop (L, 1);
+	}
+
+	register_render (L, symbol, 5);
+
+	/* The same rule as for symbols restored from the cache. */
+	names = read_translations (L, 2);
+	symbol->priv->human_name = select_translation (names, name);
+	symbol->priv->human_names = list_translations (names);
+
+	lua_getfield (L, LUA_REGISTRYINDEX, LD_LUA_DATA_INDEX);
+	ud = lua_touserdata (L, -1);
+	lua_pop (L, 1);
+
+	if (ud->record)
+		json_array_add_object_element (ud->record,
+			describe_registration (symbol, names));
+	else
+		json_object_unref (names);
+	return 0;
+}
+
+/*
+ * process_rebinding:
+ * @L: a Lua state.
+ * @pending: symbols waiting for their rendering functions.
+ *
+ * Handle a registration while running a chunk restored from the cache.
+ * Instead of creating a new symbol, the rendering function is handed over
+ * to an already existing one of the same name.
+ */
+static int
+process_rebinding (lua_State *L, LdLuaPending *pending)
+{
+	LdLuaSymbol *symbol;
+	const gchar *name;
+	GSList *iter;
+
+	if (lua_type (L, 1) != LUA_TSTRING || lua_type (L, 5) != LUA_TFUNCTION)
+	{
+		lua_pushboolean (L, FALSE);
+		return 1;
+	}
+
+	name = lua_tostring (L, 1);
+	for (iter = pending->symbols; iter; iter = g_slist_next (iter))
+		if (!strcmp (name, LD_LUA_SYMBOL (iter->data)->priv->name))
+			break;
+
+	if (!iter)
+	{
+		lua_pushboolean (L, FALSE);
+		return 1;
+	}
+
+	symbol = LD_LUA_SYMBOL (iter->data);
+	pending->symbols = g_slist_delete_link (pending->symbols, iter);
+	symbol->priv->pending = NULL;
+	pending_unref (pending);
+
+	register_render (L, symbol, 5);
+	lua_pushboolean (L, TRUE);
+	return 1;
+}
+
+/*
+ * register_render:
+ * @L: a Lua state.
+ * @symbol: the symbol to register the function for.
+ * @index: stack index of the rendering function.
+ *
+ * Store the rendering function of a symbol in the registry.
+ */
+static void
+register_render (lua_State *L, LdLuaSymbol *symbol, int index)
+{
+	index = lua_absindex (L, index);
+
 	lua_getfield (L, LUA_REGISTRYINDEX, LD_LUA_SYMBOLS_INDEX);
 	lua_pushlightuserdata (L, symbol);
 
 	lua_newtable (L);
-	lua_pushvalue (L, 5);
+	lua_pushvalue (L, index);
 	lua_setfield (L, -2, "render");
 
 	lua_settable (L, -3);
-	return 0;
+	lua_pop (L, 1);
 }
 
 /*
- * get_translation:
+ * describe_registration:
+ * @symbol: the symbol that has just been registered.
+ * @names: (transfer full): all translations of its name.
+ *
+ * Describe a symbol for the cache.
+ *
+ * Return value: a new #JsonObject.
+ */
+static JsonObject *
+describe_registration (LdLuaSymbol *symbol, JsonObject *names)
+{
+	JsonObject *object;
+	JsonArray *area, *terminals, *point;
+	guint i;
+
+	area = json_array_sized_new (4);
+	json_array_add_double_element (area, symbol->priv->area.x);
+	json_array_add_double_element (area, symbol->priv->area.y);
+	json_array_add_double_element (area, symbol->priv->area.width);
+	json_array_add_double_element (area, symbol->priv->area.height);
+
+	terminals = json_array_sized_new (symbol->priv->terminals->length);
+	for (i = 0; i < symbol->priv->terminals->length; i++)
+	{
+		point = json_array_sized_new (2);
+		json_array_add_double_element (point,
+			symbol->priv->terminals->points[i].x);
+		json_array_add_double_element (point,
+			symbol->priv->terminals->points[i].y);
+		json_array_add_array_element (terminals, point);
+	}
+
+	object = json_object_new ();
+	json_object_set_string_member (object, "name", symbol->priv->name);
+	json_object_set_object_member (object, "names", names);
+	json_object_set_array_member (object, "area", area);
+	json_object_set_array_member (object, "terminals", terminals);
+	json_object_set_boolean_member (object, "dynamic", symbol->priv->dynamic);
+	return object;
+}
+
+/*
+ * read_translations:
  * @L: a Lua state.
  * @index: stack index of the table.
  *
- * Select an applicable translation from a table.
+ * Read all translations from a table indexed by language names.
+ *
+ * Return value: a new #JsonObject.
+ */
+static JsonObject *
+read_translations (lua_State *L, int index)
+{
+	JsonObject *names;
+
+	index = lua_absindex (L, index);
+	names = json_object_new ();
+
+	lua_pushnil (L);
+	while (lua_next (L, index))
+	{
+		/* Converting the key in place would confuse lua_next(). */
+		if (lua_type (L, -2) == LUA_TSTRING && lua_isstring (L, -1))
+			json_object_set_string_member (names,
+				lua_tostring (L, -2), lua_tostring (L, -1));
+		lua_pop (L, 1);
+	}
+	return names;
+}
+
+/*
+ * select_translation:
+ * @names: translations indexed by language names.
+ * @fallback: what to return when there's no applicable translation.
+ *
+ * Select an applicable translation.
  * The return value has to be freed with g_free().
  *
- * Return value: the translation, if found. If none was found, returns %NULL.
+ * Return value: the translation, or a copy of @fallback.
  */
 static gchar *
-get_translation (lua_State *L, int index)
+select_translation (JsonObject *names, const gchar *fallback)
 {
 	const gchar *const *lang;
-	gchar *result;
+	JsonNode *node;
 
 	for (lang = g_get_language_names (); *lang; lang++)
 	{
-		lua_getfield (L, 2, *lang);
-		if (lua_isstring (L, -1))
-		{
-			result = g_strdup (lua_tostring (L, -1));
-			lua_pop (L, 1);
-			return result;
-		}
-		lua_pop (L, 1);
+		node = json_object_get_member (names, *lang);
+		if (node && JSON_NODE_HOLDS_VALUE (node)
+		 && json_node_get_value_type (node) == G_TYPE_STRING)
+			return g_strdup (json_node_get_string (node));
+	}
+	return g_strdup (fallback);
+}
+
+/*
+ * list_translations:
+ * @names: translations indexed by language names.
+ *
+ * Return value: a %NULL-terminated array of all translations, so that
+ *               symbols can be searched for in any language.
+ */
+static gchar **
+list_translations (JsonObject *names)
+{
+	GList *members, *iter;
+	GPtrArray *result;
+	JsonNode *node;
+
+	result = g_ptr_array_new ();
+	members = json_object_get_members (names);
+	for (iter = members; iter; iter = g_list_next (iter))
+	{
+		node = json_object_get_member (names, iter->data);
+		if (JSON_NODE_HOLDS_VALUE (node)
+		 && json_node_get_value_type (node) == G_TYPE_STRING)
+			g_ptr_array_add (result, g_strdup (json_node_get_string (node)));
 	}
-	return NULL;
+	g_list_free (members);
+
+	g_ptr_array_add (result, NULL);
+	return (gchar **) g_ptr_array_free (result, FALSE);
 }
 
 /*
@@ -661,6 +1627,190 @@ read_terminals_fail:
 }
 
 
+/* ===== Recorded programs ================================================= */
+
+static LdLuaProgram *
+program_new (void)
+{
+	LdLuaProgram *self;
+
+	self = g_slice_new (LdLuaProgram);
+	self->ops = g_byte_array_new ();
+	self->args = g_array_new (FALSE, FALSE, sizeof (gdouble));
+	self->texts = g_ptr_array_new_with_free_func (g_free);
+	return self;
+}
+
+static void
+program_free (LdLuaProgram *self)
+{
+	g_byte_array_unref (self->ops);
+	g_array_unref (self->args);
+	g_ptr_array_unref (self->texts);
+	g_slice_free (LdLuaProgram, self);
+}
+
+/*
+ * program_add:
+ * @data: drawing data of the render function.
+ * @op: the operation.
+ * @n_args: the number of numeric arguments.
+ * @...: the arguments as doubles.
+ *
+ * Record an operation, if recording at all.
+ */
+static void
+program_add (LdLuaDrawData *data, LdLuaOp op, gint n_args, ...)
+{
+	guint8 code;
+	gdouble arg;
+	va_list ap;
+
+	if (!data->program)
+		return;
+
+	code = op;
+	g_byte_array_append (data->program->ops, &code, 1);
+
+	va_start (ap, n_args);
+	while (n_args--)
+	{
+		arg = va_arg (ap, gdouble);
+		g_array_append_val (data->program->args, arg);
+	}
+	va_end (ap);
+}
+
+/*
+ * program_add_text:
+ *
+ * Record showing text, if recording at all.
+ */
+static void
+program_add_text (LdLuaDrawData *data, const gchar *text)
+{
+	if (!data->program)
+		return;
+
+	program_add (data, LD_LUA_OP_SHOW_TEXT, 0);
+	g_ptr_array_add (data->program->texts, g_strdup (text));
+}
+
+/*
+ * program_run:
+ * @self: a recorded program.
+ * @cr: a Cairo context to draw onto.
+ *
+ * Replay the operations of a render function.
+ */
+static void
+program_run (LdLuaProgram *self, cairo_t *cr)
+{
+	const gdouble *arg;
+	guint i, text = 0;
+	unsigned save_count = 0;
+	gdouble scale = 0;
+	gboolean scale_valid = FALSE;
+
+	arg = (const gdouble *) self->args->data;
+	for (i = 0; i < self->ops->len; i++)
+	{
+		switch (self->ops->data[i])
+		{
+		case LD_LUA_OP_SAVE:
+			save_count++;
+			cairo_save (cr);
+			break;
+		case LD_LUA_OP_RESTORE:
+			save_count--;
+			cairo_restore (cr);
+			scale_valid = FALSE;
+			break;
+		case LD_LUA_OP_SET_LINE_WIDTH:
+			/* Only transformations change the scale. */
+			if (!scale_valid)
+			{
+				scale = get_cairo_scale (cr);
+				scale_valid = TRUE;
+			}
+			cairo_set_line_width (cr, arg[0] / scale);
+			arg += 1;
+			break;
+		case LD_LUA_OP_TRANSLATE:
+			cairo_translate (cr, arg[0], arg[1]);
+			arg += 2;
+			break;
+		case LD_LUA_OP_SCALE:
+			cairo_scale (cr, arg[0], arg[1]);
+			scale_valid = FALSE;
+			arg += 2;
+			break;
+		case LD_LUA_OP_ROTATE:
+			cairo_rotate (cr, arg[0]);
+			scale_valid = FALSE;
+			arg += 1;
+			break;
+		case LD_LUA_OP_MOVE_TO:
+			cairo_move_to (cr, arg[0], arg[1]);
+			arg += 2;
+			break;
+		case LD_LUA_OP_LINE_TO:
+			cairo_line_to (cr, arg[0], arg[1]);
+			arg += 2;
+			break;
+		case LD_LUA_OP_CURVE_TO:
+			cairo_curve_to (cr, arg[0], arg[1], arg[2], arg[3], arg[4], arg[5]);
+			arg += 6;
+			break;
+		case LD_LUA_OP_ARC:
+			cairo_arc (cr, arg[0], arg[1], arg[2], arg[3], arg[4]);
+			arg += 5;
+			break;
+		case LD_LUA_OP_ARC_NEGATIVE:
+			cairo_arc_negative (cr, arg[0], arg[1], arg[2], arg[3], arg[4]);
+			arg += 5;
+			break;
+		case LD_LUA_OP_NEW_PATH:
+			cairo_new_path (cr);
+			break;
+		case LD_LUA_OP_NEW_SUB_PATH:
+			cairo_new_sub_path (cr);
+			break;
+		case LD_LUA_OP_CLOSE_PATH:
+			cairo_close_path (cr);
+			break;
+		case LD_LUA_OP_STROKE:
+			cairo_stroke (cr);
+			break;
+		case LD_LUA_OP_STROKE_PRESERVE:
+			cairo_stroke_preserve (cr);
+			break;
+		case LD_LUA_OP_FILL:
+			cairo_fill (cr);
+			break;
+		case LD_LUA_OP_FILL_PRESERVE:
+			cairo_fill_preserve (cr);
+			break;
+		case LD_LUA_OP_CLIP:
+			cairo_clip (cr);
+			break;
+		case LD_LUA_OP_CLIP_PRESERVE:
+			cairo_clip_preserve (cr);
+			break;
+		case LD_LUA_OP_SHOW_TEXT:
+			show_text (cr, get_text_layout
+				(g_ptr_array_index (self->texts, text++)));
+			break;
+		default:
+			g_assert_not_reached ();
+		}
+	}
+
+	while (save_count--)
+		cairo_restore (cr);
+}
+
+
 /* ===== Cairo ============================================================= */
 
 static gdouble
@@ -672,6 +1822,93 @@ get_cairo_scale (cairo_t *cr)
 	return dx;
 }
 
+static GPrivate text_cache_key = G_PRIVATE_INIT
+	((GDestroyNotify) text_cache_free);
+
+static void
+text_cache_free (LdLuaTextCache *cache)
+{
+	g_hash_table_destroy (cache->layouts);
+	pango_font_description_free (cache->font_desc);
+	g_object_unref (cache->context);
+	g_slice_free (LdLuaTextCache, cache);
+}
+
+/*
+ * get_text_layout:
+ * @text: the text to be shown.
+ *
+ * Retrieve a layout for the text from the cache of the current thread.
+ * Layouts are only shaped anew when the transformation changes.
+ *
+ * Return value: (transfer none): a layout.
+ */
+static PangoLayout *
+get_text_layout (const gchar *text)
+{
+	LdLuaTextCache *cache;
+	PangoLayout *layout;
+
+	cache = g_private_get (&text_cache_key);
+	if (!cache)
+	{
+		GtkStyleContext *style;
+		const PangoFontDescription *orig_font_desc;
+
+		cache = g_slice_new (LdLuaTextCache);
+		cache->context = pango_font_map_create_context
+			(pango_cairo_font_map_get_default ());
+		cache->layouts = g_hash_table_new_full (g_str_hash, g_str_equal,
+			g_free, g_object_unref);
+
+		style = gtk_style_context_new ();
+		gtk_style_context_get (style, GTK_STATE_FLAG_NORMAL,
+			GTK_STYLE_PROPERTY_FONT, &orig_font_desc, NULL);
+		cache->font_desc = pango_font_description_copy (orig_font_desc);
+		pango_font_description_set_size (cache->font_desc, 1 * PANGO_SCALE);
+		g_object_unref (style);
+
+		g_private_set (&text_cache_key, cache);
+	}
+
+	layout = g_hash_table_lookup (cache->layouts, text);
+	if (layout)
+		return layout;
+
+	if (g_hash_table_size (cache->layouts) >= LD_LUA_TEXT_CACHE_MAX)
+		g_hash_table_remove_all (cache->layouts);
+
+	layout = pango_layout_new (cache->context);
+	pango_layout_set_text (layout, text, -1);
+	pango_layout_set_font_description (layout, cache->font_desc);
+
+	g_hash_table_insert (cache->layouts, g_strdup (text), layout);
+	return layout;
+}
+
+/*
+ * show_text:
+ *
+ * Show a layout centred around the current point.
+ */
+static void
+show_text (cairo_t *cr, PangoLayout *layout)
+{
+	int width, height;
+	double x, y;
+
+	pango_cairo_update_layout (cr, layout);
+	pango_layout_get_size (layout, &width, &height);
+	cairo_get_current_point (cr, &x, &y);
+	x -= (double) width  / PANGO_SCALE / 2;
+	y -= (double) height / PANGO_SCALE / 2;
+
+	cairo_save (cr);
+	cairo_move_to (cr, x, y);
+	pango_cairo_show_layout (cr, layout);
+	cairo_restore (cr);
+}
+
 #define LD_LUA_CAIRO_GET_DATA \
 	data = luaL_checkudata (L, 1, LD_LUA_META_INDEX); \
 	if (!data->cr) \
@@ -687,22 +1924,23 @@ ld_lua_cairo_ ## name (lua_State *L) \
 	return (n_values); \
 }
 
-#define LD_LUA_CAIRO_TRIVIAL(name) \
+#define LD_LUA_CAIRO_TRIVIAL(name, op) \
 LD_LUA_CAIRO_BEGIN (name) \
 	LD_LUA_CAIRO_GET_DATA \
 	cairo_ ## name (data->cr); \
+	program_add (data, LD_LUA_OP_ ## op, 0); \
 LD_LUA_CAIRO_END (0)
 
-LD_LUA_CAIRO_TRIVIAL (new_path)
-LD_LUA_CAIRO_TRIVIAL (new_sub_path)
-LD_LUA_CAIRO_TRIVIAL (close_path)
+LD_LUA_CAIRO_TRIVIAL (new_path, NEW_PATH)
+LD_LUA_CAIRO_TRIVIAL (new_sub_path, NEW_SUB_PATH)
+LD_LUA_CAIRO_TRIVIAL (close_path, CLOSE_PATH)
 
-LD_LUA_CAIRO_TRIVIAL (stroke)
-LD_LUA_CAIRO_TRIVIAL (stroke_preserve)
-LD_LUA_CAIRO_TRIVIAL (fill)
-LD_LUA_CAIRO_TRIVIAL (fill_preserve)
-LD_LUA_CAIRO_TRIVIAL (clip)
-LD_LUA_CAIRO_TRIVIAL (clip_preserve)
+LD_LUA_CAIRO_TRIVIAL (stroke, STROKE)
+LD_LUA_CAIRO_TRIVIAL (stroke_preserve, STROKE_PRESERVE)
+LD_LUA_CAIRO_TRIVIAL (fill, FILL)
+LD_LUA_CAIRO_TRIVIAL (fill_preserve, FILL_PRESERVE)
+LD_LUA_CAIRO_TRIVIAL (clip, CLIP)
+LD_LUA_CAIRO_TRIVIAL (clip_preserve, CLIP_PRESERVE)
 
 LD_LUA_CAIRO_BEGIN (save)
 	LD_LUA_CAIRO_GET_DATA
@@ -710,6 +1948,7 @@ LD_LUA_CAIRO_BEGIN (save)
 	{
 		data->save_count++;
 		cairo_save (data->cr);
+		program_add (data, LD_LUA_OP_SAVE, 0);
 	}
 LD_LUA_CAIRO_END (0)
 
@@ -719,6 +1958,7 @@ LD_LUA_CAIRO_BEGIN (restore)
 	{
 		data->save_count--;
 		cairo_restore (data->cr);
+		program_add (data, LD_LUA_OP_RESTORE, 0);
 	}
 LD_LUA_CAIRO_END (0)
 
@@ -726,12 +1966,19 @@ LD_LUA_CAIRO_BEGIN (get_line_width)
 	LD_LUA_CAIRO_GET_DATA
 	lua_pushnumber (L, cairo_get_line_width (data->cr)
 		* get_cairo_scale (data->cr));
+
+	/* The script may depend on the context, we can't record that. */
+	data->dynamic = TRUE;
 LD_LUA_CAIRO_END (1)
 
 LD_LUA_CAIRO_BEGIN (set_line_width)
+	lua_Number width;
+
 	LD_LUA_CAIRO_GET_DATA
-	cairo_set_line_width (data->cr, luaL_checknumber (L, 2)
-		/ get_cairo_scale (data->cr));
+	width = luaL_checknumber (L, 2);
+
+	cairo_set_line_width (data->cr, width / get_cairo_scale (data->cr));
+	program_add (data, LD_LUA_OP_SET_LINE_WIDTH, 1, (gdouble) width);
 LD_LUA_CAIRO_END (0)
 
 LD_LUA_CAIRO_BEGIN (translate)
@@ -742,6 +1989,7 @@ LD_LUA_CAIRO_BEGIN (translate)
 	y = luaL_checknumber (L, 3);
 
 	cairo_translate (data->cr, x, y);
+	program_add (data, LD_LUA_OP_TRANSLATE, 2, (gdouble) x, (gdouble) y);
 LD_LUA_CAIRO_END (0)
 
 LD_LUA_CAIRO_BEGIN (scale)
@@ -752,6 +2000,7 @@ LD_LUA_CAIRO_BEGIN (scale)
 	sy = luaL_checknumber (L, 3);
 
 	cairo_scale (data->cr, sx, sy);
+	program_add (data, LD_LUA_OP_SCALE, 2, (gdouble) sx, (gdouble) sy);
 LD_LUA_CAIRO_END (0)
 
 LD_LUA_CAIRO_BEGIN (rotate)
@@ -760,6 +2009,7 @@ LD_LUA_CAIRO_BEGIN (rotate)
 	LD_LUA_CAIRO_GET_DATA
 	angle = luaL_checknumber (L, 2);
 	cairo_rotate (data->cr, angle);
+	program_add (data, LD_LUA_OP_ROTATE, 1, (gdouble) angle);
 LD_LUA_CAIRO_END (0)
 
 LD_LUA_CAIRO_BEGIN (move_to)
@@ -770,6 +2020,7 @@ LD_LUA_CAIRO_BEGIN (move_to)
 	y = luaL_checknumber (L, 3);
 
 	cairo_move_to (data->cr, x, y);
+	program_add (data, LD_LUA_OP_MOVE_TO, 2, (gdouble) x, (gdouble) y);
 LD_LUA_CAIRO_END (0)
 
 LD_LUA_CAIRO_BEGIN (line_to)
@@ -780,6 +2031,7 @@ LD_LUA_CAIRO_BEGIN (line_to)
 	y = luaL_checknumber (L, 3);
 
 	cairo_line_to (data->cr, x, y);
+	program_add (data, LD_LUA_OP_LINE_TO, 2, (gdouble) x, (gdouble) y);
 LD_LUA_CAIRO_END (0)
 
 LD_LUA_CAIRO_BEGIN (curve_to)
@@ -794,6 +2046,9 @@ LD_LUA_CAIRO_BEGIN (curve_to)
 	y3 = luaL_checknumber (L, 7);
 
 	cairo_curve_to (data->cr, x1, y1, x2, y2, x3, y3);
+	program_add (data, LD_LUA_OP_CURVE_TO, 6,
+		(gdouble) x1, (gdouble) y1, (gdouble) x2, (gdouble) y2,
+		(gdouble) x3, (gdouble) y3);
 LD_LUA_CAIRO_END (0)
 
 LD_LUA_CAIRO_BEGIN (arc)
@@ -807,6 +2062,9 @@ LD_LUA_CAIRO_BEGIN (arc)
 	angle2 = luaL_checknumber (L, 6);
 
 	cairo_arc (data->cr, xc, yc, radius, angle1, angle2);
+	program_add (data, LD_LUA_OP_ARC, 5,
+		(gdouble) xc, (gdouble) yc, (gdouble) radius,
+		(gdouble) angle1, (gdouble) angle2);
 LD_LUA_CAIRO_END (0)
 
 LD_LUA_CAIRO_BEGIN (arc_negative)
@@ -820,41 +2078,17 @@ LD_LUA_CAIRO_BEGIN (arc_negative)
 	angle2 = luaL_checknumber (L, 6);
 
 	cairo_arc_negative (data->cr, xc, yc, radius, angle1, angle2);
+	program_add (data, LD_LUA_OP_ARC_NEGATIVE, 5,
+		(gdouble) xc, (gdouble) yc, (gdouble) radius,
+		(gdouble) angle1, (gdouble) angle2);
 LD_LUA_CAIRO_END (0)
 
 LD_LUA_CAIRO_BEGIN (show_text)
-	const char *text;
-	GtkStyleContext *style;
-	const PangoFontDescription *orig_font_desc;
-	PangoFontDescription *font_desc;
-	PangoLayout *layout;
-	int width, height;
-	double x, y;
+	const gchar *text;
 
 	LD_LUA_CAIRO_GET_DATA
 	text = luaL_checkstring (L, 2);
 
-	layout = pango_cairo_create_layout (data->cr);
-	pango_layout_set_text (layout, text, -1);
-
-	style = gtk_style_context_new ();
-	gtk_style_context_get (style, GTK_STATE_FLAG_NORMAL,
-		GTK_STYLE_PROPERTY_FONT, &orig_font_desc, NULL);
-	font_desc = pango_font_description_copy (orig_font_desc);
-	pango_font_description_set_size (font_desc, 1 * PANGO_SCALE);
-	pango_layout_set_font_description (layout, font_desc);
-	pango_font_description_free (font_desc);
-	g_object_unref (style);
-
-	pango_layout_get_size (layout, &width, &height);
-	cairo_get_current_point (data->cr, &x, &y);
-	x -= (double) width  / PANGO_SCALE / 2;
-	y -= (double) height / PANGO_SCALE / 2;
-
-	cairo_save (data->cr);
-	cairo_move_to (data->cr, x, y);
-	pango_cairo_show_layout (data->cr, layout);
-	cairo_restore (data->cr);
-
-	g_object_unref (layout);
+	show_text (data->cr, get_text_layout (text));
+	program_add_text (data, text);
 LD_LUA_CAIRO_END (0)
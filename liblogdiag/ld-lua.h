@@ -61,6 +61,11 @@ gboolean ld_lua_check_file (LdLua *self, const gchar *filename);
 gboolean ld_lua_load_file (LdLua *self, const gchar *filename,
 	LdLuaLoadCallback callback, gpointer user_data);
 
+gboolean ld_lua_load_cache (LdLua *self, const gchar *filename,
+	GError **error);
+gboolean ld_lua_save_cache (LdLua *self, const gchar *filename,
+	GError **error);
+
 
 G_END_DECLS
 
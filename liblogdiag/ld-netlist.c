@@ -0,0 +1,1149 @@
+/*
+ * ld-netlist.c
+ *
+ * This file is a part of logdiag.
+ * Copyright 2026 Přemysl Eric Janouch
+ *
+ * See the file LICENSE for licensing information.
+ *
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include "liblogdiag.h"
+#include "config.h"
+
+
+/**
+ * SECTION:ld-netlist
+ * @short_description: Connectivity of a diagram
+ * @see_also: #LdDiagram, #LdLibrary
+ *
+ * #LdNetlist finds out which terminals of symbols in an #LdDiagram are
+ * joined by connections.  Terminals and connections that share a point
+ * belong to the same net, except for two connections merely crossing
+ * at their interior points.  Only the vertices of a connection count,
+ * so a terminal lying on the inside of a segment isn't joined with it;
+ * connections are drawn and routed between terminals, so they end there
+ * anyway.  Terminals of single-terminal symbols with
+ * the same label belong to the same net as well, and nets are named after
+ * their labels.  Labels on symbols with more terminals are ignored,
+ * as it isn't clear which of them they would apply to.
+ *
+ * Points are kept in a hash table and nets in a disjoint-set forest.
+ * The netlist follows changes to the diagram as they happen and only
+ * the nets that an object has been a part of are rebuilt when it moves
+ * or goes away.
+ */
+
+/* Points closer than this are considered to be the same. */
+#define POINT_QUANTUM 1e-3
+
+/* Characters besides alphanumerics that can be a part of a SPICE name. */
+#define SPICE_NAME_CHARS "_-+./:"
+
+typedef struct _Node Node;
+
+/*
+ * Key:
+ *
+ * A quantized point.
+ */
+typedef struct
+{
+	gint64 x, y;
+}
+Key;
+
+/*
+ * Pin:
+ *
+ * A point where a node can be joined with other nodes.
+ */
+typedef struct
+{
+	Key key;                 /* Where the pin is. */
+	gboolean interior;       /* Whether it's an interior point of a wire. */
+	Node *node;              /* The node the pin belongs to. */
+}
+Pin;
+
+/*
+ * Node:
+ *
+ * Either a terminal of a symbol or a whole connection.
+ */
+struct _Node
+{
+	Node *parent;            /* Parent in the forest, itself for roots. */
+	guint rank;              /* Upper bound on the height of the subtree. */
+	Node *next;              /* Next node of the same net, circular. */
+
+	LdDiagramObject *object; /* The object the node belongs to. */
+	gint terminal;           /* Index of the terminal, -1 for connections. */
+	const gchar *label;      /* Label of the symbol, owned by ObjectData. */
+	Pin *pins;               /* Pins of the node. */
+	guint n_pins;            /* The number of pins. */
+};
+
+/*
+ * Cell:
+ *
+ * All pins at a point.
+ */
+typedef struct
+{
+	Key key;                 /* The point. */
+	GPtrArray *pins;         /* (element-type Pin *): pins at the point. */
+}
+Cell;
+
+/*
+ * ObjectData:
+ *
+ * Nodes of a diagram object.
+ */
+typedef struct
+{
+	LdDiagramObject *object; /* The object, ref'ed. */
+	GPtrArray *nodes;        /* (element-type Node *): nodes of the object. */
+	gchar *label;            /* Label of the symbol, if any. */
+}
+ObjectData;
+
+/*
+ * LdNetlistPrivate:
+ * @diagram: the diagram whose connectivity is being followed.
+ * @library: the library to retrieve terminals of symbols from.
+ * @objects: (element-type LdDiagramObject * ObjectData *): tracked objects.
+ * @cells: (element-type Key * Cell *): all pins, by their position.
+ * @labels: (element-type gchar * GPtrArray *): labelled nodes, by label.
+ * @n_nets: the current number of nets.
+ */
+struct _LdNetlistPrivate
+{
+	LdDiagram *diagram;
+	LdLibrary *library;
+	GHashTable *objects;
+	GHashTable *cells;
+	GHashTable *labels;
+	guint n_nets;
+};
+
+static void ld_netlist_finalize (GObject *gobject);
+
+static guint key_hash (gconstpointer key);
+static gboolean key_equal (gconstpointer a, gconstpointer b);
+static void cell_free (Cell *cell);
+
+static Node *node_find (Node *node);
+static void node_union (LdNetlist *self, Node *a, Node *b);
+static Node *node_new (LdNetlist *self, LdDiagramObject *object,
+	gint terminal, guint n_pins);
+static void node_join (LdNetlist *self, Node *node);
+static void node_free (Node *node);
+
+static void add_object (LdNetlist *self, LdDiagramObject *object);
+static void remove_object (LdNetlist *self, LdDiagramObject *object);
+static void link_object (LdNetlist *self, ObjectData *data);
+static void unlink_object (LdNetlist *self, ObjectData *data);
+static Node *get_node (LdNetlist *self,
+	LdDiagramObject *object, gint terminal);
+
+static GHashTable *number_nets (LdNetlist *self);
+static GPtrArray *name_nets (LdNetlist *self, GHashTable *numbers,
+	GPtrArray **aliases);
+static gint compare_labels (gconstpointer a, gconstpointer b);
+static gboolean is_spice_name (const gchar *name);
+static gchar *make_spice_name (const gchar *name);
+
+static void on_object_inserted (LdDiagram *diagram,
+	LdDiagramObject *object, LdNetlist *self);
+static void on_object_removed (LdDiagram *diagram,
+	LdDiagramObject *object, LdNetlist *self);
+static void on_object_notify (LdDiagramObject *object,
+	GParamSpec *pspec, LdNetlist *self);
+static void on_symbol_changed (LdLibrary *library,
+	const gchar *identifier, LdNetlist *self);
+
+
+G_DEFINE_TYPE (LdNetlist, ld_netlist, G_TYPE_OBJECT)
+
+static void
+ld_netlist_class_init (LdNetlistClass *klass)
+{
+	GObjectClass *object_class;
+
+	object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = ld_netlist_finalize;
+
+/**
+ * LdNetlist::changed:
+ * @self: an #LdNetlist object.
+ *
+ * Nets may have changed.
+ */
+	klass->changed_signal = g_signal_new
+		("changed", G_TYPE_FROM_CLASS (klass),
+		G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+		g_cclosure_marshal_VOID__VOID, G_TYPE_NONE, 0);
+
+	g_type_class_add_private (klass, sizeof (LdNetlistPrivate));
+}
+
+static void
+ld_netlist_init (LdNetlist *self)
+{
+	self->priv = G_TYPE_INSTANCE_GET_PRIVATE
+		(self, LD_TYPE_NETLIST, LdNetlistPrivate);
+
+	self->priv->objects = g_hash_table_new (g_direct_hash, g_direct_equal);
+	self->priv->cells = g_hash_table_new_full (key_hash, key_equal,
+		NULL, (GDestroyNotify) cell_free);
+	self->priv->labels = g_hash_table_new_full (g_str_hash, g_str_equal,
+		g_free, (GDestroyNotify) g_ptr_array_unref);
+}
+
+static void
+ld_netlist_finalize (GObject *gobject)
+{
+	LdNetlist *self;
+	GList *objects, *iter;
+
+	self = LD_NETLIST (gobject);
+
+	g_signal_handlers_disconnect_by_func (self->priv->diagram,
+		on_object_inserted, self);
+	g_signal_handlers_disconnect_by_func (self->priv->diagram,
+		on_object_removed, self);
+	g_signal_handlers_disconnect_by_func (self->priv->library,
+		on_symbol_changed, self);
+
+	objects = g_hash_table_get_keys (self->priv->objects);
+	for (iter = objects; iter; iter = g_list_next (iter))
+		remove_object (self, iter->data);
+	g_list_free (objects);
+
+	g_hash_table_destroy (self->priv->objects);
+	g_hash_table_destroy (self->priv->cells);
+	g_hash_table_destroy (self->priv->labels);
+	g_object_unref (self->priv->diagram);
+	g_object_unref (self->priv->library);
+
+	/* Chain up to the parent class. */
+	G_OBJECT_CLASS (ld_netlist_parent_class)->finalize (gobject);
+}
+
+/**
+ * ld_netlist_new:
+ * @diagram: the diagram to follow.
+ * @library: the library to retrieve terminals of symbols from.
+ *
+ * Create an instance and find nets in the diagram.
+ */
+LdNetlist *
+ld_netlist_new (LdDiagram *diagram, LdLibrary *library)
+{
+	LdNetlist *self;
+	GList *iter;
+
+	g_return_val_if_fail (LD_IS_DIAGRAM (diagram), NULL);
+	g_return_val_if_fail (LD_IS_LIBRARY (library), NULL);
+
+	self = g_object_new (LD_TYPE_NETLIST, NULL);
+	self->priv->diagram = g_object_ref (diagram);
+	self->priv->library = g_object_ref (library);
+
+	for (iter = ld_diagram_get_objects (diagram); iter;
+		iter = g_list_next (iter))
+		add_object (self, iter->data);
+
+	g_signal_connect (diagram, "object-inserted",
+		G_CALLBACK (on_object_inserted), self);
+	g_signal_connect (diagram, "object-removed",
+		G_CALLBACK (on_object_removed), self);
+	g_signal_connect (library, "symbol-changed",
+		G_CALLBACK (on_symbol_changed), self);
+	return self;
+}
+
+/* ===== Points ============================================================ */
+
+static void
+key_init (Key *key, const LdPoint *point)
+{
+	key->x = (gint64) floor (point->x / POINT_QUANTUM + 0.5);
+	key->y = (gint64) floor (point->y / POINT_QUANTUM + 0.5);
+}
+
+static guint
+key_hash (gconstpointer key)
+{
+	const Key *k = key;
+	return (guint) (k->x * 73856093) ^ (guint) (k->y * 19349663);
+}
+
+static gboolean
+key_equal (gconstpointer a, gconstpointer b)
+{
+	const Key *ka = a, *kb = b;
+	return ka->x == kb->x && ka->y == kb->y;
+}
+
+static void
+cell_free (Cell *cell)
+{
+	g_ptr_array_free (cell->pins, TRUE);
+	g_slice_free (Cell, cell);
+}
+
+/* ===== Nodes ============================================================= */
+
+static Node *
+node_find (Node *node)
+{
+	Node *root, *next;
+
+	for (root = node; root->parent != root; root = root->parent)
+		;
+
+	/* Compress the path on the way. */
+	for (; node != root; node = next)
+	{
+		next = node->parent;
+		node->parent = root;
+	}
+	return root;
+}
+
+static void
+node_union (LdNetlist *self, Node *a, Node *b)
+{
+	Node *temp;
+
+	a = node_find (a);
+	b = node_find (b);
+	if (a == b)
+		return;
+
+	if (a->rank < b->rank)
+	{
+		temp = a;
+		a = b;
+		b = temp;
+	}
+	b->parent = a;
+	if (a->rank == b->rank)
+		a->rank++;
+
+	/* Swapping successors of nodes from two circles joins them. */
+	temp = a->next;
+	a->next = b->next;
+	b->next = temp;
+
+	self->priv->n_nets--;
+}
+
+static Node *
+node_new (LdNetlist *self, LdDiagramObject *object,
+	gint terminal, guint n_pins)
+{
+	Node *node;
+	guint i;
+
+	node = g_slice_new (Node);
+	node->parent = node;
+	node->rank = 0;
+	node->next = node;
+	node->object = object;
+	node->terminal = terminal;
+	node->label = NULL;
+	node->pins = g_new0 (Pin, n_pins);
+	node->n_pins = n_pins;
+
+	for (i = 0; i < n_pins; i++)
+		node->pins[i].node = node;
+
+	self->priv->n_nets++;
+	return node;
+}
+
+/*
+ * node_join:
+ *
+ * Join a node with everything that shares a point with it.
+ */
+static void
+node_join (LdNetlist *self, Node *node)
+{
+	guint i, k;
+
+	for (i = 0; i < node->n_pins; i++)
+	{
+		Pin *pin;
+		Cell *cell;
+
+		pin = &node->pins[i];
+		cell = g_hash_table_lookup (self->priv->cells, &pin->key);
+		for (k = 0; k < cell->pins->len; k++)
+		{
+			Pin *other;
+
+			other = g_ptr_array_index (cell->pins, k);
+			if (other->node != node
+			 && !(pin->interior && other->interior))
+				node_union (self, node, other->node);
+		}
+	}
+
+	if (node->label)
+	{
+		GPtrArray *group;
+
+		group = g_hash_table_lookup (self->priv->labels, node->label);
+		for (k = 0; k < group->len; k++)
+			node_union (self, node, g_ptr_array_index (group, k));
+	}
+}
+
+static void
+node_free (Node *node)
+{
+	g_free (node->pins);
+	g_slice_free (Node, node);
+}
+
+/* ===== Objects =========================================================== */
+
+static void
+add_object (LdNetlist *self, LdDiagramObject *object)
+{
+	ObjectData *data;
+
+	if (g_hash_table_lookup (self->priv->objects, object))
+		return;
+
+	data = g_slice_new (ObjectData);
+	data->object = g_object_ref (object);
+	data->nodes = g_ptr_array_new ();
+	data->label = NULL;
+	g_hash_table_insert (self->priv->objects, object, data);
+
+	/* Unlike "changed", this is also emitted on undo and redo. */
+	g_signal_connect (object, "notify",
+		G_CALLBACK (on_object_notify), self);
+	link_object (self, data);
+}
+
+static void
+remove_object (LdNetlist *self, LdDiagramObject *object)
+{
+	ObjectData *data;
+
+	data = g_hash_table_lookup (self->priv->objects, object);
+	if (!data)
+		return;
+
+	unlink_object (self, data);
+	g_signal_handlers_disconnect_by_func (object, on_object_notify, self);
+	g_hash_table_remove (self->priv->objects, object);
+
+	g_ptr_array_free (data->nodes, TRUE);
+	g_object_unref (data->object);
+	g_slice_free (ObjectData, data);
+}
+
+static void
+add_symbol_nodes (LdNetlist *self, ObjectData *data)
+{
+	LdDiagramSymbol *diagram_symbol;
+	const LdPointArray *terminals;
+	LdSymbol *symbol;
+	gchar *klass;
+	guint i;
+
+	diagram_symbol = LD_DIAGRAM_SYMBOL (data->object);
+	data->label = g_strdup (ld_diagram_symbol_get_label (diagram_symbol));
+
+	klass = ld_diagram_symbol_get_class (diagram_symbol);
+	symbol = ld_library_find_symbol (self->priv->library, klass);
+	g_free (klass);
+	if (!symbol)
+		return;
+
+	terminals = ld_symbol_get_terminals (symbol);
+	for (i = 0; i < terminals->length; i++)
+	{
+		LdPoint terminal;
+		Node *node;
+
+		terminal = terminals->points[i];
+		ld_diagram_symbol_transform_terminal (diagram_symbol, &terminal);
+
+		node = node_new (self, data->object, i, 1);
+		if (terminals->length == 1)
+			node->label = data->label;
+		key_init (&node->pins[0].key, &terminal);
+		g_ptr_array_add (data->nodes, node);
+	}
+}
+
+static void
+add_connection_nodes (LdNetlist *self, ObjectData *data)
+{
+	LdPointArray *points;
+	gdouble x, y;
+	Node *node;
+	guint i;
+
+	points = ld_diagram_connection_get_points
+		(LD_DIAGRAM_CONNECTION (data->object));
+	if (!points)
+		return;
+
+	if (points->length)
+	{
+		x = ld_diagram_object_get_x (data->object);
+		y = ld_diagram_object_get_y (data->object);
+
+		node = node_new (self, data->object, -1, points->length);
+		for (i = 0; i < points->length; i++)
+		{
+			points->points[i].x += x;
+			points->points[i].y += y;
+
+			key_init (&node->pins[i].key, &points->points[i]);
+			node->pins[i].interior = i != 0 && i != points->length - 1;
+		}
+		g_ptr_array_add (data->nodes, node);
+	}
+	ld_point_array_free (points);
+}
+
+/*
+ * link_object:
+ *
+ * Create nodes of an object and join them with the rest of the diagram.
+ */
+static void
+link_object (LdNetlist *self, ObjectData *data)
+{
+	guint i, k;
+
+	/* Reading parameters that are missing from storage sets them. */
+	g_signal_handlers_block_by_func (data->object, on_object_notify, self);
+	if (LD_IS_DIAGRAM_SYMBOL (data->object))
+		add_symbol_nodes (self, data);
+	else if (LD_IS_DIAGRAM_CONNECTION (data->object))
+		add_connection_nodes (self, data);
+	g_signal_handlers_unblock_by_func (data->object, on_object_notify, self);
+
+	for (i = 0; i < data->nodes->len; i++)
+	{
+		Node *node;
+
+		node = g_ptr_array_index (data->nodes, i);
+		for (k = 0; k < node->n_pins; k++)
+		{
+			Cell *cell;
+
+			cell = g_hash_table_lookup (self->priv->cells,
+				&node->pins[k].key);
+			if (!cell)
+			{
+				cell = g_slice_new (Cell);
+				cell->key = node->pins[k].key;
+				cell->pins = g_ptr_array_new ();
+				g_hash_table_insert (self->priv->cells, &cell->key, cell);
+			}
+			g_ptr_array_add (cell->pins, &node->pins[k]);
+		}
+		if (node->label)
+		{
+			GPtrArray *group;
+
+			group = g_hash_table_lookup (self->priv->labels, node->label);
+			if (!group)
+			{
+				group = g_ptr_array_new ();
+				g_hash_table_insert (self->priv->labels,
+					g_strdup (node->label), group);
+			}
+			g_ptr_array_add (group, node);
+		}
+		node_join (self, node);
+	}
+}
+
+/*
+ * unlink_object:
+ *
+ * Destroy nodes of an object and rebuild the nets they have been a part of.
+ */
+static void
+unlink_object (LdNetlist *self, ObjectData *data)
+{
+	GPtrArray *affected;
+	guint i, k;
+
+	/* Take apart all nets of the object, marking their nodes. */
+	affected = g_ptr_array_new ();
+	for (i = 0; i < data->nodes->len; i++)
+	{
+		Node *node, *iter, *next;
+
+		node = g_ptr_array_index (data->nodes, i);
+		if (!node->parent)
+			continue;
+
+		iter = node;
+		do
+		{
+			next = iter->next;
+			iter->parent = NULL;
+			if (iter->object != data->object)
+				g_ptr_array_add (affected, iter);
+		}
+		while ((iter = next) != node);
+		self->priv->n_nets--;
+	}
+
+	for (i = 0; i < data->nodes->len; i++)
+	{
+		Node *node;
+
+		node = g_ptr_array_index (data->nodes, i);
+		for (k = 0; k < node->n_pins; k++)
+		{
+			Cell *cell;
+
+			cell = g_hash_table_lookup (self->priv->cells,
+				&node->pins[k].key);
+			g_ptr_array_remove_fast (cell->pins, &node->pins[k]);
+			if (!cell->pins->len)
+				g_hash_table_remove (self->priv->cells, &cell->key);
+		}
+		if (node->label)
+		{
+			GPtrArray *group;
+
+			group = g_hash_table_lookup (self->priv->labels, node->label);
+			g_ptr_array_remove_fast (group, node);
+			if (!group->len)
+				g_hash_table_remove (self->priv->labels, node->label);
+		}
+		node_free (node);
+	}
+	g_ptr_array_set_size (data->nodes, 0);
+	g_free (data->label);
+	data->label = NULL;
+
+	/* The remaining nodes can only be joined among themselves again. */
+	for (i = 0; i < affected->len; i++)
+	{
+		Node *node;
+
+		node = g_ptr_array_index (affected, i);
+		node->parent = node;
+		node->rank = 0;
+		node->next = node;
+		self->priv->n_nets++;
+	}
+	for (i = 0; i < affected->len; i++)
+		node_join (self, g_ptr_array_index (affected, i));
+
+	g_ptr_array_free (affected, TRUE);
+}
+
+static Node *
+get_node (LdNetlist *self, LdDiagramObject *object, gint terminal)
+{
+	ObjectData *data;
+
+	data = g_hash_table_lookup (self->priv->objects, object);
+	if (!data)
+		return NULL;
+
+	if (LD_IS_DIAGRAM_CONNECTION (object))
+		terminal = 0;
+	if (terminal < 0 || (guint) terminal >= data->nodes->len)
+		return NULL;
+	return g_ptr_array_index (data->nodes, terminal);
+}
+
+static void
+on_object_inserted (LdDiagram *diagram,
+	LdDiagramObject *object, LdNetlist *self)
+{
+	add_object (self, object);
+	g_signal_emit (self, LD_NETLIST_GET_CLASS (self)->changed_signal, 0);
+}
+
+static void
+on_object_removed (LdDiagram *diagram,
+	LdDiagramObject *object, LdNetlist *self)
+{
+	remove_object (self, object);
+	g_signal_emit (self, LD_NETLIST_GET_CLASS (self)->changed_signal, 0);
+}
+
+static void
+on_object_notify (LdDiagramObject *object,
+	GParamSpec *pspec, LdNetlist *self)
+{
+	ObjectData *data;
+
+	data = g_hash_table_lookup (self->priv->objects, object);
+	g_return_if_fail (data != NULL);
+
+	unlink_object (self, data);
+	link_object (self, data);
+	g_signal_emit (self, LD_NETLIST_GET_CLASS (self)->changed_signal, 0);
+}
+
+static void
+on_symbol_changed (LdLibrary *library,
+	const gchar *identifier, LdNetlist *self)
+{
+	GHashTableIter iter;
+	ObjectData *data;
+	gboolean changed = FALSE;
+
+	/* Terminals of the symbol might have moved. */
+	g_hash_table_iter_init (&iter, self->priv->objects);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &data))
+	{
+		gchar *klass;
+
+		if (!LD_IS_DIAGRAM_SYMBOL (data->object))
+			continue;
+
+		klass = ld_diagram_symbol_get_class
+			(LD_DIAGRAM_SYMBOL (data->object));
+		if (!g_strcmp0 (klass, identifier))
+		{
+			unlink_object (self, data);
+			link_object (self, data);
+			changed = TRUE;
+		}
+		g_free (klass);
+	}
+
+	if (changed)
+		g_signal_emit (self, LD_NETLIST_GET_CLASS (self)->changed_signal, 0);
+}
+
+/* ===== Interface ========================================================= */
+
+/**
+ * ld_netlist_get_n_nets:
+ * @self: an #LdNetlist object.
+ *
+ * Return value: the number of nets, including unconnected terminals
+ *               and connections that don't lead to any terminal.
+ */
+guint
+ld_netlist_get_n_nets (LdNetlist *self)
+{
+	g_return_val_if_fail (LD_IS_NETLIST (self), 0);
+	return self->priv->n_nets;
+}
+
+/**
+ * ld_netlist_is_connected:
+ * @self: an #LdNetlist object.
+ * @a: a symbol or a connection.
+ * @a_terminal: index of a terminal of @a, ignored for connections.
+ * @b: a symbol or a connection.
+ * @b_terminal: index of a terminal of @b, ignored for connections.
+ *
+ * Return value: whether both objects are in the same net.
+ */
+gboolean
+ld_netlist_is_connected (LdNetlist *self,
+	LdDiagramObject *a, gint a_terminal,
+	LdDiagramObject *b, gint b_terminal)
+{
+	Node *node_a, *node_b;
+
+	g_return_val_if_fail (LD_IS_NETLIST (self), FALSE);
+	g_return_val_if_fail (LD_IS_DIAGRAM_OBJECT (a), FALSE);
+	g_return_val_if_fail (LD_IS_DIAGRAM_OBJECT (b), FALSE);
+
+	node_a = get_node (self, a, a_terminal);
+	node_b = get_node (self, b, b_terminal);
+	if (!node_a || !node_b)
+		return FALSE;
+	return node_find (node_a) == node_find (node_b);
+}
+
+/*
+ * number_nets:
+ *
+ * Name nets after the order in which they're first found at terminals
+ * of symbols in the diagram.
+ *
+ * Return value: (element-type Node * guint): net numbers by their roots.
+ */
+static GHashTable *
+number_nets (LdNetlist *self)
+{
+	GHashTable *numbers;
+	GList *iter;
+	guint i;
+
+	numbers = g_hash_table_new (g_direct_hash, g_direct_equal);
+	for (iter = ld_diagram_get_objects (self->priv->diagram); iter;
+		iter = g_list_next (iter))
+	{
+		ObjectData *data;
+
+		if (!LD_IS_DIAGRAM_SYMBOL (iter->data))
+			continue;
+
+		data = g_hash_table_lookup (self->priv->objects, iter->data);
+		for (i = 0; data && i < data->nodes->len; i++)
+		{
+			Node *root;
+
+			root = node_find (g_ptr_array_index (data->nodes, i));
+			if (!g_hash_table_lookup (numbers, root))
+				g_hash_table_insert (numbers, root, GUINT_TO_POINTER
+					(g_hash_table_size (numbers) + 1));
+		}
+	}
+	return numbers;
+}
+
+/*
+ * name_nets:
+ * @numbers: net numbers by their roots, as returned by number_nets().
+ * @aliases: (out) (element-type gchar **): other labels of each net
+ *           in numeric order, or %NULL for nets without a label.
+ *
+ * Name nets after the first of their labels in alphabetical order,
+ * so that the name doesn't depend on the order of objects.  Nets
+ * without a label are named after their number, unless a label
+ * of another net already has the same name.
+ *
+ * Return value: (element-type gchar *): names of nets in numeric order.
+ */
+static GPtrArray *
+name_nets (LdNetlist *self, GHashTable *numbers, GPtrArray **aliases)
+{
+	GHashTableIter iter;
+	GPtrArray *names, *labels, *others;
+	gpointer root, number;
+	guint index, i, suffix;
+
+	names = g_ptr_array_new_with_free_func (g_free);
+	g_ptr_array_set_size (names, g_hash_table_size (numbers));
+	*aliases = g_ptr_array_new_with_free_func ((GDestroyNotify) g_strfreev);
+	g_ptr_array_set_size (*aliases, g_hash_table_size (numbers));
+
+	labels = g_ptr_array_new ();
+	g_hash_table_iter_init (&iter, numbers);
+	while (g_hash_table_iter_next (&iter, &root, &number))
+	{
+		Node *node;
+		gchar *name;
+
+		g_ptr_array_set_size (labels, 0);
+		node = root;
+		do
+		{
+			if (node->label)
+				g_ptr_array_add (labels, (gpointer) node->label);
+		}
+		while ((node = node->next) != root);
+
+		index = GPOINTER_TO_UINT (number) - 1;
+		if (!labels->len)
+		{
+			name = g_strdup_printf ("N%u", index + 1);
+			for (suffix = 1; g_hash_table_contains (self->priv->labels, name);
+				suffix++)
+			{
+				g_free (name);
+				name = g_strdup_printf ("N%u_%u", index + 1, suffix);
+			}
+			g_ptr_array_index (names, index) = name;
+			continue;
+		}
+
+		g_ptr_array_sort (labels, compare_labels);
+		g_ptr_array_index (names, index) =
+			g_strdup (g_ptr_array_index (labels, 0));
+
+		/* Labels of a net that has several are kept as its aliases. */
+		others = g_ptr_array_new ();
+		for (i = 1; i < labels->len; i++)
+			if (strcmp (g_ptr_array_index (labels, i),
+				g_ptr_array_index (labels, i - 1)))
+				g_ptr_array_add (others,
+					g_strdup (g_ptr_array_index (labels, i)));
+
+		g_ptr_array_add (others, NULL);
+		g_ptr_array_index (*aliases, index) = g_ptr_array_free (others, FALSE);
+	}
+	g_ptr_array_free (labels, TRUE);
+	return names;
+}
+
+static gint
+compare_labels (gconstpointer a, gconstpointer b)
+{
+	return strcmp (*(const gchar **) a, *(const gchar **) b);
+}
+
+/**
+ * ld_netlist_to_json:
+ * @self: an #LdNetlist object.
+ *
+ * Export nets that lead to terminals of symbols.  Symbols are referred to
+ * by their position within the diagram's list of objects, as well as by
+ * their identifiers.  Labelled nets are named after their label and
+ * marked as `labelled', so that they can be joined with nets of the same
+ * label from other sheets.  Names of other nets only hold within the sheet.
+ * Nets with more than one label also list the others as `aliases'.
+ *
+ * Return value: (transfer full): an object with a `nets' array.
+ */
+JsonNode *
+ld_netlist_to_json (LdNetlist *self)
+{
+	GHashTable *numbers;
+	GPtrArray *nets, *names, *aliases;
+	JsonObject *root_object;
+	JsonArray *nets_array;
+	JsonNode *root;
+	GList *iter;
+	guint i, k, index;
+
+	g_return_val_if_fail (LD_IS_NETLIST (self), NULL);
+
+	numbers = number_nets (self);
+	nets = g_ptr_array_new ();
+	for (i = 0; i < g_hash_table_size (numbers); i++)
+		g_ptr_array_add (nets, json_array_new ());
+
+	index = 0;
+	for (iter = ld_diagram_get_objects (self->priv->diagram); iter;
+		iter = g_list_next (iter), index++)
+	{
+		ObjectData *data;
+
+		if (!LD_IS_DIAGRAM_SYMBOL (iter->data))
+			continue;
+
+		data = g_hash_table_lookup (self->priv->objects, iter->data);
+		for (i = 0; data && i < data->nodes->len; i++)
+		{
+			JsonObject *terminal;
+			guint number;
+
+			number = GPOINTER_TO_UINT (g_hash_table_lookup (numbers,
+				node_find (g_ptr_array_index (data->nodes, i))));
+
+			terminal = json_object_new ();
+			json_object_set_int_member (terminal, "object", index);
+			json_object_set_string_member (terminal, "id",
+				ld_diagram_object_get_id (iter->data));
+			json_object_set_int_member (terminal, "terminal", i);
+			json_array_add_object_element
+				(g_ptr_array_index (nets, number - 1), terminal);
+		}
+	}
+
+	names = name_nets (self, numbers, &aliases);
+	nets_array = json_array_new ();
+	for (i = 0; i < nets->len; i++)
+	{
+		JsonObject *net;
+		JsonArray *array;
+		gchar **others;
+
+		net = json_object_new ();
+		json_object_set_string_member (net, "name",
+			g_ptr_array_index (names, i));
+		others = g_ptr_array_index (aliases, i);
+		json_object_set_boolean_member (net, "labelled", others != NULL);
+		if (others && *others)
+		{
+			array = json_array_new ();
+			for (k = 0; others[k]; k++)
+				json_array_add_string_element (array, others[k]);
+			json_object_set_array_member (net, "aliases", array);
+		}
+		json_object_set_array_member (net, "terminals",
+			g_ptr_array_index (nets, i));
+		json_array_add_object_element (nets_array, net);
+	}
+	g_ptr_array_free (names, TRUE);
+	g_ptr_array_free (aliases, TRUE);
+	g_ptr_array_free (nets, TRUE);
+	g_hash_table_destroy (numbers);
+
+	root_object = json_object_new ();
+	json_object_set_array_member (root_object, "nets", nets_array);
+
+	root = json_node_new (JSON_NODE_OBJECT);
+	json_node_take_object (root, root_object);
+	return root;
+}
+
+/**
+ * ld_netlist_to_spice:
+ * @self: an #LdNetlist object.
+ *
+ * Export the netlist in a SPICE-like format, where each symbol becomes
+ * a subcircuit instance named after its position within the diagram's
+ * list of objects, with its terminals connected to nets in order.
+ * Nets are named the same way as in ld_netlist_to_json(), their aliases
+ * are listed in comments.  Characters that would split a name or change
+ * its meaning, such as whitespace in labels, are replaced with underscores
+ * and a suffix keeps the name unique.  The original label of a renamed
+ * net is mentioned in a comment, too.
+ *
+ * Return value: (transfer full): the netlist.
+ */
+gchar *
+ld_netlist_to_spice (LdNetlist *self)
+{
+	GHashTable *numbers, *used;
+	GPtrArray *names, *aliases, *spice_names;
+	GString *spice;
+	GList *iter;
+	guint i, k, index, suffix;
+
+	g_return_val_if_fail (LD_IS_NETLIST (self), NULL);
+
+	numbers = number_nets (self);
+	names = name_nets (self, numbers, &aliases);
+
+	/* Names that are fine as they are take precedence over renamed ones. */
+	used = g_hash_table_new (g_str_hash, g_str_equal);
+	spice_names = g_ptr_array_new_with_free_func (g_free);
+	g_ptr_array_set_size (spice_names, names->len);
+	for (i = 0; i < names->len; i++)
+		if (is_spice_name (g_ptr_array_index (names, i)))
+		{
+			g_ptr_array_index (spice_names, i) =
+				g_strdup (g_ptr_array_index (names, i));
+			g_hash_table_add (used, g_ptr_array_index (spice_names, i));
+		}
+	for (i = 0; i < names->len; i++)
+	{
+		gchar *base, *name;
+
+		if (g_ptr_array_index (spice_names, i))
+			continue;
+
+		base = make_spice_name (g_ptr_array_index (names, i));
+		name = g_strdup (base);
+		for (suffix = 1; g_hash_table_contains (used, name); suffix++)
+		{
+			g_free (name);
+			name = g_strdup_printf ("%s_%u", base, suffix);
+		}
+		g_free (base);
+
+		g_ptr_array_index (spice_names, i) = name;
+		g_hash_table_add (used, name);
+	}
+	g_hash_table_destroy (used);
+
+	spice = g_string_new ("* " PROJECT_NAME " netlist\n");
+	for (i = 0; i < names->len; i++)
+	{
+		const gchar *name;
+		gchar **others, *comment;
+
+		name = g_ptr_array_index (spice_names, i);
+		if (strcmp (name, g_ptr_array_index (names, i)))
+		{
+			/* Line breaks would end the comment. */
+			comment = g_strdelimit (g_strdup
+				(g_ptr_array_index (names, i)), "\r\n", ' ');
+			g_string_append_printf (spice, "* %s is labelled %s\n",
+				name, comment);
+			g_free (comment);
+		}
+
+		if (!(others = g_ptr_array_index (aliases, i)))
+			continue;
+		for (k = 0; others[k]; k++)
+		{
+			comment = g_strdelimit (g_strdup (others[k]), "\r\n", ' ');
+			g_string_append_printf (spice, "* %s is also labelled %s\n",
+				name, comment);
+			g_free (comment);
+		}
+	}
+
+	index = 0;
+	for (iter = ld_diagram_get_objects (self->priv->diagram); iter;
+		iter = g_list_next (iter), index++)
+	{
+		ObjectData *data;
+		gchar *klass, *subcircuit;
+
+		if (!LD_IS_DIAGRAM_SYMBOL (iter->data))
+			continue;
+
+		g_string_append_printf (spice, "X%u", index);
+		data = g_hash_table_lookup (self->priv->objects, iter->data);
+		for (i = 0; data && i < data->nodes->len; i++)
+			g_string_append_printf (spice, " %s", (gchar *)
+				g_ptr_array_index (spice_names, GPOINTER_TO_UINT
+				(g_hash_table_lookup (numbers, node_find
+				(g_ptr_array_index (data->nodes, i)))) - 1));
+
+		klass = ld_diagram_symbol_get_class (LD_DIAGRAM_SYMBOL (iter->data));
+		subcircuit = make_spice_name (klass);
+		g_string_append_printf (spice, " %s\n", subcircuit);
+		g_free (subcircuit);
+		g_free (klass);
+	}
+	g_string_append (spice, ".end\n");
+
+	g_ptr_array_free (spice_names, TRUE);
+	g_ptr_array_free (names, TRUE);
+	g_ptr_array_free (aliases, TRUE);
+	g_hash_table_destroy (numbers);
+	return g_string_free (spice, FALSE);
+}
+
+static gboolean
+is_spice_name (const gchar *name)
+{
+	const gchar *p;
+
+	if (!*name)
+		return FALSE;
+	for (p = name; *p; p++)
+		if (!g_ascii_isalnum (*p) && !strchr (SPICE_NAME_CHARS, *p))
+			return FALSE;
+	return TRUE;
+}
+
+/*
+ * make_spice_name:
+ *
+ * Replace characters that can't be a part of a SPICE name with underscores.
+ */
+static gchar *
+make_spice_name (const gchar *name)
+{
+	gchar *result, *p;
+
+	if (!name || !*name)
+		return g_strdup ("_");
+
+	result = g_strdup (name);
+	for (p = result; *p; p++)
+		if (!g_ascii_isalnum (*p) && !strchr (SPICE_NAME_CHARS, *p))
+			*p = '_';
+	return result;
+}
@@ -0,0 +1,66 @@
+/*
+ * ld-netlist.h
+ *
+ * This file is a part of logdiag.
+ * Copyright 2026 Přemysl Eric Janouch
+ *
+ * See the file LICENSE for licensing information.
+ *
+ */
+
+#ifndef __LD_NETLIST_H__
+#define __LD_NETLIST_H__
+
+G_BEGIN_DECLS
+
+
+#define LD_TYPE_NETLIST (ld_netlist_get_type ())
+#define LD_NETLIST(obj) \
+	(G_TYPE_CHECK_INSTANCE_CAST ((obj), LD_TYPE_NETLIST, LdNetlist))
+#define LD_NETLIST_CLASS(klass) \
+	(G_TYPE_CHECK_CLASS_CAST ((klass), LD_TYPE_NETLIST, LdNetlistClass))
+#define LD_IS_NETLIST(obj) (G_TYPE_CHECK_INSTANCE_TYPE ((obj), LD_TYPE_NETLIST))
+#define LD_IS_NETLIST_CLASS(klass) \
+	(G_TYPE_CHECK_INSTANCE_TYPE ((klass), LD_TYPE_NETLIST))
+#define LD_NETLIST_GET_CLASS(obj) \
+	(G_TYPE_INSTANCE_GET_CLASS ((obj), LD_NETLIST, LdNetlistClass))
+
+typedef struct _LdNetlist LdNetlist;
+typedef struct _LdNetlistPrivate LdNetlistPrivate;
+typedef struct _LdNetlistClass LdNetlistClass;
+
+
+/**
+ * LdNetlist:
+ */
+struct _LdNetlist
+{
+/*< private >*/
+	GObject parent_instance;
+	LdNetlistPrivate *priv;
+};
+
+struct _LdNetlistClass
+{
+/*< private >*/
+	GObjectClass parent_class;
+
+	guint changed_signal;
+};
+
+
+GType ld_netlist_get_type (void) G_GNUC_CONST;
+
+LdNetlist *ld_netlist_new (LdDiagram *diagram, LdLibrary *library);
+guint ld_netlist_get_n_nets (LdNetlist *self);
+gboolean ld_netlist_is_connected (LdNetlist *self,
+	LdDiagramObject *a, gint a_terminal,
+	LdDiagramObject *b, gint b_terminal);
+
+JsonNode *ld_netlist_to_json (LdNetlist *self);
+gchar *ld_netlist_to_spice (LdNetlist *self);
+
+
+G_END_DECLS
+
+#endif /* ! __LD_NETLIST_H__ */
@@ -0,0 +1,465 @@
+/*
+ * ld-router.c
+ *
+ * This file is a part of logdiag.
+ * Copyright 2026 Přemysl Eric Janouch
+ *
+ * See the file LICENSE for licensing information.
+ *
+ */
+
+#include <math.h>
+
+#include "liblogdiag.h"
+#include "config.h"
+
+
+/**
+ * SECTION:ld-router
+ * @short_description: An orthogonal connection router
+ * @see_also: #LdDiagramConnection
+ *
+ * #LdRouter finds orthogonal paths around rectangular obstacles, such as
+ * areas of symbols.  Paths run along the grid of diagram units and are
+ * searched for with A*, where each bend costs as much as a few units
+ * of length, so that the result has few of them.
+ *
+ * The search is limited to the surroundings of both end points and to
+ * a given number of iterations, so that it can keep up with the cursor.
+ */
+
+/* How much length a bend is worth. */
+#define BEND_COST 3
+/* How far around the end points a path may go. */
+#define SEARCH_MARGIN 8
+/* Relative coordinates have to fit into a state key. */
+#define COORD_LIMIT 4095
+/* Size of buckets of the obstacle index in diagram units. */
+#define BUCKET_SIZE 16
+
+enum
+{
+	DIR_RIGHT,
+	DIR_DOWN,
+	DIR_LEFT,
+	DIR_UP,
+	DIR_NONE
+};
+
+static const gint dir_dx[] = {1, 0, -1, 0};
+static const gint dir_dy[] = {0, 1, 0, -1};
+
+typedef struct
+{
+	gint x, y;               /* Position relative to the start. */
+	guint dir;               /* Direction we've come from. */
+	guint cost;              /* Cost of the best path found so far. */
+	gint parent;             /* Index of the previous state, or -1. */
+}
+State;
+
+typedef struct
+{
+	guint priority;          /* Cost plus the estimate of what remains. */
+	guint cost;              /* Cost at the time of pushing. */
+	guint state;             /* Index of the state. */
+}
+Candidate;
+
+/*
+ * LdRouter:
+ * @obstacles: (element-type LdRectangle): areas that paths avoid.
+ * @buckets: (element-type guint GArray *): indexes into @obstacles
+ *           for each bucket of space that they reach into.
+ */
+struct _LdRouter
+{
+	GArray *obstacles;
+	GHashTable *buckets;
+};
+
+static gpointer bucket_key (gint bx, gint by);
+static gboolean contains (const LdRectangle *rect, gdouble x, gdouble y);
+static gboolean is_blocked (LdRouter *self, gdouble x, gdouble y,
+	const LdPoint *start, const LdPoint *end);
+
+static void heap_push (GArray *heap, const Candidate *candidate);
+static Candidate heap_pop (GArray *heap);
+static gint candidate_compare (const Candidate *a, const Candidate *b);
+
+static gboolean starts_segment (GArray *states, const State *state);
+static LdPointArray *build_path (GArray *states, guint goal);
+
+
+/**
+ * ld_router_new:
+ *
+ * Create a new router with no obstacles.
+ *
+ * Return value: (transfer full): an #LdRouter structure.
+ */
+LdRouter *
+ld_router_new (void)
+{
+	LdRouter *self;
+
+	self = g_slice_new (LdRouter);
+	self->obstacles = g_array_new (FALSE, FALSE, sizeof (LdRectangle));
+	self->buckets = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+		NULL, (GDestroyNotify) g_array_unref);
+	return self;
+}
+
+/**
+ * ld_router_free:
+ * @self: an #LdRouter structure.
+ *
+ * Frees the router.
+ */
+void
+ld_router_free (LdRouter *self)
+{
+	g_return_if_fail (self != NULL);
+
+	g_array_unref (self->obstacles);
+	g_hash_table_destroy (self->buckets);
+	g_slice_free (LdRouter, self);
+}
+
+static gpointer
+bucket_key (gint bx, gint by)
+{
+	return GUINT_TO_POINTER ((guint) (bx & 0xffff) | (guint) by << 16);
+}
+
+/**
+ * ld_router_add_obstacle:
+ * @self: an #LdRouter structure.
+ * @rect: an area that paths shouldn't enter.  Its border may be used.
+ *
+ * Add an obstacle.
+ */
+void
+ld_router_add_obstacle (LdRouter *self, const LdRectangle *rect)
+{
+	gint bx, by, bx_last, by_last;
+	guint index;
+
+	g_return_if_fail (self != NULL);
+	g_return_if_fail (rect != NULL);
+
+	index = self->obstacles->len;
+	g_array_append_val (self->obstacles, *rect);
+
+	bx_last = floor ((rect->x + rect->width)  / BUCKET_SIZE);
+	by_last = floor ((rect->y + rect->height) / BUCKET_SIZE);
+	for (bx = floor (rect->x / BUCKET_SIZE); bx <= bx_last; bx++)
+	for (by = floor (rect->y / BUCKET_SIZE); by <= by_last; by++)
+	{
+		GArray *bucket;
+
+		bucket = g_hash_table_lookup (self->buckets, bucket_key (bx, by));
+		if (!bucket)
+		{
+			bucket = g_array_new (FALSE, FALSE, sizeof (guint));
+			g_hash_table_insert (self->buckets, bucket_key (bx, by), bucket);
+		}
+		g_array_append_val (bucket, index);
+	}
+}
+
+static gboolean
+contains (const LdRectangle *rect, gdouble x, gdouble y)
+{
+	return x > rect->x && x < rect->x + rect->width
+		&& y > rect->y && y < rect->y + rect->height;
+}
+
+static gboolean
+is_blocked (LdRouter *self, gdouble x, gdouble y,
+	const LdPoint *start, const LdPoint *end)
+{
+	GArray *bucket;
+	guint i;
+
+	bucket = g_hash_table_lookup (self->buckets, bucket_key
+		(floor (x / BUCKET_SIZE), floor (y / BUCKET_SIZE)));
+	if (!bucket)
+		return FALSE;
+
+	for (i = 0; i < bucket->len; i++)
+	{
+		LdRectangle *rect;
+
+		rect = &g_array_index (self->obstacles, LdRectangle,
+			g_array_index (bucket, guint, i));
+		/* Let paths leave and enter what they are attached to. */
+		if (contains (rect, x, y)
+		 && !contains (rect, start->x, start->y)
+		 && !contains (rect, end->x, end->y))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/* ===== Search ============================================================ */
+
+static gint
+candidate_compare (const Candidate *a, const Candidate *b)
+{
+	if (a->priority != b->priority)
+		return a->priority < b->priority ? -1 : 1;
+
+	/* Prefer candidates that have got further. */
+	if (a->cost != b->cost)
+		return a->cost > b->cost ? -1 : 1;
+	return 0;
+}
+
+static void
+heap_push (GArray *heap, const Candidate *candidate)
+{
+	Candidate *items;
+	guint i, parent;
+
+	g_array_append_val (heap, *candidate);
+	items = (Candidate *) heap->data;
+	for (i = heap->len - 1; i; i = parent)
+	{
+		Candidate temp;
+
+		parent = (i - 1) / 2;
+		if (candidate_compare (&items[parent], &items[i]) <= 0)
+			break;
+
+		temp = items[parent];
+		items[parent] = items[i];
+		items[i] = temp;
+	}
+}
+
+static Candidate
+heap_pop (GArray *heap)
+{
+	Candidate *items, result;
+	guint i, child;
+
+	items = (Candidate *) heap->data;
+	result = items[0];
+	items[0] = items[heap->len - 1];
+	g_array_set_size (heap, heap->len - 1);
+
+	for (i = 0; (child = 2 * i + 1) < heap->len; i = child)
+	{
+		Candidate temp;
+
+		if (child + 1 < heap->len
+		 && candidate_compare (&items[child + 1], &items[child]) < 0)
+			child++;
+		if (candidate_compare (&items[i], &items[child]) <= 0)
+			break;
+
+		temp = items[child];
+		items[child] = items[i];
+		items[i] = temp;
+	}
+	return result;
+}
+
+static guint
+estimate (gint x, gint y, gint tx, gint ty)
+{
+	guint result;
+
+	result = ABS (tx - x) + ABS (ty - y);
+	if (tx != x && ty != y)
+		result += BEND_COST;
+	return result;
+}
+
+static gboolean
+starts_segment (GArray *states, const State *state)
+{
+	return state->parent >= 0 && state->dir
+		!= g_array_index (states, State, state->parent).dir;
+}
+
+static LdPointArray *
+build_path (GArray *states, guint goal)
+{
+	LdPointArray *path;
+	State *state;
+	guint n_points;
+	gint index;
+
+	/* Only keep the ends and the points where the direction changes. */
+	n_points = 1;
+	for (index = goal; index >= 0; index = state->parent)
+	{
+		state = &g_array_index (states, State, index);
+		if (starts_segment (states, state))
+			n_points++;
+	}
+
+	path = ld_point_array_sized_new (n_points);
+	path->length = n_points;
+
+	state = &g_array_index (states, State, goal);
+	path->points[--n_points].x = state->x;
+	path->points[n_points].y = state->y;
+	for (index = goal; index >= 0; index = state->parent)
+	{
+		State *parent;
+
+		state = &g_array_index (states, State, index);
+		if (!starts_segment (states, state))
+			continue;
+
+		parent = &g_array_index (states, State, state->parent);
+		path->points[--n_points].x = parent->x;
+		path->points[n_points].y = parent->y;
+	}
+	return path;
+}
+
+/**
+ * ld_router_route:
+ * @self: an #LdRouter structure.
+ * @start: where the path starts.
+ * @end: where the path ends.
+ * @max_iterations: the maximum number of search steps.
+ *
+ * Find an orthogonal path between two points that avoids obstacles and has
+ * the least bends.  Obstacles that contain either end point are ignored.
+ *
+ * Return value: (transfer full): points of the path relative to @start,
+ *               or %NULL if there's none or the search takes too long.
+ */
+LdPointArray *
+ld_router_route (LdRouter *self,
+	const LdPoint *start, const LdPoint *end, guint max_iterations)
+{
+	GArray *states, *heap;
+	GHashTable *index;
+	LdPointArray *path = NULL;
+	gint tx, ty, min_x, max_x, min_y, max_y;
+	guint iterations;
+	State state;
+	Candidate candidate;
+
+	g_return_val_if_fail (self != NULL, NULL);
+	g_return_val_if_fail (start != NULL, NULL);
+	g_return_val_if_fail (end != NULL, NULL);
+
+	/* Only end points on the same grid can be routed. */
+	if (end->x - start->x != floor (end->x - start->x)
+	 || end->y - start->y != floor (end->y - start->y))
+		return NULL;
+
+	tx = end->x - start->x;
+	ty = end->y - start->y;
+	if ((!tx && !ty)
+	 || ABS (tx) > COORD_LIMIT - SEARCH_MARGIN
+	 || ABS (ty) > COORD_LIMIT - SEARCH_MARGIN)
+		return NULL;
+
+	min_x = MIN (0, tx) - SEARCH_MARGIN;
+	max_x = MAX (0, tx) + SEARCH_MARGIN;
+	min_y = MIN (0, ty) - SEARCH_MARGIN;
+	max_y = MAX (0, ty) + SEARCH_MARGIN;
+
+	states = g_array_new (FALSE, FALSE, sizeof (State));
+	heap = g_array_new (FALSE, FALSE, sizeof (Candidate));
+	index = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	state.x = state.y = 0;
+	state.dir = DIR_NONE;
+	state.cost = 0;
+	state.parent = -1;
+	g_array_append_val (states, state);
+
+	candidate.priority = estimate (0, 0, tx, ty);
+	candidate.cost = 0;
+	candidate.state = 0;
+	heap_push (heap, &candidate);
+
+	for (iterations = 0; heap->len && iterations < max_iterations;
+		iterations++)
+	{
+		guint dir, current;
+
+		candidate = heap_pop (heap);
+		current = candidate.state;
+		state = g_array_index (states, State, current);
+		if (candidate.cost > state.cost)
+			continue;
+
+		if (state.x == tx && state.y == ty)
+		{
+			path = build_path (states, current);
+			break;
+		}
+
+		for (dir = 0; dir < DIR_NONE; dir++)
+		{
+			State *next;
+			Candidate next_candidate;
+			gpointer key, value;
+			gint nx, ny;
+			guint cost;
+
+			/* Turning back never helps. */
+			if (state.dir != DIR_NONE && dir == (state.dir + 2) % 4)
+				continue;
+
+			nx = state.x + dir_dx[dir];
+			ny = state.y + dir_dy[dir];
+			if (nx < min_x || nx > max_x || ny < min_y || ny > max_y)
+				continue;
+			if (is_blocked (self, start->x + nx, start->y + ny, start, end))
+				continue;
+
+			cost = state.cost + 1;
+			if (state.dir != DIR_NONE && dir != state.dir)
+				cost += BEND_COST;
+
+			key = GUINT_TO_POINTER ((guint) (nx + COORD_LIMIT) << 16
+				| (guint) (ny + COORD_LIMIT) << 3 | dir);
+			if (g_hash_table_lookup_extended (index, key, NULL, &value))
+			{
+				next = &g_array_index (states, State,
+					GPOINTER_TO_UINT (value));
+				if (next->cost <= cost)
+					continue;
+
+				next->cost = cost;
+				next->parent = current;
+				next_candidate.state = GPOINTER_TO_UINT (value);
+			}
+			else
+			{
+				State new_state;
+
+				new_state.x = nx;
+				new_state.y = ny;
+				new_state.dir = dir;
+				new_state.cost = cost;
+				new_state.parent = current;
+
+				g_hash_table_insert (index, key,
+					GUINT_TO_POINTER (states->len));
+				g_array_append_val (states, new_state);
+				next_candidate.state = states->len - 1;
+			}
+
+			next_candidate.priority = cost + estimate (nx, ny, tx, ty);
+			next_candidate.cost = cost;
+			heap_push (heap, &next_candidate);
+		}
+	}
+
+	g_hash_table_destroy (index);
+	g_array_unref (heap);
+	g_array_unref (states);
+	return path;
+}
@@ -0,0 +1,35 @@
+/*
+ * ld-router.h
+ *
+ * This file is a part of logdiag.
+ * Copyright 2026 Přemysl Eric Janouch
+ *
+ * See the file LICENSE for licensing information.
+ *
+ */
+
+#ifndef __LD_ROUTER_H__
+#define __LD_ROUTER_H__
+
+G_BEGIN_DECLS
+
+
+/**
+ * LdRouter:
+ *
+ * An opaque orthogonal connection router.
+ */
+typedef struct _LdRouter LdRouter;
+
+
+LdRouter *ld_router_new (void);
+void ld_router_free (LdRouter *self);
+
+void ld_router_add_obstacle (LdRouter *self, const LdRectangle *rect);
+LdPointArray *ld_router_route (LdRouter *self,
+	const LdPoint *start, const LdPoint *end, guint max_iterations);
+
+
+G_END_DECLS
+
+#endif /* ! __LD_ROUTER_H__ */
@@ -0,0 +1,583 @@
+/*
+ * ld-symbol-index.c
+ *
+ * This file is a part of logdiag.
+ * Copyright 2026 Přemysl Eric Janouch
+ *
+ * See the file LICENSE for licensing information.
+ *
+ */
+
+#include <string.h>
+
+#include "liblogdiag.h"
+#include "config.h"
+
+
+/**
+ * SECTION:ld-symbol-index
+ * @short_description: A search index for symbols
+ * @see_also: #LdLibrary
+ *
+ * #LdSymbolIndex looks up identifiers by words contained in their keys,
+ * such as names and human names.  Matching ignores case and diacritics.
+ * Words of the query that are at least three characters long may match
+ * anywhere within a key, shorter ones only at the beginning of a word.
+ *
+ * Substrings are found through an index of trigrams, prefixes through
+ * a sorted array of word beginnings.  Both are cheap to update, so that
+ * the index can follow symbols as they come and go.
+ */
+
+/* Trigrams are packed into integers, the extra bit makes them non-zero. */
+#define TRIGRAM(s) GUINT_TO_POINTER ((guint) (guint8) (s)[0] \
+	| (guint) (guint8) (s)[1] << 8 | (guint) (guint8) (s)[2] << 16 | 1 << 24)
+
+/* Don't bother compacting small indexes. */
+#define COMPACT_THRESHOLD 64
+
+typedef struct
+{
+	gchar *identifier;       /* The identifier, NULL if removed. */
+	gchar **keys;            /* Normalized keys. */
+}
+Entry;
+
+typedef struct
+{
+	const gchar *word;       /* Beginning of a word within a key. */
+	guint id;                /* Index of the entry. */
+}
+Word;
+
+typedef struct
+{
+	guint score;             /* How well the entry matches. */
+	Entry *entry;            /* The entry. */
+}
+Result;
+
+/*
+ * LdSymbolIndex:
+ * @entries: (element-type Entry *): all entries, including removed ones.
+ * @ids: maps identifiers to indexes into @entries, plus one.
+ * @trigrams: maps trigrams to arrays of indexes into @entries.
+ * @words: (element-type Word): beginnings of words in all keys.
+ * @words_sorted: whether @words is currently sorted.
+ * @n_removed: the number of removed entries in @entries.
+ */
+struct _LdSymbolIndex
+{
+	GPtrArray *entries;
+	GHashTable *ids;
+	GHashTable *trigrams;
+	GArray *words;
+	gboolean words_sorted;
+	guint n_removed;
+};
+
+static void init (LdSymbolIndex *self);
+static void clear (LdSymbolIndex *self);
+static void compact (LdSymbolIndex *self);
+static void entry_free (Entry *entry);
+static void add_entry (LdSymbolIndex *self, Entry *entry);
+static void add_key (LdSymbolIndex *self, const gchar *key, guint id);
+
+static gchar *normalize (const gchar *text);
+static gchar **split_words (const gchar *text);
+static gboolean is_word_start (const gchar *text, const gchar *p);
+
+static GArray *find_candidates (LdSymbolIndex *self, gchar **tokens);
+static guint score_entry (Entry *entry, gchar **tokens);
+static guint score_key (const gchar *key, const gchar *token);
+static gint compare_words (gconstpointer a, gconstpointer b);
+static gint compare_results (gconstpointer a, gconstpointer b);
+
+
+/**
+ * ld_symbol_index_new:
+ *
+ * Create a new, empty index.
+ *
+ * Return value: (transfer full): an #LdSymbolIndex structure.
+ */
+LdSymbolIndex *
+ld_symbol_index_new (void)
+{
+	LdSymbolIndex *self;
+
+	self = g_slice_new (LdSymbolIndex);
+	init (self);
+	return self;
+}
+
+/**
+ * ld_symbol_index_free:
+ * @self: an #LdSymbolIndex structure.
+ *
+ * Frees the index.
+ */
+void
+ld_symbol_index_free (LdSymbolIndex *self)
+{
+	g_return_if_fail (self != NULL);
+
+	g_ptr_array_foreach (self->entries, (GFunc) entry_free, NULL);
+	clear (self);
+	g_slice_free (LdSymbolIndex, self);
+}
+
+static void
+init (LdSymbolIndex *self)
+{
+	self->entries = g_ptr_array_new ();
+	self->ids = g_hash_table_new (g_str_hash, g_str_equal);
+	self->trigrams = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+		NULL, (GDestroyNotify) g_array_unref);
+	self->words = g_array_new (FALSE, FALSE, sizeof (Word));
+	self->words_sorted = TRUE;
+	self->n_removed = 0;
+}
+
+/*
+ * clear:
+ *
+ * Destroy everything but the entries themselves.
+ */
+static void
+clear (LdSymbolIndex *self)
+{
+	g_ptr_array_unref (self->entries);
+	g_hash_table_destroy (self->ids);
+	g_hash_table_destroy (self->trigrams);
+	g_array_unref (self->words);
+}
+
+/*
+ * compact:
+ *
+ * Rebuild the index without removed entries.
+ */
+static void
+compact (LdSymbolIndex *self)
+{
+	GPtrArray *entries;
+	guint i;
+
+	entries = g_ptr_array_ref (self->entries);
+	clear (self);
+	init (self);
+
+	for (i = 0; i < entries->len; i++)
+	{
+		Entry *entry;
+
+		entry = g_ptr_array_index (entries, i);
+		if (entry->identifier)
+			add_entry (self, entry);
+		else
+			entry_free (entry);
+	}
+	g_ptr_array_unref (entries);
+}
+
+static void
+entry_free (Entry *entry)
+{
+	g_free (entry->identifier);
+	g_strfreev (entry->keys);
+	g_slice_free (Entry, entry);
+}
+
+/**
+ * ld_symbol_index_insert:
+ * @self: an #LdSymbolIndex structure.
+ * @identifier: the identifier to be found.
+ * @keys: (array zero-terminated=1): strings the identifier is to be
+ *        found by.
+ *
+ * Insert an identifier into the index, replacing any previous entry.
+ */
+void
+ld_symbol_index_insert (LdSymbolIndex *self, const gchar *identifier,
+	const gchar *const *keys)
+{
+	Entry *entry;
+	guint i, n_keys;
+
+	g_return_if_fail (self != NULL);
+	g_return_if_fail (identifier != NULL);
+	g_return_if_fail (keys != NULL);
+
+	ld_symbol_index_remove (self, identifier);
+
+	n_keys = g_strv_length ((gchar **) keys);
+	entry = g_slice_new (Entry);
+	entry->identifier = g_strdup (identifier);
+	entry->keys = g_new (gchar *, n_keys + 1);
+	for (i = 0; i < n_keys; i++)
+		entry->keys[i] = normalize (keys[i]);
+	entry->keys[n_keys] = NULL;
+
+	add_entry (self, entry);
+}
+
+static void
+add_entry (LdSymbolIndex *self, Entry *entry)
+{
+	gchar **key;
+	guint id;
+
+	id = self->entries->len;
+	g_ptr_array_add (self->entries, entry);
+	g_hash_table_insert (self->ids,
+		entry->identifier, GUINT_TO_POINTER (id + 1));
+
+	for (key = entry->keys; *key; key++)
+		add_key (self, *key, id);
+}
+
+static void
+add_key (LdSymbolIndex *self, const gchar *key, guint id)
+{
+	const gchar *p;
+	gsize i, length;
+
+	for (p = key; *p; p = g_utf8_next_char (p))
+	{
+		Word word;
+
+		if (!is_word_start (key, p))
+			continue;
+
+		word.word = p;
+		word.id = id;
+		g_array_append_val (self->words, word);
+		self->words_sorted = FALSE;
+	}
+
+	length = strlen (key);
+	for (i = 0; i + 3 <= length; i++)
+	{
+		GArray *postings;
+
+		postings = g_hash_table_lookup (self->trigrams, TRIGRAM (key + i));
+		if (!postings)
+		{
+			postings = g_array_new (FALSE, FALSE, sizeof (guint));
+			g_hash_table_insert (self->trigrams, TRIGRAM (key + i), postings);
+		}
+		/* Keys of an entry are added one after another. */
+		else if (g_array_index (postings, guint, postings->len - 1) == id)
+			continue;
+
+		g_array_append_val (postings, id);
+	}
+}
+
+/**
+ * ld_symbol_index_remove:
+ * @self: an #LdSymbolIndex structure.
+ * @identifier: the identifier to be removed.
+ *
+ * Remove an identifier from the index.
+ */
+void
+ld_symbol_index_remove (LdSymbolIndex *self, const gchar *identifier)
+{
+	Entry *entry;
+	gpointer id;
+
+	g_return_if_fail (self != NULL);
+	g_return_if_fail (identifier != NULL);
+
+	id = g_hash_table_lookup (self->ids, identifier);
+	if (!id)
+		return;
+
+	/* The entry stays in place until the index is compacted. */
+	entry = g_ptr_array_index (self->entries, GPOINTER_TO_UINT (id) - 1);
+	g_hash_table_remove (self->ids, identifier);
+	g_free (entry->identifier);
+	entry->identifier = NULL;
+
+	if (++self->n_removed > COMPACT_THRESHOLD
+	 && self->n_removed > self->entries->len / 2)
+		compact (self);
+}
+
+/**
+ * ld_symbol_index_query:
+ * @self: an #LdSymbolIndex structure.
+ * @query: words to look for.
+ * @max_results: the maximum number of results, or zero for no limit.
+ *
+ * Find identifiers whose keys contain all words of the query.  Results are
+ * ordered by how well they match, exact and prefix matches go first.
+ *
+ * Return value: (transfer full): a %NULL-terminated array of identifiers.
+ *               Free it with g_strfreev().
+ */
+gchar **
+ld_symbol_index_query (LdSymbolIndex *self, const gchar *query,
+	guint max_results)
+{
+	gchar *normalized, **tokens, **identifiers;
+	GArray *candidates, *results;
+	guint i;
+
+	g_return_val_if_fail (self != NULL, NULL);
+	g_return_val_if_fail (query != NULL, NULL);
+
+	normalized = normalize (query);
+	tokens = split_words (normalized);
+	g_free (normalized);
+
+	results = g_array_new (FALSE, FALSE, sizeof (Result));
+	candidates = find_candidates (self, tokens);
+	for (i = 0; i < candidates->len; i++)
+	{
+		Result result;
+
+		result.entry = g_ptr_array_index (self->entries,
+			g_array_index (candidates, guint, i));
+		if (!result.entry->identifier)
+			continue;
+
+		result.score = score_entry (result.entry, tokens);
+		if (result.score)
+			g_array_append_val (results, result);
+	}
+	g_array_unref (candidates);
+	g_strfreev (tokens);
+
+	g_array_sort (results, compare_results);
+	if (max_results && results->len > max_results)
+		g_array_set_size (results, max_results);
+
+	identifiers = g_new (gchar *, results->len + 1);
+	for (i = 0; i < results->len; i++)
+		identifiers[i] = g_strdup
+			(g_array_index (results, Result, i).entry->identifier);
+	identifiers[i] = NULL;
+
+	g_array_unref (results);
+	return identifiers;
+}
+
+/*
+ * find_candidates:
+ *
+ * Retrieve indexes of entries that may match all of the words, using
+ * the most selective of them.
+ */
+static GArray *
+find_candidates (LdSymbolIndex *self, gchar **tokens)
+{
+	GArray *best = NULL, *candidates;
+	const gchar *prefix = NULL;
+	gchar **token;
+	gsize i, length;
+
+	candidates = g_array_new (FALSE, FALSE, sizeof (guint));
+	for (token = tokens; *token; token++)
+	{
+		length = strlen (*token);
+		if (length < 3)
+		{
+			if (!prefix || length > strlen (prefix))
+				prefix = *token;
+			continue;
+		}
+
+		for (i = 0; i + 3 <= length; i++)
+		{
+			GArray *postings;
+
+			postings = g_hash_table_lookup (self->trigrams,
+				TRIGRAM (*token + i));
+			if (!postings)
+				return candidates;
+			if (!best || postings->len < best->len)
+				best = postings;
+		}
+	}
+
+	if (best)
+		g_array_append_vals (candidates, best->data, best->len);
+	else if (prefix)
+	{
+		GHashTable *seen;
+		guint low, high, mid;
+
+		if (!self->words_sorted)
+		{
+			g_array_sort (self->words, compare_words);
+			self->words_sorted = TRUE;
+		}
+
+		/* Find the first word that isn't less than the prefix. */
+		length = strlen (prefix);
+		for (low = 0, high = self->words->len; low < high; )
+		{
+			mid = low + (high - low) / 2;
+			if (strcmp (g_array_index (self->words, Word, mid).word,
+				prefix) < 0)
+				low = mid + 1;
+			else
+				high = mid;
+		}
+
+		seen = g_hash_table_new (g_direct_hash, g_direct_equal);
+		for (; low < self->words->len; low++)
+		{
+			Word *word;
+
+			word = &g_array_index (self->words, Word, low);
+			if (strncmp (word->word, prefix, length))
+				break;
+			if (g_hash_table_contains (seen, GUINT_TO_POINTER (word->id + 1)))
+				continue;
+
+			g_hash_table_add (seen, GUINT_TO_POINTER (word->id + 1));
+			g_array_append_val (candidates, word->id);
+		}
+		g_hash_table_destroy (seen);
+	}
+	return candidates;
+}
+
+/*
+ * score_entry:
+ *
+ * Return value: how well an entry matches all of the words, zero if not.
+ */
+static guint
+score_entry (Entry *entry, gchar **tokens)
+{
+	guint total = 0, best, score;
+	gchar **token, **key;
+
+	for (token = tokens; *token; token++)
+	{
+		best = 0;
+		for (key = entry->keys; *key; key++)
+		{
+			score = score_key (*key, *token);
+			if (score > best)
+				best = score;
+		}
+		if (!best)
+			return 0;
+		total += best;
+	}
+	return total;
+}
+
+static guint
+score_key (const gchar *key, const gchar *token)
+{
+	const gchar *p;
+	guint score = 0;
+
+	if (!strcmp (key, token))
+		return 4;
+
+	for (p = strstr (key, token); p; p = strstr (p + 1, token))
+	{
+		if (p == key)
+			return 3;
+		if (is_word_start (key, p))
+			score = 2;
+		else if (!score && strlen (token) >= 3)
+			score = 1;
+	}
+	return score;
+}
+
+static gint
+compare_words (gconstpointer a, gconstpointer b)
+{
+	return strcmp (((const Word *) a)->word, ((const Word *) b)->word);
+}
+
+static gint
+compare_results (gconstpointer a, gconstpointer b)
+{
+	const Result *ra = a, *rb = b;
+
+	if (ra->score != rb->score)
+		return ra->score > rb->score ? -1 : 1;
+	return strcmp (ra->entry->identifier, rb->entry->identifier);
+}
+
+/*
+ * normalize:
+ *
+ * Fold case and strip diacritics.
+ */
+static gchar *
+normalize (const gchar *text)
+{
+	gchar *folded, *decomposed, *p;
+	GString *result;
+
+	folded = g_utf8_casefold (text, -1);
+	decomposed = g_utf8_normalize (folded, -1, G_NORMALIZE_ALL);
+	g_free (folded);
+
+	/* Invalid UTF-8 can't be found. */
+	if (!decomposed)
+		return g_strdup ("");
+
+	result = g_string_sized_new (strlen (decomposed));
+	for (p = decomposed; *p; p = g_utf8_next_char (p))
+	{
+		gunichar c;
+
+		c = g_utf8_get_char (p);
+		if (g_unichar_type (c) != G_UNICODE_NON_SPACING_MARK)
+			g_string_append_unichar (result, c);
+	}
+	g_free (decomposed);
+	return g_string_free (result, FALSE);
+}
+
+/*
+ * split_words:
+ *
+ * Split normalized text into words made of letters and digits.
+ */
+static gchar **
+split_words (const gchar *text)
+{
+	GPtrArray *words;
+	const gchar *p, *start = NULL;
+
+	words = g_ptr_array_new ();
+	for (p = text; ; p = g_utf8_next_char (p))
+	{
+		if (*p && g_unichar_isalnum (g_utf8_get_char (p)))
+		{
+			if (!start)
+				start = p;
+			continue;
+		}
+		if (start)
+			g_ptr_array_add (words, g_strndup (start, p - start));
+		start = NULL;
+		if (!*p)
+			break;
+	}
+	g_ptr_array_add (words, NULL);
+	return (gchar **) g_ptr_array_free (words, FALSE);
+}
+
+static gboolean
+is_word_start (const gchar *text, const gchar *p)
+{
+	if (!g_unichar_isalnum (g_utf8_get_char (p)))
+		return FALSE;
+	return p == text
+		|| !g_unichar_isalnum (g_utf8_get_char (g_utf8_prev_char (p)));
+}
@@ -0,0 +1,37 @@
+/*
+ * ld-symbol-index.h
+ *
+ * This file is a part of logdiag.
+ * Copyright 2026 Přemysl Eric Janouch
+ *
+ * See the file LICENSE for licensing information.
+ *
+ */
+
+#ifndef __LD_SYMBOL_INDEX_H__
+#define __LD_SYMBOL_INDEX_H__
+
+G_BEGIN_DECLS
+
+
+/**
+ * LdSymbolIndex:
+ *
+ * An opaque search index.
+ */
+typedef struct _LdSymbolIndex LdSymbolIndex;
+
+
+LdSymbolIndex *ld_symbol_index_new (void);
+void ld_symbol_index_free (LdSymbolIndex *self);
+
+void ld_symbol_index_insert (LdSymbolIndex *self, const gchar *identifier,
+	const gchar *const *keys);
+void ld_symbol_index_remove (LdSymbolIndex *self, const gchar *identifier);
+gchar **ld_symbol_index_query (LdSymbolIndex *self, const gchar *query,
+	guint max_results);
+
+
+G_END_DECLS
+
+#endif /* ! __LD_SYMBOL_INDEX_H__ */
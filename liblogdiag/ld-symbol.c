@@ -171,6 +171,33 @@ ld_symbol_get_human_name (LdSymbol *self)
 	return klass->get_human_name (self);
 }
 
+/**
+ * ld_symbol_get_human_names:
+ * @self: an #LdSymbol object.
+ *
+ * Get human names of the symbol in all languages it has been translated to.
+ * Symbols that don't implement this only have their localised name.
+ *
+ * Return value: (transfer full): a %NULL-terminated array of names.
+ *               Free it with g_strfreev().
+ */
+gchar **
+ld_symbol_get_human_names (LdSymbol *self)
+{
+	LdSymbolClass *klass;
+	gchar **names;
+
+	g_return_val_if_fail (LD_IS_SYMBOL (self), NULL);
+
+	klass = LD_SYMBOL_GET_CLASS (self);
+	if (klass->get_human_names)
+		return klass->get_human_names (self);
+
+	names = g_new0 (gchar *, 2);
+	names[0] = g_strdup (ld_symbol_get_human_name (self));
+	return names;
+}
+
 /**
  * ld_symbol_get_area:
  * @self: an #LdSymbol object.
@@ -41,6 +41,7 @@ struct _LdSymbol
  * LdSymbolClass:
  * @get_name: get the name of the symbol.
  * @get_human_name: get the localized human name of the symbol.
+ * @get_human_names: get human names of the symbol in all languages.
  * @get_area: get the area of the symbol.
  * @get_terminals: get a list of symbol terminals.
  * @draw: draw the symbol on a Cairo surface.
@@ -53,6 +54,7 @@ struct _LdSymbolClass
 /*< public >*/
 	const gchar *(*get_name) (LdSymbol *self);
 	const gchar *(*get_human_name) (LdSymbol *self);
+	gchar **(*get_human_names) (LdSymbol *self);
 	void (*get_area) (LdSymbol *self, LdRectangle *area);
 	const LdPointArray *(*get_terminals) (LdSymbol *self);
 	void (*draw) (LdSymbol *self, cairo_t *cr);
@@ -63,6 +65,7 @@ GType ld_symbol_get_type (void) G_GNUC_CONST;
 
 const gchar *ld_symbol_get_name (LdSymbol *self);
 const gchar *ld_symbol_get_human_name (LdSymbol *self);
+gchar **ld_symbol_get_human_names (LdSymbol *self);
 void ld_symbol_get_area (LdSymbol *self, LdRectangle *area);
 const LdPointArray *ld_symbol_get_terminals (LdSymbol *self);
 void ld_symbol_draw (LdSymbol *self, cairo_t *cr);
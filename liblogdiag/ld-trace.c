@@ -0,0 +1,188 @@
+/*
+ * ld-trace.c
+ *
+ * This file is a part of logdiag.
+ * Copyright 2026 Přemysl Eric Janouch
+ *
+ * See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <glib/gstdio.h>
+
+#include "liblogdiag.h"
+#include "config.h"
+
+
+/**
+ * SECTION:ld-trace
+ * @short_description: Trace events
+ *
+ * When the %LD_TRACE_ENVIRONMENT environment variable names a file,
+ * scoped events are written into it in the Chrome trace event format,
+ * which can be opened in chrome://tracing, Perfetto or speedscope.
+ *
+ * |[
+ * gint64 trace = ld_trace_begin ();
+ * load_something (filename);
+ * ld_trace_end (trace, "category", "load_something", filename);
+ * ]|
+ *
+ * Otherwise tracing costs a single branch.
+ */
+
+static FILE *trace_file;
+static gboolean trace_first = TRUE;
+static gint trace_last_thread;
+static GMutex trace_mutex;
+static GPrivate trace_thread;
+
+static void trace_init (void);
+static void trace_close (void);
+static gint trace_get_thread_id (void);
+static void trace_write_string (const gchar *string);
+
+
+static void
+trace_init (void)
+{
+	static gsize initialized;
+	const gchar *filename;
+
+	if (!g_once_init_enter (&initialized))
+		return;
+
+	filename = g_getenv (LD_TRACE_ENVIRONMENT);
+	if (filename && *filename)
+	{
+		trace_file = g_fopen (filename, "w");
+		if (!trace_file)
+			g_warning ("cannot open `%s' for tracing: %s",
+				filename, g_strerror (errno));
+		else
+		{
+			fputs ("[\n", trace_file);
+			atexit (trace_close);
+		}
+	}
+	g_once_init_leave (&initialized, 1);
+}
+
+static void
+trace_close (void)
+{
+	g_mutex_lock (&trace_mutex);
+	fputs ("\n]\n", trace_file);
+	fclose (trace_file);
+	trace_file = NULL;
+	g_mutex_unlock (&trace_mutex);
+}
+
+static gint
+trace_get_thread_id (void)
+{
+	gint id;
+
+	id = GPOINTER_TO_INT (g_private_get (&trace_thread));
+	if (!id)
+	{
+		id = g_atomic_int_add (&trace_last_thread, 1) + 1;
+		g_private_set (&trace_thread, GINT_TO_POINTER (id));
+	}
+	return id;
+}
+
+static void
+trace_write_string (const gchar *string)
+{
+	const gchar *p;
+
+	fputc ('"', trace_file);
+	for (p = string; *p; p++)
+	{
+		if (*p == '"' || *p == '\\')
+			fprintf (trace_file, "\\%c", *p);
+		else if ((guchar) *p < 0x20)
+			fprintf (trace_file, "\\u%04x", (guchar) *p);
+		else
+			fputc (*p, trace_file);
+	}
+	fputc ('"', trace_file);
+}
+
+/**
+ * ld_trace_is_enabled:
+ *
+ * Return value: whether trace events are being written.
+ */
+gboolean
+ld_trace_is_enabled (void)
+{
+	trace_init ();
+	return trace_file != NULL;
+}
+
+/**
+ * ld_trace_begin:
+ *
+ * Start a scoped event.
+ *
+ * Return value: a value to pass to ld_trace_end().
+ */
+gint64
+ld_trace_begin (void)
+{
+	return ld_trace_is_enabled () ? g_get_monotonic_time () : 0;
+}
+
+/**
+ * ld_trace_end:
+ * @start: the value returned by ld_trace_begin().
+ * @category: the category of the event.
+ * @name: the name of the event.
+ * @detail: (allow-none): an argument to the event, such as a filename.
+ *
+ * End a scoped event and write it out.
+ */
+void
+ld_trace_end (gint64 start, const gchar *category,
+	const gchar *name, const gchar *detail)
+{
+	gint64 end;
+
+	g_return_if_fail (category != NULL);
+	g_return_if_fail (name != NULL);
+
+	if (!start)
+		return;
+
+	end = g_get_monotonic_time ();
+	g_mutex_lock (&trace_mutex);
+	if (!trace_file)
+		goto out;
+
+	if (!trace_first)
+		fputs (",\n", trace_file);
+	trace_first = FALSE;
+
+	fputs ("{\"cat\": ", trace_file);
+	trace_write_string (category);
+	fputs (", \"name\": ", trace_file);
+	trace_write_string (name);
+	fprintf (trace_file, ", \"ph\": \"X\", \"pid\": 1, \"tid\": %d"
+		", \"ts\": %" G_GINT64_FORMAT ", \"dur\": %" G_GINT64_FORMAT,
+		trace_get_thread_id (), start, end - start);
+	if (detail)
+	{
+		fputs (", \"args\": {\"detail\": ", trace_file);
+		trace_write_string (detail);
+		fputc ('}', trace_file);
+	}
+	fputc ('}', trace_file);
+
+out:
+	g_mutex_unlock (&trace_mutex);
+}
@@ -0,0 +1,33 @@
+/*
+ * ld-trace.h
+ *
+ * This file is a part of logdiag.
+ * Copyright 2026 Přemysl Eric Janouch
+ *
+ * See the file LICENSE for licensing information.
+ *
+ */
+
+#ifndef __LD_TRACE_H__
+#define __LD_TRACE_H__
+
+G_BEGIN_DECLS
+
+
+/**
+ * LD_TRACE_ENVIRONMENT:
+ *
+ * The environment variable naming the file to write trace events into.
+ */
+#define LD_TRACE_ENVIRONMENT "LOGDIAG_TRACE"
+
+
+gboolean ld_trace_is_enabled (void);
+gint64 ld_trace_begin (void);
+void ld_trace_end (gint64 start, const gchar *category,
+	const gchar *name, const gchar *detail);
+
+
+G_END_DECLS
+
+#endif /* ! __LD_TRACE_H__ */
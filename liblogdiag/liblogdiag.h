@@ -25,8 +25,11 @@
 
 #include "ld-marshal.h"
 #include "ld-types.h"
+#include "ld-trace.h"
+#include "ld-journal.h"
 
 #include "ld-symbol.h"
+#include "ld-symbol-index.h"
 #include "ld-category.h"
 #include "ld-library.h"
 
@@ -35,6 +38,10 @@
 #include "ld-diagram-symbol.h"
 #include "ld-diagram-connection.h"
 #include "ld-diagram.h"
+#include "ld-diagram-diff.h"
+#include "ld-document.h"
+#include "ld-netlist.h"
+#include "ld-router.h"
 
 #include "ld-diagram-view.h"
 #include "ld-category-view.h"
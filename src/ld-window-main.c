@@ -8,6 +8,10 @@
  *
  */
 
+#include <string.h>
+#include <math.h>
+#include <glib/gstdio.h>
+
 #include <liblogdiag/liblogdiag.h>
 #include "config.h"
 
@@ -18,6 +22,25 @@
 #include <shellapi.h>
 #endif
 
+/* The maximum number of symbols to show when searching the library. */
+#define LIBRARY_SEARCH_MAX_RESULTS 100
+
+/* Unsaved changes are recorded next to the diagram in a file like this. */
+#define JOURNAL_SUFFIX ".journal"
+/* Journals that can't be replayed are moved aside by adding this. */
+#define FAILED_JOURNAL_SUFFIX ".failed"
+
+/* Copied objects for windows of the same process. */
+#define CLIPBOARD_TARGET_OBJECTS "application/x-logdiag-objects"
+/* Copied objects in the file format for other processes. */
+#define CLIPBOARD_TARGET_DIAGRAM "application/x-logdiag-diagram"
+
+enum
+{
+	CLIPBOARD_OBJECTS,
+	CLIPBOARD_DIAGRAM
+};
+
 
 struct _LdWindowMainPrivate
 {
@@ -31,6 +54,8 @@ struct _LdWindowMainPrivate
 	GtkWidget *toolbar;
 
 	GtkWidget *library_view;
+	GtkWidget *lv_box;
+	GtkWidget *lv_search;
 	GtkWidget *lv_window;
 	GtkWidget *lv_viewport;
 
@@ -38,6 +63,9 @@ struct _LdWindowMainPrivate
 
 	LdDiagram *diagram;
 	gchar *filename;
+	LdJournal *journal;
+
+	JsonNode *clipboard_fragment;
 
 	GtkWidget *scrolled_window;
 	LdDiagramView *view;
@@ -55,6 +83,7 @@ struct _LdWindowMainPrivate
 /* ===== Local functions =================================================== */
 
 static void ld_window_main_finalize (GObject *gobject);
+static LdLibrary *get_shared_library (void);
 static void load_library_directories (LdLibrary *library);
 static void display_and_free_error (LdWindowMain *self, const gchar *title,
 	GError *error);
@@ -89,6 +118,11 @@ static gboolean diagram_open (LdWindowMain *self, const gchar *filename);
 static gboolean diagram_save (LdWindowMain *self, GtkWindow *dialog_parent,
 	const gchar *filename);
 
+static void journal_open (LdWindowMain *self, const gchar *filename,
+	gboolean truncate);
+static void journal_close (LdWindowMain *self);
+static gboolean journal_recover (LdWindowMain *self, const gchar *filename);
+
 static GtkFileFilter *diagram_get_file_filter (void);
 static void diagram_show_open_dialog (LdWindowMain *self);
 static void diagram_show_save_as_dialog (LdWindowMain *self);
@@ -101,6 +135,7 @@ static void on_symbol_selected (LdCategoryView *view,
 	LdSymbol *symbol, const gchar *path, LdWindowMain *self);
 static void on_symbol_deselected (LdCategoryView *view,
 	LdSymbol *symbol, const gchar *path, LdWindowMain *self);
+static void on_library_search_changed (GtkEntry *entry, LdWindowMain *self);
 
 static void on_action_new (GtkAction *action, LdWindowMain *self);
 static void on_action_open (GtkAction *action, LdWindowMain *self);
@@ -117,6 +152,9 @@ static gboolean on_action_about_activate_link (GtkAboutDialog *dialog,
 
 static void on_action_undo (GtkAction *action, LdWindowMain *self);
 static void on_action_redo (GtkAction *action, LdWindowMain *self);
+static void on_action_cut (GtkAction *action, LdWindowMain *self);
+static void on_action_copy (GtkAction *action, LdWindowMain *self);
+static void on_action_paste (GtkAction *action, LdWindowMain *self);
 static void on_action_delete (GtkAction *action, LdWindowMain *self);
 static void on_action_select_all (GtkAction *action, LdWindowMain *self);
 
@@ -125,11 +163,22 @@ static void on_action_main_toolbar (GtkToggleAction *action,
 static void on_action_library_pane (GtkToggleAction *action,
 	LdWindowMain *self);
 static void on_action_grid (GtkToggleAction *action, LdWindowMain *self);
+static void on_action_profile (GtkToggleAction *action, LdWindowMain *self);
 
 static void on_action_zoom_in (GtkAction *action, LdWindowMain *self);
 static void on_action_zoom_out (GtkAction *action, LdWindowMain *self);
 static void on_action_normal_size (GtkAction *action, LdWindowMain *self);
 
+static gboolean clipboard_copy (LdWindowMain *self);
+static void on_clipboard_get (GtkClipboard *clipboard,
+	GtkSelectionData *selection_data, guint info, gpointer user_data);
+static void on_clipboard_clear (GtkClipboard *clipboard, gpointer user_data);
+static void on_clipboard_objects_received (GtkClipboard *clipboard,
+	GtkSelectionData *selection_data, gpointer user_data);
+static void on_clipboard_diagram_received (GtkClipboard *clipboard,
+	GtkSelectionData *selection_data, gpointer user_data);
+static void paste_fragment (LdWindowMain *self, JsonNode *fragment);
+
 
 /* ===== Local variables =================================================== */
 
@@ -165,11 +214,15 @@ static GtkActionEntry wm_action_entries[] =
 		{"Redo", GTK_STOCK_REDO, N_("_Redo"), "<Shift><Ctrl>Z",
 			N_("Redo the last undone action"),
 			G_CALLBACK (on_action_redo)},
-/*
- *		{"Cut", GTK_STOCK_CUT, N_("Cu_t"), "<Ctrl>X", NULL, NULL},
- *		{"Copy", GTK_STOCK_COPY, N_("_Copy"), "<Ctrl>C", NULL, NULL},
- *		{"Paste", GTK_STOCK_PASTE, N_("_Paste"), "<Ctrl>V", NULL, NULL},
- */
+		{"Cut", GTK_STOCK_CUT, N_("Cu_t"), "<Ctrl>X",
+			N_("Move the selection to the clipboard"),
+			G_CALLBACK (on_action_cut)},
+		{"Copy", GTK_STOCK_COPY, N_("_Copy"), "<Ctrl>C",
+			N_("Copy the selection to the clipboard"),
+			G_CALLBACK (on_action_copy)},
+		{"Paste", GTK_STOCK_PASTE, N_("_Paste"), "<Ctrl>V",
+			N_("Paste the contents of the clipboard"),
+			G_CALLBACK (on_action_paste)},
 		{"Delete", GTK_STOCK_DELETE, N_("_Delete"), "Delete",
 			N_("Delete the contents of the selection"),
 			G_CALLBACK (on_action_delete)},
@@ -207,7 +260,12 @@ static GtkToggleActionEntry wm_toggle_action_entries[] =
 		G_CALLBACK (on_action_library_pane), TRUE},
 	{"ShowGrid", NULL, N_("Show _Grid"), "numbersign",
 		N_("Toggle displaying of the grid"),
-		G_CALLBACK (on_action_grid), TRUE}
+		G_CALLBACK (on_action_grid), TRUE},
+
+	/* Only bound to an accelerator, meant for developers. */
+	{"ShowProfile", NULL, N_("Show _Profile"), "<Shift><Ctrl>F12",
+		N_("Toggle profiling of the diagram view"),
+		G_CALLBACK (on_action_profile), FALSE}
 };
 
 
@@ -313,9 +371,21 @@ ld_window_main_init (LdWindowMain *self)
 		GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
 	gtk_container_add (GTK_CONTAINER (priv->lv_window), priv->lv_viewport);
 
+	priv->lv_search = gtk_search_entry_new ();
+	gtk_entry_set_placeholder_text (GTK_ENTRY (priv->lv_search),
+		_("Search symbols"));
+	g_signal_connect (priv->lv_search, "changed",
+		G_CALLBACK (on_library_search_changed), self);
+
+	priv->lv_box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
+	gtk_box_pack_start (GTK_BOX (priv->lv_box),
+		priv->lv_search, FALSE, FALSE, 0);
+	gtk_box_pack_start (GTK_BOX (priv->lv_box),
+		priv->lv_window, TRUE, TRUE, 0);
+
 	priv->paned = gtk_paned_new (GTK_ORIENTATION_HORIZONTAL);
 	gtk_paned_pack1 (GTK_PANED (priv->paned),
-		priv->lv_window, FALSE, FALSE);
+		priv->lv_box, FALSE, FALSE);
 	gtk_paned_pack2 (GTK_PANED (priv->paned),
 		priv->scrolled_window, TRUE, TRUE);
 	gtk_paned_set_position (GTK_PANED (priv->paned), 180);
@@ -339,6 +409,7 @@ ld_window_main_init (LdWindowMain *self)
 
 	/* Initialize the backend. */
 	priv->diagram = ld_diagram_new ();
+	ld_diagram_set_canonical (priv->diagram, TRUE);
 
 	g_signal_connect_after (priv->diagram, "changed",
 		G_CALLBACK (on_diagram_changed), self);
@@ -349,8 +420,7 @@ ld_window_main_init (LdWindowMain *self)
 	g_signal_connect_after (priv->diagram, "selection-changed",
 		G_CALLBACK (on_diagram_selection_changed), self);
 
-	priv->library = ld_library_new ();
-	load_library_directories (priv->library);
+	priv->library = get_shared_library ();
 
 	ld_diagram_view_set_diagram (priv->view, priv->diagram);
 	ld_diagram_view_set_library (priv->view, priv->library);
@@ -380,6 +450,8 @@ ld_window_main_init (LdWindowMain *self)
 
 	action_set_sensitive (self, "Undo", FALSE);
 	action_set_sensitive (self, "Redo", FALSE);
+	action_set_sensitive (self, "Cut", FALSE);
+	action_set_sensitive (self, "Copy", FALSE);
 	action_set_sensitive (self, "Delete", FALSE);
 	action_set_sensitive (self, "NormalSize", FALSE);
 
@@ -409,6 +481,10 @@ ld_window_main_finalize (GObject *gobject)
 
 	self = LD_WINDOW_MAIN (gobject);
 
+	/* The diagram has either been saved or the user has let it go. */
+	ld_diagram_set_journal (self->priv->diagram, NULL);
+	journal_close (self);
+
 	/* Dispose of objects. Note that GtkObject has floating ref. by default
 	 * and gtk_object_destroy () should be used for it.
 	 */
@@ -425,6 +501,32 @@ ld_window_main_finalize (GObject *gobject)
 	G_OBJECT_CLASS (ld_window_main_parent_class)->finalize (gobject);
 }
 
+/*
+ * get_shared_library:
+ *
+ * All windows of the process share a single library, which is loaded
+ * the first time it's needed and lives for as long as any window holds
+ * a reference to it.
+ *
+ * Return value: (transfer full): the library.
+ */
+static LdLibrary *
+get_shared_library (void)
+{
+	static LdLibrary *library;
+
+	if (library)
+		return g_object_ref (library);
+
+	library = ld_library_new ();
+	g_object_add_weak_pointer (G_OBJECT (library), (gpointer *) &library);
+
+	ld_library_set_lazy (library, TRUE);
+	ld_library_set_watch (library, TRUE);
+	load_library_directories (library);
+	return library;
+}
+
 static void
 load_library_directories (LdLibrary *library)
 {
@@ -603,6 +705,8 @@ on_diagram_selection_changed (LdDiagram *diagram, LdWindowMain *self)
 	gboolean selection_empty;
 
 	selection_empty = !ld_diagram_get_selection (diagram);
+	action_set_sensitive (self, "Cut", !selection_empty);
+	action_set_sensitive (self, "Copy", !selection_empty);
 	action_set_sensitive (self, "Delete", !selection_empty);
 }
 
@@ -655,6 +759,9 @@ diagram_new (LdWindowMain *self)
 		" closing it and creating a new one?")))
 		return;
 
+	ld_diagram_set_journal (self->priv->diagram, NULL);
+	journal_close (self);
+
 	ld_diagram_clear (self->priv->diagram);
 	ld_diagram_set_modified (self->priv->diagram, FALSE);
 
@@ -699,6 +806,14 @@ diagram_save (LdWindowMain *self, GtkWindow *dialog_parent,
 		return FALSE;
 	}
 
+	/* Changes are now going to be recorded against another file. */
+	if (g_strcmp0 (filename, self->priv->filename))
+	{
+		ld_diagram_set_journal (self->priv->diagram, NULL);
+		journal_close (self);
+		journal_open (self, filename, TRUE);
+	}
+
 	ld_diagram_set_modified (self->priv->diagram, FALSE);
 	update_title (self);
 	return TRUE;
@@ -715,7 +830,10 @@ diagram_open (LdWindowMain *self, const gchar *filename)
 	GError *error = NULL;
 	GFile *file;
 	gchar *uri;
+	gboolean recovered;
 
+	/* Loading is not a change to be recorded. */
+	ld_diagram_set_journal (self->priv->diagram, NULL);
 	ld_diagram_load_from_file (self->priv->diagram, filename, &error);
 	if (error)
 	{
@@ -727,7 +845,7 @@ diagram_open (LdWindowMain *self, const gchar *filename)
 			GTK_DIALOG_MODAL, GTK_MESSAGE_ERROR, GTK_BUTTONS_OK,
 			_("Failed to open the file"));
 
-		if (error->domain != G_FILE_ERROR)
+		if (error->domain != G_FILE_ERROR && error->domain != G_IO_ERROR)
 		{
 			gchar *display_filename;
 
@@ -746,8 +864,10 @@ diagram_open (LdWindowMain *self, const gchar *filename)
 		gtk_widget_destroy (message_dialog);
 
 		g_error_free (error);
+		ld_diagram_set_journal (self->priv->diagram, self->priv->journal);
 		return FALSE;
 	}
+	journal_close (self);
 
 	file = g_file_new_for_path (filename);
 	uri = g_file_get_uri (file);
@@ -756,13 +876,136 @@ diagram_open (LdWindowMain *self, const gchar *filename)
 	g_free (uri);
 
 	ld_diagram_set_modified (self->priv->diagram, FALSE);
+	recovered = journal_recover (self, filename);
 	diagram_set_filename (self, g_strdup (filename));
 
+	/* Recovered changes remain in the journal until they are saved. */
+	journal_open (self, filename, !recovered);
+
 	ld_diagram_view_set_x (self->priv->view, 0);
 	ld_diagram_view_set_y (self->priv->view, 0);
 	return TRUE;
 }
 
+/*
+ * journal_open:
+ * @filename: the file of the diagram.
+ * @truncate: whether to throw away anything recorded so far.
+ *
+ * Start recording changes to the diagram next to its file.
+ */
+static void
+journal_open (LdWindowMain *self, const gchar *filename, gboolean truncate)
+{
+	GError *error = NULL;
+	gchar *path;
+
+	g_return_if_fail (self->priv->journal == NULL);
+
+	path = g_strconcat (filename, JOURNAL_SUFFIX, NULL);
+	self->priv->journal = ld_journal_new (path, &error);
+	g_free (path);
+
+	if (self->priv->journal && truncate)
+		ld_journal_truncate (self->priv->journal, &error);
+	if (error)
+	{
+		g_warning ("%s", error->message);
+		g_error_free (error);
+	}
+	ld_diagram_set_journal (self->priv->diagram, self->priv->journal);
+}
+
+/*
+ * journal_close:
+ *
+ * Stop recording changes to the diagram and remove the journal.
+ * It has to be detached from the diagram beforehand.
+ */
+static void
+journal_close (LdWindowMain *self)
+{
+	gchar *path;
+
+	if (!self->priv->journal)
+		return;
+
+	path = g_strdup (ld_journal_get_filename (self->priv->journal));
+	ld_journal_free (self->priv->journal);
+	self->priv->journal = NULL;
+
+	g_unlink (path);
+	g_free (path);
+}
+
+/*
+ * journal_recover:
+ * @filename: the file of the diagram that has just been opened.
+ *
+ * If there are changes left over from an earlier session that ended
+ * abruptly, offer the user to apply them.
+ *
+ * Return value: %TRUE if the changes have been recovered.
+ */
+static gboolean
+journal_recover (LdWindowMain *self, const gchar *filename)
+{
+	GtkWidget *message_dialog;
+	GStatBuf info;
+	GError *error = NULL;
+	gchar *path, *name, *failed_path;
+	gboolean recovered = FALSE;
+
+	path = g_strconcat (filename, JOURNAL_SUFFIX, NULL);
+	if (g_stat (path, &info) || !info.st_size)
+	{
+		g_free (path);
+		return FALSE;
+	}
+
+	name = g_filename_display_basename (filename);
+	message_dialog = gtk_message_dialog_new (GTK_WINDOW (self),
+		GTK_DIALOG_MODAL, GTK_MESSAGE_QUESTION, GTK_BUTTONS_NONE,
+		_("Recover unsaved changes to diagram \"%s\"?"), name);
+	gtk_message_dialog_format_secondary_text
+		(GTK_MESSAGE_DIALOG (message_dialog),
+		_("The diagram has been modified when the program last ended"
+		" without saving it."));
+	gtk_dialog_add_buttons (GTK_DIALOG (message_dialog),
+		_("_Discard Changes"), GTK_RESPONSE_NO,
+		_("_Recover"), GTK_RESPONSE_YES,
+		NULL);
+	gtk_dialog_set_default_response
+		(GTK_DIALOG (message_dialog), GTK_RESPONSE_YES);
+	g_free (name);
+
+	if (gtk_dialog_run (GTK_DIALOG (message_dialog)) == GTK_RESPONSE_YES)
+	{
+		recovered = ld_diagram_replay_journal
+			(self->priv->diagram, path, &error);
+		if (recovered)
+			ld_diagram_set_modified (self->priv->diagram, TRUE);
+		else
+		{
+			/* The journal would be truncated, keep it for manual recovery. */
+			failed_path = g_strconcat (path, FAILED_JOURNAL_SUFFIX, NULL);
+			if (!g_rename (path, failed_path))
+			{
+				name = g_filename_display_name (failed_path);
+				g_prefix_error (&error,
+					_("The changes have been kept in \"%s\": "), name);
+				g_free (name);
+			}
+			g_free (failed_path);
+			display_and_free_error (self,
+				_("Failed to recover the changes"), error);
+		}
+	}
+	gtk_widget_destroy (message_dialog);
+	g_free (path);
+	return recovered;
+}
+
 /*
  * diagram_get_file_filter:
  *
@@ -960,6 +1203,41 @@ on_symbol_deselected (LdCategoryView *view,
 		self->priv->statusbar_menu_context_id);
 }
 
+static void
+on_library_search_changed (GtkEntry *entry, LdWindowMain *self)
+{
+	GHashTable *filter;
+	const gchar *text;
+	gchar **results, **iter, *p;
+
+	text = gtk_entry_get_text (entry);
+	if (!*text)
+	{
+		ld_category_tree_view_set_filter
+			(LD_CATEGORY_TREE_VIEW (self->priv->library_view), NULL);
+		return;
+	}
+
+	/* Let through the results and every category on the way to them. */
+	filter = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	results = ld_library_search (self->priv->library,
+		text, LIBRARY_SEARCH_MAX_RESULTS);
+	for (iter = results; *iter; iter++)
+	{
+		while ((p = strrchr (*iter, LD_LIBRARY_IDENTIFIER_SEPARATOR[0])))
+		{
+			g_hash_table_add (filter, g_strdup (*iter));
+			*p = '\0';
+		}
+		g_hash_table_add (filter, g_strdup (*iter));
+	}
+	g_strfreev (results);
+
+	ld_category_tree_view_set_filter
+		(LD_CATEGORY_TREE_VIEW (self->priv->library_view), filter);
+	g_hash_table_unref (filter);
+}
+
 static void
 on_view_zoom_changed (LdDiagramView *view, GParamSpec *pspec,
 	LdWindowMain *self)
@@ -1226,6 +1504,60 @@ on_action_redo (GtkAction *action, LdWindowMain *self)
 	ld_diagram_redo (self->priv->diagram);
 }
 
+static void
+on_action_cut (GtkAction *action, LdWindowMain *self)
+{
+	GtkWidget *focus;
+
+	/* Accelerators take precedence over the library search entry. */
+	focus = gtk_window_get_focus (GTK_WINDOW (self));
+	if (GTK_IS_EDITABLE (focus))
+		gtk_editable_cut_clipboard (GTK_EDITABLE (focus));
+	else if (clipboard_copy (self))
+		ld_diagram_remove_selection (self->priv->diagram);
+}
+
+static void
+on_action_copy (GtkAction *action, LdWindowMain *self)
+{
+	GtkWidget *focus;
+
+	focus = gtk_window_get_focus (GTK_WINDOW (self));
+	if (GTK_IS_EDITABLE (focus))
+		gtk_editable_copy_clipboard (GTK_EDITABLE (focus));
+	else
+		clipboard_copy (self);
+}
+
+static void
+on_action_paste (GtkAction *action, LdWindowMain *self)
+{
+	GtkClipboard *clipboard;
+	GtkWidget *focus;
+
+	focus = gtk_window_get_focus (GTK_WINDOW (self));
+	if (GTK_IS_EDITABLE (focus))
+	{
+		gtk_editable_paste_clipboard (GTK_EDITABLE (focus));
+		return;
+	}
+
+	/* Prefer objects copied within this process, they needn't be parsed.
+	 * Nothing stops other processes from offering the same target, though,
+	 * so it is only ever requested from one of our own windows.
+	 */
+	clipboard = gtk_widget_get_clipboard
+		(GTK_WIDGET (self), GDK_SELECTION_CLIPBOARD);
+	if (LD_IS_WINDOW_MAIN (gtk_clipboard_get_owner (clipboard)))
+		gtk_clipboard_request_contents (clipboard,
+			gdk_atom_intern_static_string (CLIPBOARD_TARGET_OBJECTS),
+			on_clipboard_objects_received, g_object_ref (self));
+	else
+		gtk_clipboard_request_contents (clipboard,
+			gdk_atom_intern_static_string (CLIPBOARD_TARGET_DIAGRAM),
+			on_clipboard_diagram_received, g_object_ref (self));
+}
+
 static void
 on_action_delete (GtkAction *action, LdWindowMain *self)
 {
@@ -1248,7 +1580,7 @@ on_action_main_toolbar (GtkToggleAction *action, LdWindowMain *self)
 static void
 on_action_library_pane (GtkToggleAction *action, LdWindowMain *self)
 {
-	gtk_widget_set_visible (self->priv->lv_window,
+	gtk_widget_set_visible (self->priv->lv_box,
 		gtk_toggle_action_get_active (action));
 }
 
@@ -1259,6 +1591,13 @@ on_action_grid (GtkToggleAction *action, LdWindowMain *self)
 		gtk_toggle_action_get_active (action));
 }
 
+static void
+on_action_profile (GtkToggleAction *action, LdWindowMain *self)
+{
+	ld_diagram_view_set_show_profile (self->priv->view,
+		gtk_toggle_action_get_active (action));
+}
+
 static void
 on_action_zoom_in (GtkAction *action, LdWindowMain *self)
 {
@@ -1276,3 +1615,180 @@ on_action_normal_size (GtkAction *action, LdWindowMain *self)
 {
 	ld_diagram_view_set_zoom (self->priv->view, 1);
 }
+
+/* ===== Clipboard ========================================================= */
+
+/*
+ * clipboard_copy:
+ *
+ * Put a copy of the selection into the clipboard.  The objects are
+ * copied in the background and serialization is deferred until
+ * another process asks for them.
+ *
+ * Return value: whether anything has been copied.
+ */
+static gboolean
+clipboard_copy (LdWindowMain *self)
+{
+	static const GtkTargetEntry targets[] =
+	{
+		{(gchar *) CLIPBOARD_TARGET_OBJECTS,
+			GTK_TARGET_SAME_APP, CLIPBOARD_OBJECTS},
+		{(gchar *) CLIPBOARD_TARGET_DIAGRAM, 0, CLIPBOARD_DIAGRAM}
+	};
+
+	GtkClipboard *clipboard;
+	JsonNode *fragment;
+
+	fragment = ld_diagram_copy_selection_deferred (self->priv->diagram);
+	if (!fragment)
+		return FALSE;
+
+	/* This clears any previous contents that we've set. */
+	clipboard = gtk_widget_get_clipboard
+		(GTK_WIDGET (self), GDK_SELECTION_CLIPBOARD);
+	if (!gtk_clipboard_set_with_owner (clipboard,
+		targets, G_N_ELEMENTS (targets),
+		on_clipboard_get, on_clipboard_clear, G_OBJECT (self)))
+	{
+		json_node_free (fragment);
+		return FALSE;
+	}
+
+	self->priv->clipboard_fragment = fragment;
+	return TRUE;
+}
+
+static void
+on_clipboard_get (GtkClipboard *clipboard,
+	GtkSelectionData *selection_data, guint info, gpointer user_data)
+{
+	LdWindowMain *self;
+	JsonGenerator *generator;
+	gchar *data;
+	gsize length;
+
+	self = LD_WINDOW_MAIN (user_data);
+	ld_diagram_finish_copy (self->priv->diagram);
+
+	switch (info)
+	{
+	case CLIPBOARD_OBJECTS:
+		/* Just pass the pointer, the receiver checks that it's ours. */
+		gtk_selection_data_set (selection_data,
+			gtk_selection_data_get_target (selection_data), 8,
+			(const guchar *) &self->priv->clipboard_fragment,
+			sizeof self->priv->clipboard_fragment);
+		break;
+	case CLIPBOARD_DIAGRAM:
+		generator = json_generator_new ();
+		json_generator_set_root (generator, self->priv->clipboard_fragment);
+		data = json_generator_to_data (generator, &length);
+		g_object_unref (generator);
+
+		gtk_selection_data_set (selection_data,
+			gtk_selection_data_get_target (selection_data), 8,
+			(const guchar *) data, length);
+		g_free (data);
+		break;
+	}
+}
+
+static void
+on_clipboard_clear (GtkClipboard *clipboard, gpointer user_data)
+{
+	LdWindowMain *self;
+
+	self = LD_WINDOW_MAIN (user_data);
+	json_node_free (self->priv->clipboard_fragment);
+	self->priv->clipboard_fragment = NULL;
+}
+
+static void
+on_clipboard_objects_received (GtkClipboard *clipboard,
+	GtkSelectionData *selection_data, gpointer user_data)
+{
+	LdWindowMain *self;
+	GObject *owner;
+	JsonNode *fragment;
+
+	self = LD_WINDOW_MAIN (user_data);
+	fragment = NULL;
+	if (gtk_selection_data_get_format (selection_data) == 8
+	 && gtk_selection_data_get_length (selection_data) == sizeof fragment)
+		memcpy (&fragment, gtk_selection_data_get_data (selection_data),
+			sizeof fragment);
+
+	/* The pointer may only be used if it's still what the owner holds. */
+	owner = gtk_clipboard_get_owner (clipboard);
+	if (!fragment || !LD_IS_WINDOW_MAIN (owner)
+	 || fragment != LD_WINDOW_MAIN (owner)->priv->clipboard_fragment)
+	{
+		/* Try the file format, someone else may own the clipboard. */
+		gtk_clipboard_request_contents (clipboard,
+			gdk_atom_intern_static_string (CLIPBOARD_TARGET_DIAGRAM),
+			on_clipboard_diagram_received, self);
+		return;
+	}
+
+	paste_fragment (self, fragment);
+	g_object_unref (self);
+}
+
+static void
+on_clipboard_diagram_received (GtkClipboard *clipboard,
+	GtkSelectionData *selection_data, gpointer user_data)
+{
+	LdWindowMain *self;
+	JsonParser *parser;
+	const guchar *data;
+	gint length;
+
+	self = LD_WINDOW_MAIN (user_data);
+	data = gtk_selection_data_get_data (selection_data);
+	length = gtk_selection_data_get_length (selection_data);
+
+	parser = json_parser_new ();
+	if (data && length > 0 && json_parser_load_from_data
+		(parser, (const gchar *) data, length, NULL))
+		paste_fragment (self, json_parser_get_root (parser));
+
+	g_object_unref (parser);
+	g_object_unref (self);
+}
+
+/*
+ * paste_fragment:
+ *
+ * Insert objects under the pointer if it's over the diagram,
+ * or at their original position otherwise.
+ */
+static void
+paste_fragment (LdWindowMain *self, JsonNode *fragment)
+{
+	GtkWidget *view;
+	GdkDevice *pointer;
+	GError *error = NULL;
+	LdPoint origin;
+	gboolean over_view;
+	gint x, y;
+
+	view = GTK_WIDGET (self->priv->view);
+	pointer = gdk_device_manager_get_client_pointer
+		(gdk_display_get_device_manager (gtk_widget_get_display (view)));
+
+	over_view = gtk_widget_get_realized (view)
+		&& gdk_device_get_window_at_position (pointer, &x, &y)
+			== gtk_widget_get_window (view);
+	if (over_view)
+	{
+		ld_diagram_view_widget_to_diagram_coords (self->priv->view,
+			x, y, &origin.x, &origin.y);
+		origin.x = floor (origin.x + 0.5);
+		origin.y = floor (origin.y + 0.5);
+	}
+
+	if (!ld_diagram_paste (self->priv->diagram, fragment,
+		over_view ? &origin : NULL, &error))
+		display_and_free_error (self, _("Cannot paste"), error);
+}
@@ -0,0 +1,176 @@
+/*
+ * logdiag-diff.c -- compare and merge diagrams from the command line.
+ *
+ * This file is a part of logdiag.
+ * Copyright 2026 Přemysl Eric Janouch
+ *
+ * See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdlib.h>
+#include <locale.h>
+
+#include <liblogdiag/liblogdiag.h>
+#include "config.h"
+
+/* Exit statuses, following diff(1). */
+#define EXIT_SAME 0
+#define EXIT_DIFFERENT 1
+#define EXIT_TROUBLE 2
+
+static gboolean option_merge = FALSE;
+static gchar **option_files = NULL;
+
+static GOptionEntry option_entries[] =
+{
+	{"merge", 'm', 0, G_OPTION_ARG_NONE, &option_merge,
+		N_("Merge changes between BASE and THEIRS into OURS"),
+		NULL},
+	{G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &option_files,
+		NULL, N_("OLD NEW | BASE OURS THEIRS")},
+	{NULL}
+};
+
+static LdDiagram *
+load_diagram (const gchar *filename)
+{
+	LdDiagram *diagram;
+	GError *error = NULL;
+
+	diagram = ld_diagram_new ();
+	if (!ld_diagram_load_from_file (diagram, filename, &error))
+	{
+		g_printerr ("%s: %s\n", filename, error->message);
+		g_error_free (error);
+		exit (EXIT_TROUBLE);
+	}
+	return diagram;
+}
+
+static const gchar *
+describe_change (LdDiagramChange *change)
+{
+	if (change->flags & LD_DIAGRAM_CHANGE_ADDED)
+		return "added";
+	if (change->flags & LD_DIAGRAM_CHANGE_REMOVED)
+		return "removed";
+	if ((change->flags & LD_DIAGRAM_CHANGE_MOVED)
+		&& (change->flags & LD_DIAGRAM_CHANGE_MODIFIED))
+		return "moved,modified";
+	if (change->flags & LD_DIAGRAM_CHANGE_MOVED)
+		return "moved";
+	return "modified";
+}
+
+/*
+ * diff:
+ *
+ * Print a line for each changed object: what has happened to it
+ * and its identifier in the new diagram, or the old one if removed.
+ */
+static int
+diff (const gchar *old_filename, const gchar *new_filename)
+{
+	LdDiagram *old_diagram, *new_diagram;
+	GPtrArray *changes;
+	guint i;
+	int status;
+
+	old_diagram = load_diagram (old_filename);
+	new_diagram = load_diagram (new_filename);
+
+	changes = ld_diagram_diff (old_diagram, new_diagram);
+	for (i = 0; i < changes->len; i++)
+	{
+		LdDiagramChange *change;
+
+		change = g_ptr_array_index (changes, i);
+		g_print ("%s\t%s\n", describe_change (change),
+			ld_diagram_object_get_id (change->new_object
+				? change->new_object : change->old_object));
+	}
+
+	status = changes->len ? EXIT_DIFFERENT : EXIT_SAME;
+	g_ptr_array_free (changes, TRUE);
+	g_object_unref (old_diagram);
+	g_object_unref (new_diagram);
+	return status;
+}
+
+/*
+ * merge:
+ *
+ * Overwrite our version with the result, as git expects from merge
+ * drivers, and report conflicts with the exit status.
+ */
+static int
+merge (const gchar *base_filename, const gchar *ours_filename,
+	const gchar *theirs_filename)
+{
+	LdDiagram *base, *ours, *theirs;
+	GError *error = NULL;
+	guint conflicts;
+
+	base = load_diagram (base_filename);
+	ours = load_diagram (ours_filename);
+	theirs = load_diagram (theirs_filename);
+
+	conflicts = ld_diagram_merge (ours, base, theirs);
+	if (!ld_diagram_save_to_file (ours, ours_filename, &error))
+	{
+		g_printerr ("%s: %s\n", ours_filename, error->message);
+		g_error_free (error);
+		exit (EXIT_TROUBLE);
+	}
+	if (conflicts)
+		g_printerr (g_dngettext (GETTEXT_DOMAIN,
+			"%u conflict, our changes have been kept\n",
+			"%u conflicts, our changes have been kept\n", conflicts),
+			conflicts);
+
+	g_object_unref (base);
+	g_object_unref (ours);
+	g_object_unref (theirs);
+	return conflicts ? EXIT_DIFFERENT : EXIT_SAME;
+}
+
+int
+main (int argc, char *argv[])
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	guint n_files;
+
+	setlocale (LC_ALL, "");
+
+	bindtextdomain (GETTEXT_DOMAIN, GETTEXT_DIRNAME);
+	bind_textdomain_codeset (GETTEXT_DOMAIN, "UTF-8");
+	textdomain (GETTEXT_DOMAIN);
+
+	context = g_option_context_new (_("- compare and merge diagrams"));
+	g_option_context_add_main_entries (context,
+		option_entries, GETTEXT_DOMAIN);
+	if (!g_option_context_parse (context, &argc, &argv, &error))
+	{
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		exit (EXIT_TROUBLE);
+	}
+
+	n_files = option_files ? g_strv_length (option_files) : 0;
+	if (n_files != (option_merge ? 3 : 2))
+	{
+		gchar *help;
+
+		help = g_option_context_get_help (context, TRUE, NULL);
+		g_printerr ("%s", help);
+		g_free (help);
+		exit (EXIT_TROUBLE);
+	}
+	g_option_context_free (context);
+
+	if (option_merge)
+		return merge (option_files[0], option_files[1], option_files[2]);
+	return diff (option_files[0], option_files[1]);
+}
@@ -0,0 +1,384 @@
+/*
+ * benchmark.c
+ *
+ * This file is a part of logdiag.
+ * Copyright 2026 Přemysl Eric Janouch
+ *
+ * See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdlib.h>
+#include <math.h>
+#include <glib/gstdio.h>
+
+#include <liblogdiag/liblogdiag.h>
+#include "config.h"
+
+/* Symbols that synthetic diagrams are made of. */
+static const gchar *symbol_classes[] =
+{
+	"Logical/AND", "Logical/OR", "Logical/NOT",
+	"Passive/Resistor", "Passive/Capacitor", "Passive/Diode"
+};
+
+/* Distance between symbols in synthetic diagrams. */
+#define GRID_SPACING 16
+/* The size of the surface that diagrams are rendered onto. */
+#define RENDER_SIZE 2048
+
+static gint option_min_objects = 1000;
+static gint option_max_objects = 10000;
+static gint option_seed = 1;
+static gchar *option_library = NULL;
+
+static GOptionEntry option_entries[] =
+{
+	{"min-objects", 0, 0, G_OPTION_ARG_INT, &option_min_objects,
+		"The smallest diagram size", "N"},
+	{"max-objects", 0, 0, G_OPTION_ARG_INT, &option_max_objects,
+		"The largest diagram size, going up by factors of ten", "N"},
+	{"seed", 0, 0, G_OPTION_ARG_INT, &option_seed,
+		"Seed for generating diagrams", "N"},
+	{"library", 0, 0, G_OPTION_ARG_FILENAME, &option_library,
+		"The symbol library to use", "DIR"},
+	{NULL}
+};
+
+/*
+ * Benchmark:
+ * @results: an array of results being built.
+ * @n_objects: the size of the diagram being measured.
+ * @library: symbols for the diagram.
+ * @view: a view for measuring rendering, or %NULL.
+ */
+typedef struct
+{
+	JsonBuilder *results;
+	guint n_objects;
+	LdLibrary *library;
+	LdDiagramView *view;
+}
+Benchmark;
+
+static void
+report (Benchmark *bench, const gchar *name, gint64 start, guint n_operations)
+{
+	gdouble seconds;
+
+	seconds = (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC;
+
+	json_builder_begin_object (bench->results);
+	json_builder_set_member_name (bench->results, "name");
+	json_builder_add_string_value (bench->results, name);
+	json_builder_set_member_name (bench->results, "objects");
+	json_builder_add_int_value (bench->results, bench->n_objects);
+	json_builder_set_member_name (bench->results, "operations");
+	json_builder_add_int_value (bench->results, n_operations);
+	json_builder_set_member_name (bench->results, "seconds");
+	json_builder_add_double_value (bench->results, seconds);
+	json_builder_set_member_name (bench->results, "ns_per_operation");
+	json_builder_add_double_value (bench->results,
+		n_operations ? seconds * 1e9 / n_operations : 0);
+	json_builder_end_object (bench->results);
+}
+
+/*
+ * generate_objects:
+ *
+ * Lay out symbols on a grid, with about a third of them connected
+ * by wire to their right neighbour.
+ *
+ * Return value: (element-type LdDiagramObject): the objects.
+ */
+static GPtrArray *
+generate_objects (Benchmark *bench, GRand *rand)
+{
+	GPtrArray *objects;
+	guint columns, i;
+
+	objects = g_ptr_array_new_with_free_func (g_object_unref);
+	columns = MAX (1, (guint) sqrt (bench->n_objects));
+	for (i = 0; objects->len < bench->n_objects; i++)
+	{
+		const gchar *klass;
+		LdDiagramSymbol *symbol;
+		LdSymbol *library_symbol;
+		const LdPointArray *terminals;
+		gdouble x, y;
+
+		x = (i % columns) * GRID_SPACING;
+		y = (i / columns) * GRID_SPACING;
+
+		klass = symbol_classes[g_rand_int_range (rand,
+			0, G_N_ELEMENTS (symbol_classes))];
+		symbol = ld_diagram_symbol_new (NULL);
+		g_object_set (symbol, "class", klass, "x", x, "y", y, NULL);
+		g_ptr_array_add (objects, symbol);
+
+		library_symbol = ld_library_find_symbol (bench->library, klass);
+		if (!library_symbol || objects->len == bench->n_objects
+		 || g_rand_int_range (rand, 0, 3))
+			continue;
+
+		/* Run a wire from the last terminal to the next grid cell. */
+		terminals = ld_symbol_get_terminals (library_symbol);
+		if (terminals->length)
+		{
+			LdDiagramConnection *connection;
+			LdPointArray *points;
+			LdPoint *last;
+
+			last = &terminals->points[terminals->length - 1];
+			connection = ld_diagram_connection_new (NULL);
+			g_object_set (connection,
+				"x", x + last->x, "y", y + last->y, NULL);
+
+			points = ld_point_array_sized_new (3);
+			points->length = 3;
+			points->points[0].x = points->points[0].y = 0;
+			points->points[1].x = GRID_SPACING / 2 - last->x;
+			points->points[1].y = 0;
+			points->points[2].x = GRID_SPACING / 2 - last->x;
+			points->points[2].y = g_rand_int_range (rand, -2, 3);
+			ld_diagram_connection_set_points (connection, points);
+			ld_point_array_free (points);
+
+			g_ptr_array_add (objects, connection);
+		}
+	}
+	return objects;
+}
+
+static void
+bench_history (Benchmark *bench, LdDiagram *diagram, GPtrArray *objects)
+{
+	gint64 start;
+	guint i;
+
+	start = g_get_monotonic_time ();
+	for (i = 0; i < objects->len; i++)
+		ld_diagram_insert_object (diagram, objects->pdata[i], -1);
+	report (bench, "insert", start, objects->len);
+
+	start = g_get_monotonic_time ();
+	for (i = 0; i < objects->len; i++)
+		ld_diagram_undo (diagram);
+	report (bench, "undo", start, objects->len);
+
+	start = g_get_monotonic_time ();
+	for (i = 0; i < objects->len; i++)
+		ld_diagram_redo (diagram);
+	report (bench, "redo", start, objects->len);
+}
+
+static void
+bench_bulk (Benchmark *bench, GPtrArray *objects)
+{
+	LdDiagram *diagram;
+	gint64 start;
+
+	diagram = ld_diagram_new ();
+
+	start = g_get_monotonic_time ();
+	ld_diagram_insert_objects (diagram,
+		(LdDiagramObject **) objects->pdata, objects->len, -1);
+	report (bench, "insert_objects", start, objects->len);
+
+	start = g_get_monotonic_time ();
+	ld_diagram_remove_objects (diagram,
+		(LdDiagramObject **) objects->pdata, objects->len);
+	report (bench, "remove_objects", start, objects->len);
+
+	g_object_unref (diagram);
+}
+
+static void
+bench_file (Benchmark *bench, LdDiagram *diagram)
+{
+	GError *error = NULL;
+	gchar *filename;
+	gint64 start;
+	gint fd;
+
+	fd = g_file_open_tmp ("logdiag-benchmark-XXXXXX.ldd", &filename, &error);
+	if (fd == -1)
+	{
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		return;
+	}
+	g_close (fd, NULL);
+
+	start = g_get_monotonic_time ();
+	if (!ld_diagram_save_to_file (diagram, filename, &error))
+	{
+		g_printerr ("%s\n", error->message);
+		g_clear_error (&error);
+	}
+	else
+		report (bench, "save", start, 1);
+
+	start = g_get_monotonic_time ();
+	if (!ld_diagram_load_from_file (diagram, filename, &error))
+	{
+		g_printerr ("%s\n", error->message);
+		g_clear_error (&error);
+	}
+	else
+		report (bench, "load", start, 1);
+
+	g_unlink (filename);
+	g_free (filename);
+}
+
+static void
+bench_netlist (Benchmark *bench, LdDiagram *diagram)
+{
+	LdNetlist *netlist;
+	gint64 start;
+
+	start = g_get_monotonic_time ();
+	netlist = ld_netlist_new (diagram, bench->library);
+	report (bench, "netlist", start, 1);
+
+	g_object_unref (netlist);
+}
+
+static void
+bench_view (Benchmark *bench, LdDiagram *diagram)
+{
+	cairo_surface_t *surface;
+	cairo_t *cr;
+	LdRectangle bounds;
+	gdouble scale;
+	gint64 start;
+
+	ld_diagram_view_set_diagram (bench->view, diagram);
+
+	start = g_get_monotonic_time ();
+	ld_diagram_view_get_export_bounds (bench->view, &bounds);
+	report (bench, "bounds", start, 1);
+
+	surface = cairo_image_surface_create
+		(CAIRO_FORMAT_ARGB32, RENDER_SIZE, RENDER_SIZE);
+	cr = cairo_create (surface);
+
+	scale = RENDER_SIZE / MAX (1, MAX (bounds.width, bounds.height));
+	cairo_scale (cr, scale, scale);
+	cairo_translate (cr, -bounds.x, -bounds.y);
+
+	start = g_get_monotonic_time ();
+	ld_diagram_view_export (bench->view, cr, &bounds);
+	cairo_surface_flush (surface);
+	report (bench, "render", start, 1);
+
+	cairo_destroy (cr);
+	cairo_surface_destroy (surface);
+}
+
+static void
+bench_run (Benchmark *bench)
+{
+	LdDiagram *diagram;
+	GPtrArray *objects;
+	GRand *rand;
+
+	rand = g_rand_new_with_seed (option_seed);
+	objects = generate_objects (bench, rand);
+	g_rand_free (rand);
+
+	bench_bulk (bench, objects);
+
+	diagram = ld_diagram_new ();
+	bench_history (bench, diagram, objects);
+	g_ptr_array_free (objects, TRUE);
+
+	bench_file (bench, diagram);
+	bench_netlist (bench, diagram);
+	if (bench->view)
+		bench_view (bench, diagram);
+
+	g_object_unref (diagram);
+}
+
+int
+main (int argc, char *argv[])
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	JsonGenerator *generator;
+	JsonNode *root;
+	Benchmark bench;
+	gchar *json;
+	guint n;
+
+	context = g_option_context_new
+		("- measure performance of the diagram model and view");
+	g_option_context_add_main_entries (context, option_entries, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error))
+	{
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		exit (EXIT_FAILURE);
+	}
+	g_option_context_free (context);
+
+	if (option_min_objects < 1 || option_max_objects < option_min_objects)
+	{
+		g_printerr ("%s\n", "invalid diagram sizes");
+		exit (EXIT_FAILURE);
+	}
+
+	bench.library = ld_library_new ();
+	ld_library_load (bench.library,
+		option_library ? option_library : PROJECT_SHARE_DIR "library");
+
+	/* Rendering needs a widget, which needs a display. */
+	bench.view = NULL;
+	if (gtk_init_check (&argc, &argv))
+	{
+		bench.view = LD_DIAGRAM_VIEW (ld_diagram_view_new ());
+		g_object_ref_sink (bench.view);
+		ld_diagram_view_set_library (bench.view, bench.library);
+	}
+	else
+		g_printerr ("%s\n", "cannot open display, not measuring rendering");
+
+	bench.results = json_builder_new ();
+	json_builder_begin_object (bench.results);
+	json_builder_set_member_name (bench.results, "version");
+	json_builder_add_string_value (bench.results, PROJECT_VERSION);
+	json_builder_set_member_name (bench.results, "seed");
+	json_builder_add_int_value (bench.results, option_seed);
+	json_builder_set_member_name (bench.results, "results");
+	json_builder_begin_array (bench.results);
+
+	for (n = option_min_objects; n <= (guint) option_max_objects; n *= 10)
+	{
+		bench.n_objects = n;
+		bench_run (&bench);
+		if (n > G_MAXUINT / 10)
+			break;
+	}
+
+	json_builder_end_array (bench.results);
+	json_builder_end_object (bench.results);
+
+	root = json_builder_get_root (bench.results);
+	generator = json_generator_new ();
+	json_generator_set_pretty (generator, TRUE);
+	json_generator_set_root (generator, root);
+	json = json_generator_to_data (generator, NULL);
+	g_print ("%s\n", json);
+
+	g_free (json);
+	g_object_unref (generator);
+	json_node_free (root);
+	g_object_unref (bench.results);
+
+	if (bench.view)
+		g_object_unref (bench.view);
+	g_object_unref (bench.library);
+	return 0;
+}
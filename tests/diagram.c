@@ -8,8 +8,62 @@
  *
  */
 
+#include <string.h>
+#include <math.h>
+#include <glib/gstdio.h>
+
 #include <liblogdiag/liblogdiag.h>
 
+/* A small symbol with a single terminal in its origin. */
+typedef LdSymbol TestPin;
+typedef LdSymbolClass TestPinClass;
+
+static GType test_pin_get_type (void);
+
+G_DEFINE_TYPE (TestPin, test_pin, LD_TYPE_SYMBOL)
+
+static const gchar *
+test_pin_get_name (LdSymbol *self)
+{
+	return "pin";
+}
+
+static void
+test_pin_get_area (LdSymbol *self, LdRectangle *area)
+{
+	area->x = area->y = -0.5;
+	area->width = area->height = 1;
+}
+
+static const LdPointArray *
+test_pin_get_terminals (LdSymbol *self)
+{
+	static LdPoint points[] = {{0, 0}};
+	static const LdPointArray terminals = {points, 1, 1};
+
+	return &terminals;
+}
+
+static void
+test_pin_draw (LdSymbol *self, cairo_t *cr)
+{
+}
+
+static void
+test_pin_class_init (TestPinClass *klass)
+{
+	klass->get_name = test_pin_get_name;
+	klass->get_human_name = test_pin_get_name;
+	klass->get_area = test_pin_get_area;
+	klass->get_terminals = test_pin_get_terminals;
+	klass->draw = test_pin_draw;
+}
+
+static void
+test_pin_init (TestPin *self)
+{
+}
+
 typedef struct
 {
 	LdDiagram *diagram;
@@ -125,6 +179,668 @@ diagram_test_history_grouping (Diagram *fixture, gconstpointer user_data)
 	g_object_unref (object);
 }
 
+static void
+on_selection_changed (LdDiagram *diagram, guint *count)
+{
+	(*count)++;
+}
+
+static void
+diagram_test_selection (Diagram *fixture, gconstpointer user_data)
+{
+	LdDiagramObject *objects[3];
+	GList *select = NULL, *unselect = NULL, *selection;
+	guint count = 0, i;
+
+	for (i = 0; i < G_N_ELEMENTS (objects); i++)
+	{
+		objects[i] = ld_diagram_object_new (NULL);
+		ld_diagram_insert_object (fixture->diagram, objects[i], -1);
+	}
+	ld_diagram_select (fixture->diagram, objects[0]);
+
+	g_signal_connect (fixture->diagram, "selection-changed",
+		G_CALLBACK (on_selection_changed), &count);
+
+	/* Change the selection in one go, with a single signal emission. */
+	select = g_list_prepend (select, objects[1]);
+	select = g_list_prepend (select, objects[2]);
+	unselect = g_list_prepend (unselect, objects[0]);
+	ld_diagram_change_selection (fixture->diagram, select, unselect);
+	g_assert_cmpuint (count, ==, 1);
+
+	selection = ld_diagram_get_selection (fixture->diagram);
+	g_assert_cmpuint (g_list_length (selection), ==, 2);
+	g_assert (g_list_find (selection, objects[0]) == NULL);
+
+	/* Nothing changes the second time. */
+	ld_diagram_change_selection (fixture->diagram, select, unselect);
+	g_assert_cmpuint (count, ==, 1);
+
+	g_list_free (select);
+	g_list_free (unselect);
+	for (i = 0; i < G_N_ELEMENTS (objects); i++)
+		g_object_unref (objects[i]);
+}
+
+static LdDiagramObject *
+add_wire (LdDiagram *diagram, gdouble x, gdouble y)
+{
+	static LdPoint points[] = {{0, 0}, {1, 0}};
+	LdDiagramConnection *connection;
+	LdPointArray *array;
+
+	array = ld_point_array_new ();
+	ld_point_array_insert (array, points, 0, G_N_ELEMENTS (points));
+	connection = ld_diagram_connection_new (NULL);
+	ld_diagram_connection_set_points (connection, array);
+	ld_point_array_free (array);
+
+	ld_diagram_object_set_x (LD_DIAGRAM_OBJECT (connection), x);
+	ld_diagram_object_set_y (LD_DIAGRAM_OBJECT (connection), y);
+	ld_diagram_insert_object (diagram, LD_DIAGRAM_OBJECT (connection), -1);
+	g_object_unref (connection);
+	return LD_DIAGRAM_OBJECT (connection);
+}
+
+static void
+send_pointer (GtkWidget *view, GdkEventType type, gdouble x, gdouble y)
+{
+	GdkEvent event;
+	gdouble wx, wy;
+
+	ld_diagram_view_diagram_to_widget_coords (LD_DIAGRAM_VIEW (view),
+		x, y, &wx, &wy);
+
+	memset (&event, 0, sizeof event);
+	if (type == GDK_MOTION_NOTIFY)
+	{
+		event.motion.type = type;
+		event.motion.window = gtk_widget_get_window (view);
+		event.motion.x = wx;
+		event.motion.y = wy;
+		event.motion.state = GDK_BUTTON1_MASK;
+	}
+	else
+	{
+		event.button.type = type;
+		event.button.window = gtk_widget_get_window (view);
+		event.button.x = wx;
+		event.button.y = wy;
+		event.button.button = 1;
+		if (type == GDK_BUTTON_RELEASE)
+			event.button.state = GDK_BUTTON1_MASK;
+	}
+	gtk_widget_event (view, &event);
+
+	/* Motion is only processed in the next frame. */
+	g_signal_emit_by_name (gtk_widget_get_frame_clock (view), "update");
+}
+
+static void
+assert_selection (LdDiagram *diagram, LdDiagramObject **objects, guint n)
+{
+	GList *selection;
+	guint i;
+
+	selection = ld_diagram_get_selection (diagram);
+	g_assert_cmpuint (g_list_length (selection), ==, n);
+	for (i = 0; i < n; i++)
+		g_assert (g_list_find (selection, objects[i]) != NULL);
+}
+
+static void
+diagram_test_rubber_band (Diagram *fixture, gconstpointer user_data)
+{
+	LdDiagramObject *a, *b, *c, *d, *expected[3];
+	GtkWidget *window, *view;
+
+	window = gtk_offscreen_window_new ();
+	view = ld_diagram_view_new ();
+	gtk_widget_set_size_request (view, 600, 400);
+	gtk_container_add (GTK_CONTAINER (window), view);
+	ld_diagram_view_set_diagram (LD_DIAGRAM_VIEW (view), fixture->diagram);
+	gtk_widget_show_all (window);
+
+	a = add_wire (fixture->diagram, 0, 0);
+	b = add_wire (fixture->diagram, 10, 0);
+	c = add_wire (fixture->diagram, 20, 0);
+
+	send_pointer (view, GDK_BUTTON_PRESS, -2, -2);
+	send_pointer (view, GDK_MOTION_NOTIFY, 5, 2);
+	expected[0] = a;
+	assert_selection (fixture->diagram, expected, 1);
+
+	/* Changes to the diagram during the operation are picked up. */
+	ld_diagram_object_set_x (b, 3);
+	send_pointer (view, GDK_MOTION_NOTIFY, 5, 2.5);
+	expected[1] = b;
+	assert_selection (fixture->diagram, expected, 2);
+
+	d = add_wire (fixture->diagram, 1, 1);
+	send_pointer (view, GDK_MOTION_NOTIFY, 5, 2);
+	expected[2] = d;
+	assert_selection (fixture->diagram, expected, 3);
+
+	ld_diagram_remove_object (fixture->diagram, a);
+	send_pointer (view, GDK_MOTION_NOTIFY, 5, 2.5);
+	expected[0] = d;
+	assert_selection (fixture->diagram, expected, 2);
+
+	/* Only the parts gained or lost are queried from now on. */
+	send_pointer (view, GDK_MOTION_NOTIFY, 2.5, 2.5);
+	assert_selection (fixture->diagram, expected, 1);
+
+	send_pointer (view, GDK_MOTION_NOTIFY, 25, 2);
+	expected[2] = c;
+	assert_selection (fixture->diagram, expected, 3);
+
+	send_pointer (view, GDK_BUTTON_RELEASE, 25, 2);
+	assert_selection (fixture->diagram, expected, 3);
+
+	gtk_widget_destroy (window);
+}
+
+static LdDiagramObject *
+add_pin (LdDiagram *diagram, gdouble x, gdouble y)
+{
+	LdDiagramSymbol *symbol;
+
+	symbol = ld_diagram_symbol_new (NULL);
+	ld_diagram_symbol_set_class (symbol, "pin");
+	ld_diagram_object_set_x (LD_DIAGRAM_OBJECT (symbol), x);
+	ld_diagram_object_set_y (LD_DIAGRAM_OBJECT (symbol), y);
+	ld_diagram_insert_object (diagram, LD_DIAGRAM_OBJECT (symbol), -1);
+	g_object_unref (symbol);
+	return LD_DIAGRAM_OBJECT (symbol);
+}
+
+static void
+diagram_test_follow (Diagram *fixture, gconstpointer user_data)
+{
+	static LdPoint path[] =
+		{{0, 0}, {3, 0}, {3, 5}, {7, 5}, {7, 10}, {10, 10}};
+	static const LdPoint expected[] =
+		{{0, 0}, {3, 0}, {3, 5}, {7, 5}, {7, 10}, {12, 10}};
+	LdDiagramConnection *connection;
+	LdDiagramObject *pin;
+	LdPointArray *points;
+	LdLibrary *library;
+	LdSymbol *symbol;
+	GtkWidget *window, *view;
+	guint i;
+
+	library = ld_library_new ();
+	symbol = g_object_new (test_pin_get_type (), NULL);
+	ld_category_insert_symbol (ld_library_get_root (library), symbol, -1);
+	g_object_unref (symbol);
+
+	window = gtk_offscreen_window_new ();
+	view = ld_diagram_view_new ();
+	gtk_container_add (GTK_CONTAINER (window), view);
+	ld_diagram_view_set_library (LD_DIAGRAM_VIEW (view), library);
+	ld_diagram_view_set_diagram (LD_DIAGRAM_VIEW (view), fixture->diagram);
+	gtk_widget_show_all (window);
+
+	add_pin (fixture->diagram, 0, 0);
+	pin = add_pin (fixture->diagram, 10, 10);
+
+	points = ld_point_array_new ();
+	ld_point_array_insert (points, path, 0, G_N_ELEMENTS (path));
+	connection = ld_diagram_connection_new (NULL);
+	ld_diagram_connection_set_points (connection, points);
+	ld_point_array_free (points);
+	ld_diagram_insert_object (fixture->diagram,
+		LD_DIAGRAM_OBJECT (connection), -1);
+	g_object_unref (connection);
+
+	/* Only the segment at the moved end is routed anew. */
+	ld_diagram_select (fixture->diagram, pin);
+	g_signal_emit_by_name (view, "move", (gdouble) 2, (gdouble) 0);
+
+	points = ld_diagram_connection_get_points (connection);
+	g_assert_cmpuint (points->length, ==, G_N_ELEMENTS (expected));
+	for (i = 0; i < points->length; i++)
+	{
+		g_assert_cmpfloat (points->points[i].x, ==, expected[i].x);
+		g_assert_cmpfloat (points->points[i].y, ==, expected[i].y);
+	}
+	ld_point_array_free (points);
+
+	gtk_widget_destroy (window);
+	g_object_unref (library);
+}
+
+static void
+diagram_test_bulk (Diagram *fixture, gconstpointer user_data)
+{
+	LdDiagramObject *objects[4];
+	GList *list;
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (objects); i++)
+		objects[i] = ld_diagram_object_new (NULL);
+
+	/* Insert the middle two objects in between the outer two. */
+	ld_diagram_insert_object (fixture->diagram, objects[0], -1);
+	ld_diagram_insert_object (fixture->diagram, objects[3], -1);
+	ld_diagram_insert_objects (fixture->diagram, objects + 1, 2, 1);
+
+	list = ld_diagram_get_objects (fixture->diagram);
+	for (i = 0; i < G_N_ELEMENTS (objects); i++, list = g_list_next (list))
+		g_assert (list->data == objects[i]);
+	g_assert (list == NULL);
+
+	/* Remove the first three objects and bring them back. */
+	ld_diagram_select (fixture->diagram, objects[2]);
+	ld_diagram_remove_objects (fixture->diagram, objects, 3);
+	g_assert (ld_diagram_get_selection (fixture->diagram) == NULL);
+	g_assert_cmpuint (g_list_length
+		(ld_diagram_get_objects (fixture->diagram)), ==, 1);
+
+	ld_diagram_undo (fixture->diagram);
+	list = ld_diagram_get_objects (fixture->diagram);
+	for (i = 0; i < G_N_ELEMENTS (objects); i++, list = g_list_next (list))
+		g_assert (list->data == objects[i]);
+
+	/* The whole insertion is undone at once. */
+	ld_diagram_undo (fixture->diagram);
+	g_assert_cmpuint (g_list_length
+		(ld_diagram_get_objects (fixture->diagram)), ==, 2);
+	ld_diagram_redo (fixture->diagram);
+	g_assert_cmpuint (g_list_length
+		(ld_diagram_get_objects (fixture->diagram)), ==, 4);
+
+	for (i = 0; i < G_N_ELEMENTS (objects); i++)
+		g_object_unref (objects[i]);
+}
+
+static void
+diagram_test_paste (Diagram *fixture, gconstpointer user_data)
+{
+	const LdPoint origin = {10, 20};
+	LdDiagramObject *object;
+	JsonNode *fragment;
+	GList *selection;
+	gdouble x, y;
+
+	object = ld_diagram_object_new (NULL);
+	g_object_set (object, "x", 3.5, "y", -2.0, NULL);
+	ld_diagram_insert_object (fixture->diagram, object, -1);
+
+	g_assert (ld_diagram_copy_selection (fixture->diagram) == NULL);
+	ld_diagram_select (fixture->diagram, object);
+	fragment = ld_diagram_copy_selection (fixture->diagram);
+	g_assert (fragment != NULL);
+
+	/* The copy is independent of the original object. */
+	g_object_set (object, "x", 0.0, NULL);
+
+	/* Positions are kept relative to the origin of the fragment. */
+	g_assert (ld_diagram_paste (fixture->diagram, fragment, &origin, NULL));
+	g_assert_cmpuint (g_list_length
+		(ld_diagram_get_objects (fixture->diagram)), ==, 2);
+
+	selection = ld_diagram_get_selection (fixture->diagram);
+	g_assert_cmpuint (g_list_length (selection), ==, 1);
+	g_assert (selection->data != object);
+
+	g_object_get (selection->data, "x", &x, "y", &y, NULL);
+	g_assert_cmpfloat (x, ==, origin.x + 0.5);
+	g_assert_cmpfloat (y, ==, origin.y);
+
+	/* Pasting is a single user action. */
+	ld_diagram_undo (fixture->diagram);
+	g_assert_cmpuint (g_list_length
+		(ld_diagram_get_objects (fixture->diagram)), ==, 1);
+
+	json_node_free (fragment);
+	g_object_unref (object);
+}
+
+static void
+on_notify_count (GObject *object, GParamSpec *pspec, guint *count)
+{
+	(*count)++;
+}
+
+static void
+diagram_test_deferred_copy (Diagram *fixture, gconstpointer user_data)
+{
+	LdDiagramObject *objects[3];
+	JsonNode *fragment;
+	JsonObject *root;
+	JsonArray *array;
+	guint i, notifications;
+
+	for (i = 0; i < G_N_ELEMENTS (objects); i++)
+	{
+		objects[i] = ld_diagram_object_new (NULL);
+		g_object_set (objects[i], "x", (gdouble) i, NULL);
+		ld_diagram_insert_object (fixture->diagram, objects[i], -1);
+		ld_diagram_select (fixture->diagram, objects[i]);
+	}
+
+	fragment = ld_diagram_copy_selection_deferred (fixture->diagram);
+	root = json_node_get_object (fragment);
+	array = json_object_get_array_member (root, "objects");
+
+	/* Changes made while the copy is in progress don't show in it,
+	 * not even to objects that have been removed in the meantime. */
+	ld_diagram_remove_object (fixture->diagram, objects[1]);
+	g_object_set (objects[1], "x", 10.0, NULL);
+	g_object_set (objects[2], "x", 10.0, NULL);
+	ld_diagram_undo (fixture->diagram);
+
+	ld_diagram_finish_copy (fixture->diagram);
+	g_assert_cmpuint (json_array_get_length (array), ==, 3);
+	for (i = 0; i < G_N_ELEMENTS (objects); i++)
+		g_assert_cmpfloat (json_object_get_double_member
+			(json_array_get_object_element (array, i), "x"), ==, i);
+	json_node_free (fragment);
+
+	/* Finishing the copy doesn't make the change happen twice. */
+	notifications = 0;
+	g_signal_connect (objects[0], "notify::x",
+		G_CALLBACK (on_notify_count), &notifications);
+	fragment = ld_diagram_copy_selection_deferred (fixture->diagram);
+	g_object_set (objects[0], "x", 10.0, NULL);
+	g_assert_cmpuint (notifications, ==, 1);
+	g_signal_handlers_disconnect_by_func (objects[0],
+		on_notify_count, &notifications);
+
+	array = json_object_get_array_member
+		(json_node_get_object (fragment), "objects");
+	g_assert_cmpfloat (json_object_get_double_member
+		(json_array_get_object_element (array, 0), "x"), ==, 0);
+	json_node_free (fragment);
+
+	for (i = 0; i < G_N_ELEMENTS (objects); i++)
+		g_object_unref (objects[i]);
+}
+
+static void
+diagram_test_ids (Diagram *fixture, gconstpointer user_data)
+{
+	LdDiagramObject *objects[2];
+	const gchar *id;
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS (objects); i++)
+	{
+		objects[i] = ld_diagram_object_new (NULL);
+		ld_diagram_object_set_id (objects[i], "same");
+		ld_diagram_insert_object (fixture->diagram, objects[i], -1);
+	}
+
+	/* The second object must have been given a new identifier. */
+	g_assert_cmpstr (ld_diagram_object_get_id (objects[0]), ==, "same");
+	id = ld_diagram_object_get_id (objects[1]);
+	g_assert_cmpstr (id, !=, "same");
+	g_assert (ld_diagram_find_object (fixture->diagram, id) == objects[1]);
+
+	/* Identifiers survive removal and reinsertion. */
+	ld_diagram_remove_object (fixture->diagram, objects[0]);
+	g_assert (ld_diagram_find_object (fixture->diagram, "same") == NULL);
+	ld_diagram_undo (fixture->diagram);
+	g_assert (ld_diagram_find_object (fixture->diagram, "same") == objects[0]);
+
+	for (i = 0; i < G_N_ELEMENTS (objects); i++)
+		g_object_unref (objects[i]);
+}
+
+static void
+insert_with_id (LdDiagram *diagram, const gchar *id, gdouble x)
+{
+	LdDiagramObject *object;
+
+	object = ld_diagram_object_new (NULL);
+	ld_diagram_object_set_id (object, id);
+	g_object_set (object, "x", x, NULL);
+	ld_diagram_insert_object (diagram, object, -1);
+	g_object_unref (object);
+}
+
+static void
+diagram_test_merge (Diagram *fixture, gconstpointer user_data)
+{
+	LdDiagram *ours, *theirs;
+	LdDiagramChange *change;
+	GPtrArray *changes;
+
+	insert_with_id (fixture->diagram, "a", 0);
+	insert_with_id (fixture->diagram, "b", 0);
+
+	ours = ld_diagram_new ();
+	insert_with_id (ours, "a", 1);
+	insert_with_id (ours, "b", 0);
+
+	theirs = ld_diagram_new ();
+	insert_with_id (theirs, "a", 0);
+	insert_with_id (theirs, "b", 2);
+	insert_with_id (theirs, "c", 3);
+
+	changes = ld_diagram_diff (fixture->diagram, theirs);
+	g_assert_cmpuint (changes->len, ==, 2);
+	change = g_ptr_array_index (changes, 0);
+	g_assert_cmpint (change->flags, ==, LD_DIAGRAM_CHANGE_MOVED);
+	g_assert_cmpstr (ld_diagram_object_get_id (change->new_object), ==, "b");
+	change = g_ptr_array_index (changes, 1);
+	g_assert_cmpint (change->flags, ==, LD_DIAGRAM_CHANGE_ADDED);
+	g_ptr_array_free (changes, TRUE);
+
+	/* Changes to different objects merge cleanly. */
+	g_assert_cmpuint (ld_diagram_merge (ours, fixture->diagram, theirs), ==, 0);
+	g_assert_cmpuint (g_list_length (ld_diagram_get_objects (ours)), ==, 3);
+	g_assert_cmpfloat (ld_diagram_object_get_x
+		(ld_diagram_find_object (ours, "a")), ==, 1);
+	g_assert_cmpfloat (ld_diagram_object_get_x
+		(ld_diagram_find_object (ours, "b")), ==, 2);
+
+	/* Conflicting changes keep ours. */
+	ld_diagram_object_set_x (ld_diagram_find_object (theirs, "a"), 5);
+	g_assert_cmpuint (ld_diagram_merge (ours, fixture->diagram, theirs), ==, 1);
+	g_assert_cmpfloat (ld_diagram_object_get_x
+		(ld_diagram_find_object (ours, "a")), ==, 1);
+
+	g_object_unref (ours);
+	g_object_unref (theirs);
+}
+
+static void
+diagram_test_journal (Diagram *fixture, gconstpointer user_data)
+{
+	static const gchar garbage[] = "{\"op\":\"remove\",\"po";
+	static const gchar invalid[] =
+		"{\"op\":\"insert\",\"pos\":0,\"object\":{}}\n"
+		"{\"op\":\"commit\"}\n"
+		"{\"op\":\"remove\",\"pos\":5}\n"
+		"{\"op\":\"commit\"}\n";
+	LdDiagramObject *objects[3];
+	LdDiagram *recovered;
+	LdJournal *journal;
+	gchar *path;
+	GList *list;
+	gdouble x;
+	guint i;
+
+	g_close (g_file_open_tmp ("logdiag-XXXXXX", &path, NULL), NULL);
+	journal = ld_journal_new (path, NULL);
+	g_assert (journal != NULL);
+	ld_diagram_set_journal (fixture->diagram, journal);
+
+	for (i = 0; i < G_N_ELEMENTS (objects); i++)
+		objects[i] = ld_diagram_object_new (NULL);
+	ld_diagram_insert_objects (fixture->diagram, objects, 3, -1);
+	g_object_set (objects[1], "x", 5.0, NULL);
+	ld_diagram_remove_object (fixture->diagram, objects[0]);
+
+	/* Neither an unfinished action nor a partial write is replayed. */
+	ld_diagram_begin_user_action (fixture->diagram);
+	ld_diagram_remove_object (fixture->diagram, objects[1]);
+	g_assert (ld_journal_append (journal, garbage, strlen (garbage), NULL));
+
+	ld_diagram_set_journal (fixture->diagram, NULL);
+	ld_journal_free (journal);
+
+	recovered = ld_diagram_new ();
+	g_assert (ld_diagram_replay_journal (recovered, path, NULL));
+
+	list = ld_diagram_get_objects (recovered);
+	g_assert_cmpuint (g_list_length (list), ==, 2);
+	g_object_get (list->data, "x", &x, NULL);
+	g_assert_cmpfloat (x, ==, 5.0);
+
+	g_object_unref (recovered);
+
+	/* A journal that can't be replayed entirely isn't replayed at all. */
+	g_assert (g_file_set_contents (path, invalid, -1, NULL));
+	recovered = ld_diagram_new ();
+	g_assert (!ld_diagram_replay_journal (recovered, path, NULL));
+	g_assert (!ld_diagram_get_objects (recovered));
+	g_object_unref (recovered);
+
+	g_unlink (path);
+	g_free (path);
+	for (i = 0; i < G_N_ELEMENTS (objects); i++)
+		g_object_unref (objects[i]);
+}
+
+static void
+diagram_test_journal_history (Diagram *fixture, gconstpointer user_data)
+{
+	LdDiagramObject *objects[2];
+	LdDiagram *recovered;
+	LdJournal *journal;
+	gchar *path;
+	GList *list;
+	guint i;
+
+	g_close (g_file_open_tmp ("logdiag-XXXXXX", &path, NULL), NULL);
+	journal = ld_journal_new (path, NULL);
+	g_assert (journal != NULL);
+	ld_diagram_set_journal (fixture->diagram, journal);
+
+	for (i = 0; i < G_N_ELEMENTS (objects); i++)
+		objects[i] = ld_diagram_object_new (NULL);
+	ld_diagram_insert_objects (fixture->diagram, objects, 2, -1);
+
+	/* Undone and redone changes are recorded as well. */
+	ld_diagram_object_set_x (objects[0], 5);
+	ld_diagram_undo (fixture->diagram);
+	ld_diagram_object_set_x (objects[1], 7);
+	ld_diagram_undo (fixture->diagram);
+	ld_diagram_redo (fixture->diagram);
+
+	ld_diagram_set_journal (fixture->diagram, NULL);
+	ld_journal_free (journal);
+
+	recovered = ld_diagram_new ();
+	g_assert (ld_diagram_replay_journal (recovered, path, NULL));
+	list = ld_diagram_get_objects (recovered);
+	g_assert_cmpuint (g_list_length (list), ==, 2);
+	g_assert_cmpfloat (ld_diagram_object_get_x (list->data), ==, 0);
+	g_assert_cmpfloat (ld_diagram_object_get_x (list->next->data), ==, 7);
+	g_object_unref (recovered);
+
+	g_unlink (path);
+	g_free (path);
+	for (i = 0; i < G_N_ELEMENTS (objects); i++)
+		g_object_unref (objects[i]);
+}
+
+static void
+diagram_test_compression (Diagram *fixture, gconstpointer user_data)
+{
+	LdDiagramObject *object;
+	LdDiagram *loaded;
+	gchar *path, *contents;
+	gsize length;
+
+	g_close (g_file_open_tmp ("logdiag-XXXXXX", &path, NULL), NULL);
+	object = ld_diagram_object_new (NULL);
+	ld_diagram_object_set_x (object, 3);
+	ld_diagram_insert_object (fixture->diagram, object, -1);
+	g_object_unref (object);
+
+	ld_diagram_set_compression_level (fixture->diagram, 9);
+	g_assert (ld_diagram_save_to_file (fixture->diagram, path, NULL));
+	g_assert (g_file_get_contents (path, &contents, &length, NULL));
+	g_assert (length >= 2 && contents[0] == '\x1f' && contents[1] == '\x8b');
+	g_free (contents);
+
+	loaded = ld_diagram_new ();
+	g_assert (ld_diagram_load_from_file (loaded, path, NULL));
+	g_assert_cmpint (ld_diagram_get_compression_level (loaded), ==, 6);
+	g_assert_cmpuint (g_list_length (ld_diagram_get_objects (loaded)), ==, 1);
+	g_assert_cmpfloat (ld_diagram_object_get_x
+		(ld_diagram_get_objects (loaded)->data), ==, 3);
+
+	/* Plain files load as they always did. */
+	ld_diagram_set_compression_level (fixture->diagram, 0);
+	g_assert (ld_diagram_save_to_file (fixture->diagram, path, NULL));
+	g_assert (ld_diagram_load_from_file (loaded, path, NULL));
+	g_assert_cmpint (ld_diagram_get_compression_level (loaded), ==, 0);
+	g_assert_cmpuint (g_list_length (ld_diagram_get_objects (loaded)), ==, 1);
+
+	g_object_unref (loaded);
+	g_unlink (path);
+	g_free (path);
+}
+
+static void
+diagram_test_canonical (Diagram *fixture, gconstpointer user_data)
+{
+	LdDiagramObject *object;
+	GStatBuf stat_buf;
+	GFile *file;
+	gchar *path, *contents;
+
+	g_close (g_file_open_tmp ("logdiag-XXXXXX", &path, NULL), NULL);
+	object = ld_diagram_object_new (NULL);
+	ld_diagram_object_set_id (object, "a");
+	ld_diagram_object_set_x (object, 1);
+	ld_diagram_object_set_y (object, 0.1);
+	ld_diagram_insert_object (fixture->diagram, object, -1);
+	g_object_unref (object);
+
+	ld_diagram_set_canonical (fixture->diagram, TRUE);
+	g_assert (ld_diagram_save_to_file (fixture->diagram, path, NULL));
+	g_assert (g_file_get_contents (path, &contents, NULL, NULL));
+	g_assert_cmpstr (contents, ==, "/* logdiag diagram */\n{\n"
+		"\t\"objects\": [\n"
+		"\t\t{\"id\": \"a\", \"type\": \"object\", "
+			"\"x\": 1.0, \"y\": 0.1}\n"
+		"\t],\n"
+		"\t\"version\": 1\n}\n");
+	g_free (contents);
+
+	/* Saving the same contents again leaves the file alone. */
+	file = g_file_new_for_path (path);
+	g_assert (g_file_set_attribute_uint64 (file,
+		G_FILE_ATTRIBUTE_TIME_MODIFIED, 0, G_FILE_QUERY_INFO_NONE,
+		NULL, NULL));
+	g_object_unref (file);
+	g_assert (ld_diagram_save_to_file (fixture->diagram, path, NULL));
+	g_assert (g_stat (path, &stat_buf) == 0);
+	g_assert_cmpint (stat_buf.st_mtime, ==, 0);
+
+	ld_diagram_object_set_x (object, 2);
+	g_assert (ld_diagram_save_to_file (fixture->diagram, path, NULL));
+	g_assert (g_stat (path, &stat_buf) == 0);
+	g_assert_cmpint (stat_buf.st_mtime, !=, 0);
+
+	/* Numbers that JSON can't express are written as null. */
+	ld_diagram_object_set_y (object, NAN);
+	g_assert (ld_diagram_save_to_file (fixture->diagram, path, NULL));
+	g_assert (g_file_get_contents (path, &contents, NULL, NULL));
+	g_assert (strstr (contents, "\"y\": null") != NULL);
+	g_free (contents);
+
+	g_unlink (path);
+	g_free (path);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -137,6 +853,44 @@ main (int argc, char *argv[])
 	g_test_add ("/diagram/history-grouping", Diagram, NULL,
 		diagram_setup, diagram_test_history_grouping,
 		diagram_teardown);
+	g_test_add ("/diagram/bulk", Diagram, NULL,
+		diagram_setup, diagram_test_bulk,
+		diagram_teardown);
+	g_test_add ("/diagram/paste", Diagram, NULL,
+		diagram_setup, diagram_test_paste,
+		diagram_teardown);
+	g_test_add ("/diagram/deferred-copy", Diagram, NULL,
+		diagram_setup, diagram_test_deferred_copy,
+		diagram_teardown);
+	g_test_add ("/diagram/ids", Diagram, NULL,
+		diagram_setup, diagram_test_ids,
+		diagram_teardown);
+	g_test_add ("/diagram/merge", Diagram, NULL,
+		diagram_setup, diagram_test_merge,
+		diagram_teardown);
+	g_test_add ("/diagram/journal", Diagram, NULL,
+		diagram_setup, diagram_test_journal,
+		diagram_teardown);
+	g_test_add ("/diagram/journal-history", Diagram, NULL,
+		diagram_setup, diagram_test_journal_history,
+		diagram_teardown);
+	g_test_add ("/diagram/compression", Diagram, NULL,
+		diagram_setup, diagram_test_compression,
+		diagram_teardown);
+	g_test_add ("/diagram/canonical", Diagram, NULL,
+		diagram_setup, diagram_test_canonical,
+		diagram_teardown);
+
+	/* Selection. */
+	g_test_add ("/diagram/selection", Diagram, NULL,
+		diagram_setup, diagram_test_selection,
+		diagram_teardown);
+	g_test_add ("/diagram/rubber-band", Diagram, NULL,
+		diagram_setup, diagram_test_rubber_band,
+		diagram_teardown);
+	g_test_add ("/diagram/follow", Diagram, NULL,
+		diagram_setup, diagram_test_follow,
+		diagram_teardown);
 
 	return g_test_run ();
 }
@@ -0,0 +1,417 @@
+/*
+ * document.c
+ *
+ * This file is a part of logdiag.
+ * Copyright 2026 Přemysl Eric Janouch
+ *
+ * See the file LICENSE for licensing information.
+ *
+ */
+
+#include <glib/gstdio.h>
+
+#include <liblogdiag/liblogdiag.h>
+
+typedef struct
+{
+	gchar *directory;
+	LdDocument *document;
+	GString *events;
+}
+Document;
+
+static void
+on_sheet_loaded (LdDocument *document, const gchar *filename, Document *fixture)
+{
+	gchar *name;
+
+	name = g_path_get_basename (filename);
+	g_string_append_printf (fixture->events, "+%s ", name);
+	g_free (name);
+}
+
+static void
+on_sheet_unloaded (LdDocument *document,
+	const gchar *filename, Document *fixture)
+{
+	gchar *name;
+
+	name = g_path_get_basename (filename);
+	g_string_append_printf (fixture->events, "-%s ", name);
+	g_free (name);
+}
+
+static void
+document_setup (Document *fixture, gconstpointer test_data)
+{
+	gchar *root_path;
+
+	fixture->directory = g_dir_make_tmp ("logdiag-XXXXXX", NULL);
+	g_assert (fixture->directory != NULL);
+
+	root_path = g_build_filename (fixture->directory, "root.ldd", NULL);
+	fixture->document = ld_document_new (root_path);
+	g_free (root_path);
+
+	fixture->events = g_string_new (NULL);
+	g_signal_connect (fixture->document, "sheet-loaded",
+		G_CALLBACK (on_sheet_loaded), fixture);
+	g_signal_connect (fixture->document, "sheet-unloaded",
+		G_CALLBACK (on_sheet_unloaded), fixture);
+}
+
+static void
+document_teardown (Document *fixture, gconstpointer test_data)
+{
+	const gchar *name;
+	GDir *dir;
+
+	g_object_unref (fixture->document);
+	g_string_free (fixture->events, TRUE);
+
+	dir = g_dir_open (fixture->directory, 0, NULL);
+	while ((name = g_dir_read_name (dir)))
+	{
+		gchar *path;
+
+		path = g_build_filename (fixture->directory, name, NULL);
+		g_unlink (path);
+		g_free (path);
+	}
+	g_dir_close (dir);
+
+	g_rmdir (fixture->directory);
+	g_free (fixture->directory);
+}
+
+/* Save a sheet with one symbol, labelled unless @label is NULL. */
+static gchar *
+write_sheet (Document *fixture, const gchar *name,
+	const gchar *label, gint compression_level)
+{
+	LdDiagramSymbol *symbol;
+	LdDiagram *diagram;
+	gchar *path;
+
+	diagram = ld_diagram_new ();
+	symbol = ld_diagram_symbol_new (NULL);
+	ld_diagram_symbol_set_label (symbol, label);
+	ld_diagram_insert_object (diagram, LD_DIAGRAM_OBJECT (symbol), -1);
+	g_object_unref (symbol);
+
+	path = g_build_filename (fixture->directory, name, NULL);
+	ld_diagram_set_compression_level (diagram, compression_level);
+	g_assert (ld_diagram_save_to_file (diagram, path, NULL));
+	g_object_unref (diagram);
+	return path;
+}
+
+static guint64
+get_file_size (const gchar *path)
+{
+	GStatBuf stat_buf;
+
+	g_assert (g_stat (path, &stat_buf) == 0);
+	return stat_buf.st_size;
+}
+
+static void
+document_test_lru (Document *fixture, gconstpointer user_data)
+{
+	gchar *a, *b, *c;
+
+	a = write_sheet (fixture, "a.ldd", NULL, 0);
+	b = write_sheet (fixture, "b.ldd", NULL, 0);
+	c = write_sheet (fixture, "c.ldd", NULL, 0);
+	ld_document_set_budget (fixture->document, 2 * get_file_size (a));
+
+	/* The least recently used sheet makes room for the new one. */
+	g_assert (ld_document_get_sheet (fixture->document, a, NULL));
+	g_assert (ld_document_get_sheet (fixture->document, b, NULL));
+	g_assert (ld_document_get_sheet (fixture->document, c, NULL));
+	g_assert (!ld_document_is_loaded (fixture->document, a));
+	g_assert (ld_document_is_loaded (fixture->document, b));
+	g_assert (ld_document_is_loaded (fixture->document, c));
+
+	/* Retrieving a loaded sheet makes it the most recently used one. */
+	g_assert (ld_document_get_sheet (fixture->document, b, NULL));
+	g_assert (ld_document_get_sheet (fixture->document, a, NULL));
+	g_assert (ld_document_is_loaded (fixture->document, a));
+	g_assert (ld_document_is_loaded (fixture->document, b));
+	g_assert (!ld_document_is_loaded (fixture->document, c));
+
+	g_free (c);
+	g_free (b);
+	g_free (a);
+}
+
+static void
+document_test_signals (Document *fixture, gconstpointer user_data)
+{
+	gchar *a, *b;
+
+	a = write_sheet (fixture, "a.ldd", NULL, 0);
+	b = write_sheet (fixture, "b.ldd", NULL, 0);
+
+	g_assert (ld_document_get_sheet (fixture->document, a, NULL));
+	g_assert (ld_document_get_sheet (fixture->document, b, NULL));
+	g_assert (ld_document_get_sheet (fixture->document, a, NULL));
+	g_assert_cmpstr (fixture->events->str, ==, "+a.ldd +b.ldd ");
+
+	/* The active sheet is never unloaded. */
+	g_assert (ld_document_open_sheet (fixture->document, b, NULL));
+	ld_document_set_budget (fixture->document, 0);
+	g_assert_cmpstr (fixture->events->str, ==, "+a.ldd +b.ldd -a.ldd ");
+
+	g_free (b);
+	g_free (a);
+}
+
+static void
+document_test_keep (Document *fixture, gconstpointer user_data)
+{
+	LdDiagramObject *object;
+	LdDiagram *diagram;
+	gchar *a, *b;
+
+	a = write_sheet (fixture, "a.ldd", NULL, 0);
+	b = write_sheet (fixture, "b.ldd", NULL, 0);
+	ld_document_set_budget (fixture->document, 0);
+
+	/* Held sheets stay loaded until they're released. */
+	g_assert (ld_document_hold_sheet (fixture->document, a, NULL));
+	diagram = ld_document_get_sheet (fixture->document, b, NULL);
+	g_assert (ld_document_is_loaded (fixture->document, a));
+
+	/* So do sheets with unsaved changes, until they're saved. */
+	object = ld_diagram_object_new (NULL);
+	ld_diagram_insert_object (diagram, object, -1);
+	g_object_unref (object);
+	g_assert (ld_document_get_sheet (fixture->document, a, NULL));
+	g_assert (ld_document_is_loaded (fixture->document, b));
+
+	ld_document_release_sheet (fixture->document, a);
+	g_assert (!ld_document_is_loaded (fixture->document, a));
+	g_assert (ld_document_is_loaded (fixture->document, b));
+
+	g_assert (ld_document_save (fixture->document, NULL));
+	g_assert (!ld_document_is_loaded (fixture->document, b));
+
+	g_free (b);
+	g_free (a);
+}
+
+static void
+document_test_save (Document *fixture, gconstpointer user_data)
+{
+	static const gchar replacement[] = "{}";
+	LdDiagramObject *object;
+	LdDiagram *diagram, *loaded;
+	gchar *a, *b, *contents;
+
+	a = write_sheet (fixture, "a.ldd", NULL, 0);
+	b = write_sheet (fixture, "b.ldd", NULL, 0);
+
+	diagram = ld_document_get_sheet (fixture->document, a, NULL);
+	object = ld_diagram_object_new (NULL);
+	ld_diagram_insert_object (diagram, object, -1);
+	g_object_unref (object);
+	g_assert (ld_document_get_sheet (fixture->document, b, NULL));
+
+	/* An unmodified sheet mustn't overwrite changes made elsewhere. */
+	g_assert (g_file_set_contents (b, replacement, -1, NULL));
+	g_assert (ld_document_save (fixture->document, NULL));
+	g_assert (!ld_diagram_get_modified (diagram));
+
+	g_assert (g_file_get_contents (b, &contents, NULL, NULL));
+	g_assert_cmpstr (contents, ==, replacement);
+	g_free (contents);
+
+	loaded = ld_diagram_new ();
+	g_assert (ld_diagram_load_from_file (loaded, a, NULL));
+	g_assert_cmpuint (g_list_length (ld_diagram_get_objects (loaded)), ==, 2);
+	g_object_unref (loaded);
+
+	g_free (b);
+	g_free (a);
+}
+
+static void
+document_test_find_label (Document *fixture, gconstpointer user_data)
+{
+	LdDiagramSymbol *symbol;
+	gchar *a, *b;
+	GList *sheets;
+
+	a = write_sheet (fixture, "a.ldd", "VCC", 0);
+	b = write_sheet (fixture, "b.ldd", "VCC", 0);
+
+	/* Sheets that have never been loaded aren't searched. */
+	g_assert (ld_document_get_sheet (fixture->document, a, NULL));
+	sheets = ld_document_find_label (fixture->document, "VCC");
+	g_assert_cmpuint (g_list_length (sheets), ==, 1);
+	g_assert_cmpstr (sheets->data, ==, a);
+	g_list_free (sheets);
+
+	/* Unloaded ones still are. */
+	ld_document_set_budget (fixture->document, 0);
+	g_assert (!ld_document_is_loaded (fixture->document, a));
+	g_assert (ld_document_get_sheet (fixture->document, b, NULL));
+	sheets = ld_document_find_label (fixture->document, "VCC");
+	g_assert_cmpuint (g_list_length (sheets), ==, 2);
+	g_list_free (sheets);
+
+	g_assert (!ld_document_find_label (fixture->document, "GND"));
+
+	/* Changes to loaded sheets are picked up. */
+	symbol = ld_diagram_symbol_new (NULL);
+	ld_diagram_symbol_set_label (symbol, "GND");
+	ld_diagram_insert_object (ld_document_get_sheet
+		(fixture->document, b, NULL), LD_DIAGRAM_OBJECT (symbol), -1);
+	g_object_unref (symbol);
+	sheets = ld_document_find_label (fixture->document, "GND");
+	g_assert_cmpuint (g_list_length (sheets), ==, 1);
+	g_assert_cmpstr (sheets->data, ==, b);
+	g_list_free (sheets);
+
+	g_free (b);
+	g_free (a);
+}
+
+static void
+document_test_missing (Document *fixture, gconstpointer user_data)
+{
+	LdDiagram *diagram;
+	GError *error;
+	gchar *a, *path;
+
+	/* Missing sheets are new and empty. */
+	path = g_build_filename (fixture->directory, "new.ldd", NULL);
+	diagram = ld_document_get_sheet (fixture->document, path, NULL);
+	g_assert (diagram != NULL);
+	g_assert (!ld_diagram_get_objects (diagram));
+	g_free (path);
+
+	/* Sheets that can't be reached for other reasons are errors. */
+	a = write_sheet (fixture, "a.ldd", NULL, 0);
+	path = g_build_filename (a, "b.ldd", NULL);
+	error = NULL;
+	g_assert (!ld_document_get_sheet (fixture->document, path, &error));
+	g_assert_error (error, G_FILE_ERROR, G_FILE_ERROR_NOTDIR);
+	g_assert (!ld_document_is_loaded (fixture->document, path));
+	g_error_free (error);
+	g_free (path);
+	g_free (a);
+}
+
+static void
+document_test_compressed (Document *fixture, gconstpointer user_data)
+{
+	LdDiagramSymbol *symbol;
+	LdDiagram *diagram;
+	gchar *a, *path;
+	guint i;
+
+	diagram = ld_diagram_new ();
+	for (i = 0; i < 100; i++)
+	{
+		symbol = ld_diagram_symbol_new (NULL);
+		ld_diagram_symbol_set_class (symbol, "Generic/Resistor");
+		ld_diagram_insert_object (diagram, LD_DIAGRAM_OBJECT (symbol), -1);
+		g_object_unref (symbol);
+	}
+
+	a = g_build_filename (fixture->directory, "a.ldd", NULL);
+	ld_diagram_set_compression_level (diagram, 9);
+	g_assert (ld_diagram_save_to_file (diagram, a, NULL));
+	g_object_unref (diagram);
+
+	/* The sheet costs more than the size of its file. */
+	ld_document_set_budget (fixture->document, get_file_size (a));
+	g_assert (ld_document_get_sheet (fixture->document, a, NULL));
+	g_assert (ld_document_is_loaded (fixture->document, a));
+
+	path = g_build_filename (fixture->directory, "new.ldd", NULL);
+	g_assert (ld_document_get_sheet (fixture->document, path, NULL));
+	g_assert (!ld_document_is_loaded (fixture->document, a));
+	g_free (path);
+	g_free (a);
+}
+
+static void
+document_test_sheets (Document *fixture, gconstpointer user_data)
+{
+	LdDiagramSymbol *symbol;
+	LdDiagram *child, *root;
+	gchar *root_path, *child_path;
+	GList *sheets;
+
+	root_path = g_build_filename (fixture->directory, "root.ldd", NULL);
+	root = ld_diagram_new ();
+	symbol = ld_diagram_symbol_new (NULL);
+	ld_diagram_symbol_set_sheet (symbol, "child.ldd");
+	ld_diagram_insert_object (root, LD_DIAGRAM_OBJECT (symbol), -1);
+	g_object_unref (symbol);
+	g_assert (ld_diagram_save_to_file (root, root_path, NULL));
+	g_object_unref (root);
+
+	child_path = write_sheet (fixture, "child.ldd", "VCC", 0);
+
+	/* Only the sheets that are navigated to get loaded. */
+	root = ld_document_open_sheet (fixture->document, NULL, NULL);
+	g_assert (root != NULL);
+	g_assert (!ld_document_is_loaded (fixture->document, child_path));
+
+	symbol = ld_diagram_get_objects (root)->data;
+	child = ld_document_enter_sheet (fixture->document, symbol, NULL);
+	g_assert (child != NULL);
+	g_assert (ld_document_is_loaded (fixture->document, child_path));
+	g_assert_cmpstr (ld_document_get_active_sheet (fixture->document),
+		==, child_path);
+
+	sheets = ld_document_find_label (fixture->document, "VCC");
+	g_assert_cmpuint (g_list_length (sheets), ==, 1);
+	g_assert_cmpstr (sheets->data, ==, child_path);
+	g_list_free (sheets);
+
+	/* Inactive sheets are unloaded to meet the budget. */
+	ld_document_set_budget (fixture->document, 0);
+	g_assert (!ld_document_is_loaded (fixture->document, root_path));
+	g_assert (ld_document_is_loaded (fixture->document, child_path));
+
+	g_free (child_path);
+	g_free (root_path);
+}
+
+int
+main (int argc, char *argv[])
+{
+	gtk_test_init (&argc, &argv, NULL);
+
+	g_test_add ("/document/lru", Document, NULL,
+		document_setup, document_test_lru,
+		document_teardown);
+	g_test_add ("/document/signals", Document, NULL,
+		document_setup, document_test_signals,
+		document_teardown);
+	g_test_add ("/document/keep", Document, NULL,
+		document_setup, document_test_keep,
+		document_teardown);
+	g_test_add ("/document/save", Document, NULL,
+		document_setup, document_test_save,
+		document_teardown);
+	g_test_add ("/document/find-label", Document, NULL,
+		document_setup, document_test_find_label,
+		document_teardown);
+	g_test_add ("/document/missing", Document, NULL,
+		document_setup, document_test_missing,
+		document_teardown);
+	g_test_add ("/document/compressed", Document, NULL,
+		document_setup, document_test_compressed,
+		document_teardown);
+	g_test_add ("/document/sheets", Document, NULL,
+		document_setup, document_test_sheets,
+		document_teardown);
+
+	return g_test_run ();
+}
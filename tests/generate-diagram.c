@@ -0,0 +1,617 @@
+/*
+ * generate-diagram.c
+ *
+ * This file is a part of logdiag.
+ * Copyright 2026 Přemysl Eric Janouch
+ *
+ * See the file LICENSE for licensing information.
+ *
+ */
+
+#include <stdlib.h>
+#include <errno.h>
+#include <math.h>
+#include <glib/gstdio.h>
+
+#include <liblogdiag/liblogdiag.h>
+#include "config.h"
+
+/* Distance between symbols laid out on a grid. */
+#define GRID_SPACING 16
+/* Half the width of generated symbols. */
+#define SYMBOL_HALF_WIDTH 4
+/* How many following symbols a wire may lead to. */
+#define WIRE_REACH 8
+
+static gint option_seed = 1;
+static gint option_objects = 1000;
+static gint option_kinds = 8;
+static gdouble option_skew = 1;
+static gdouble option_wires = 1;
+static gint option_clusters = 0;
+static gdouble option_spread = 40;
+static gdouble option_dangling = 0.05;
+static gchar *option_category = "Synthetic";
+static gchar *option_library = NULL;
+static gchar *option_output = NULL;
+static gboolean option_verify = FALSE;
+
+static GOptionEntry option_entries[] =
+{
+	{"seed", 's', 0, G_OPTION_ARG_INT, &option_seed,
+		"Seed for the random generator", "N"},
+	{"objects", 'n', 0, G_OPTION_ARG_INT, &option_objects,
+		"The number of symbols and wires together", "N"},
+	{"kinds", 'k', 0, G_OPTION_ARG_INT, &option_kinds,
+		"The number of different symbols", "N"},
+	{"skew", 0, 0, G_OPTION_ARG_DOUBLE, &option_skew,
+		"How much more common the first kinds of symbols are", "S"},
+	{"wires", 'w', 0, G_OPTION_ARG_DOUBLE, &option_wires,
+		"The number of wires per symbol", "D"},
+	{"clusters", 'c', 0, G_OPTION_ARG_INT, &option_clusters,
+		"Scatter symbols around this many points instead of a grid", "N"},
+	{"spread", 0, 0, G_OPTION_ARG_DOUBLE, &option_spread,
+		"The standard deviation of distance from cluster centres", "D"},
+	{"dangling", 'd', 0, G_OPTION_ARG_DOUBLE, &option_dangling,
+		"The fraction of symbols and wires left unconnected", "F"},
+	{"category", 0, 0, G_OPTION_ARG_STRING, &option_category,
+		"The name of the generated category of symbols", "NAME"},
+	{"library", 'l', 0, G_OPTION_ARG_FILENAME, &option_library,
+		"Write the symbol library into this directory", "DIR"},
+	{"output", 'o', 0, G_OPTION_ARG_FILENAME, &option_output,
+		"Write the diagram into this file instead of standard output",
+		"FILE"},
+	{"verify", 0, 0, G_OPTION_ARG_NONE, &option_verify,
+		"Load the output back and resolve its symbols in the library", NULL},
+	{NULL}
+};
+
+/*
+ * Kind:
+ * @n_terminals: the number of terminals, split between the left
+ *               and the right side.
+ * @weight: the cumulative probability of this and all previous kinds.
+ */
+typedef struct
+{
+	guint n_terminals;
+	gdouble weight;
+}
+Kind;
+
+/*
+ * Symbol:
+ * @kind: an index into kinds.
+ * @x: horizontal position.
+ * @y: vertical position.
+ * @rotation: an #LdDiagramSymbolRotation value.
+ * @dangling: whether wires should avoid this symbol.
+ */
+typedef struct
+{
+	guint kind;
+	gint x, y;
+	gint rotation;
+	gboolean dangling;
+}
+Symbol;
+
+/* ===== Symbol library ==================================================== */
+
+static void
+kind_get_terminal (const Kind *kind, guint terminal, LdPoint *point)
+{
+	guint left;
+
+	left = (kind->n_terminals + 1) / 2;
+	if (terminal < left)
+	{
+		point->x = -SYMBOL_HALF_WIDTH;
+		point->y = (gint) terminal * 2 - (gint) (left - 1);
+	}
+	else
+	{
+		terminal -= left;
+		point->x = SYMBOL_HALF_WIDTH;
+		point->y = (gint) terminal * 2 - (gint) (kind->n_terminals - left - 1);
+	}
+}
+
+static gint
+kind_get_half_height (const Kind *kind)
+{
+	return (kind->n_terminals + 1) / 2 + 1;
+}
+
+static gchar *
+kind_get_name (guint index)
+{
+	return g_strdup_printf ("Block%u", index + 1);
+}
+
+static GArray *
+generate_kinds (GRand *rand)
+{
+	GArray *kinds;
+	gdouble total;
+	guint i;
+
+	kinds = g_array_sized_new (FALSE, FALSE, sizeof (Kind), option_kinds);
+	for (total = 0, i = 0; i < (guint) option_kinds; i++)
+	{
+		Kind kind;
+
+		kind.n_terminals = g_rand_int_range (rand, 2, 9);
+		kind.weight = total += 1 / pow (i + 1, option_skew);
+		g_array_append_val (kinds, kind);
+	}
+	for (i = 0; i < kinds->len; i++)
+		g_array_index (kinds, Kind, i).weight /= total;
+	return kinds;
+}
+
+static guint
+pick_kind (GArray *kinds, GRand *rand)
+{
+	gdouble value;
+	guint i;
+
+	value = g_rand_double (rand);
+	for (i = 0; i < kinds->len - 1; i++)
+		if (value < g_array_index (kinds, Kind, i).weight)
+			break;
+	return i;
+}
+
+static gchar *
+generate_lua (GArray *kinds)
+{
+	GString *lua;
+	guint i, k;
+
+	lua = g_string_new ("-- Generated by generate-diagram\n");
+	for (i = 0; i < kinds->len; i++)
+	{
+		const Kind *kind;
+		gchar *name;
+		gint height;
+
+		kind = &g_array_index (kinds, Kind, i);
+		height = kind_get_half_height (kind);
+		name = kind_get_name (i);
+
+		g_string_append_printf (lua, "\nlogdiag.register (\"%s\",\n"
+			"\t{en = \"%s\"},\n\t{%d, %d, %d, %d},\n\t{",
+			name, name, -SYMBOL_HALF_WIDTH, -height,
+			SYMBOL_HALF_WIDTH, height);
+		for (k = 0; k < kind->n_terminals; k++)
+		{
+			LdPoint point;
+
+			kind_get_terminal (kind, k, &point);
+			g_string_append_printf (lua, "%s{%g, %g}",
+				k ? ", " : "", point.x, point.y);
+		}
+		g_string_append_printf (lua, "},\n\tfunction (cr)\n"
+			"\t\tcr:move_to (%d, %d)\n"
+			"\t\tcr:line_to (%d, %d)\n"
+			"\t\tcr:line_to (%d, %d)\n"
+			"\t\tcr:line_to (%d, %d)\n"
+			"\t\tcr:close_path ()\n",
+			-SYMBOL_HALF_WIDTH + 1, -height, SYMBOL_HALF_WIDTH - 1, -height,
+			SYMBOL_HALF_WIDTH - 1, height, -SYMBOL_HALF_WIDTH + 1, height);
+		for (k = 0; k < kind->n_terminals; k++)
+		{
+			LdPoint point;
+
+			kind_get_terminal (kind, k, &point);
+			g_string_append_printf (lua,
+				"\t\tcr:move_to (%g, %g)\n\t\tcr:line_to (%g, %g)\n",
+				point.x, point.y, point.x + (point.x < 0 ? 1 : -1), point.y);
+		}
+		g_string_append (lua, "\t\tcr:stroke ()\n\tend)\n");
+		g_free (name);
+	}
+	return g_string_free (lua, FALSE);
+}
+
+static gboolean
+write_library (GArray *kinds, GError **error)
+{
+	gchar *category_dir, *path, *contents;
+	gboolean success;
+
+	category_dir = g_build_filename (option_library, option_category, NULL);
+	if (g_mkdir_with_parents (category_dir, 0755))
+	{
+		g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+			"%s: %s", category_dir, g_strerror (errno));
+		g_free (category_dir);
+		return FALSE;
+	}
+
+	path = g_build_filename (category_dir, "category.json", NULL);
+	contents = g_strdup_printf ("{\n\t\"en\": \"%s\"\n}\n", option_category);
+	success = g_file_set_contents (path, contents, -1, error);
+	g_free (contents);
+	g_free (path);
+
+	if (success)
+	{
+		path = g_build_filename (category_dir, "symbols.lua", NULL);
+		contents = generate_lua (kinds);
+		success = g_file_set_contents (path, contents, -1, error);
+		g_free (contents);
+		g_free (path);
+	}
+
+	g_free (category_dir);
+	return success;
+}
+
+/* ===== Diagram =========================================================== */
+
+static void
+rotate_point (LdPoint *point, gint rotation)
+{
+	gdouble temp;
+
+	switch (rotation)
+	{
+	case LD_DIAGRAM_SYMBOL_ROTATION_90:
+		temp = point->y;
+		point->y = point->x;
+		point->x = -temp;
+		break;
+	case LD_DIAGRAM_SYMBOL_ROTATION_180:
+		point->y = -point->y;
+		point->x = -point->x;
+		break;
+	case LD_DIAGRAM_SYMBOL_ROTATION_270:
+		temp = point->x;
+		point->x = point->y;
+		point->y = -temp;
+		break;
+	}
+}
+
+static void
+pick_terminal (GArray *kinds, const Symbol *symbol, GRand *rand,
+	LdPoint *point)
+{
+	const Kind *kind;
+
+	kind = &g_array_index (kinds, Kind, symbol->kind);
+	kind_get_terminal (kind,
+		g_rand_int_range (rand, 0, kind->n_terminals), point);
+	rotate_point (point, symbol->rotation);
+	point->x += symbol->x;
+	point->y += symbol->y;
+}
+
+/*
+ * generate_symbols:
+ *
+ * Either lay symbols out on a square grid or scatter them around cluster
+ * centres.  Symbols of one cluster follow each other, so that wires
+ * between close indexes stay within the cluster.
+ */
+static GArray *
+generate_symbols (GArray *kinds, guint n_symbols, GRand *rand)
+{
+	GArray *symbols;
+	guint columns, i;
+	gdouble field, cx = 0, cy = 0;
+
+	symbols = g_array_sized_new (FALSE, FALSE, sizeof (Symbol), n_symbols);
+	columns = MAX (1, (guint) ceil (sqrt (n_symbols)));
+	field = columns * GRID_SPACING;
+
+	for (i = 0; i < n_symbols; i++)
+	{
+		Symbol symbol;
+
+		symbol.kind = pick_kind (kinds, rand);
+		symbol.rotation = g_rand_int_range (rand, 0, 4);
+		symbol.dangling = g_rand_double (rand) < option_dangling;
+
+		if (option_clusters <= 0)
+		{
+			symbol.x = (i % columns) * GRID_SPACING;
+			symbol.y = (i / columns) * GRID_SPACING;
+		}
+		else
+		{
+			gdouble r, phi;
+
+			if (i % MAX (1, n_symbols / option_clusters) == 0)
+			{
+				cx = g_rand_double_range (rand, 0, field);
+				cy = g_rand_double_range (rand, 0, field);
+			}
+
+			/* Box-Muller, since GRand only has uniform distributions. */
+			r = option_spread
+				* sqrt (-2 * log (1 - g_rand_double (rand)));
+			phi = g_rand_double_range (rand, 0, 2 * G_PI);
+			symbol.x = floor (cx + r * cos (phi) + 0.5);
+			symbol.y = floor (cy + r * sin (phi) + 0.5);
+		}
+		g_array_append_val (symbols, symbol);
+	}
+	return symbols;
+}
+
+static void
+add_symbol (JsonBuilder *builder, const Symbol *symbol)
+{
+	gchar *name, *klass;
+
+	name = kind_get_name (symbol->kind);
+	klass = g_strdup_printf ("%s/%s", option_category, name);
+
+	json_builder_begin_object (builder);
+	json_builder_set_member_name (builder, "type");
+	json_builder_add_string_value (builder, "symbol");
+	json_builder_set_member_name (builder, "class");
+	json_builder_add_string_value (builder, klass);
+	json_builder_set_member_name (builder, "x");
+	json_builder_add_double_value (builder, symbol->x);
+	json_builder_set_member_name (builder, "y");
+	json_builder_add_double_value (builder, symbol->y);
+	json_builder_set_member_name (builder, "rotation");
+	json_builder_add_int_value (builder, symbol->rotation);
+	json_builder_end_object (builder);
+
+	g_free (klass);
+	g_free (name);
+}
+
+static void
+add_wire (JsonBuilder *builder, const LdPoint *start, const LdPoint *end)
+{
+	LdPoint points[4];
+	gdouble middle;
+	guint i;
+
+	/* A horizontal, a vertical and another horizontal segment. */
+	middle = floor ((end->x - start->x) / 2);
+	points[0].x = 0;
+	points[0].y = 0;
+	points[1].x = middle;
+	points[1].y = 0;
+	points[2].x = middle;
+	points[2].y = end->y - start->y;
+	points[3].x = end->x - start->x;
+	points[3].y = end->y - start->y;
+
+	json_builder_begin_object (builder);
+	json_builder_set_member_name (builder, "type");
+	json_builder_add_string_value (builder, "connection");
+	json_builder_set_member_name (builder, "x");
+	json_builder_add_double_value (builder, start->x);
+	json_builder_set_member_name (builder, "y");
+	json_builder_add_double_value (builder, start->y);
+	json_builder_set_member_name (builder, "points");
+	json_builder_begin_array (builder);
+	for (i = 0; i < G_N_ELEMENTS (points); i++)
+	{
+		json_builder_begin_array (builder);
+		json_builder_add_double_value (builder, points[i].x);
+		json_builder_add_double_value (builder, points[i].y);
+		json_builder_end_array (builder);
+	}
+	json_builder_end_array (builder);
+	json_builder_end_object (builder);
+}
+
+/*
+ * generate_diagram:
+ *
+ * Produce a diagram in the format of ld_diagram_save_to_file().
+ * Symbols come first, so that wires are drawn over them.
+ */
+static JsonNode *
+generate_diagram (GArray *kinds, GRand *rand)
+{
+	JsonBuilder *builder;
+	JsonNode *root;
+	GArray *symbols;
+	guint n_symbols, n_wires, i;
+
+	n_symbols = MAX (1, floor (option_objects / (1 + option_wires)));
+	n_wires = option_objects > (gint) n_symbols
+		? option_objects - n_symbols : 0;
+	symbols = generate_symbols (kinds, n_symbols, rand);
+
+	builder = json_builder_new ();
+	json_builder_begin_object (builder);
+	json_builder_set_member_name (builder, "version");
+	json_builder_add_int_value (builder, 1);
+	json_builder_set_member_name (builder, "objects");
+	json_builder_begin_array (builder);
+
+	for (i = 0; i < n_symbols; i++)
+		add_symbol (builder, &g_array_index (symbols, Symbol, i));
+
+	for (i = 0; i < n_wires; i++)
+	{
+		const Symbol *from, *to;
+		LdPoint start, end;
+		guint k;
+
+		k = g_rand_int_range (rand, 0, n_symbols);
+		from = &g_array_index (symbols, Symbol, k);
+		to = &g_array_index (symbols, Symbol,
+			(k + g_rand_int_range (rand, 1, WIRE_REACH + 1)) % n_symbols);
+
+		/* Wires next to symbols that are meant to be left alone
+		 * don't touch them, as if they were leftovers. */
+		if (from->dangling)
+		{
+			start.x = from->x;
+			start.y = from->y + GRID_SPACING / 2;
+		}
+		else
+			pick_terminal (kinds, from, rand, &start);
+
+		if (from->dangling || to->dangling
+		 || g_rand_double (rand) < option_dangling)
+		{
+			end.x = start.x + g_rand_int_range (rand, -GRID_SPACING,
+				GRID_SPACING + 1);
+			end.y = start.y + g_rand_int_range (rand, -GRID_SPACING,
+				GRID_SPACING + 1);
+		}
+		else
+			pick_terminal (kinds, to, rand, &end);
+
+		add_wire (builder, &start, &end);
+	}
+
+	json_builder_end_array (builder);
+	json_builder_end_object (builder);
+
+	root = json_builder_get_root (builder);
+	g_object_unref (builder);
+	g_array_unref (symbols);
+	return root;
+}
+
+/*
+ * verify_output:
+ * @n_objects: the number of objects that have been written.
+ *
+ * Check that the diagram loads with all of its objects and that
+ * every symbol in it can be found in the generated library.
+ */
+static gboolean
+verify_output (guint n_objects)
+{
+	LdLibrary *library;
+	LdDiagram *diagram;
+	GError *error = NULL;
+	GList *iter;
+	guint n_loaded = 0, n_symbols = 0, n_missing = 0;
+
+	library = ld_library_new ();
+	diagram = ld_diagram_new ();
+	if (!ld_library_load (library, option_library))
+	{
+		g_printerr ("%s: %s\n", option_library, "cannot load the library");
+		goto verify_output_end;
+	}
+	if (!ld_diagram_load_from_file (diagram, option_output, &error))
+	{
+		g_printerr ("%s: %s\n", option_output, error->message);
+		g_error_free (error);
+		goto verify_output_end;
+	}
+
+	for (iter = ld_diagram_get_objects (diagram); iter;
+		iter = g_list_next (iter), n_loaded++)
+	{
+		gchar *klass;
+
+		if (!LD_IS_DIAGRAM_SYMBOL (iter->data))
+			continue;
+
+		klass = ld_diagram_symbol_get_class (iter->data);
+		if (!ld_library_find_symbol (library, klass))
+		{
+			g_printerr ("%s: %s\n", klass, "symbol not found");
+			n_missing++;
+		}
+		g_free (klass);
+		n_symbols++;
+	}
+
+verify_output_end:
+	g_object_unref (diagram);
+	g_object_unref (library);
+
+	if (n_loaded != n_objects)
+		g_printerr ("loaded %u of %u objects\n", n_loaded, n_objects);
+	return n_loaded == n_objects && n_symbols && !n_missing;
+}
+
+int
+main (int argc, char *argv[])
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	JsonGenerator *generator;
+	JsonNode *root;
+	GArray *kinds;
+	GRand *rand;
+	gboolean success;
+	guint n_objects;
+
+	context = g_option_context_new
+		("- generate synthetic diagrams and symbol libraries");
+	g_option_context_add_main_entries (context, option_entries, NULL);
+	if (!g_option_context_parse (context, &argc, &argv, &error))
+	{
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		exit (EXIT_FAILURE);
+	}
+	g_option_context_free (context);
+
+	if (option_objects < 1 || option_kinds < 1 || option_wires < 0
+	 || option_dangling < 0 || option_dangling > 1)
+	{
+		g_printerr ("%s\n", "invalid parameters");
+		exit (EXIT_FAILURE);
+	}
+	if (option_verify && (!option_output || !option_library))
+	{
+		g_printerr ("%s\n", "verification needs both the output and a library");
+		exit (EXIT_FAILURE);
+	}
+
+	/* Everything is derived from the seed, in a fixed order. */
+	rand = g_rand_new_with_seed (option_seed);
+	kinds = generate_kinds (rand);
+
+	if (option_library && !write_library (kinds, &error))
+	{
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		exit (EXIT_FAILURE);
+	}
+
+	root = generate_diagram (kinds, rand);
+	n_objects = json_array_get_length (json_object_get_array_member
+		(json_node_get_object (root), "objects"));
+	generator = json_generator_new ();
+	json_generator_set_pretty (generator, TRUE);
+	json_generator_set_root (generator, root);
+
+	if (option_output)
+		success = json_generator_to_file (generator, option_output, &error);
+	else
+	{
+		gchar *json;
+
+		json = json_generator_to_data (generator, NULL);
+		g_print ("%s\n", json);
+		g_free (json);
+		success = TRUE;
+	}
+
+	g_object_unref (generator);
+	json_node_free (root);
+	g_array_unref (kinds);
+	g_rand_free (rand);
+
+	if (!success)
+	{
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		exit (EXIT_FAILURE);
+	}
+	if (option_verify && !verify_output (n_objects))
+		exit (EXIT_FAILURE);
+	return 0;
+}
@@ -0,0 +1,432 @@
+/*
+ * netlist.c
+ *
+ * This file is a part of logdiag.
+ * Copyright 2026 Přemysl Eric Janouch
+ *
+ * See the file LICENSE for licensing information.
+ *
+ */
+
+#include <liblogdiag/liblogdiag.h>
+
+/* A symbol with one terminal on its left and one on its right. */
+typedef LdSymbol TestSymbol;
+typedef LdSymbolClass TestSymbolClass;
+
+static GType test_symbol_get_type (void);
+
+G_DEFINE_TYPE (TestSymbol, test_symbol, LD_TYPE_SYMBOL)
+
+static const gchar *
+test_symbol_get_name (LdSymbol *self)
+{
+	return "two";
+}
+
+static const LdPointArray *
+test_symbol_get_terminals (LdSymbol *self)
+{
+	static LdPoint points[] = {{-1, 0}, {1, 0}};
+	static const LdPointArray terminals = {points, 2, 2};
+
+	return &terminals;
+}
+
+static void
+test_symbol_class_init (TestSymbolClass *klass)
+{
+	klass->get_name = test_symbol_get_name;
+	klass->get_human_name = test_symbol_get_name;
+	klass->get_terminals = test_symbol_get_terminals;
+}
+
+static void
+test_symbol_init (TestSymbol *self)
+{
+}
+
+/* A net label with a single terminal in its origin. */
+typedef LdSymbol TestLabel;
+typedef LdSymbolClass TestLabelClass;
+
+static GType test_label_get_type (void);
+
+G_DEFINE_TYPE (TestLabel, test_label, LD_TYPE_SYMBOL)
+
+static const gchar *
+test_label_get_name (LdSymbol *self)
+{
+	return "label";
+}
+
+static const LdPointArray *
+test_label_get_terminals (LdSymbol *self)
+{
+	static LdPoint points[] = {{0, 0}};
+	static const LdPointArray terminals = {points, 1, 1};
+
+	return &terminals;
+}
+
+static void
+test_label_class_init (TestLabelClass *klass)
+{
+	klass->get_name = test_label_get_name;
+	klass->get_human_name = test_label_get_name;
+	klass->get_terminals = test_label_get_terminals;
+}
+
+static void
+test_label_init (TestLabel *self)
+{
+}
+
+typedef struct
+{
+	LdLibrary *library;
+	LdDiagram *diagram;
+	LdNetlist *netlist;
+}
+Netlist;
+
+static void
+netlist_setup (Netlist *fixture, gconstpointer test_data)
+{
+	LdSymbol *symbol;
+
+	fixture->library = ld_library_new ();
+	symbol = g_object_new (test_symbol_get_type (), NULL);
+	ld_category_insert_symbol (ld_library_get_root (fixture->library),
+		symbol, -1);
+	g_object_unref (symbol);
+	symbol = g_object_new (test_label_get_type (), NULL);
+	ld_category_insert_symbol (ld_library_get_root (fixture->library),
+		symbol, -1);
+	g_object_unref (symbol);
+
+	fixture->diagram = ld_diagram_new ();
+	fixture->netlist = ld_netlist_new (fixture->diagram, fixture->library);
+}
+
+static void
+netlist_teardown (Netlist *fixture, gconstpointer test_data)
+{
+	g_object_unref (fixture->netlist);
+	g_object_unref (fixture->diagram);
+	g_object_unref (fixture->library);
+}
+
+static LdDiagramObject *
+add_symbol (Netlist *fixture, gdouble x, gdouble y)
+{
+	LdDiagramSymbol *symbol;
+
+	symbol = ld_diagram_symbol_new (NULL);
+	ld_diagram_symbol_set_class (symbol, "two");
+	ld_diagram_object_set_x (LD_DIAGRAM_OBJECT (symbol), x);
+	ld_diagram_object_set_y (LD_DIAGRAM_OBJECT (symbol), y);
+	ld_diagram_insert_object (fixture->diagram,
+		LD_DIAGRAM_OBJECT (symbol), -1);
+	g_object_unref (symbol);
+	return LD_DIAGRAM_OBJECT (symbol);
+}
+
+static LdDiagramObject *
+add_label (Netlist *fixture, gdouble x, gdouble y, const gchar *label)
+{
+	LdDiagramSymbol *symbol;
+
+	symbol = ld_diagram_symbol_new (NULL);
+	ld_diagram_symbol_set_class (symbol, "label");
+	ld_diagram_symbol_set_label (symbol, label);
+	ld_diagram_object_set_x (LD_DIAGRAM_OBJECT (symbol), x);
+	ld_diagram_object_set_y (LD_DIAGRAM_OBJECT (symbol), y);
+	ld_diagram_insert_object (fixture->diagram,
+		LD_DIAGRAM_OBJECT (symbol), -1);
+	g_object_unref (symbol);
+	return LD_DIAGRAM_OBJECT (symbol);
+}
+
+static LdDiagramObject *
+add_connection (Netlist *fixture, const LdPoint *points, guint n_points)
+{
+	LdDiagramConnection *connection;
+	LdPointArray *array;
+
+	array = ld_point_array_new ();
+	ld_point_array_insert (array, (LdPoint *) points, 0, n_points);
+	connection = ld_diagram_connection_new (NULL);
+	ld_diagram_connection_set_points (connection, array);
+	ld_point_array_free (array);
+
+	ld_diagram_insert_object (fixture->diagram,
+		LD_DIAGRAM_OBJECT (connection), -1);
+	g_object_unref (connection);
+	return LD_DIAGRAM_OBJECT (connection);
+}
+
+static void
+netlist_test_join (Netlist *fixture, gconstpointer user_data)
+{
+	static const LdPoint wire[] = {{1, 0}, {9, 0}};
+	LdDiagramObject *a, *b, *middle;
+
+	a = add_symbol (fixture, 0, 0);
+	b = add_symbol (fixture, 10, 0);
+	g_assert_cmpuint (ld_netlist_get_n_nets (fixture->netlist), ==, 4);
+	g_assert (!ld_netlist_is_connected (fixture->netlist, a, 1, b, 0));
+
+	add_connection (fixture, wire, G_N_ELEMENTS (wire));
+	g_assert_cmpuint (ld_netlist_get_n_nets (fixture->netlist), ==, 3);
+	g_assert (ld_netlist_is_connected (fixture->netlist, a, 1, b, 0));
+	g_assert (!ld_netlist_is_connected (fixture->netlist, a, 0, b, 1));
+
+	/* Terminals only join connections at their vertices. */
+	middle = add_label (fixture, 5, 0, NULL);
+	g_assert (!ld_netlist_is_connected (fixture->netlist, a, 1, middle, 0));
+	g_assert_cmpuint (ld_netlist_get_n_nets (fixture->netlist), ==, 4);
+}
+
+static void
+netlist_test_crossing (Netlist *fixture, gconstpointer user_data)
+{
+	static const LdPoint first[] = {{0, 0}, {5, 5}, {10, 10}};
+	static const LdPoint second[] = {{0, 10}, {5, 5}, {10, 0}};
+	static const LdPoint branch[] = {{5, 5}, {5, 20}};
+	LdDiagramObject *a, *b;
+
+	/* Wires merely crossing each other aren't joined. */
+	a = add_connection (fixture, first, G_N_ELEMENTS (first));
+	b = add_connection (fixture, second, G_N_ELEMENTS (second));
+	g_assert (!ld_netlist_is_connected (fixture->netlist, a, -1, b, -1));
+
+	/* A wire ending at the crossing joins both. */
+	add_connection (fixture, branch, G_N_ELEMENTS (branch));
+	g_assert (ld_netlist_is_connected (fixture->netlist, a, -1, b, -1));
+	g_assert_cmpuint (ld_netlist_get_n_nets (fixture->netlist), ==, 1);
+}
+
+static void
+netlist_test_split (Netlist *fixture, gconstpointer user_data)
+{
+	static const LdPoint wire[] = {{1, 0}, {9, 0}};
+	LdDiagramObject *a, *b, *connection;
+
+	a = add_symbol (fixture, 0, 0);
+	b = add_symbol (fixture, 10, 0);
+	connection = add_connection (fixture, wire, G_N_ELEMENTS (wire));
+	g_assert (ld_netlist_is_connected (fixture->netlist, a, 1, b, 0));
+
+	/* Moving a symbol away splits the net, moving it back joins it. */
+	ld_diagram_object_set_x (b, 20);
+	g_assert (!ld_netlist_is_connected (fixture->netlist, a, 1, b, 0));
+	g_assert (ld_netlist_is_connected
+		(fixture->netlist, a, 1, connection, -1));
+	g_assert_cmpuint (ld_netlist_get_n_nets (fixture->netlist), ==, 4);
+
+	ld_diagram_object_set_x (b, 10);
+	g_assert (ld_netlist_is_connected (fixture->netlist, a, 1, b, 0));
+	g_assert_cmpuint (ld_netlist_get_n_nets (fixture->netlist), ==, 3);
+
+	/* So does removing the wire in between. */
+	ld_diagram_remove_object (fixture->diagram, connection);
+	g_assert (!ld_netlist_is_connected (fixture->netlist, a, 1, b, 0));
+	g_assert_cmpuint (ld_netlist_get_n_nets (fixture->netlist), ==, 4);
+}
+
+static void
+netlist_test_history (Netlist *fixture, gconstpointer user_data)
+{
+	static const LdPoint wire[] = {{1, 0}, {9, 0}};
+	LdDiagramObject *a, *b, *connection;
+
+	a = add_symbol (fixture, 0, 0);
+	b = add_symbol (fixture, 10, 0);
+	connection = add_connection (fixture, wire, G_N_ELEMENTS (wire));
+
+	ld_diagram_remove_object (fixture->diagram, connection);
+	ld_diagram_undo (fixture->diagram);
+	g_assert (ld_netlist_is_connected (fixture->netlist, a, 1, b, 0));
+	ld_diagram_redo (fixture->diagram);
+	g_assert (!ld_netlist_is_connected (fixture->netlist, a, 1, b, 0));
+	ld_diagram_undo (fixture->diagram);
+
+	ld_diagram_object_set_y (b, 5);
+	g_assert (!ld_netlist_is_connected (fixture->netlist, a, 1, b, 0));
+	ld_diagram_undo (fixture->diagram);
+	g_assert (ld_netlist_is_connected (fixture->netlist, a, 1, b, 0));
+	ld_diagram_redo (fixture->diagram);
+	g_assert (!ld_netlist_is_connected (fixture->netlist, a, 1, b, 0));
+}
+
+static void
+netlist_test_export (Netlist *fixture, gconstpointer user_data)
+{
+	static const LdPoint wire[] = {{1, 0}, {9, 0}};
+	JsonObject *root_object, *net;
+	JsonArray *nets;
+	JsonNode *root;
+	gchar *spice;
+
+	add_symbol (fixture, 0, 0);
+	add_connection (fixture, wire, G_N_ELEMENTS (wire));
+	add_symbol (fixture, 10, 0);
+
+	root = ld_netlist_to_json (fixture->netlist);
+	root_object = json_node_get_object (root);
+	nets = json_object_get_array_member (root_object, "nets");
+	g_assert_cmpuint (json_array_get_length (nets), ==, 3);
+
+	net = json_array_get_object_element (nets, 1);
+	g_assert_cmpstr (json_object_get_string_member (net, "name"), ==, "N2");
+	g_assert_cmpuint (json_array_get_length
+		(json_object_get_array_member (net, "terminals")), ==, 2);
+	json_node_free (root);
+
+	spice = ld_netlist_to_spice (fixture->netlist);
+	g_assert_cmpstr (spice, ==, "* logdiag netlist\n"
+		"X0 N1 N2 two\n"
+		"X2 N2 N3 two\n"
+		".end\n");
+	g_free (spice);
+}
+
+static void
+netlist_test_labels (Netlist *fixture, gconstpointer user_data)
+{
+	LdDiagramObject *a, *b, *label;
+
+	/* Labels with the same name are connected without any wire. */
+	a = add_symbol (fixture, 0, 0);
+	b = add_symbol (fixture, 10, 0);
+	add_label (fixture, 1, 0, "VCC");
+	label = add_label (fixture, 9, 0, "VCC");
+	g_assert (ld_netlist_is_connected (fixture->netlist, a, 1, b, 0));
+	g_assert_cmpuint (ld_netlist_get_n_nets (fixture->netlist), ==, 3);
+
+	/* Labels of symbols with more terminals don't short them. */
+	ld_diagram_symbol_set_label (LD_DIAGRAM_SYMBOL (a), "VCC");
+	g_assert (!ld_netlist_is_connected (fixture->netlist, a, 0, a, 1));
+	g_assert_cmpuint (ld_netlist_get_n_nets (fixture->netlist), ==, 3);
+
+	ld_diagram_symbol_set_label (LD_DIAGRAM_SYMBOL (label), "GND");
+	g_assert (!ld_netlist_is_connected (fixture->netlist, a, 1, b, 0));
+	g_assert_cmpuint (ld_netlist_get_n_nets (fixture->netlist), ==, 4);
+
+	ld_diagram_symbol_set_label (LD_DIAGRAM_SYMBOL (label), "VCC");
+	g_assert (ld_netlist_is_connected (fixture->netlist, a, 1, b, 0));
+	ld_diagram_symbol_set_label (LD_DIAGRAM_SYMBOL (label), NULL);
+	g_assert (!ld_netlist_is_connected (fixture->netlist, a, 1, b, 0));
+}
+
+static void
+netlist_test_label_export (Netlist *fixture, gconstpointer user_data)
+{
+	static const LdPoint wire[] = {{1, 0}, {9, 0}};
+	JsonObject *root_object, *net;
+	JsonArray *nets, *aliases;
+	JsonNode *root;
+	gchar *spice;
+
+	/* Two labels on one net, and a label that looks like a net number. */
+	add_symbol (fixture, 0, 0);
+	add_connection (fixture, wire, G_N_ELEMENTS (wire));
+	add_symbol (fixture, 10, 0);
+	add_symbol (fixture, 30, 0);
+	add_label (fixture, 1, 0, "VCC");
+	add_label (fixture, 9, 0, "AVDD");
+	add_label (fixture, 31, 0, "N3");
+
+	root = ld_netlist_to_json (fixture->netlist);
+	root_object = json_node_get_object (root);
+	nets = json_object_get_array_member (root_object, "nets");
+	g_assert_cmpuint (json_array_get_length (nets), ==, 5);
+
+	net = json_array_get_object_element (nets, 1);
+	g_assert_cmpstr (json_object_get_string_member (net, "name"), ==, "AVDD");
+	g_assert (json_object_get_boolean_member (net, "labelled"));
+	aliases = json_object_get_array_member (net, "aliases");
+	g_assert_cmpuint (json_array_get_length (aliases), ==, 1);
+	g_assert_cmpstr (json_array_get_string_element (aliases, 0), ==, "VCC");
+	g_assert_cmpuint (json_array_get_length
+		(json_object_get_array_member (net, "terminals")), ==, 4);
+
+	/* Names of unlabelled nets are only valid within the sheet. */
+	net = json_array_get_object_element (nets, 2);
+	g_assert_cmpstr (json_object_get_string_member (net, "name"), ==, "N3_1");
+	g_assert (!json_object_get_boolean_member (net, "labelled"));
+	g_assert (!json_object_has_member (net, "aliases"));
+
+	net = json_array_get_object_element (nets, 4);
+	g_assert_cmpstr (json_object_get_string_member (net, "name"), ==, "N3");
+	g_assert (json_object_get_boolean_member (net, "labelled"));
+	g_assert (!json_object_has_member (net, "aliases"));
+	json_node_free (root);
+
+	spice = ld_netlist_to_spice (fixture->netlist);
+	g_assert_cmpstr (spice, ==, "* logdiag netlist\n"
+		"* AVDD is also labelled VCC\n"
+		"X0 N1 AVDD two\n"
+		"X2 AVDD N3_1 two\n"
+		"X3 N4 N3 two\n"
+		"X4 AVDD label\n"
+		"X5 AVDD label\n"
+		"X6 N3 label\n"
+		".end\n");
+	g_free (spice);
+}
+
+static void
+netlist_test_spice_names (Netlist *fixture, gconstpointer user_data)
+{
+	gchar *spice;
+
+	/* Names that SPICE would split are renamed, avoiding existing ones. */
+	add_label (fixture, 0, 0, "V IN");
+	add_label (fixture, 10, 0, "V_IN");
+	add_label (fixture, 20, 0, "A\nB");
+
+	spice = ld_netlist_to_spice (fixture->netlist);
+	g_assert_cmpstr (spice, ==, "* logdiag netlist\n"
+		"* V_IN_1 is labelled V IN\n"
+		"* A_B is labelled A B\n"
+		"X0 V_IN_1 label\n"
+		"X1 V_IN label\n"
+		"X2 A_B label\n"
+		".end\n");
+	g_free (spice);
+}
+
+int
+main (int argc, char *argv[])
+{
+	gtk_test_init (&argc, &argv, NULL);
+
+	g_test_add ("/netlist/join", Netlist, NULL,
+		netlist_setup, netlist_test_join,
+		netlist_teardown);
+	g_test_add ("/netlist/crossing", Netlist, NULL,
+		netlist_setup, netlist_test_crossing,
+		netlist_teardown);
+	g_test_add ("/netlist/split", Netlist, NULL,
+		netlist_setup, netlist_test_split,
+		netlist_teardown);
+	g_test_add ("/netlist/history", Netlist, NULL,
+		netlist_setup, netlist_test_history,
+		netlist_teardown);
+	g_test_add ("/netlist/export", Netlist, NULL,
+		netlist_setup, netlist_test_export,
+		netlist_teardown);
+	g_test_add ("/netlist/labels", Netlist, NULL,
+		netlist_setup, netlist_test_labels,
+		netlist_teardown);
+	g_test_add ("/netlist/label-export", Netlist, NULL,
+		netlist_setup, netlist_test_label_export,
+		netlist_teardown);
+	g_test_add ("/netlist/spice-names", Netlist, NULL,
+		netlist_setup, netlist_test_spice_names,
+		netlist_teardown);
+
+	return g_test_run ();
+}
@@ -0,0 +1,93 @@
+/*
+ * router.c
+ *
+ * This file is a part of logdiag.
+ * Copyright 2026 Přemysl Eric Janouch
+ *
+ * See the file LICENSE for licensing information.
+ *
+ */
+
+#include <liblogdiag/liblogdiag.h>
+
+typedef struct
+{
+	LdRouter *router;
+}
+Router;
+
+static void
+router_setup (Router *fixture, gconstpointer test_data)
+{
+	LdRectangle obstacle = {3, -2, 4, 4};
+
+	fixture->router = ld_router_new ();
+	ld_router_add_obstacle (fixture->router, &obstacle);
+}
+
+static void
+router_teardown (Router *fixture, gconstpointer test_data)
+{
+	ld_router_free (fixture->router);
+}
+
+static void
+assert_route (LdRouter *router, const LdPoint *end,
+	const LdPoint *expected, guint n_expected)
+{
+	LdPoint start = {0, 0};
+	LdPointArray *path;
+	guint i;
+
+	path = ld_router_route (router, &start, end, 10000);
+	g_assert (path != NULL);
+	g_assert_cmpuint (path->length, ==, n_expected);
+	for (i = 0; i < n_expected; i++)
+	{
+		g_assert_cmpfloat (path->points[i].x, ==, expected[i].x);
+		g_assert_cmpfloat (path->points[i].y, ==, expected[i].y);
+	}
+	ld_point_array_free (path);
+}
+
+static void
+router_test_route (Router *fixture, gconstpointer user_data)
+{
+	LdPoint below = {0, 5};
+	LdPoint below_path[] = {{0, 0}, {0, 5}};
+	LdPoint beyond = {10, 5};
+	LdPoint beyond_path[] = {{0, 0}, {0, 5}, {10, 5}};
+	LdPoint behind = {10, 0};
+	LdPoint behind_path[] = {{0, 0}, {0, -2}, {10, -2}, {10, 0}};
+	LdPoint inside = {5, 0};
+	LdPoint inside_path[] = {{0, 0}, {5, 0}};
+
+	assert_route (fixture->router, &below, below_path, 2);
+	assert_route (fixture->router, &beyond, beyond_path, 3);
+	assert_route (fixture->router, &behind, behind_path, 4);
+	assert_route (fixture->router, &inside, inside_path, 2);
+}
+
+static void
+router_test_limits (Router *fixture, gconstpointer user_data)
+{
+	LdPoint start = {0, 0}, off_grid = {10, 0.5}, end = {10, 0};
+
+	g_assert (ld_router_route (fixture->router, &start, &start, 100) == NULL);
+	g_assert (ld_router_route (fixture->router,
+		&start, &off_grid, 10000) == NULL);
+	g_assert (ld_router_route (fixture->router, &start, &end, 5) == NULL);
+}
+
+int
+main (int argc, char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add ("/router/route", Router, NULL,
+		router_setup, router_test_route, router_teardown);
+	g_test_add ("/router/limits", Router, NULL,
+		router_setup, router_test_limits, router_teardown);
+
+	return g_test_run ();
+}
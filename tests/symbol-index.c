@@ -0,0 +1,172 @@
+/*
+ * symbol-index.c
+ *
+ * This file is a part of logdiag.
+ * Copyright 2026 Přemysl Eric Janouch
+ *
+ * See the file LICENSE for licensing information.
+ *
+ */
+
+#include <glib/gstdio.h>
+
+#include <liblogdiag/liblogdiag.h>
+
+typedef struct
+{
+	LdSymbolIndex *index;
+}
+SymbolIndex;
+
+static void
+symbol_index_setup (SymbolIndex *fixture, gconstpointer test_data)
+{
+	const gchar *and_keys[] = {"Logic/AND", "AND gate", NULL};
+	const gchar *nand_keys[] = {"Logic/NAND", "NAND gate", NULL};
+	const gchar *relay_keys[] = {"Electric/Relay", "Relé", NULL};
+
+	fixture->index = ld_symbol_index_new ();
+	ld_symbol_index_insert (fixture->index, "Logic/AND", and_keys);
+	ld_symbol_index_insert (fixture->index, "Logic/NAND", nand_keys);
+	ld_symbol_index_insert (fixture->index, "Electric/Relay", relay_keys);
+}
+
+static void
+symbol_index_teardown (SymbolIndex *fixture, gconstpointer test_data)
+{
+	ld_symbol_index_free (fixture->index);
+}
+
+static void
+assert_query (LdSymbolIndex *index, const gchar *query,
+	const gchar *const *expected)
+{
+	gchar **results;
+	guint i;
+
+	results = ld_symbol_index_query (index, query, 0);
+	for (i = 0; expected[i]; i++)
+		g_assert_cmpstr (results[i], ==, expected[i]);
+	g_assert_cmpstr (results[i], ==, NULL);
+	g_strfreev (results);
+}
+
+static void
+symbol_index_test_query (SymbolIndex *fixture, gconstpointer user_data)
+{
+	const gchar *gate[] = {"Logic/AND", "Logic/NAND", NULL};
+	const gchar *and[] = {"Logic/AND", "Logic/NAND", NULL};
+	const gchar *prefix[] = {"Logic/AND", NULL};
+	const gchar *folded[] = {"Electric/Relay", NULL};
+	const gchar *none[] = {NULL};
+
+	assert_query (fixture->index, "gate", gate);
+	assert_query (fixture->index, "and", and);
+	assert_query (fixture->index, "an", prefix);
+	assert_query (fixture->index, "RELE", folded);
+	assert_query (fixture->index, "logic relay", none);
+	assert_query (fixture->index, "", none);
+}
+
+static void
+symbol_index_test_remove (SymbolIndex *fixture, gconstpointer user_data)
+{
+	const gchar *and[] = {"Logic/NAND", NULL};
+	const gchar *keys[] = {"Logic/AND", "Conjunction", NULL};
+	const gchar *renamed[] = {"Logic/AND", NULL};
+
+	ld_symbol_index_remove (fixture->index, "Logic/AND");
+	assert_query (fixture->index, "and", and);
+
+	ld_symbol_index_insert (fixture->index, "Logic/AND", keys);
+	assert_query (fixture->index, "conj", renamed);
+}
+
+static void
+remove_tree (const gchar *path)
+{
+	const gchar *name;
+	GDir *dir;
+
+	if ((dir = g_dir_open (path, 0, NULL)))
+	{
+		while ((name = g_dir_read_name (dir)))
+		{
+			gchar *child;
+
+			child = g_build_filename (path, name, NULL);
+			remove_tree (child);
+			g_free (child);
+		}
+		g_dir_close (dir);
+	}
+	g_remove (path);
+}
+
+static void
+symbol_index_test_translations (void)
+{
+	const gchar *found[] = {"Passive/R", NULL};
+	LdLibrary *library;
+	gchar *directory, *category, *path, **results;
+	guint i;
+
+	directory = g_dir_make_tmp ("logdiag-XXXXXX", NULL);
+	g_assert (directory != NULL);
+
+	/* Keep the cache of compiled symbols out of the user's home. */
+	g_setenv ("XDG_CACHE_HOME", directory, TRUE);
+
+	category = g_build_filename (directory, "Passive", NULL);
+	g_assert_cmpint (g_mkdir (category, 0755), ==, 0);
+
+	path = g_build_filename (category, "category.json", NULL);
+	g_assert (g_file_set_contents (path, "{\"en\": \"Passive\"}", -1, NULL));
+	g_free (path);
+
+	path = g_build_filename (category, "symbols.lua", NULL);
+	g_assert (g_file_set_contents (path,
+		"logdiag.register (\"R\", {en = \"Resistor\", cs = \"Odpor\"},\n"
+		"\t{-1, -1, 1, 1}, {{-1, 0}, {1, 0}}, function (cr) end)\n",
+		-1, NULL));
+	g_free (path);
+
+	/* Only one of the names can be in the current locale. */
+	library = ld_library_new ();
+	ld_library_set_lazy (library, FALSE);
+	g_assert (ld_library_load (library, directory));
+
+	results = ld_library_search (library, "odpor", 0);
+	for (i = 0; found[i]; i++)
+		g_assert_cmpstr (results[i], ==, found[i]);
+	g_assert_cmpstr (results[i], ==, NULL);
+	g_strfreev (results);
+
+	results = ld_library_search (library, "resistor", 0);
+	for (i = 0; found[i]; i++)
+		g_assert_cmpstr (results[i], ==, found[i]);
+	g_assert_cmpstr (results[i], ==, NULL);
+	g_strfreev (results);
+
+	g_object_unref (library);
+	remove_tree (directory);
+	g_free (category);
+	g_free (directory);
+}
+
+int
+main (int argc, char *argv[])
+{
+	g_test_init (&argc, &argv, NULL);
+
+	g_test_add ("/symbol-index/query", SymbolIndex, NULL,
+		symbol_index_setup, symbol_index_test_query,
+		symbol_index_teardown);
+	g_test_add ("/symbol-index/remove", SymbolIndex, NULL,
+		symbol_index_setup, symbol_index_test_remove,
+		symbol_index_teardown);
+	g_test_add_func ("/symbol-index/translations",
+		symbol_index_test_translations);
+
+	return g_test_run ();
+}